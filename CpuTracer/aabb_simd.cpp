@@ -0,0 +1,178 @@
+﻿#include "aabb_simd.h"
+
+#include <float.h>
+
+#if defined(__AVX2__)
+#define AABB_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AABB_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+void AABBArraySoA::Resize(uint32_t count)
+{
+	count_ = count;
+	for (int i = 0; i < 3; i++)
+	{
+		data_[i].assign(count + kAABBBatchSize, FLT_MAX);
+		data_[i + 3].assign(count + kAABBBatchSize, -FLT_MAX);
+	}
+}
+
+void AABBArraySoA::Set(uint32_t index, const float3& bmin, const float3& bmax)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		data_[i][index] = bmin[i];
+		data_[i + 3][index] = bmax[i];
+	}
+}
+
+void AABBArraySoA::Get(uint32_t index, float3& bmin, float3& bmax) const
+{
+	for (int i = 0; i < 3; i++)
+	{
+		bmin[i] = data_[i][index];
+		bmax[i] = data_[i + 3][index];
+	}
+}
+
+void AABBArraySoA::Save(AccelCacheWriter& writer) const
+{
+	writer.WriteValue(count_);
+	for (int i = 0; i < 6; i++)
+		writer.WriteArray(data_[i]);
+}
+
+bool AABBArraySoA::Load(AccelCacheReader& reader)
+{
+	count_ = 0;
+	uint32_t count;
+	if (!reader.ReadValue(count))
+		return false;
+	for (int i = 0; i < 6; i++)
+	{
+		if (!reader.ReadArray(data_[i]) || data_[i].size() != (size_t)count + kAABBBatchSize)
+			return false;
+	}
+	count_ = count;
+	return true;
+}
+
+uint32_t IntersectAABBBatchScalar(const AABBArraySoA& boxes, uint32_t first, uint32_t count, const RayBoxPrecomp& ray, float tmin, float tmax, float* tEnter)
+{
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float enter = tmin, exit = tmax;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t0 = (boxes.GetComponent(axis)[first + i] - ray.origin[axis]) * ray.invDir[axis];
+			float t1 = (boxes.GetComponent(axis + 3)[first + i] - ray.origin[axis]) * ray.invDir[axis];
+			if (t0 != t0 || t1 != t1)
+				continue;
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		tEnter[i] = enter;
+		if (enter <= exit)
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+#if defined(AABB_SIMD_AVX2)
+
+uint32_t IntersectAABBBatch(const AABBArraySoA& boxes, uint32_t first, uint32_t count, const RayBoxPrecomp& ray, float tmin, float tmax, float* tEnter)
+{
+	const __m256 kNegInf = _mm256_set1_ps(-INFINITY);
+	const __m256 kPosInf = _mm256_set1_ps(INFINITY);
+
+	__m256 enter = _mm256_set1_ps(tmin);
+	__m256 exit = _mm256_set1_ps(tmax);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		__m256 o = _mm256_set1_ps(ray.origin[axis]);
+		__m256 inv = _mm256_set1_ps(ray.invDir[axis]);
+		__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(boxes.GetComponent(axis) + first), o), inv);
+		__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(boxes.GetComponent(axis + 3) + first), o), inv);
+
+		// NaN になった軸は制約なしとして扱う
+		__m256 nan = _mm256_cmp_ps(t0, t1, _CMP_UNORD_Q);
+		__m256 tNear = _mm256_blendv_ps(_mm256_min_ps(t0, t1), kNegInf, nan);
+		__m256 tFar = _mm256_blendv_ps(_mm256_max_ps(t0, t1), kPosInf, nan);
+		enter = _mm256_max_ps(enter, tNear);
+		exit = _mm256_min_ps(exit, tFar);
+	}
+	_mm256_storeu_ps(tEnter, enter);
+
+	uint32_t laneMask = (count >= 8) ? 0xffu : ((1u << count) - 1);
+	return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ)) & laneMask;
+}
+
+uint32_t GetAABBBatchSimdWidth()
+{
+	return 8;
+}
+
+#elif defined(AABB_SIMD_SSE2)
+
+uint32_t IntersectAABBBatch(const AABBArraySoA& boxes, uint32_t first, uint32_t count, const RayBoxPrecomp& ray, float tmin, float tmax, float* tEnter)
+{
+	const __m128 kNegInf = _mm_set1_ps(-INFINITY);
+	const __m128 kPosInf = _mm_set1_ps(INFINITY);
+
+	__m128 o[3], inv[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		o[axis] = _mm_set1_ps(ray.origin[axis]);
+		inv[axis] = _mm_set1_ps(ray.invDir[axis]);
+	}
+
+	// 4個ずつ2回に分けて処理する
+	uint32_t mask = 0;
+	for (uint32_t base = 0; base < count; base += 4)
+	{
+		__m128 enter = _mm_set1_ps(tmin);
+		__m128 exit = _mm_set1_ps(tmax);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(boxes.GetComponent(axis) + first + base), o[axis]), inv[axis]);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(boxes.GetComponent(axis + 3) + first + base), o[axis]), inv[axis]);
+
+			// NaN になった軸は制約なしとして扱う
+			__m128 nan = _mm_cmpunord_ps(t0, t1);
+			__m128 tNear = _mm_or_ps(_mm_andnot_ps(nan, _mm_min_ps(t0, t1)), _mm_and_ps(nan, kNegInf));
+			__m128 tFar = _mm_or_ps(_mm_andnot_ps(nan, _mm_max_ps(t0, t1)), _mm_and_ps(nan, kPosInf));
+			enter = _mm_max_ps(enter, tNear);
+			exit = _mm_min_ps(exit, tFar);
+		}
+		_mm_storeu_ps(tEnter + base, enter);
+		mask |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(enter, exit)) << base;
+	}
+
+	uint32_t laneMask = (count >= 32) ? ~0u : ((1u << count) - 1);
+	return mask & laneMask;
+}
+
+uint32_t GetAABBBatchSimdWidth()
+{
+	return 4;
+}
+
+#else
+
+uint32_t IntersectAABBBatch(const AABBArraySoA& boxes, uint32_t first, uint32_t count, const RayBoxPrecomp& ray, float tmin, float tmax, float* tEnter)
+{
+	return IntersectAABBBatchScalar(boxes, first, count, ray, tmin, tmax, tEnter);
+}
+
+uint32_t GetAABBBatchSimdWidth()
+{
+	return 1;
+}
+
+#endif
+
+//	EOF
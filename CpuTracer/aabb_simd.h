@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "rt_math.h"
+#include "as_cache.h"
+
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// 1本のレイと複数のAABBを一括で判定するカーネル
+// AVX2が有効なら8個、SSE2なら4個ずつまとめて処理し、どちらも使えなければスカラーで処理する
+
+static const uint32_t kAABBBatchSize = 8;
+
+// レイごとに1回だけ計算しておく値
+struct RayBoxPrecomp
+{
+	float3	origin;
+	float3	invDir;
+
+	RayBoxPrecomp()
+	{}
+	RayBoxPrecomp(const float3& o, const float3& dir)
+		: origin(o), invDir(float3(1.0f) / dir)
+	{}
+};
+
+// SoA配置のAABB列
+// 末尾を kAABBBatchSize 個分の空のAABBで埋めておくので、どの位置からでも8個まとめて読み込める
+class AABBArraySoA
+{
+public:
+	void Resize(uint32_t count);
+	void Set(uint32_t index, const float3& bmin, const float3& bmax);
+	void Get(uint32_t index, float3& bmin, float3& bmax) const;
+
+	uint32_t GetCount() const { return count_; }
+	size_t GetMemorySize() const { return data_[0].size() * sizeof(float) * 6; }
+	size_t GetAllocatedSize() const { return data_[0].capacity() * sizeof(float) * 6; }
+	void ShrinkToFit() { for (auto&& d : data_) d.shrink_to_fit(); }
+
+	// 0,1,2 = min xyz、3,4,5 = max xyz
+	const float* GetComponent(int i) const { return data_[i].data(); }
+
+	// キャッシュへの保存と復元
+	void Save(AccelCacheWriter& writer) const;
+	bool Load(AccelCacheReader& reader);
+
+private:
+	std::vector<float>	data_[6];
+	uint32_t			count_ = 0;
+};	// class AABBArraySoA
+
+// boxes の first から count 個（kAABBBatchSize 以下）のAABBとレイの交差判定を行う
+// 交差したAABBのビットが立ったマスクを返し、tEnter に進入距離を格納する
+// 原点がスラブ面上にあって 0 * inf = NaN になる軸は、その軸の判定を無視する
+uint32_t IntersectAABBBatch(const AABBArraySoA& boxes, uint32_t first, uint32_t count, const RayBoxPrecomp& ray, float tmin, float tmax, float* tEnter);
+
+// スカラー版（SIMDが使えない環境での実装と検証用）
+uint32_t IntersectAABBBatchScalar(const AABBArraySoA& boxes, uint32_t first, uint32_t count, const RayBoxPrecomp& ray, float tmin, float tmax, float* tEnter);
+
+// 実際に使われるSIMD幅
+uint32_t GetAABBBatchSimdWidth();
+
+// 立っている最下位ビットの位置（mask != 0 であること）
+inline uint32_t FirstBitIndex(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+//	EOF
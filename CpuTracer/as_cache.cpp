@@ -0,0 +1,203 @@
+﻿#include "as_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	static const char kCacheMagic[4] = { 'A', 'S', 'C', 'H' };
+
+	struct CacheHeader
+	{
+		char		magic[4];
+		uint32_t	version;
+		uint64_t	key;
+		uint8_t		padding[kAccelCacheAlignment - 16];
+	};
+	static_assert(sizeof(CacheHeader) == kAccelCacheAlignment, "header must keep the payload aligned");
+
+	size_t AlignUp(size_t value)
+	{
+		return (value + kAccelCacheAlignment - 1) & ~(kAccelCacheAlignment - 1);
+	}
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+{
+	auto p = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool HashFile(const char* filename, uint64_t& hash)
+{
+	MappedFile file;
+	if (file.Open(filename))
+	{
+		hash = HashBytes(file.GetData(), file.GetSize(), hash);
+		return true;
+	}
+
+	// 空のファイルはマップできないが、内容がないだけなのでハッシュはそのまま（内容の検証は読み込む側で行う）
+	FILE* fp = fopen(filename, "rb");
+	if (!fp)
+		return false;
+	bool isEmpty = (fgetc(fp) == EOF);
+	fclose(fp);
+	return isEmpty;
+}
+
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	file_ = file;
+	mapping_ = mapping;
+	data_ = static_cast<const uint8_t*>(data);
+	size_ = (size_t)size.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	data_ = static_cast<const uint8_t*>(data);
+	size_ = (size_t)st.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping_) CloseHandle(mapping_);
+	if (file_) CloseHandle(file_);
+	mapping_ = nullptr;
+	file_ = nullptr;
+#else
+	if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
+
+AccelCacheWriter::AccelCacheWriter(uint64_t key)
+{
+	CacheHeader header = {};
+	memcpy(header.magic, kCacheMagic, sizeof(header.magic));
+	header.version = kAccelCacheVersion;
+	header.key = key;
+	data_.resize(sizeof(header));
+	memcpy(data_.data(), &header, sizeof(header));
+}
+
+void AccelCacheWriter::WriteRaw(const void* data, size_t elementSize, size_t count)
+{
+	// 要素数もアラインメント単位で置くので、配列の先頭は常に揃う
+	uint64_t count64 = count;
+	size_t pos = data_.size();
+	data_.resize(pos + kAccelCacheAlignment, 0);
+	memcpy(data_.data() + pos, &count64, sizeof(count64));
+
+	size_t size = elementSize * count;
+	pos = data_.size();
+	data_.resize(pos + AlignUp(size), 0);
+	if (size > 0)
+		memcpy(data_.data() + pos, data, size);
+}
+
+bool AccelCacheWriter::Save(const char* filename)
+{
+	FILE* fp = fopen(filename, "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(data_.data(), 1, data_.size(), fp) == data_.size();
+	if (fclose(fp) != 0)
+		ok = false;
+	return ok;
+}
+
+bool AccelCacheReader::Open(const char* filename, uint64_t key)
+{
+	pos_ = 0;
+	if (!file_.Open(filename))
+		return false;
+
+	CacheHeader header;
+	if (file_.GetSize() < sizeof(header))
+		return false;
+	memcpy(&header, file_.GetData(), sizeof(header));
+	if (memcmp(header.magic, kCacheMagic, sizeof(header.magic)) != 0 || header.version != kAccelCacheVersion || header.key != key)
+	{
+		file_.Close();
+		return false;
+	}
+	pos_ = sizeof(header);
+	return true;
+}
+
+bool AccelCacheReader::ReadRaw(size_t elementSize, const void*& data, size_t& count)
+{
+	const size_t fileSize = file_.GetSize();
+	if (pos_ + kAccelCacheAlignment > fileSize)
+		return false;
+
+	uint64_t count64;
+	memcpy(&count64, file_.GetData() + pos_, sizeof(count64));
+	size_t pos = pos_ + kAccelCacheAlignment;
+	if (elementSize > 0 && count64 > (fileSize - pos) / elementSize)
+		return false;
+
+	count = (size_t)count64;
+	data = file_.GetData() + pos;
+	pos_ = pos + AlignUp(elementSize * count);
+	return true;
+}
+
+//	EOF
@@ -0,0 +1,132 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+// 構築済みのアクセラレーション構造を保存するキャッシュファイル
+// 配列を kAccelCacheAlignment 境界に並べただけのコンテナで、読み込み時はファイルをメモリマップして配列をそのまま取り出す
+// ヘッダのキーが一致しない（元データや構築パラメータが変わった）ファイルは読み込まない
+
+static const uint32_t kAccelCacheVersion = 4;
+static const size_t kAccelCacheAlignment = 64;
+
+// FNV-1a（キャッシュのキーに使う）
+static const uint64_t kHashBasis = 14695981039346656037ULL;
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash = kHashBasis);
+
+// ファイルの内容のハッシュ（キャッシュ元のファイルの変更を検出する）
+bool HashFile(const char* filename, uint64_t& hash);
+
+template <typename T>
+uint64_t HashValue(const T& value, uint64_t hash = kHashBasis)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+	return HashBytes(&value, sizeof(value), hash);
+}
+
+// 読み込み専用のメモリマップトファイル
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* filename);
+	void Close();
+
+	const uint8_t* GetData() const { return data_; }
+	size_t GetSize() const { return size_; }
+
+private:
+	const uint8_t*	data_ = nullptr;
+	size_t			size_ = 0;
+#if defined(_WIN32)
+	void*			file_ = nullptr;
+	void*			mapping_ = nullptr;
+#endif
+};	// class MappedFile
+
+class AccelCacheWriter
+{
+public:
+	explicit AccelCacheWriter(uint64_t key);
+
+	// 要素数の後に、アラインメントを揃えて配列の中身を書き込む
+	template <typename T>
+	void WriteArray(const T* values, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "array element must be trivially copyable");
+		WriteRaw(values, sizeof(T), count);
+	}
+	template <typename T>
+	void WriteArray(const std::vector<T>& values)
+	{
+		WriteArray(values.data(), values.size());
+	}
+	template <typename T>
+	void WriteValue(const T& value)
+	{
+		WriteArray(&value, 1);
+	}
+
+	bool Save(const char* filename);
+
+private:
+	void WriteRaw(const void* data, size_t elementSize, size_t count);
+
+	std::vector<uint8_t>	data_;
+};	// class AccelCacheWriter
+
+class AccelCacheReader
+{
+public:
+	// ファイルをマップしてヘッダのマジック、バージョン、キーを確認する
+	bool Open(const char* filename, uint64_t key);
+
+	// マップしたメモリ上の配列を直接参照する（Reader が生きている間だけ有効）
+	template <typename T>
+	bool ReadArrayView(const T*& values, size_t& count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "array element must be trivially copyable");
+		const void* p;
+		if (!ReadRaw(sizeof(T), p, count))
+			return false;
+		values = static_cast<const T*>(p);
+		return true;
+	}
+	template <typename T>
+	bool ReadArray(std::vector<T>& values)
+	{
+		const T* p;
+		size_t count;
+		if (!ReadArrayView(p, count))
+			return false;
+		values.assign(p, p + count);
+		return true;
+	}
+	template <typename T>
+	bool ReadValue(T& value)
+	{
+		const T* p;
+		size_t count;
+		if (!ReadArrayView(p, count) || count != 1)
+			return false;
+		value = *p;
+		return true;
+	}
+
+	// すべて読み終わったか
+	bool IsEnd() const { return pos_ == file_.GetSize(); }
+
+private:
+	bool ReadRaw(size_t elementSize, const void*& data, size_t& count);
+
+	MappedFile	file_;
+	size_t		pos_ = 0;
+};	// class AccelCacheReader
+
+//	EOF
@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include "range_free_list.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// ASのメモリブロックを作る側の抽象
+// D3D12 ではデフォルトヒープのバッファ、CpuTracer では配列（CpuAsMemoryHeap）で実装する
+class AsMemoryHeap
+{
+public:
+	virtual ~AsMemoryHeap() {}
+
+	// size バイトのブロックを作り、GPUアドレスを返す（アドレスは AsMemoryPool::kAlignment 境界）
+	virtual bool CreateBlock(uint64_t size, uint64_t* pAddress) = 0;
+
+	// CreateBlock で作ったブロックをすべて破棄する
+	virtual void DestroyBlocks() = 0;
+};	// class AsMemoryHeap
+
+// AsMemoryPool から確保した領域
+struct AsAllocation
+{
+	uint32_t	block = 0;
+	uint64_t	offset = 0;
+	uint64_t	size = 0;				// kAlignment に切り上げたサイズ
+	uint64_t	address = 0;
+};
+
+struct AsMemoryPoolStats
+{
+	uint32_t	blockCount = 0;
+	uint64_t	blockBytes = 0;
+	uint64_t	usedBytes = 0;
+	uint64_t	peakBytes = 0;
+	uint64_t	allocCount = 0;
+};
+
+// ASの結果やスクラッチを大きなブロックから切り出すプール
+// 結果とスクラッチはリソースの状態が違うので、それぞれ別のプール（別の AsMemoryHeap）にする
+// 同時に構築するASにはそれぞれ別のスクラッチを切り出し、構築が終わったら（フェンスを待ってから）Free で返す
+class AsMemoryPool
+{
+public:
+	static const uint64_t kAlignment = 256;		// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT
+
+	void Init(AsMemoryHeap* pHeap, uint64_t blockSize)
+	{
+		pHeap_ = pHeap;
+		blockSize_ = (blockSize + kAlignment - 1) & ~(kAlignment - 1);
+		blocks_.clear();
+		stats_ = AsMemoryPoolStats();
+	}
+
+	// size バイトを kAlignment 境界に確保する
+	// どのブロックにも収まらなければ新しいブロックを作り、ブロックより大きなものはそれ専用のブロックにする
+	bool Allocate(uint64_t size, AsAllocation& alloc)
+	{
+		size = (std::max<uint64_t>(size, 1) + kAlignment - 1) & ~(kAlignment - 1);
+		for (uint32_t i = 0; i < (uint32_t)blocks_.size(); i++)
+		{
+			uint64_t offset = blocks_[i].freeList.Allocate(size);
+			if (offset != RangeFreeList::kInvalid)
+			{
+				SetAllocation(i, offset, size, alloc);
+				return true;
+			}
+		}
+
+		Block block;
+		block.size = std::max(size, blockSize_);
+		if (!pHeap_->CreateBlock(block.size, &block.address))
+			return false;
+		block.freeList.Free(size, block.size - size);
+		blocks_.push_back(block);
+		stats_.blockCount++;
+		stats_.blockBytes += block.size;
+		SetAllocation((uint32_t)blocks_.size() - 1, 0, size, alloc);
+		return true;
+	}
+
+	// GPUがもう使っていない領域を返す
+	void Free(const AsAllocation& alloc)
+	{
+		if (alloc.size == 0)
+			return;
+		blocks_[alloc.block].freeList.Free(alloc.offset, alloc.size);
+		stats_.usedBytes -= alloc.size;
+	}
+
+	// すべての領域とブロックを捨てる
+	void Reset()
+	{
+		if (pHeap_ != nullptr)
+			pHeap_->DestroyBlocks();
+		blocks_.clear();
+		stats_ = AsMemoryPoolStats();
+	}
+
+	const AsMemoryPoolStats& GetStats() const { return stats_; }
+
+private:
+	struct Block
+	{
+		uint64_t		size = 0;
+		uint64_t		address = 0;
+		RangeFreeList	freeList;
+	};
+
+	void SetAllocation(uint32_t blockIndex, uint64_t offset, uint64_t size, AsAllocation& alloc)
+	{
+		alloc.block = blockIndex;
+		alloc.offset = offset;
+		alloc.size = size;
+		alloc.address = blocks_[blockIndex].address + offset;
+		stats_.allocCount++;
+		stats_.usedBytes += size;
+		stats_.peakBytes = std::max(stats_.peakBytes, stats_.usedBytes);
+	}
+
+	AsMemoryHeap*			pHeap_ = nullptr;
+	uint64_t				blockSize_ = 0;
+	std::vector<Block>		blocks_;
+	AsMemoryPoolStats		stats_;
+};	// class AsMemoryPool
+
+//	EOF
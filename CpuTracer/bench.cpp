@@ -0,0 +1,267 @@
+﻿#include "bench.h"
+#include "scene01.h"
+#include "scene02.h"
+#include "shader03.h"
+#include "random.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	// rays を kBenchBatchSize 本ずつトレースして計測する
+	// traceGroup は rays[count]（groupSize 本以下）をまとめてトレースしてヒットした数を返す
+	// 走査統計とヒット数はレイ列が同じなら毎回同じなので、最初の1回だけ集計する
+	template <typename TraceGroup>
+	BenchResult MeasureRayGroups(const char* sample, const char* rayType, const std::vector<RayDesc>& rays, uint32_t repeat, uint32_t groupSize, TraceGroup traceGroup)
+	{
+		BenchResult result;
+		result.sample = sample;
+		result.rayType = rayType;
+		result.rayCount = rays.size();
+		if (rays.empty())
+			return result;
+
+		const size_t batchCount = (rays.size() + kBenchBatchSize - 1) / kBenchBatchSize;
+		std::vector<double> batchNs(batchCount), bestNs;
+		double bestSeconds = 0.0;
+		for (uint32_t r = 0; r < repeat; r++)
+		{
+			TraversalStats topStats, bottomStats;
+			TraversalStats* pTop = (r == 0) ? &topStats : nullptr;
+			TraversalStats* pBottom = (r == 0) ? &bottomStats : nullptr;
+			uint64_t hitCount = 0;
+
+			double seconds = 0.0;
+			for (size_t b = 0; b < batchCount; b++)
+			{
+				size_t first = b * kBenchBatchSize;
+				size_t last = std::min(first + kBenchBatchSize, rays.size());
+
+				auto start = std::chrono::steady_clock::now();
+				for (size_t i = first; i < last; i += groupSize)
+				{
+					hitCount += traceGroup(&rays[i], (uint32_t)std::min<size_t>(groupSize, last - i), pTop, pBottom);
+				}
+				auto end = std::chrono::steady_clock::now();
+
+				double sec = std::chrono::duration<double>(end - start).count();
+				seconds += sec;
+				batchNs[b] = sec * 1e9 / (double)(last - first);
+			}
+
+			if (r == 0)
+			{
+				result.hitCount = hitCount;
+				result.nodeVisits = topStats.nodeVisits + bottomStats.nodeVisits;
+				result.primTests = bottomStats.primTests;
+			}
+			if (r == 0 || seconds < bestSeconds)
+			{
+				bestSeconds = seconds;
+				bestNs = batchNs;
+			}
+		}
+
+		result.seconds = bestSeconds;
+		std::sort(bestNs.begin(), bestNs.end());
+		const double kPercentiles[3] = { 0.5, 0.9, 0.99 };
+		for (int i = 0; i < 3; i++)
+		{
+			size_t index = std::min((size_t)(kPercentiles[i] * (double)bestNs.size()), bestNs.size() - 1);
+			result.latencyNs[i] = bestNs[index];
+		}
+		return result;
+	}
+
+	// trace はレイ1本をトレースしてヒットしたかを返す
+	template <typename Trace>
+	BenchResult MeasureRays(const char* sample, const char* rayType, const std::vector<RayDesc>& rays, uint32_t repeat, Trace trace)
+	{
+		return MeasureRayGroups(sample, rayType, rays, repeat, 1, [&](const RayDesc* group, uint32_t, TraversalStats* pTop, TraversalStats* pBottom)
+		{
+			return trace(group[0], pTop, pBottom) ? 1u : 0u;
+		});
+	}
+
+	// 鏡面反射方向
+	float3 Reflect(const float3& dir, const float3& normal)
+	{
+		return dir - 2.0f * dot(dir, normal) * normal;
+	}
+
+	bool BenchScene01(const BenchDesc& desc, std::vector<BenchResult>& results)
+	{
+		Scene01 scene;
+		if (!InitScene01(scene))
+			return false;
+
+		// ステンシル領域内のレイだけを集める
+		Random rnd(desc.seed);
+		std::vector<RayDesc> primary;
+		primary.reserve(desc.rayCount);
+		while (primary.size() < desc.rayCount)
+		{
+			RayDesc ray;
+			if (MakeScene01Ray(scene, rnd.NextFloat(), rnd.NextFloat(), ray))
+				primary.push_back(ray);
+		}
+
+		results.push_back(MeasureRays("sample01", "primary", primary, desc.repeat, [&](const RayDesc& ray, TraversalStats* pTop, TraversalStats* pBottom)
+		{
+			TriangleHit hit;
+			return IntersectScene01(scene, ray, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, hit, pTop, pBottom);
+		}));
+		return true;
+	}
+
+	bool BenchScene02(const BenchDesc& desc, std::vector<BenchResult>& results)
+	{
+		Scene02 scene;
+		if (!InitScene02(scene, Scene02Desc()))
+			return false;
+		SceneCB cb = MakeScene02CB(desc.frame, desc.width, desc.height);
+
+		// プライマリレイはピクセル内でジッタリングし、ヒット位置から二次レイを生成する
+		Random rnd(desc.seed);
+		std::vector<RayDesc> primary, shadow, reflection;
+		primary.reserve(desc.rayCount);
+		float3 lightDir = normalize(-cb.lightDir.xyz());
+		for (uint32_t i = 0; i < desc.rayCount; i++)
+		{
+			float px = rnd.NextFloat(0.0f, (float)desc.width);
+			float py = rnd.NextFloat(0.0f, (float)desc.height);
+			RayDesc ray = MakeCameraRay(cb, px, py, desc.width, desc.height);
+			primary.push_back(ray);
+
+			InstanceHit hit;
+			if (!IntersectScene02(scene, ray, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, hit))
+				continue;
+
+			float3 origin = ray.Origin + ray.Direction * hit.triangle.t;
+			float3 normal = GetScene02Normal(scene, hit);
+
+			// Sample02 はシャドウレイを飛ばさないので、Sample03 と同じ条件のレイを計測用に生成する
+			RayDesc shadowRay = { origin, 1e-4f, lightDir, 10000.0f };
+			shadow.push_back(shadowRay);
+
+			RayDesc reflRay = { origin, 1e-4f, Reflect(ray.Direction, normal), 10000.0f };
+			reflection.push_back(reflRay);
+		}
+
+		auto Trace = [&](uint32_t rayFlags)
+		{
+			return [&scene, rayFlags](const RayDesc& ray, TraversalStats* pTop, TraversalStats* pBottom)
+			{
+				InstanceHit hit;
+				return IntersectScene02(scene, ray, rayFlags, ~0u, hit, pTop, pBottom);
+			};
+		};
+		const uint32_t kSecondaryFlags = RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH;
+		results.push_back(MeasureRays("sample02", "primary", primary, desc.repeat, Trace(RAY_FLAG_CULL_BACK_FACING_TRIANGLES)));
+		results.push_back(MeasureRays("sample02", "shadow", shadow, desc.repeat, Trace(kSecondaryFlags)));
+		results.push_back(MeasureRays("sample02", "reflection", reflection, desc.repeat, Trace(kSecondaryFlags)));
+		return true;
+	}
+
+	bool BenchScene03(const BenchDesc& desc, std::vector<BenchResult>& results)
+	{
+		Scene03 scene;
+		if (!InitScene03(scene))
+			return false;
+		SceneCB cb = MakeScene03CB(desc.frame, desc.width, desc.height);
+
+		TraceContext03 ctx;
+		ctx.scene = &scene;
+		ctx.cb = &cb;
+
+		// test.r.hlsl と同じく、シャドウレイは全ヒット位置から、反射レイは内側の箱のヒット位置から飛ばす
+		Random rnd(desc.seed);
+		std::vector<RayDesc> primary, shadow, reflection;
+		primary.reserve(desc.rayCount);
+		float3 lightDir = normalize(-cb.lightDir.xyz());
+		for (uint32_t i = 0; i < desc.rayCount; i++)
+		{
+			float px = rnd.NextFloat(0.0f, (float)desc.width);
+			float py = rnd.NextFloat(0.0f, (float)desc.height);
+			RayDesc ray = MakeCameraRay(cb, px, py, desc.width, desc.height);
+			primary.push_back(ray);
+
+			HitInfo03 hit;
+			if (!TraceRayQuery03(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, 0, 1, ray, hit))
+				continue;
+
+			float3 origin = ray.Origin + ray.Direction * hit.t;
+			RayDesc shadowRay = { origin, 1e-4f, lightDir, 10000.0f };
+			shadow.push_back(shadowRay);
+
+			if (hit.hitGroupIndex == kInnerBoxHitGroup)
+			{
+				RayDesc reflRay = { origin, 1e-5f, Reflect(ray.Direction, hit.normal), 10000.0f };
+				reflection.push_back(reflRay);
+			}
+		}
+
+		auto Trace = [&](uint32_t rayFlags, uint32_t contribution)
+		{
+			return [&ctx, rayFlags, contribution](const RayDesc& ray, TraversalStats* pTop, TraversalStats* pBottom)
+			{
+				ctx.pTopStats = pTop;
+				ctx.pBottomStats = pBottom;
+				HitInfo03 hit;
+				return TraceRayQuery03(ctx, rayFlags, ~0u, contribution, 1, ray, hit);
+			};
+		};
+		results.push_back(MeasureRays("sample03", "primary", primary, desc.repeat, Trace(RAY_FLAG_CULL_BACK_FACING_TRIANGLES, 0)));
+		results.push_back(MeasureRays("sample03", "shadow", shadow, desc.repeat, Trace(RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH, 1)));
+		results.push_back(MeasureRays("sample03", "reflection", reflection, desc.repeat, Trace(RAY_FLAG_CULL_BACK_FACING_TRIANGLES, 0)));
+
+		// シャドウレイを遮蔽判定で調べる（shadow と同じレイで、ヒット数も同じになる）
+		results.push_back(MeasureRays("sample03", "occluded", shadow, desc.repeat, [&](const RayDesc& ray, TraversalStats* pTop, TraversalStats* pBottom)
+		{
+			ctx.pTopStats = pTop;
+			ctx.pBottomStats = pBottom;
+			return Occluded03(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, 1, 1, ray);
+		}));
+		const uint32_t kOcclusionBatchSizes[] = { 4, 8, 16 };
+		for (uint32_t batchSize : kOcclusionBatchSizes)
+		{
+			std::string rayType = "occluded" + std::to_string(batchSize);
+			results.push_back(MeasureRayGroups("sample03", rayType.c_str(), shadow, desc.repeat, batchSize, [&](const RayDesc* rays, uint32_t count, TraversalStats* pTop, TraversalStats* pBottom)
+			{
+				ctx.pTopStats = pTop;
+				ctx.pBottomStats = pBottom;
+				uint32_t hitCount = 0;
+				for (uint32_t mask = OccludedBatch03(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, 1, 1, rays, count); mask != 0; mask &= mask - 1)
+					hitCount++;
+				return hitCount;
+			}));
+		}
+		return true;
+	}
+}
+
+bool RunBenchmarks(const BenchDesc& desc, std::vector<BenchResult>& results)
+{
+	if (desc.width == 0 || desc.height == 0 || desc.rayCount == 0 || desc.repeat == 0)
+		return false;
+
+	return BenchScene01(desc, results)
+		&& BenchScene02(desc, results)
+		&& BenchScene03(desc, results);
+}
+
+void WriteBenchCSV(FILE* fp, const std::vector<BenchResult>& results)
+{
+	fprintf(fp, "sample,ray_type,rays,seconds,mrays_per_sec,p50_ns,p90_ns,p99_ns,nodes_per_ray,tests_per_ray,hit_rate\n");
+	for (auto&& r : results)
+	{
+		double perRay = (r.rayCount > 0) ? 1.0 / (double)r.rayCount : 0.0;
+		fprintf(fp, "%s,%s,%llu,%.6f,%.3f,%.1f,%.1f,%.1f,%.3f,%.3f,%.4f\n",
+			r.sample.c_str(), r.rayType.c_str(), (unsigned long long)r.rayCount, r.seconds, r.MRaysPerSecond(),
+			r.latencyNs[0], r.latencyNs[1], r.latencyNs[2],
+			(double)r.nodeVisits * perRay, (double)r.primTests * perRay, (double)r.hitCount * perRay);
+	}
+}
+
+//	EOF
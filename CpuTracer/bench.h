@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// 各サンプルのシーンでレイの種類ごとのスループットと走査コストを計測する
+// レイは固定シードの乱数で事前に生成し、1スレッドで計測するので実行ごとに同じレイ列になる
+
+struct BenchDesc
+{
+	uint32_t	width = 1280;			// プライマリレイを生成するスクリーンサイズ
+	uint32_t	height = 720;
+	int			frame = 0;				// カメラアニメーションのフレーム
+	uint32_t	rayCount = 1000000;		// レイの種類ごとのプライマリレイ数（二次レイはヒットした数だけ生成する）
+	uint32_t	repeat = 1;				// 計測回数（最速の結果を採用する）
+	uint64_t	seed = 1;
+};
+
+struct BenchResult
+{
+	std::string	sample;
+	std::string	rayType;
+	uint64_t	rayCount = 0;
+	uint64_t	hitCount = 0;
+	double		seconds = 0.0;
+	double		latencyNs[3] = {};		// p50, p90, p99（kBenchBatchSize 本ずつ計測した1本あたりの時間）
+	uint64_t	nodeVisits = 0;			// トップレベルとボトムレベルの合計
+	uint64_t	primTests = 0;			// ボトムレベルのプリミティブ判定数
+
+	double MRaysPerSecond() const
+	{
+		return (seconds > 0.0) ? (double)rayCount / seconds * 1e-6 : 0.0;
+	}
+};
+
+static const uint32_t kBenchBatchSize = 64;
+
+// Sample01, Sample02, Sample03 のシーンを計測して results に追加する
+bool RunBenchmarks(const BenchDesc& desc, std::vector<BenchResult>& results);
+
+// CSVで書き出す（1行目はヘッダ）
+void WriteBenchCSV(FILE* fp, const std::vector<BenchResult>& results);
+
+//	EOF
@@ -0,0 +1,155 @@
+﻿#include "blas.h"
+
+namespace
+{
+	// トライアングルのAABBを広げる割合
+	const float kTriangleBoundsPadding = 1e-6f;
+}
+
+bool TriangleBlas::Build(const TriangleGeometryDesc& geo, const BvhBuildDesc& desc, BvhBuildStats* pStats)
+{
+	triangles_.Resize(0);
+	if (geo.VertexBuffer == nullptr || geo.IndexBuffer == nullptr || geo.VertexStrideInBytes < sizeof(float3))
+	{
+		return false;
+	}
+
+	uint32_t primCount = geo.IndexCount / 3;
+	auto GetPosition = [&](uint16_t index)
+	{
+		auto p = reinterpret_cast<const uint8_t*>(geo.VertexBuffer) + (size_t)geo.VertexStrideInBytes * index;
+		return *reinterpret_cast<const float3*>(p);
+	};
+
+	std::vector<float3> vertices(primCount * 3);
+	std::vector<BoundingBox> bounds(primCount);
+	for (uint32_t i = 0; i < primCount; i++)
+	{
+		const uint16_t* idx = geo.IndexBuffer + i * 3;
+		if (idx[0] >= geo.VertexCount || idx[1] >= geo.VertexCount || idx[2] >= geo.VertexCount)
+		{
+			return false;
+		}
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			vertices[i * 3 + k] = GetPosition(idx[k]);
+			bounds[i].Grow(vertices[i * 3 + k]);
+		}
+
+		// 辺や頂点を通るレイがスラブ判定の誤差でノードを外れないように、座標の大きさに応じて少し広げておく
+		float3 pad = max(abs(bounds[i].bmin), abs(bounds[i].bmax)) * kTriangleBoundsPadding;
+		bounds[i].bmin = bounds[i].bmin - pad;
+		bounds[i].bmax = bounds[i].bmax + pad;
+	}
+
+	if (!bvh_.Build(bounds.data(), primCount, desc, pStats))
+	{
+		return false;
+	}
+
+	// リーフから連続して読めるようにBVHのプリミティブ順に並べ替える
+	auto&& primIndices = bvh_.GetPrimIndices();
+	triangles_.Resize(primCount);
+	for (uint32_t i = 0; i < primCount; i++)
+	{
+		const float3* v = &vertices[primIndices[i] * 3];
+		triangles_.Set(i, v[0], v[1], v[2]);
+	}
+	return true;
+}
+
+bool TriangleBlas::Intersect(const RayDesc& ray, uint32_t rayFlags, TriangleHit& hit, TraversalStats* pStats) const
+{
+	bool isHit = false;
+	bool acceptFirst = (rayFlags & RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH) != 0;
+
+	RayTrianglePrecomp precomp(ray.Origin, ray.Direction);
+	auto&& primIndices = bvh_.GetPrimIndices();
+	float tmax = ray.TMax;
+	bvh_.TraverseLeaves(ray.Origin, ray.Direction, ray.TMin, tmax, [&](uint32_t first, uint32_t count, float& tcur)
+	{
+		for (uint32_t base = 0; base < count; base += kTriangleBatchSize)
+		{
+			uint32_t n = std::min(count - base, kTriangleBatchSize);
+			float t[kTriangleBatchSize], u[kTriangleBatchSize], v[kTriangleBatchSize];
+			uint32_t mask = IntersectTriangleBatch(triangles_, first + base, n, precomp, rayFlags, ray.TMin, tcur, t, u, v);
+			if (pStats) pStats->primTests += n;
+
+			// 同じ距離なら先に並んでいるトライアングルを残す
+			for (; mask != 0; mask &= mask - 1)
+			{
+				uint32_t i = FirstBitIndex(mask);
+				if (t[i] >= tcur)
+					continue;
+
+				tcur = t[i];
+				hit.t = t[i];
+				hit.barycentrics.x = u[i];
+				hit.barycentrics.y = v[i];
+				hit.primitiveIndex = primIndices[first + base + i];
+				isHit = true;
+				if (acceptFirst)
+					return true;
+			}
+		}
+		return false;
+	}, pStats);
+
+	return isHit;
+}
+
+void TriangleBlas::Save(AccelCacheWriter& writer) const
+{
+	bvh_.Save(writer);
+	triangles_.Save(writer);
+}
+
+bool TriangleBlas::Load(AccelCacheReader& reader)
+{
+	if (!bvh_.Load(reader) || !triangles_.Load(reader) || triangles_.GetCount() != bvh_.GetPrimIndices().size())
+	{
+		triangles_.Resize(0);
+		return false;
+	}
+	return true;
+}
+
+bool ProceduralBlas::Build(const RaytracingAABB* aabbs, uint32_t count, const BvhBuildDesc& desc, BvhBuildStats* pStats)
+{
+	std::vector<BoundingBox> bounds(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		bounds[i].bmin = float3(aabbs[i].MinX, aabbs[i].MinY, aabbs[i].MinZ);
+		bounds[i].bmax = float3(aabbs[i].MaxX, aabbs[i].MaxY, aabbs[i].MaxZ);
+	}
+
+	if (!bvh_.Build(bounds.data(), count, desc, pStats))
+	{
+		boxes_.Resize(0);
+		return false;
+	}
+
+	// リーフから連続して読めるようにBVHのプリミティブ順に並べ替える
+	auto&& primIndices = bvh_.GetPrimIndices();
+	boxes_.Resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		auto&& b = bounds[primIndices[i]];
+		boxes_.Set(i, b.bmin, b.bmax);
+	}
+	return true;
+}
+
+void ProceduralBlas::Save(AccelCacheWriter& writer) const
+{
+	bvh_.Save(writer);
+	boxes_.Save(writer);
+}
+
+bool ProceduralBlas::Load(AccelCacheReader& reader)
+{
+	return bvh_.Load(reader) && boxes_.Load(reader) && boxes_.GetCount() == bvh_.GetPrimIndices().size();
+}
+
+//	EOF
@@ -0,0 +1,200 @@
+﻿#pragma once
+
+#include "raytracing.h"
+#include "bvh.h"
+#include "aabb_simd.h"
+#include "triangle_simd.h"
+#include "packet.h"
+
+// トライアングルジオメトリのボトムレベルAS
+
+// D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC 相当
+// 頂点は先頭に float3 の位置を持つこと（DXGI_FORMAT_R32G32B32_FLOAT）、インデックスは16bit（DXGI_FORMAT_R16_UINT）
+struct TriangleGeometryDesc
+{
+	const void*		VertexBuffer = nullptr;
+	uint32_t		VertexStrideInBytes = 0;
+	uint32_t		VertexCount = 0;
+	const uint16_t*	IndexBuffer = nullptr;
+	uint32_t		IndexCount = 0;
+};
+
+// BuiltInTriangleIntersectionAttributes を含むヒット情報
+struct TriangleHit
+{
+	float		t;
+	float2		barycentrics;
+	uint32_t	primitiveIndex;
+};
+
+class TriangleBlas
+{
+public:
+	bool Build(const TriangleGeometryDesc& geo, const BvhBuildDesc& desc, BvhBuildStats* pStats = nullptr);
+
+	// オブジェクト空間のレイで交差判定する
+	// RAY_FLAG_CULL_BACK_FACING_TRIANGLES, RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH に対応
+	// リーフ内のトライアングルは水密な判定でまとめて判定するので、共有する辺や頂点をレイがすり抜けない
+	bool Intersect(const RayDesc& ray, uint32_t rayFlags, TriangleHit& hit, TraversalStats* pStats = nullptr) const;
+
+	const Bvh& GetBvh() const { return bvh_; }
+	uint32_t GetPrimitiveCount() const { return triangles_.GetCount(); }
+
+	// キャッシュへの保存と復元
+	void Save(AccelCacheWriter& writer) const;
+	bool Load(AccelCacheReader& reader);
+	size_t GetMemorySize() const { return bvh_.GetMemorySize() + triangles_.GetMemorySize(); }
+	size_t GetAllocatedSize() const { return bvh_.GetAllocatedSize() + triangles_.GetAllocatedSize(); }
+
+	// 構築後にノードを format の形式に変換して小さくする
+	void Compact(BvhNodeFormat format) { bvh_.Compact(format); triangles_.ShrinkToFit(); }
+
+private:
+	Bvh						bvh_;
+	TriangleArraySoA		triangles_;		// リーフから連続して読めるようにBVHのプリミティブ順に格納
+};	// class TriangleBlas
+
+// プロシージャルAABBジオメトリのボトムレベルAS
+// 交差判定自体は交差シェーダが行うので、AABBに当たったプリミティブを列挙するだけ
+// リーフ内のAABBはSoA配置にしてまとめて判定する
+class ProceduralBlas
+{
+public:
+	bool Build(const RaytracingAABB* aabbs, uint32_t count, const BvhBuildDesc& desc, BvhBuildStats* pStats = nullptr);
+
+	// オブジェクト空間のレイがAABBに当たるプリミティブについて func(primitiveIndex, tmax) を呼び出す
+	// func は交差があれば tmax を更新し、探索を打ち切る場合は true を返す
+	template <typename Func>
+	void Traverse(const RayDesc& ray, float& tmax, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		RayBoxPrecomp precomp(ray.Origin, ray.Direction);
+		auto&& primIndices = bvh_.GetPrimIndices();
+		bvh_.TraverseLeaves(ray.Origin, ray.Direction, ray.TMin, tmax, [&](uint32_t first, uint32_t count, float& tcur)
+		{
+			for (uint32_t base = 0; base < count; base += kAABBBatchSize)
+			{
+				uint32_t n = std::min(count - base, kAABBBatchSize);
+				float tEnter[kAABBBatchSize];
+				uint32_t mask = IntersectAABBBatch(boxes_, first + base, n, precomp, ray.TMin, tcur, tEnter);
+				if (pStats) pStats->primTests += n;
+				for (; mask != 0; mask &= mask - 1)
+				{
+					if (func(primIndices[first + base + FirstBitIndex(mask)], tcur))
+						return true;
+				}
+			}
+			return false;
+		}, pStats);
+	}
+
+	// パケット内の各レイについて、AABBに当たるプリミティブごとに func(rayIndex, primitiveIndex) を呼び出す
+	// rayTMax はレイごとの tmax で、func は交差があれば rayTMax[rayIndex] を更新する
+	// 方向の符号が揃っていないパケットはレイ1本ずつの走査に切り替える
+	template <typename Func>
+	void TraversePacket(const RayPacket& packet, float* rayTMax, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		if (!packet.isCoherent)
+		{
+			for (uint32_t r = 0; r < packet.rayCount; r++)
+			{
+				RayDesc ray = { packet.origin, packet.tmin, packet.directions[r], rayTMax[r] };
+				Traverse(ray, rayTMax[r], [&](uint32_t prim, float&)
+				{
+					func(r, prim);
+					return false;
+				}, pStats);
+			}
+			return;
+		}
+
+		auto PacketTMax = [&]()
+		{
+			float t = packet.tmin;
+			for (uint32_t r = 0; r < packet.rayCount; r++) t = std::max(t, rayTMax[r]);
+			return t;
+		};
+
+		float packetTMax = PacketTMax();
+		auto&& primIndices = bvh_.GetPrimIndices();
+		bvh_.TraverseLeavesWith([&](const BvhNode& node, float tcur, float& tEnter)
+		{
+			return IntersectPacketBox(packet, node.bmin, node.bmax, tcur, tEnter);
+		}, packetTMax, [&](uint32_t first, uint32_t count, float& tcur)
+		{
+			// リーフではレイごとにAABBをまとめて判定する
+			for (uint32_t r = 0; r < packet.rayCount; r++)
+			{
+				RayBoxPrecomp precomp;
+				precomp.origin = packet.origin;
+				precomp.invDir = packet.invDirections[r];
+				for (uint32_t base = 0; base < count; base += kAABBBatchSize)
+				{
+					uint32_t n = std::min(count - base, kAABBBatchSize);
+					float tEnter[kAABBBatchSize];
+					uint32_t mask = IntersectAABBBatch(boxes_, first + base, n, precomp, packet.tmin, rayTMax[r], tEnter);
+					if (pStats) pStats->primTests += n;
+					for (; mask != 0; mask &= mask - 1)
+					{
+						func(r, primIndices[first + base + FirstBitIndex(mask)]);
+					}
+				}
+			}
+			tcur = PacketTMax();
+			return false;
+		}, pStats);
+	}
+
+	// レイの束の activeMask の各レイについて、AABBに当たるプリミティブごとに func(rayIndex, primitiveIndex) を呼び出す
+	// func がそのレイの走査を終える場合は true を返し、レイのビットを activeMask から外す
+	// すべてのレイが終わったら走査をやめる
+	template <typename Func>
+	void TraverseBatch(RayBatch& batch, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		auto&& primIndices = bvh_.GetPrimIndices();
+		float batchTMax = batch.GetMaxTMax();
+		bvh_.TraverseLeavesWith([&](const BvhNode& node, float, float& tEnter)
+		{
+			return IntersectBatchBox(batch, node.bmin, node.bmax, tEnter);
+		}, batchTMax, [&](uint32_t first, uint32_t count, float&)
+		{
+			// リーフではレイごとにAABBをまとめて判定する
+			for (uint32_t mask = batch.activeMask; mask != 0; mask &= mask - 1)
+			{
+				uint32_t r = FirstBitIndex(mask);
+				bool isDone = false;
+				for (uint32_t base = 0; base < count && !isDone; base += kAABBBatchSize)
+				{
+					uint32_t n = std::min(count - base, kAABBBatchSize);
+					float tEnter[kAABBBatchSize];
+					uint32_t hitMask = IntersectAABBBatch(boxes_, first + base, n, batch.rays[r], batch.tmin[r], batch.tmax[r], tEnter);
+					if (pStats) pStats->primTests += n;
+					for (; hitMask != 0 && !isDone; hitMask &= hitMask - 1)
+					{
+						isDone = func(r, primIndices[first + base + FirstBitIndex(hitMask)]);
+					}
+				}
+				if (isDone)
+					batch.activeMask &= ~(1u << r);
+			}
+			return batch.activeMask == 0;
+		}, pStats);
+	}
+
+	const Bvh& GetBvh() const { return bvh_; }
+	uint32_t GetPrimitiveCount() const { return boxes_.GetCount(); }
+	size_t GetMemorySize() const { return bvh_.GetMemorySize() + boxes_.GetMemorySize(); }
+	size_t GetAllocatedSize() const { return bvh_.GetAllocatedSize() + boxes_.GetAllocatedSize(); }
+
+	// 構築後にノードを format の形式に変換して小さくする
+	void Compact(BvhNodeFormat format) { bvh_.Compact(format); boxes_.ShrinkToFit(); }
+
+	// キャッシュへの保存と復元
+	void Save(AccelCacheWriter& writer) const;
+	bool Load(AccelCacheReader& reader);
+
+private:
+	Bvh				bvh_;
+	AABBArraySoA	boxes_;		// BVHのプリミティブ配列順に並べたAABB
+};	// class ProceduralBlas
+
+//	EOF
@@ -0,0 +1,819 @@
+﻿#include "bvh.h"
+
+#include <chrono>
+
+namespace
+{
+	struct BuildTask
+	{
+		uint32_t	nodeIndex;
+		uint32_t	depth;
+	};
+
+	struct Bin
+	{
+		BoundingBox	bounds;
+		uint32_t	count = 0;
+	};
+
+	struct CollapseTask
+	{
+		uint32_t	srcNode;		// 2分木のノード
+		uint32_t	dstNode;		// ワイドノード
+	};
+
+	struct QuantizeTask
+	{
+		uint32_t	srcNode;		// 全精度のノード
+		uint32_t	dstNode;		// 量子化ノード
+		float3		origin;			// 量子化ノードの原点（展開した親のボックスの最小点）
+	};
+
+	// 走査時の展開（QuantizedBvhNode::Decode）と同じ計算
+	float DecodeAxis(float origin, uint32_t q, float scale)
+	{
+		return origin + (float)q * scale;
+	}
+
+	// [origin, bmax] を 254 目盛り以内に収める指数
+	// 丸めで1目盛りずれても 255 に収まるように余裕を持たせる
+	bool ComputeExponent(float origin, float bmax, int8_t& exponent)
+	{
+		float extent = bmax - origin;
+		if (!(extent >= 0.0f) || extent > FLT_MAX)
+			return false;
+
+		int e;
+		frexpf(extent / 254.0f, &e);
+		exponent = (int8_t)std::min(std::max(e, -126), 127);
+		return true;
+	}
+
+	// bmin 以下、bmax 以上に展開される目盛りを求める
+	bool QuantizeAxis(float origin, float scale, float bmin, float bmax, uint8_t& qmin, uint8_t& qmax)
+	{
+		float lo = floorf((bmin - origin) / scale);
+		float hi = ceilf((bmax - origin) / scale);
+		uint32_t qlo = (uint32_t)std::min(std::max(lo, 0.0f), 255.0f);
+		uint32_t qhi = (uint32_t)std::min(std::max(hi, 0.0f), 255.0f);
+		while (qlo > 0 && DecodeAxis(origin, qlo, scale) > bmin)
+			qlo--;
+		while (qhi < 255 && DecodeAxis(origin, qhi, scale) < bmax)
+			qhi++;
+		if (DecodeAxis(origin, qlo, scale) > bmin || DecodeAxis(origin, qhi, scale) < bmax)
+			return false;
+
+		qmin = (uint8_t)qlo;
+		qmax = (uint8_t)qhi;
+		return true;
+	}
+
+	float NodeArea(const BvhNode& n)
+	{
+		BoundingBox b;
+		b.bmin = n.bmin;
+		b.bmax = n.bmax;
+		return b.Area();
+	}
+
+	// 量子化ノードとワイドノードの子の参照が範囲内か
+	// 内部ノードは親より後ろにあるので、ループにはならない
+	bool IsValidChildRef(uint32_t child, size_t parent, size_t nodeCount, size_t primCount)
+	{
+		uint32_t index = BvhChildRef::Index(child);
+		uint32_t count = BvhChildRef::Count(child);
+		if (count > 0)
+			return (size_t)index + count <= primCount;
+		return index > parent && index < nodeCount;
+	}
+
+	bool IsValidRootRef(uint32_t root, size_t nodeCount, size_t primCount)
+	{
+		if (BvhChildRef::Count(root) > 0)
+			return IsValidChildRef(root, 0, nodeCount, primCount);
+		return root == 0 && nodeCount > 0;
+	}
+}
+
+bool Bvh::Build(const BoundingBox* primBounds, uint32_t primCount, const BvhBuildDesc& desc, BvhBuildStats* pStats)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Reset();
+	primIndices_.resize(primCount);
+	if (primCount == 0)
+	{
+		return false;
+	}
+
+	uint32_t binCount = std::max<uint32_t>(desc.binCount, 2);
+	uint32_t maxLeafSize = std::max<uint32_t>(desc.maxLeafSize, 1);
+
+	std::vector<float3> centers(primCount);
+	for (uint32_t i = 0; i < primCount; i++)
+	{
+		primIndices_[i] = i;
+		centers[i] = primBounds[i].Center();
+	}
+
+	// ノード数は最大で 2N-1
+	nodes_.reserve(primCount * 2);
+	{
+		BvhNode root{};
+		root.leftFirst = 0;
+		root.count = primCount;
+		nodes_.push_back(root);
+	}
+
+	BvhBuildStats stats;
+	std::vector<Bin> bins(binCount);
+	std::vector<float> rightArea(binCount);
+	std::vector<uint32_t> rightCount(binCount);
+	std::vector<BuildTask> tasks;
+	tasks.push_back({ 0, 0 });
+	while (!tasks.empty())
+	{
+		auto task = tasks.back();
+		tasks.pop_back();
+
+		// ノードの範囲とセントロイドの範囲を求める
+		uint32_t first = nodes_[task.nodeIndex].leftFirst;
+		uint32_t count = nodes_[task.nodeIndex].count;
+		BoundingBox bounds, centerBounds;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t prim = primIndices_[first + i];
+			bounds.Grow(primBounds[prim]);
+			centerBounds.Grow(centers[prim]);
+		}
+		nodes_[task.nodeIndex].bmin = bounds.bmin;
+		nodes_[task.nodeIndex].bmax = bounds.bmax;
+		stats.maxDepth = std::max(stats.maxDepth, task.depth);
+
+		auto MakeLeaf = [&]()
+		{
+			stats.leafCount++;
+			stats.maxLeafPrims = std::max(stats.maxLeafPrims, count);
+		};
+
+		if (count <= maxLeafSize || task.depth + 1 >= kMaxStackDepth)
+		{
+			MakeLeaf();
+			continue;
+		}
+
+		// 各軸についてビンに振り分け、分割コストが最小になる位置を探す
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float cmin = centerBounds.bmin[axis];
+			float extent = centerBounds.bmax[axis] - cmin;
+			if (extent <= 0.0f)
+				continue;
+
+			float scale = (float)binCount / extent;
+			for (auto&& b : bins) b = Bin();
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t prim = primIndices_[first + i];
+				uint32_t b = std::min((uint32_t)((centers[prim][axis] - cmin) * scale), binCount - 1);
+				bins[b].count++;
+				bins[b].bounds.Grow(primBounds[prim]);
+			}
+
+			// 右からの累積
+			BoundingBox rb;
+			uint32_t rc = 0;
+			for (uint32_t b = binCount - 1; b > 0; b--)
+			{
+				rb.Grow(bins[b].bounds);
+				rc += bins[b].count;
+				rightArea[b] = rb.Area();
+				rightCount[b] = rc;
+			}
+
+			// 左からの累積と評価
+			BoundingBox lb;
+			uint32_t lc = 0;
+			for (uint32_t b = 0; b < binCount - 1; b++)
+			{
+				lb.Grow(bins[b].bounds);
+				lc += bins[b].count;
+				if (lc == 0 || rightCount[b + 1] == 0)
+					continue;
+
+				float cost = lb.Area() * (float)lc + rightArea[b + 1] * (float)rightCount[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		// 分割できない場合はリーフ
+		if (bestAxis < 0)
+		{
+			MakeLeaf();
+			continue;
+		}
+
+		// 分割してもコストが下がらないならリーフにする
+		float parentArea = bounds.Area();
+		float splitCost = desc.traversalCost + desc.intersectCost * bestCost / std::max(parentArea, FLT_MIN);
+		float leafCost = desc.intersectCost * (float)count;
+		if (splitCost >= leafCost && count <= maxLeafSize * 4)
+		{
+			MakeLeaf();
+			continue;
+		}
+
+		// パーティション
+		float cmin = centerBounds.bmin[bestAxis];
+		float scale = (float)binCount / (centerBounds.bmax[bestAxis] - cmin);
+		auto IsLeft = [&](uint32_t prim)
+		{
+			uint32_t b = std::min((uint32_t)((centers[prim][bestAxis] - cmin) * scale), binCount - 1);
+			return b <= bestSplit;
+		};
+		uint32_t i = first, j = first + count;
+		while (i < j)
+		{
+			if (IsLeft(primIndices_[i]))
+				i++;
+			else
+				std::swap(primIndices_[i], primIndices_[--j]);
+		}
+		uint32_t leftCount = i - first;
+
+		// 子ノードは連続して確保する
+		uint32_t childIndex = (uint32_t)nodes_.size();
+		BvhNode child{};
+		child.leftFirst = first;
+		child.count = leftCount;
+		nodes_.push_back(child);
+		child.leftFirst = first + leftCount;
+		child.count = count - leftCount;
+		nodes_.push_back(child);
+
+		nodes_[task.nodeIndex].leftFirst = childIndex;
+		nodes_[task.nodeIndex].count = 0;
+
+		tasks.push_back({ childIndex + 1, task.depth + 1 });
+		tasks.push_back({ childIndex, task.depth + 1 });
+	}
+
+	// 上限で確保した分を実際のノード数に合わせる
+	nodes_.shrink_to_fit();
+
+	auto end = std::chrono::steady_clock::now();
+
+	if (pStats)
+	{
+		stats.seconds = std::chrono::duration<double>(end - start).count();
+		stats.nodeCount = (uint32_t)nodes_.size();
+		stats.sahCost = ComputeSAHCost(desc);
+		*pStats = stats;
+	}
+
+	// 変換できない場合は全精度のノードのまま使う
+	if (desc.nodeFormat == kBvhNodeQuantized)
+		Quantize();
+	else if (GetWideBvhWidth(desc.nodeFormat) > 0)
+		Collapse(GetWideBvhWidth(desc.nodeFormat));
+
+	return true;
+}
+
+void Bvh::Compact(BvhNodeFormat format)
+{
+	// 全精度のノードだけを変換する。変換できない場合は全精度のまま
+	if (format_ == kBvhNodeFull && format != kBvhNodeFull)
+	{
+		if (format == kBvhNodeQuantized)
+			Quantize();
+		else
+			Collapse(GetWideBvhWidth(format));
+	}
+
+	nodes_.shrink_to_fit();
+	primIndices_.shrink_to_fit();
+	quantizedNodes_.shrink_to_fit();
+	wideBounds_.ShrinkToFit();
+	wideChildren_.shrink_to_fit();
+}
+
+void Bvh::Reset()
+{
+	nodes_.clear();
+	format_ = kBvhNodeFull;
+	rootBounds_ = BoundingBox();
+	rootChild_ = BvhChildRef::kEmpty;
+	quantizedNodes_.clear();
+	wideBounds_ = AABBArraySoA();
+	wideChildren_.clear();
+}
+
+bool Bvh::Quantize()
+{
+	if (format_ == kBvhNodeQuantized)
+		return true;
+	if (format_ != kBvhNodeFull || nodes_.empty())
+		return false;
+
+	std::vector<QuantizedBvhNode> qnodes;
+	auto&& root = nodes_[0];
+	BoundingBox rootBounds;
+	rootBounds.bmin = root.bmin;
+	rootBounds.bmax = root.bmax;
+
+	// 量子化ノードは内部ノードの数だけ必要
+	uint32_t rootChild = 0;
+	if (root.IsLeaf())
+	{
+		if (!BvhChildRef::CanEncode(root.leftFirst, root.count))
+			return false;
+		rootChild = BvhChildRef::Make(root.leftFirst, root.count);
+	}
+	else
+	{
+		qnodes.reserve(nodes_.size() / 2);
+		qnodes.push_back(QuantizedBvhNode());
+	}
+
+	// 親から順に量子化し、子の原点には量子化後に展開したボックスを使う
+	std::vector<QuantizeTask> tasks;
+	if (!root.IsLeaf())
+		tasks.push_back({ 0, 0, rootBounds.bmin });
+	while (!tasks.empty())
+	{
+		auto task = tasks.back();
+		tasks.pop_back();
+
+		auto&& src = nodes_[task.srcNode];
+		QuantizedBvhNode dst{};
+
+		// 子のボックスをすべて含む範囲で目盛りを決める
+		BoundingBox childBounds[2];
+		BoundingBox grid;
+		for (int c = 0; c < 2; c++)
+		{
+			auto&& child = nodes_[src.leftFirst + c];
+			childBounds[c].bmin = child.bmin;
+			childBounds[c].bmax = child.bmax;
+			if (childBounds[c].IsValid())
+				grid.Grow(childBounds[c]);
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (grid.IsValid() && !ComputeExponent(task.origin[axis], grid.bmax[axis], dst.exponent[axis]))
+				return false;
+		}
+		float3 scale = dst.GetScale();
+
+		for (int c = 0; c < 2; c++)
+		{
+			uint32_t childIndex = src.leftFirst + c;
+			auto&& child = nodes_[childIndex];
+			if (!childBounds[c].IsValid())
+			{
+				// どのレイとも交差しない子
+				dst.child[c] = BvhChildRef::kEmpty;
+				continue;
+			}
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (!QuantizeAxis(task.origin[axis], scale[axis], childBounds[c].bmin[axis], childBounds[c].bmax[axis], dst.qmin[c][axis], dst.qmax[c][axis]))
+					return false;
+			}
+
+			if (child.IsLeaf())
+			{
+				if (!BvhChildRef::CanEncode(child.leftFirst, child.count))
+					return false;
+				dst.child[c] = BvhChildRef::Make(child.leftFirst, child.count);
+			}
+			else
+			{
+				uint32_t dstChild = (uint32_t)qnodes.size();
+				if (dstChild > BvhChildRef::kMaxIndex)
+					return false;
+				qnodes.push_back(QuantizedBvhNode());
+				dst.child[c] = BvhChildRef::Make(dstChild, 0);
+				tasks.push_back({ childIndex, dstChild, QuantizedBvhNode::Decode(task.origin, scale, dst.qmin[c]) });
+			}
+		}
+		qnodes[task.dstNode] = dst;
+	}
+
+	quantizedNodes_.swap(qnodes);
+	rootBounds_ = rootBounds;
+	rootChild_ = rootChild;
+	format_ = kBvhNodeQuantized;
+	std::vector<BvhNode>().swap(nodes_);
+	return true;
+}
+
+bool Bvh::Collapse(uint32_t width)
+{
+	BvhNodeFormat format = (width == 8) ? kBvhNodeWide8 : (width == 4) ? kBvhNodeWide4 : kBvhNodeFull;
+	if (format == kBvhNodeFull)
+		return false;
+	if (format_ == format)
+		return true;
+	if (format_ != kBvhNodeFull || nodes_.empty())
+		return false;
+
+	auto&& root = nodes_[0];
+	BoundingBox rootBounds;
+	rootBounds.bmin = root.bmin;
+	rootBounds.bmax = root.bmax;
+
+	// 子の参照とボックスは、ワイドノードの数が決まってからSoAに詰める
+	uint32_t rootChild = 0;
+	std::vector<uint32_t> children;
+	std::vector<uint32_t> childSrc;
+	std::vector<CollapseTask> tasks;
+	if (root.IsLeaf())
+	{
+		if (!BvhChildRef::CanEncode(root.leftFirst, root.count))
+			return false;
+		rootChild = BvhChildRef::Make(root.leftFirst, root.count);
+	}
+	else
+	{
+		children.resize(width, (uint32_t)BvhChildRef::kEmpty);
+		childSrc.resize(width);
+		tasks.push_back({ 0, 0 });
+	}
+
+	while (!tasks.empty())
+	{
+		auto task = tasks.back();
+		tasks.pop_back();
+
+		// 表面積が最大の内部ノードを、その2つの子で置き換えることを繰り返す
+		uint32_t slots[kMaxWideBvhWidth];
+		uint32_t slotCount = 2;
+		slots[0] = nodes_[task.srcNode].leftFirst;
+		slots[1] = nodes_[task.srcNode].leftFirst + 1;
+		while (slotCount < width)
+		{
+			int best = -1;
+			float bestArea = -1.0f;
+			for (uint32_t i = 0; i < slotCount; i++)
+			{
+				auto&& node = nodes_[slots[i]];
+				if (!node.IsLeaf() && NodeArea(node) > bestArea)
+				{
+					best = (int)i;
+					bestArea = NodeArea(node);
+				}
+			}
+			if (best < 0)
+				break;
+
+			uint32_t left = nodes_[slots[best]].leftFirst;
+			slots[best] = left;
+			slots[slotCount++] = left + 1;
+		}
+
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			uint32_t slot = task.dstNode * width + i;
+			auto&& node = nodes_[slots[i]];
+			childSrc[slot] = slots[i];
+			if (node.IsLeaf())
+			{
+				if (!BvhChildRef::CanEncode(node.leftFirst, node.count))
+					return false;
+				children[slot] = BvhChildRef::Make(node.leftFirst, node.count);
+			}
+			else
+			{
+				uint32_t dstChild = (uint32_t)(children.size() / width);
+				if (dstChild > BvhChildRef::kMaxIndex)
+					return false;
+				children[slot] = BvhChildRef::Make(dstChild, 0);
+				children.resize(children.size() + width, (uint32_t)BvhChildRef::kEmpty);
+				childSrc.resize(children.size());
+				tasks.push_back({ slots[i], dstChild });
+			}
+		}
+	}
+
+	// 使わない子のボックスは [+inf, +inf] にしておき、SIMD判定で必ず外れるようにする
+	wideBounds_.Resize((uint32_t)children.size());
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		if (children[i] == BvhChildRef::kEmpty)
+		{
+			wideBounds_.Set((uint32_t)i, float3(INFINITY), float3(INFINITY));
+			continue;
+		}
+		auto&& node = nodes_[childSrc[i]];
+		wideBounds_.Set((uint32_t)i, node.bmin, node.bmax);
+	}
+
+	wideChildren_.swap(children);
+	rootBounds_ = rootBounds;
+	rootChild_ = rootChild;
+	format_ = format;
+	std::vector<BvhNode>().swap(nodes_);
+	return true;
+}
+
+bool Bvh::Refit(const BoundingBox* primBounds, uint32_t primCount)
+{
+	if (format_ == kBvhNodeQuantized || primCount != primIndices_.size() || primCount == 0)
+		return false;
+
+	auto LeafBounds = [&](uint32_t first, uint32_t count)
+	{
+		BoundingBox bounds;
+		for (uint32_t i = 0; i < count; i++)
+			bounds.Grow(primBounds[primIndices_[first + i]]);
+		return bounds;
+	};
+
+	// 子は親より後ろにあるので、後ろから更新すれば子のボックスは更新済み
+	if (format_ == kBvhNodeFull)
+	{
+		for (size_t i = nodes_.size(); i-- > 0;)
+		{
+			auto&& node = nodes_[i];
+			BoundingBox bounds;
+			if (node.IsLeaf())
+			{
+				bounds = LeafBounds(node.leftFirst, node.count);
+			}
+			else
+			{
+				auto&& left = nodes_[node.leftFirst];
+				auto&& right = nodes_[node.leftFirst + 1];
+				bounds.bmin = min(left.bmin, right.bmin);
+				bounds.bmax = max(left.bmax, right.bmax);
+			}
+			node.bmin = bounds.bmin;
+			node.bmax = bounds.bmax;
+		}
+		return true;
+	}
+
+	// ワイドノードは子のボックスを持つので、子のワイドノードの全スロットをまとめたものが親のスロットのボックスになる
+	const uint32_t width = GetWideWidth();
+	auto NodeBounds = [&](uint32_t node)
+	{
+		BoundingBox bounds;
+		for (uint32_t i = 0; i < width; i++)
+		{
+			if (wideChildren_[node * width + i] == BvhChildRef::kEmpty)
+				continue;
+			BoundingBox b;
+			wideBounds_.Get(node * width + i, b.bmin, b.bmax);
+			bounds.Grow(b);
+		}
+		return bounds;
+	};
+
+	for (size_t slot = wideChildren_.size(); slot-- > 0;)
+	{
+		uint32_t child = wideChildren_[slot];
+		if (child == BvhChildRef::kEmpty)
+			continue;
+
+		uint32_t count = BvhChildRef::Count(child);
+		auto bounds = (count > 0) ? LeafBounds(BvhChildRef::Index(child), count) : NodeBounds(BvhChildRef::Index(child));
+		wideBounds_.Set((uint32_t)slot, bounds.bmin, bounds.bmax);
+	}
+
+	uint32_t rootCount = BvhChildRef::Count(rootChild_);
+	rootBounds_ = (rootCount > 0) ? LeafBounds(BvhChildRef::Index(rootChild_), rootCount) : NodeBounds(0);
+	return true;
+}
+
+void Bvh::Save(AccelCacheWriter& writer) const
+{
+	writer.WriteValue(format_);
+	writer.WriteArray(primIndices_);
+	switch (format_)
+	{
+	case kBvhNodeQuantized:
+		writer.WriteArray(quantizedNodes_);
+		break;
+	case kBvhNodeWide4:
+	case kBvhNodeWide8:
+		wideBounds_.Save(writer);
+		writer.WriteArray(wideChildren_);
+		break;
+	default:
+		writer.WriteArray(nodes_);
+		return;
+	}
+	writer.WriteValue(rootBounds_);
+	writer.WriteValue(rootChild_);
+}
+
+bool Bvh::Load(AccelCacheReader& reader)
+{
+	Reset();
+
+	BvhNodeFormat format;
+	if (!reader.ReadValue(format) || !reader.ReadArray(primIndices_))
+		return false;
+	if (format == kBvhNodeQuantized)
+		return LoadQuantized(reader);
+	if (GetWideBvhWidth(format) > 0)
+		return LoadWide(reader, format);
+	if (format != kBvhNodeFull || !reader.ReadArray(nodes_) || nodes_.empty())
+	{
+		nodes_.clear();
+		return false;
+	}
+
+	// 走査中に範囲外を参照しないことだけ確認する
+	// 子ノードは親より後ろにあるので、ループにはならない
+	const size_t nodeCount = nodes_.size();
+	const size_t primCount = primIndices_.size();
+	bool isValid = true;
+	for (size_t i = 0; i < nodeCount && isValid; i++)
+	{
+		auto&& node = nodes_[i];
+		if (node.IsLeaf())
+			isValid = (size_t)node.leftFirst + node.count <= primCount;
+		else
+			isValid = node.leftFirst > i && (size_t)node.leftFirst + 1 < nodeCount;
+	}
+	for (size_t i = 0; i < primCount && isValid; i++)
+	{
+		isValid = primIndices_[i] < primCount;
+	}
+
+	if (!isValid)
+	{
+		nodes_.clear();
+		primIndices_.clear();
+	}
+	return isValid;
+}
+
+bool Bvh::LoadQuantized(AccelCacheReader& reader)
+{
+	if (!reader.ReadArray(quantizedNodes_) || !reader.ReadValue(rootBounds_) || !reader.ReadValue(rootChild_))
+	{
+		quantizedNodes_.clear();
+		return false;
+	}
+
+	// 全精度のノードと同じく、範囲外を参照しないことだけ確認する
+	const size_t nodeCount = quantizedNodes_.size();
+	const size_t primCount = primIndices_.size();
+	bool isValid = IsValidRootRef(rootChild_, nodeCount, primCount);
+	for (size_t i = 0; i < nodeCount && isValid; i++)
+	{
+		auto&& node = quantizedNodes_[i];
+		for (int c = 0; c < 2 && isValid; c++)
+			isValid = node.child[c] == BvhChildRef::kEmpty || IsValidChildRef(node.child[c], i, nodeCount, primCount);
+		for (int axis = 0; axis < 3 && isValid; axis++)
+			isValid = node.exponent[axis] >= -126;
+	}
+	for (size_t i = 0; i < primCount && isValid; i++)
+	{
+		isValid = primIndices_[i] < primCount;
+	}
+
+	if (!isValid)
+	{
+		quantizedNodes_.clear();
+		primIndices_.clear();
+		return false;
+	}
+	format_ = kBvhNodeQuantized;
+	return true;
+}
+
+bool Bvh::LoadWide(AccelCacheReader& reader, BvhNodeFormat format)
+{
+	const uint32_t width = GetWideBvhWidth(format);
+	if (!wideBounds_.Load(reader) || !reader.ReadArray(wideChildren_) || !reader.ReadValue(rootBounds_) || !reader.ReadValue(rootChild_)
+		|| wideChildren_.size() % width != 0 || wideBounds_.GetCount() != wideChildren_.size())
+	{
+		Reset();
+		return false;
+	}
+
+	const size_t nodeCount = wideChildren_.size() / width;
+	const size_t primCount = primIndices_.size();
+	bool isValid = IsValidRootRef(rootChild_, nodeCount, primCount);
+	for (size_t i = 0; i < wideChildren_.size() && isValid; i++)
+	{
+		isValid = wideChildren_[i] == BvhChildRef::kEmpty || IsValidChildRef(wideChildren_[i], i / width, nodeCount, primCount);
+	}
+	for (size_t i = 0; i < primCount && isValid; i++)
+	{
+		isValid = primIndices_[i] < primCount;
+	}
+
+	if (!isValid)
+	{
+		Reset();
+		primIndices_.clear();
+		return false;
+	}
+	format_ = format;
+	return true;
+}
+
+float Bvh::ComputeSAHCost(const BvhBuildDesc& desc) const
+{
+	if (format_ == kBvhNodeQuantized)
+		return ComputeQuantizedSAHCost(desc);
+	if (GetWideWidth() > 0)
+		return ComputeWideSAHCost(desc);
+	if (nodes_.empty())
+		return 0.0f;
+
+	float rootArea = std::max(NodeArea(nodes_[0]), FLT_MIN);
+	double cost = 0.0;
+	for (auto&& n : nodes_)
+	{
+		double area = NodeArea(n) / rootArea;
+		if (n.IsLeaf())
+			cost += area * desc.intersectCost * n.count;
+		else
+			cost += area * desc.traversalCost;
+	}
+	return (float)cost;
+}
+
+float Bvh::ComputeQuantizedSAHCost(const BvhBuildDesc& desc) const
+{
+	struct Entry
+	{
+		uint32_t	child;
+		BoundingBox	bounds;
+	};
+
+	// 展開したボックスで、全精度のノードと同じく子を1つずつ数える
+	float rootArea = std::max(rootBounds_.Area(), FLT_MIN);
+	double cost = 0.0;
+	std::vector<Entry> entries;
+	entries.push_back({ rootChild_, rootBounds_ });
+	while (!entries.empty())
+	{
+		auto entry = entries.back();
+		entries.pop_back();
+
+		double area = entry.bounds.Area() / rootArea;
+		uint32_t count = BvhChildRef::Count(entry.child);
+		if (count > 0)
+		{
+			cost += area * desc.intersectCost * count;
+			continue;
+		}
+
+		cost += area * desc.traversalCost;
+		auto&& node = quantizedNodes_[BvhChildRef::Index(entry.child)];
+		float3 scale = node.GetScale();
+		for (int c = 0; c < 2; c++)
+		{
+			if (node.child[c] == BvhChildRef::kEmpty)
+				continue;
+			BoundingBox b;
+			b.bmin = QuantizedBvhNode::Decode(entry.bounds.bmin, scale, node.qmin[c]);
+			b.bmax = QuantizedBvhNode::Decode(entry.bounds.bmin, scale, node.qmax[c]);
+			entries.push_back({ node.child[c], b });
+		}
+	}
+	return (float)cost;
+}
+
+float Bvh::ComputeWideSAHCost(const BvhBuildDesc& desc) const
+{
+	// ワイドノード1つの判定を、2分木のノード1つと同じコストとして数える
+	float rootArea = std::max(rootBounds_.Area(), FLT_MIN);
+	uint32_t rootCount = BvhChildRef::Count(rootChild_);
+	double cost = (rootCount > 0) ? desc.intersectCost * rootCount : desc.traversalCost;
+	for (size_t i = 0; i < wideChildren_.size(); i++)
+	{
+		uint32_t child = wideChildren_[i];
+		if (child == BvhChildRef::kEmpty)
+			continue;
+
+		BoundingBox b;
+		wideBounds_.Get((uint32_t)i, b.bmin, b.bmax);
+		double area = b.Area() / rootArea;
+		uint32_t count = BvhChildRef::Count(child);
+		if (count > 0)
+			cost += area * desc.intersectCost * count;
+		else
+			cost += area * desc.traversalCost;
+	}
+	return (float)cost;
+}
+
+//	EOF
@@ -0,0 +1,529 @@
+﻿#pragma once
+
+#include "rt_math.h"
+#include "as_cache.h"
+#include "aabb_simd.h"
+
+#include <float.h>
+#include <string.h>
+#include <vector>
+
+// バイナリBVH（ビン分割SAHで構築する）
+
+struct BoundingBox
+{
+	float3	bmin = float3(FLT_MAX);
+	float3	bmax = float3(-FLT_MAX);
+
+	void Grow(const float3& p)
+	{
+		bmin = min(bmin, p);
+		bmax = max(bmax, p);
+	}
+	void Grow(const BoundingBox& b)
+	{
+		bmin = min(bmin, b.bmin);
+		bmax = max(bmax, b.bmax);
+	}
+	bool IsValid() const
+	{
+		return bmin.x <= bmax.x && bmin.y <= bmax.y && bmin.z <= bmax.z;
+	}
+	float3 Center() const
+	{
+		return (bmin + bmax) * 0.5f;
+	}
+	float Area() const
+	{
+		if (!IsValid()) return 0.0f;
+		float3 e = bmax - bmin;
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+};
+
+// 32バイトのノード
+// count > 0 ならリーフで、leftFirst はプリミティブ配列の先頭
+// count == 0 なら内部ノードで、leftFirst は左の子（右の子は leftFirst + 1）
+struct BvhNode
+{
+	float3		bmin;
+	uint32_t	leftFirst;
+	float3		bmax;
+	uint32_t	count;
+
+	bool IsLeaf() const { return count > 0; }
+};
+
+// 量子化ノードとワイドノードの子の参照
+// 下位24bitは内部ノードならノード番号、リーフならプリミティブ配列の先頭で、上位8bitがリーフのプリミティブ数（0なら内部ノード）
+struct BvhChildRef
+{
+	static const uint32_t kEmpty = 0;			// ボックスを持たない子（ノード0はルートなので子にはならない）
+	static const uint32_t kMaxIndex = 0xffffff;
+	static const uint32_t kMaxCount = 0xff;
+
+	static uint32_t Make(uint32_t index, uint32_t count) { return (count << 24) | index; }
+	static uint32_t Index(uint32_t child) { return child & kMaxIndex; }
+	static uint32_t Count(uint32_t child) { return child >> 24; }
+	static bool CanEncode(uint32_t index, uint32_t count) { return index <= kMaxIndex && count <= kMaxCount; }
+};
+
+// 量子化した24バイトのノード（2つの子をまとめて持つ）
+// 子のバウンディングボックスは、このノードのボックスの最小点を原点とし 2^exponent を1目盛りとする8bit座標
+struct QuantizedBvhNode
+{
+	uint32_t	child[2];		// BvhChildRef
+	uint8_t		qmin[2][3];
+	uint8_t		qmax[2][3];
+	int8_t		exponent[3];
+	uint8_t		padding;
+
+	// 1目盛りの大きさ（exponent は正規化数の範囲に収めてあるので、指数部を直接作る）
+	float3 GetScale() const
+	{
+		return float3(ExponentToFloat(exponent[0]), ExponentToFloat(exponent[1]), ExponentToFloat(exponent[2]));
+	}
+	static float ExponentToFloat(int e)
+	{
+		uint32_t bits = (uint32_t)(e + 127) << 23;
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+	static float3 Decode(const float3& origin, const float3& scale, const uint8_t q[3])
+	{
+		return float3(origin.x + (float)q[0] * scale.x, origin.y + (float)q[1] * scale.y, origin.z + (float)q[2] * scale.z);
+	}
+};
+
+// ノードの形式
+enum BvhNodeFormat : uint32_t
+{
+	kBvhNodeFull = 0,			// BvhNode（32バイト、float）
+	kBvhNodeQuantized = 1,		// QuantizedBvhNode（子2つで24バイト、8bit）
+	kBvhNodeWide4 = 2,			// 子4つのワイドノード（子のボックスはSoAで、1回のSIMD判定でまとめて調べる）
+	kBvhNodeWide8 = 3,			// 子8つのワイドノード
+};
+
+// ワイドノードの最大の子の数（IntersectAABBBatch で一度に判定できる数）
+static const uint32_t kMaxWideBvhWidth = kAABBBatchSize;
+
+inline uint32_t GetWideBvhWidth(BvhNodeFormat format)
+{
+	return format == kBvhNodeWide8 ? 8 : format == kBvhNodeWide4 ? 4 : 0;
+}
+
+struct BvhBuildDesc
+{
+	uint32_t	binCount = 16;			// 1軸あたりのビン数
+	uint32_t	maxLeafSize = 4;		// これ以下のプリミティブ数ならリーフにする
+	float		traversalCost = 1.0f;	// SAHのノード走査コスト
+	float		intersectCost = 1.0f;	// SAHのプリミティブ交差コスト
+	BvhNodeFormat	nodeFormat = kBvhNodeFull;	// 構築後のノード形式
+};
+
+struct BvhBuildStats
+{
+	double		seconds = 0.0;
+	float		sahCost = 0.0f;
+	uint32_t	nodeCount = 0;
+	uint32_t	leafCount = 0;
+	uint32_t	maxDepth = 0;
+	uint32_t	maxLeafPrims = 0;
+};
+
+// 走査時の統計
+struct TraversalStats
+{
+	uint64_t	nodeVisits = 0;
+	uint64_t	primTests = 0;
+};
+
+class Bvh
+{
+public:
+	static const int kMaxStackDepth = 64;
+
+	// プリミティブのバウンディングボックスから構築する
+	bool Build(const BoundingBox* primBounds, uint32_t primCount, const BvhBuildDesc& desc, BvhBuildStats* pStats = nullptr);
+
+	// 構築済みのノードを量子化ノードに変換し、全精度のノードは解放する
+	// リーフのプリミティブ数やノード数が量子化ノードに収まらない場合は失敗し、全精度のまま残る
+	bool Quantize();
+	bool IsQuantized() const { return format_ == kBvhNodeQuantized; }
+
+	// 構築済みの2分木を子 width 個（4 か 8）のワイドノードにまとめ、全精度のノードは解放する
+	// 失敗する条件は Quantize と同じ
+	bool Collapse(uint32_t width);
+	uint32_t GetWideWidth() const { return GetWideBvhWidth(format_); }
+
+	BvhNodeFormat GetNodeFormat() const { return format_; }
+
+	// 木の構造はそのままで、プリミティブのバウンディングボックスからノードのボックスを更新する（refit）
+	// primCount は構築時と同じであること。量子化ノードは展開先の目盛りが変わるので更新できず、失敗する
+	// プリミティブが大きく動くとボックスの重なりが増えるので、ComputeSAHCost を構築し直した場合と比べて判断する
+	bool Refit(const BoundingBox* primBounds, uint32_t primCount);
+
+	// ルートの表面積で正規化したSAHコスト（量子化済みなら展開したボックスで計算する）
+	float ComputeSAHCost(const BvhBuildDesc& desc) const;
+
+	// キャッシュへの保存と復元（復元時は構築せず、ノードの参照範囲だけ確認する）
+	void Save(AccelCacheWriter& writer) const;
+	bool Load(AccelCacheReader& reader);
+
+	// ノードとプリミティブインデックスのメモリ量
+	size_t GetMemorySize() const
+	{
+		return nodes_.size() * sizeof(BvhNode) + quantizedNodes_.size() * sizeof(QuantizedBvhNode)
+			+ wideBounds_.GetMemorySize() + wideChildren_.size() * sizeof(uint32_t) + primIndices_.size() * sizeof(uint32_t);
+	}
+
+	// 確保済みのメモリ量
+	size_t GetAllocatedSize() const
+	{
+		return nodes_.capacity() * sizeof(BvhNode) + quantizedNodes_.capacity() * sizeof(QuantizedBvhNode)
+			+ wideBounds_.GetAllocatedSize() + wideChildren_.capacity() * sizeof(uint32_t) + primIndices_.capacity() * sizeof(uint32_t);
+	}
+
+	// 構築後のコンパクション（DXRの COPY_MODE_COMPACT 相当）
+	// 全精度のノードを format の形式（量子化やワイドノード）に変換して小さくする
+	// すでに全精度以外の形式の場合や変換できない場合は形式を変えず、余分に確保した分だけを解放する
+	void Compact(BvhNodeFormat format);
+
+	// 量子化やワイドノードへの変換後は、GetNodes() は空になる
+	const std::vector<BvhNode>& GetNodes() const { return nodes_; }
+	const std::vector<QuantizedBvhNode>& GetQuantizedNodes() const { return quantizedNodes_; }
+	const std::vector<uint32_t>& GetPrimIndices() const { return primIndices_; }
+	BoundingBox GetBounds() const
+	{
+		BoundingBox ret;
+		if (format_ != kBvhNodeFull)
+		{
+			ret = rootBounds_;
+		}
+		else if (!nodes_.empty())
+		{
+			ret.bmin = nodes_[0].bmin;
+			ret.bmax = nodes_[0].bmax;
+		}
+		return ret;
+	}
+
+	// レイが通るリーフのプリミティブについて func(primIndex, tmax) を呼び出す
+	// func は交差があれば tmax を更新し、探索を打ち切る場合は true を返す
+	template <typename Func>
+	void Traverse(const float3& origin, const float3& dir, float tmin, float& tmax, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		TraverseLeaves(origin, dir, tmin, tmax, [&](uint32_t first, uint32_t count, float& tcur)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (pStats) pStats->primTests++;
+				if (func(primIndices_[first + i], tcur))
+					return true;
+			}
+			return false;
+		}, pStats);
+	}
+
+	// レイが通るリーフについて func(first, count, tmax) を呼び出す
+	// first, count は GetPrimIndices() 上の範囲で、primTests は呼び出し側で数える
+	template <typename Func>
+	void TraverseLeaves(const float3& origin, const float3& dir, float tmin, float& tmax, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		if (GetWideWidth() > 0)
+		{
+			TraverseWide(RayBoxPrecomp(origin, dir), tmin, tmax, func, pStats);
+			return;
+		}
+
+		float3 invDir = float3(1.0f) / dir;
+		TraverseLeavesWith([&](const BvhNode& node, float tcur, float& tEnter)
+		{
+			return IntersectNode(node, origin, invDir, tmin, tcur, tEnter);
+		}, tmax, func, pStats);
+	}
+
+	// nodeTest(node, tmax, tEnter) が true を返すノードを近い順に辿り、リーフについて func(first, count, tmax) を呼び出す
+	// パケットなど、レイ1本以外の判定で走査する場合に使う
+	template <typename NodeTest, typename Func>
+	void TraverseLeavesWith(NodeTest&& nodeTest, float& tmax, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		if (format_ == kBvhNodeQuantized)
+		{
+			TraverseQuantized(nodeTest, tmax, func, pStats);
+			return;
+		}
+		if (GetWideWidth() > 0)
+		{
+			TraverseWideWith(nodeTest, tmax, func, pStats);
+			return;
+		}
+		if (nodes_.empty())
+			return;
+
+		uint32_t stack[kMaxStackDepth];
+		uint32_t stackPtr = 0;
+		uint32_t nodeIndex = 0;
+		while (true)
+		{
+			auto&& node = nodes_[nodeIndex];
+			if (pStats) pStats->nodeVisits++;
+
+			if (node.IsLeaf())
+			{
+				if (func(node.leftFirst, node.count, tmax))
+					return;
+			}
+			else
+			{
+				// 近い方の子から辿る
+				uint32_t child0 = node.leftFirst, child1 = node.leftFirst + 1;
+				float t0, t1;
+				bool hit0 = nodeTest(nodes_[child0], tmax, t0);
+				bool hit1 = nodeTest(nodes_[child1], tmax, t1);
+				if (hit0 && hit1)
+				{
+					if (t1 < t0) std::swap(child0, child1);
+					stack[stackPtr++] = child1;
+					nodeIndex = child0;
+					continue;
+				}
+				if (hit0) { nodeIndex = child0; continue; }
+				if (hit1) { nodeIndex = child1; continue; }
+			}
+
+			if (stackPtr == 0)
+				break;
+			nodeIndex = stack[--stackPtr];
+		}
+	}
+
+	static bool IntersectNode(const BvhNode& node, const float3& origin, const float3& invDir, float tmin, float tmax, float& tEnter)
+	{
+		return IntersectBox(node.bmin, node.bmax, origin, invDir, tmin, tmax, tEnter);
+	}
+
+	static bool IntersectBox(const float3& bmin, const float3& bmax, const float3& origin, const float3& invDir, float tmin, float tmax, float& tEnter)
+	{
+		float3 t0 = (bmin - origin) * invDir;
+		float3 t1 = (bmax - origin) * invDir;
+		float3 tNear = min(t0, t1);
+		float3 tFar = max(t0, t1);
+		tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, tmin));
+		float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tmax));
+		return tEnter <= tExit;
+	}
+
+private:
+	bool LoadQuantized(AccelCacheReader& reader);
+	bool LoadWide(AccelCacheReader& reader, BvhNodeFormat format);
+	float ComputeQuantizedSAHCost(const BvhBuildDesc& desc) const;
+	float ComputeWideSAHCost(const BvhBuildDesc& desc) const;
+	void Reset();
+
+	// ワイドノードは子ごとに 1段分のスタックを使う可能性がある
+	static const int kMaxWideStackDepth = kMaxStackDepth * (kMaxWideBvhWidth - 1);
+
+	// 当たった子を近い順に order に並べ、その数を返す（幅が小さいので挿入ソート）
+	static uint32_t SortHitChildren(uint32_t mask, const float* tEnter, uint32_t* order)
+	{
+		uint32_t hitCount = 0;
+		for (; mask != 0; mask &= mask - 1)
+		{
+			uint32_t i = FirstBitIndex(mask);
+			uint32_t j = hitCount++;
+			for (; j > 0 && tEnter[order[j - 1]] > tEnter[i]; j--)
+				order[j] = order[j - 1];
+			order[j] = i;
+		}
+		return hitCount;
+	}
+
+	// ワイドノードの走査
+	// 子のボックスは1回のSIMD判定でまとめて調べ、遠い子から積んで近い子を先に辿る
+	template <typename Func>
+	void TraverseWide(const RayBoxPrecomp& ray, float tmin, float& tmax, Func&& func, TraversalStats* pStats) const
+	{
+		const uint32_t width = GetWideWidth();
+		uint32_t stack[kMaxWideStackDepth];
+		uint32_t stackPtr = 0;
+		uint32_t child = rootChild_;
+		while (true)
+		{
+			if (pStats) pStats->nodeVisits++;
+
+			uint32_t count = BvhChildRef::Count(child);
+			if (count > 0)
+			{
+				if (func(BvhChildRef::Index(child), count, tmax))
+					return;
+			}
+			else
+			{
+				uint32_t first = BvhChildRef::Index(child) * width;
+				float tEnter[kMaxWideBvhWidth];
+				uint32_t order[kMaxWideBvhWidth];
+				uint32_t mask = IntersectAABBBatch(wideBounds_, first, width, ray, tmin, tmax, tEnter);
+				uint32_t hitCount = SortHitChildren(mask, tEnter, order);
+				if (hitCount > 0)
+				{
+					for (uint32_t i = hitCount - 1; i > 0; i--)
+						stack[stackPtr++] = wideChildren_[first + order[i]];
+					child = wideChildren_[first + order[0]];
+					continue;
+				}
+			}
+
+			if (stackPtr == 0)
+				break;
+			child = stack[--stackPtr];
+		}
+	}
+
+	// パケットなど nodeTest で判定する場合のワイドノードの走査（子を1つずつ判定する）
+	template <typename NodeTest, typename Func>
+	void TraverseWideWith(NodeTest&& nodeTest, float& tmax, Func&& func, TraversalStats* pStats) const
+	{
+		const uint32_t width = GetWideWidth();
+		uint32_t stack[kMaxWideStackDepth];
+		uint32_t stackPtr = 0;
+		uint32_t child = rootChild_;
+		while (true)
+		{
+			if (pStats) pStats->nodeVisits++;
+
+			uint32_t count = BvhChildRef::Count(child);
+			if (count > 0)
+			{
+				if (func(BvhChildRef::Index(child), count, tmax))
+					return;
+			}
+			else
+			{
+				uint32_t first = BvhChildRef::Index(child) * width;
+				float tEnter[kMaxWideBvhWidth];
+				uint32_t order[kMaxWideBvhWidth];
+				uint32_t mask = 0;
+				for (uint32_t i = 0; i < width; i++)
+				{
+					if (wideChildren_[first + i] == BvhChildRef::kEmpty)
+						continue;
+					BvhNode box;
+					wideBounds_.Get(first + i, box.bmin, box.bmax);
+					if (nodeTest(box, tmax, tEnter[i]))
+						mask |= 1u << i;
+				}
+				uint32_t hitCount = SortHitChildren(mask, tEnter, order);
+				if (hitCount > 0)
+				{
+					for (uint32_t i = hitCount - 1; i > 0; i--)
+						stack[stackPtr++] = wideChildren_[first + order[i]];
+					child = wideChildren_[first + order[0]];
+					continue;
+				}
+			}
+
+			if (stackPtr == 0)
+				break;
+			child = stack[--stackPtr];
+		}
+	}
+
+	// 量子化ノードの走査
+	// 子のボックスは展開してから nodeTest に渡すので、判定は全精度のノードと共通になる
+	// ノードの訪問数は全精度のノードと同じ数え方（ルートと、辿った子ごとに1回）
+	template <typename NodeTest, typename Func>
+	void TraverseQuantized(NodeTest&& nodeTest, float& tmax, Func&& func, TraversalStats* pStats) const
+	{
+		struct StackEntry
+		{
+			uint32_t	child;
+			float3		origin;		// 内部ノードならそのノードのボックスの最小点
+		};
+
+		StackEntry stack[kMaxStackDepth];
+		uint32_t stackPtr = 0;
+		uint32_t child = rootChild_;
+		float3 origin = rootBounds_.bmin;
+		while (true)
+		{
+			if (pStats) pStats->nodeVisits++;
+
+			uint32_t count = BvhChildRef::Count(child);
+			if (count > 0)
+			{
+				if (func(BvhChildRef::Index(child), count, tmax))
+					return;
+			}
+			else
+			{
+				auto&& node = quantizedNodes_[BvhChildRef::Index(child)];
+				float3 scale = node.GetScale();
+				// 空の子は辿らないが、警告よけに初期化しておく
+				BvhNode box0, box1;
+				box0.bmin = box1.bmin = origin;
+				float t0 = 0.0f, t1 = 0.0f;
+				bool hit0 = false, hit1 = false;
+				if (node.child[0] != BvhChildRef::kEmpty)
+				{
+					box0.bmin = QuantizedBvhNode::Decode(origin, scale, node.qmin[0]);
+					box0.bmax = QuantizedBvhNode::Decode(origin, scale, node.qmax[0]);
+					hit0 = nodeTest(box0, tmax, t0);
+				}
+				if (node.child[1] != BvhChildRef::kEmpty)
+				{
+					box1.bmin = QuantizedBvhNode::Decode(origin, scale, node.qmin[1]);
+					box1.bmax = QuantizedBvhNode::Decode(origin, scale, node.qmax[1]);
+					hit1 = nodeTest(box1, tmax, t1);
+				}
+
+				// 近い方の子から辿る
+				if (hit0 && hit1)
+				{
+					if (t1 < t0)
+					{
+						stack[stackPtr++] = { node.child[0], box0.bmin };
+						child = node.child[1];
+						origin = box1.bmin;
+					}
+					else
+					{
+						stack[stackPtr++] = { node.child[1], box1.bmin };
+						child = node.child[0];
+						origin = box0.bmin;
+					}
+					continue;
+				}
+				if (hit0) { child = node.child[0]; origin = box0.bmin; continue; }
+				if (hit1) { child = node.child[1]; origin = box1.bmin; continue; }
+			}
+
+			if (stackPtr == 0)
+				break;
+			--stackPtr;
+			child = stack[stackPtr].child;
+			origin = stack[stackPtr].origin;
+		}
+	}
+
+private:
+	std::vector<BvhNode>			nodes_;
+	std::vector<uint32_t>			primIndices_;
+
+	BvhNodeFormat					format_ = kBvhNodeFull;
+
+	// 量子化ノードとワイドノード（ルートのボックスだけは全精度で持つ）
+	BoundingBox						rootBounds_;
+	uint32_t						rootChild_ = BvhChildRef::kEmpty;
+
+	// 量子化ノード
+	std::vector<QuantizedBvhNode>	quantizedNodes_;
+
+	// ワイドノード
+	// ノード i の子は [i * 幅, (i + 1) * 幅) にあり、使わない子は kEmpty で、ボックスはどのレイとも交差しない [+inf, +inf]
+	AABBArraySoA					wideBounds_;
+	std::vector<uint32_t>			wideChildren_;
+};	// class Bvh
+
+//	EOF
@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include "as_memory_pool.h"
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// D3D12 のデフォルトヒープの代わりに、ブロックをCPUのメモリに確保する AsMemoryHeap
+// GPUアドレスはブロックごとに 4GB ずつずらした仮のアドレスで、GetData で中身を読み書きできる
+class CpuAsMemoryHeap : public AsMemoryHeap
+{
+public:
+	bool CreateBlock(uint64_t size, uint64_t* pAddress) override
+	{
+		blocks_.emplace_back(new uint8_t[(size_t)size]);
+		*pAddress = (uint64_t)blocks_.size() << 32;
+		return true;
+	}
+
+	void DestroyBlocks() override
+	{
+		blocks_.clear();
+	}
+
+	uint8_t* GetData(const AsAllocation& alloc)
+	{
+		return blocks_[alloc.block].get() + alloc.offset;
+	}
+
+private:
+	std::vector<std::unique_ptr<uint8_t[]>>	blocks_;
+};	// class CpuAsMemoryHeap
+
+//	EOF
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include "descriptor_allocator.h"
+
+#include <stdint.h>
+#include <vector>
+
+// D3D12 のディスクリプタヒープの代わりに、ディスクリプタの中身を配列に持つ DescriptorHeap
+// DescriptorAllocator をGPUなしで試すのに使い、広げたときに中身が保たれることも確かめられる
+class CpuDescriptorHeap : public DescriptorHeap
+{
+public:
+	void Init(uint32_t capacity)
+	{
+		descriptors_.assign(capacity, 0);
+		growCount_ = 0;
+	}
+
+	bool Grow(uint32_t capacity) override
+	{
+		if (capacity < descriptors_.size())
+			return false;
+
+		// D3D12 と同じく別のヒープを作ってコピーする
+		std::vector<uint64_t> descriptors(capacity, 0);
+		std::copy(descriptors_.begin(), descriptors_.end(), descriptors.begin());
+		descriptors_.swap(descriptors);
+		growCount_++;
+		return true;
+	}
+
+	// ビューの作成に相当する（value がビューの中身）
+	void Write(uint32_t index, uint64_t value) { descriptors_[index] = value; }
+	uint64_t Read(uint32_t index) const { return descriptors_[index]; }
+
+	uint32_t GetCapacity() const { return (uint32_t)descriptors_.size(); }
+	uint32_t GetGrowCount() const { return growCount_; }
+
+private:
+	std::vector<uint64_t>	descriptors_;
+	uint32_t				growCount_ = 0;
+};	// class CpuDescriptorHeap
+
+//	EOF
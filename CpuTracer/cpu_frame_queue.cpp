@@ -0,0 +1,74 @@
+﻿#include "cpu_frame_queue.h"
+
+CpuFrameQueue::CpuFrameQueue()
+{
+	thread_ = std::thread([this]() { Run(); });
+}
+
+CpuFrameQueue::~CpuFrameQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		isQuit_ = true;
+	}
+	commandCV_.notify_one();
+	thread_.join();
+}
+
+void CpuFrameQueue::Execute(std::function<void()> func)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		commands_.push_back({ std::move(func), 0 });
+	}
+	commandCV_.notify_one();
+}
+
+void CpuFrameQueue::Signal(uint64_t value)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		commands_.push_back({ nullptr, value });
+	}
+	commandCV_.notify_one();
+}
+
+uint64_t CpuFrameQueue::GetCompletedValue()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return completedValue_;
+}
+
+void CpuFrameQueue::Wait(uint64_t value)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	fenceCV_.wait(lock, [&]() { return completedValue_ >= value; });
+}
+
+void CpuFrameQueue::Run()
+{
+	// 終了時は残っている処理をすべて実行してから抜ける
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		commandCV_.wait(lock, [&]() { return isQuit_ || !commands_.empty(); });
+		if (commands_.empty())
+			break;
+
+		auto command = std::move(commands_.front());
+		commands_.pop_front();
+		if (command.func)
+		{
+			lock.unlock();
+			command.func();
+			lock.lock();
+		}
+		else
+		{
+			completedValue_ = command.signalValue;
+			fenceCV_.notify_all();
+		}
+	}
+}
+
+//	EOF
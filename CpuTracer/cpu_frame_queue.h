@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include "frame_pacer.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// GPUの代わりに、送られた処理をワーカースレッドで順番に実行する FrameQueue
+// FramePacer のスケジューリングをGPUなしで試したり計測したりするのに使う
+class CpuFrameQueue : public FrameQueue
+{
+public:
+	CpuFrameQueue();
+	~CpuFrameQueue();
+
+	// コマンドリストの実行に相当する（すぐに戻り、処理はワーカースレッドで行う）
+	void Execute(std::function<void()> func);
+
+	void Signal(uint64_t value) override;
+	uint64_t GetCompletedValue() override;
+	void Wait(uint64_t value) override;
+
+private:
+	struct Command
+	{
+		std::function<void()>	func;			// 空ならフェンスの書き込み
+		uint64_t				signalValue;
+	};
+
+	void Run();
+
+	std::mutex					mutex_;
+	std::condition_variable		commandCV_;
+	std::condition_variable		fenceCV_;
+	std::deque<Command>			commands_;
+	uint64_t					completedValue_ = 0;
+	bool						isQuit_ = false;
+	std::thread					thread_;
+};	// class CpuFrameQueue
+
+//	EOF
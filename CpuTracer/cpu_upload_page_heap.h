@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include "upload_arena.h"
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// D3D12 のアップロードヒープの代わりに、ページをCPUのメモリに確保する UploadPageHeap
+// GPUアドレスはページごとに 4GB ずつずらした仮のアドレスで、アラインメントの確認に使う
+class CpuUploadPageHeap : public UploadPageHeap
+{
+public:
+	bool CreatePage(uint64_t size, void** ppData, uint64_t* pAddress) override
+	{
+		pages_.emplace_back(new uint8_t[(size_t)size]);
+		*ppData = pages_.back().get();
+		*pAddress = (uint64_t)pages_.size() << 32;
+		return true;
+	}
+
+	void DestroyPages() override
+	{
+		pages_.clear();
+	}
+
+private:
+	std::vector<std::unique_ptr<uint8_t[]>>	pages_;
+};	// class CpuUploadPageHeap
+
+//	EOF
@@ -0,0 +1,143 @@
+﻿#pragma once
+
+#include "range_free_list.h"
+
+#include <stdint.h>
+#include <algorithm>
+
+// ディスクリプタヒープの抽象
+// D3D12 ではシェーダから見えないヒープに作ったビューを見えるヒープにコピーして持ち、CpuTracer では配列（CpuDescriptorHeap）で実装する
+class DescriptorHeap
+{
+public:
+	virtual ~DescriptorHeap() {}
+
+	// 今のディスクリプタとインデックスを保ったまま capacity 個入るように広げる
+	virtual bool Grow(uint32_t capacity) = 0;
+};	// class DescriptorHeap
+
+struct DescriptorAllocatorStats
+{
+	uint32_t	capacity = 0;
+	uint32_t	persistentCount = 0;		// 使用中の常駐ディスクリプタ数
+	uint32_t	persistentPeak = 0;
+	uint32_t	transientPeak = 0;			// 1フレームで使った一時ディスクリプタの最大数
+	uint32_t	growCount = 0;
+	uint32_t	overflowCount = 0;			// 最大サイズまで広げても足りずに失敗した回数
+};
+
+// ディスクリプタヒープのインデックスを管理するアロケータ
+// ヒープの先頭をフレームスロットごとの一時領域（フレームの始めに捨てる線形確保）、その後ろを常駐領域（フリーリスト）にする
+// 常駐領域が足りなくなったらヒープを最大サイズまで倍々に広げ、それでも足りなければ kInvalidIndex を返す
+class DescriptorAllocator
+{
+public:
+	static const uint32_t kInvalidIndex = ~0u;
+
+	// pHeap は capacity 個で作っておく
+	// transientCount はスロットごとの一時ディスクリプタ数で、capacity はその slotCount 倍より大きくする
+	bool Init(DescriptorHeap* pHeap, uint32_t capacity, uint32_t maxCapacity, uint32_t slotCount, uint32_t transientCount)
+	{
+		if (slotCount == 0 || capacity > maxCapacity || slotCount * transientCount >= capacity)
+			return false;
+
+		pHeap_ = pHeap;
+		maxCapacity_ = maxCapacity;
+		slotCount_ = slotCount;
+		transientCount_ = transientCount;
+		slot_ = 0;
+		transientUsed_ = 0;
+		freeList_.Clear();
+		freeList_.Free(slotCount * transientCount, capacity - slotCount * transientCount);
+		stats_ = DescriptorAllocatorStats();
+		stats_.capacity = capacity;
+		return true;
+	}
+
+	// 連続した count 個の常駐ディスクリプタを確保し、先頭のインデックスを返す
+	uint32_t Allocate(uint32_t count = 1)
+	{
+		uint64_t index = freeList_.Allocate(count);
+		if (index == RangeFreeList::kInvalid && Grow(count))
+			index = freeList_.Allocate(count);
+		if (index == RangeFreeList::kInvalid)
+		{
+			stats_.overflowCount++;
+			return kInvalidIndex;
+		}
+
+		stats_.persistentCount += count;
+		stats_.persistentPeak = std::max(stats_.persistentPeak, stats_.persistentCount);
+		return (uint32_t)index;
+	}
+
+	// Allocate で確保したディスクリプタを返す
+	void Free(uint32_t index, uint32_t count = 1)
+	{
+		if (index == kInvalidIndex || count == 0)
+			return;
+
+		freeList_.Free(index, count);
+		stats_.persistentCount -= count;
+	}
+
+	// slot の一時領域を使い始める
+	// 前回 slot で確保した一時ディスクリプタは、そのフレームが終わっている（FramePacer::BeginFrame で待った）ので捨てる
+	void BeginFrame(uint32_t slot)
+	{
+		slot_ = slot;
+		transientUsed_ = 0;
+	}
+
+	// このフレームだけで使う連続した count 個のディスクリプタを確保する
+	// 一時領域は広げないので、足りなければ kInvalidIndex を返す
+	uint32_t AllocateTransient(uint32_t count = 1)
+	{
+		if (transientUsed_ + count > transientCount_)
+		{
+			stats_.overflowCount++;
+			return kInvalidIndex;
+		}
+
+		uint32_t index = slot_ * transientCount_ + transientUsed_;
+		transientUsed_ += count;
+		stats_.transientPeak = std::max(stats_.transientPeak, transientUsed_);
+		return index;
+	}
+
+	uint32_t GetCapacity() const { return stats_.capacity; }
+	const DescriptorAllocatorStats& GetStats() const { return stats_; }
+
+private:
+	// count 個の空きが末尾にできるまで広げる
+	bool Grow(uint32_t count)
+	{
+		uint32_t oldCapacity = stats_.capacity;
+		uint64_t required = (uint64_t)oldCapacity + count - freeList_.GetTailCount(oldCapacity);
+		if (required > maxCapacity_)
+			return false;
+
+		uint64_t newCapacity = std::max<uint64_t>(oldCapacity, 1);
+		while (newCapacity < required)
+			newCapacity *= 2;
+		newCapacity = std::min<uint64_t>(newCapacity, maxCapacity_);
+		if (!pHeap_->Grow((uint32_t)newCapacity))
+			return false;
+
+		freeList_.Free(oldCapacity, newCapacity - oldCapacity);
+		stats_.capacity = (uint32_t)newCapacity;
+		stats_.growCount++;
+		return true;
+	}
+
+	DescriptorHeap*				pHeap_ = nullptr;
+	uint32_t					maxCapacity_ = 0;
+	uint32_t					slotCount_ = 0;
+	uint32_t					transientCount_ = 0;
+	uint32_t					slot_ = 0;
+	uint32_t					transientUsed_ = 0;
+	RangeFreeList				freeList_;			// 常駐領域の空き
+	DescriptorAllocatorStats	stats_;
+};	// class DescriptorAllocator
+
+//	EOF
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+// フレームを送るキューの抽象
+// D3D12 ではコマンドキューとフェンス、CpuTracer ではワーカースレッド（CpuFrameQueue）で実装する
+class FrameQueue
+{
+public:
+	virtual ~FrameQueue() {}
+
+	// それまでに送った処理が終わったらフェンスが value になるようにする
+	virtual void Signal(uint64_t value) = 0;
+
+	// フェンスの現在の値
+	virtual uint64_t GetCompletedValue() = 0;
+
+	// フェンスが value になるまでCPUで待つ
+	virtual void Wait(uint64_t value) = 0;
+};	// class FrameQueue
+
+struct FramePacerStats
+{
+	uint64_t	frameCount = 0;
+	uint64_t	waitCount = 0;			// BeginFrame でCPUが待った回数
+	double		waitSeconds = 0.0;
+};
+
+// フレームスロットごとにフェンス値を覚えておき、最大でスロット数のフレームを同時に処理させる
+// スロットはスワップチェインのバックバッファ番号で、コマンドアロケータなどフレームごとのリソースもスロットごとに持つ
+// CPUが待つのは、まだキューで使われているスロットを再利用するときだけ
+class FramePacer
+{
+public:
+	void Init(FrameQueue* pQueue, uint32_t slotCount)
+	{
+		pQueue_ = pQueue;
+		slotValues_.assign(slotCount, 0);
+		nextValue_ = pQueue->GetCompletedValue() + 1;
+		slot_ = 0;
+		stats_ = FramePacerStats();
+	}
+
+	// slot のリソースを使い始める
+	// 前回 slot で送ったフレームが終わっていなければ待つ
+	void BeginFrame(uint32_t slot)
+	{
+		slot_ = slot;
+		uint64_t value = slotValues_[slot];
+		if (pQueue_->GetCompletedValue() >= value)
+			return;
+
+		auto start = std::chrono::steady_clock::now();
+		pQueue_->Wait(value);
+		stats_.waitCount++;
+		stats_.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// BeginFrame のスロットのコマンドをキューに送った後に呼び、このフレームのフェンス値を返す
+	uint64_t EndFrame()
+	{
+		uint64_t value = nextValue_++;
+		slotValues_[slot_] = value;
+		pQueue_->Signal(value);
+		stats_.frameCount++;
+		return value;
+	}
+
+	// 送ったすべての処理が終わるまで待つ（初期化時のコマンドの完了待ちや終了時に使う）
+	void WaitIdle()
+	{
+		uint64_t value = nextValue_++;
+		pQueue_->Signal(value);
+		pQueue_->Wait(value);
+	}
+
+	uint32_t GetSlotCount() const { return (uint32_t)slotValues_.size(); }
+	const FramePacerStats& GetStats() const { return stats_; }
+
+private:
+	FrameQueue*				pQueue_ = nullptr;
+	std::vector<uint64_t>	slotValues_;		// スロットを最後に使ったフレームのフェンス値
+	uint64_t				nextValue_ = 1;
+	uint32_t				slot_ = 0;
+	FramePacerStats			stats_;
+};	// class FramePacer
+
+//	EOF
@@ -0,0 +1,33 @@
+﻿#include "image.h"
+
+#include <stdio.h>
+
+bool WritePPM(const char* filename, const Image& image)
+{
+	FILE* fp = fopen(filename, "wb");
+	if (fp == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(fp, "P6\n%u %u\n255\n", image.width, image.height);
+
+	std::vector<uint8_t> line(image.width * 3);
+	for (uint32_t y = 0; y < image.height; y++)
+	{
+		const uint32_t* src = image.pixels.data() + (size_t)y * image.width;
+		for (uint32_t x = 0; x < image.width; x++)
+		{
+			line[x * 3 + 0] = (uint8_t)(src[x] & 0xff);
+			line[x * 3 + 1] = (uint8_t)((src[x] >> 8) & 0xff);
+			line[x * 3 + 2] = (uint8_t)((src[x] >> 16) & 0xff);
+		}
+		fwrite(line.data(), 1, line.size(), fp);
+	}
+
+	bool ret = ferror(fp) == 0;
+	fclose(fp);
+	return ret;
+}
+
+//	EOF
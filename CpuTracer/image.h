@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include "rt_math.h"
+
+#include <vector>
+
+// R8G8B8A8_UNORM の出力バッファ
+struct Image
+{
+	uint32_t				width = 0;
+	uint32_t				height = 0;
+	std::vector<uint32_t>	pixels;
+
+	void Resize(uint32_t w, uint32_t h)
+	{
+		width = w;
+		height = h;
+		pixels.assign((size_t)w * h, 0);
+	}
+
+	// RWTexture2D<float4> への書き込みと同じくUNORM変換して格納する
+	void Store(uint32_t x, uint32_t y, const float4& color)
+	{
+		auto ToUnorm = [](float v) { return (uint32_t)(saturate(v) * 255.0f + 0.5f); };
+		pixels[(size_t)y * width + x] = ToUnorm(color.x) | (ToUnorm(color.y) << 8) | (ToUnorm(color.z) << 16) | (ToUnorm(color.w) << 24);
+	}
+};
+
+// プログレッシブレンダリングの累積バッファ（R32G32B32A32_FLOAT、サンプルの合計を持つ）
+struct AccumImage
+{
+	uint32_t				width = 0;
+	uint32_t				height = 0;
+	std::vector<float4>		pixels;
+
+	void Resize(uint32_t w, uint32_t h)
+	{
+		width = w;
+		height = h;
+		pixels.assign((size_t)w * h, float4(0, 0, 0, 0));
+	}
+
+	// color を加えて平均を返す
+	// sampleCount が1なら前のフレームまでの合計は捨てる
+	float4 Accumulate(uint32_t x, uint32_t y, const float4& color, uint32_t sampleCount)
+	{
+		auto&& sum = pixels[(size_t)y * width + x];
+		sum = (sampleCount > 1) ? sum + color : color;
+		return sum * (1.0f / (float)sampleCount);
+	}
+
+	float4 GetAverage(uint32_t x, uint32_t y, uint32_t sampleCount) const
+	{
+		return pixels[(size_t)y * width + x] * (1.0f / (float)sampleCount);
+	}
+};
+
+// バイナリPPM(P6)で書き出す
+bool WritePPM(const char* filename, const Image& image);
+
+//	EOF
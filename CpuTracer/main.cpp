@@ -0,0 +1,2566 @@
+﻿// CpuTracer: GPU・ウィンドウなしでサンプルのシーンをレンダリングする
+//
+// Linux等では以下のようにビルドできる
+//   g++ -std=c++14 -O2 -pthread -o CpuTracer *.cpp
+//
+
+#include "shader03.h"
+#include "wavefront03.h"
+#include "scene02.h"
+#include "random.h"
+#include "bench.h"
+#include "cpu_frame_queue.h"
+#include "cpu_descriptor_heap.h"
+#include "cpu_upload_page_heap.h"
+#include "cpu_as_memory_heap.h"
+#include "upload_ring.h"
+#include "shader_table.h"
+#include "progressive.h"
+#include "procedural.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace
+{
+	static const int kWindowWidth = 1280;
+	static const int kWindowHeight = 720;
+	static const uint32_t kMaxFramesInFlight = 3;		// Sample03 の kMaxBuffers
+
+	struct Options
+	{
+		std::string		mode = "render";
+		DispatchDesc	dispatch;
+		int				frame = 0;
+		int				repeat = 1;
+		std::string		output = "sample03.ppm";
+		std::string		sceneFile;			// 空なら組み込みのシーン
+		std::string		cacheFile;			// 構築済みのASのキャッシュ
+
+		// -mode bvh
+		BvhBuildDesc	bvh;
+		int				longCount = 16;		// Sample02 の kLongCount
+		int				latiCount = 16;		// Sample02 の kLatiCount
+		int				rayCount = 1000000;
+
+		// -mode tlas
+		int				gridCount = 16;
+
+		// -mode bench
+		std::string		csv;
+
+		// -mode scene
+		std::string		save;
+		bool			match03 = false;		// 組み込みの Sample03 と同じ画像になるか確かめる
+
+		// -mode refit
+		int				frameCount = 60;
+		float			rebuildRatio = 1.5f;	// 構築し直した場合に対するSAHコストの比がこれを超えたら構築し直す
+
+		// -mode frames
+		float			cpuMs = 4.0f;			// 1フレームのコマンド記録にかかる時間
+		float			gpuMs = 6.0f;			// 1フレームのキューでの処理時間
+
+		// -mode descriptors
+		int				blasCount = 5000;
+		int				heapSize = 100;			// Sample03 の初期ヒープサイズ
+		int				maxHeapSize = 1000000;	// CBV_SRV_UAV ヒープの最大サイズ
+
+		// -mode upload
+		int				bufferCount = 50000;
+		int				pageSize = 4 * 1024 * 1024;
+
+		// -mode aspool
+		int				blockSize = 16 * 1024 * 1024;
+
+		// -mode compact
+		BvhNodeFormat	compactFormat = kBvhNodeQuantized;	// コンパクション後のBLASのノード形式
+
+		// -mode shadertable
+		int				instanceCount = 100000;
+		int				materialCount = 64;
+
+		// render, -mode progressive
+		int				sampleCount = 0;		// 累積するフレーム数（0なら累積しない）
+		float			lightRadius = 0.05f;	// 累積する場合の平行光源の見かけの半径（ラジアン）
+		bool			wavefront = false;		// ウェーブフロント方式でレンダリングする
+	};
+
+	void PrintUsage()
+	{
+		printf("usage: CpuTracer [options]\n");
+		printf("  -mode <name>      render | bvh | tlas | aabb | bench | scene | nodes | refit | frames | descriptors | upload | aspool | compact | shadertable | progressive | scaling | wavefront | raysort | procedural | triangle (default render)\n");
+		printf("  -w <width>        output width (default %d)\n", kWindowWidth);
+		printf("  -h <height>       output height (default %d)\n", kWindowHeight);
+		printf("  -frame <n>        camera and sphere animation frame (default 0)\n");
+		printf("  -threads <n>      worker threads, 0 = all cores (default 0)\n");
+		printf("  -tile <n>         tile size in pixels (default 16)\n");
+		printf("  -tilew <n>        tile width in pixels, set after -tile (default 16)\n");
+		printf("  -tileh <n>        tile height in pixels, set after -tile (default 16)\n");
+		printf("  -schedule <name>  tile scheduling: steal | shared | static (default steal)\n");
+		printf("  -repeat <n>       render n times and report the best (default 1)\n");
+		printf("  -packet <n>       trace primary rays in n x n packets, n = 2, 4 or 8 (default 0 = off)\n");
+		printf("  -o <file>         output image (.ppm)\n");
+		printf("  -scene <file>     load a scene file instead of the built-in Sample03 scene\n");
+		printf("  -cache <file>     load the built scene from a cache file, or save it there if stale\n");
+		printf("  -quantize         store BVH nodes as 8bit quantized child bounds (render, bvh, tlas)\n");
+		printf("  -wide <n>         collapse BVH nodes into n = 4 or 8 wide nodes (render, bvh, tlas)\n");
+		printf("  -samples <n>      accumulate n jittered frames with soft shadows (default 0 = off)\n");
+		printf("  -light <radians>  apparent light radius for soft shadows when accumulating (default 0.05)\n");
+		printf("  -wavefront        trace each ray type in bulk from per-stage ray queues (ignores -packet)\n");
+		printf("  -sort             with -wavefront, sort reflection and shadow rays by direction octant and origin\n");
+		printf("bvh mode:\n");
+		printf("  -long <n>         sphere longitude count (default 16)\n");
+		printf("  -lati <n>         sphere latitude count (default 16)\n");
+		printf("  -bins <n>         SAH bin count (default 16)\n");
+		printf("  -leaf <n>         max leaf size (default 4)\n");
+		printf("  -rays <n>         rays traced to measure traversal cost (default 1000000)\n");
+		printf("tlas mode (also uses -long -lati -bins -leaf -rays):\n");
+		printf("  -grid <n>         place n x n copies of the Sample02 instances (default 16)\n");
+		printf("  -scene <file>     load meshes and instances from a scene file instead of the grid\n");
+		printf("  -cache <file>     same as render mode\n");
+		printf("aabb mode (uses -rays):\n");
+		printf("  compares the SIMD ray/AABB batch kernel with the scalar fallback\n");
+		printf("bench mode (uses -w -h -frame -rays -repeat):\n");
+		printf("  traces primary, shadow and reflection rays of Sample01-03 on 1 thread\n");
+		printf("  -csv <file>       write results as CSV (default stdout)\n");
+		printf("scene mode (uses -scene):\n");
+		printf("  -save <file>      convert the scene file to the binary format\n");
+		printf("  -match03          render the scene file and the built-in Sample03 (frame 0) and require identical images\n");
+		printf("nodes mode (uses -grid -long -lati -bins -leaf -rays -repeat and the render options):\n");
+		printf("  compares full precision, quantized and wide BVH nodes on the Sample02 grid\n");
+		printf("  and on Sample03 with n x n spheres in the inner box\n");
+		printf("refit mode (uses -grid -quantize -wide):\n");
+		printf("  moves n x n spheres in the Sample03 inner box and compares TLAS refit with rebuild\n");
+		printf("  -frames <n>       animation frames (default 60)\n");
+		printf("  -rebuild <ratio>  rebuild when the refit SAH cost exceeds ratio x rebuilt cost (default 1.5)\n");
+		printf("frames mode (uses -frames):\n");
+		printf("  runs the Sample03 frame loop on a CPU queue with 1 to %u frames in flight\n", kMaxFramesInFlight);
+		printf("  -cpu <ms>         command recording time per frame (default 4)\n");
+		printf("  -gpu <ms>         queue execution time per frame (default 6)\n");
+		printf("descriptors mode (uses -frames):\n");
+		printf("  streams BLAS descriptors in and out of a growable heap with per-frame transient ranges\n");
+		printf("  -blas <n>         BLAS descriptors allocated over all frames (default 5000)\n");
+		printf("  -heap <n>         initial heap size (default 100)\n");
+		printf("  -maxheap <n>      heap size limit (default 1000000)\n");
+		printf("upload mode:\n");
+		printf("  packs small vertex, index, AABB, instance, constant and structured buffers into upload pages\n");
+		printf("  -buffers <n>      buffer count (default 50000)\n");
+		printf("  -page <bytes>     upload page size (default 4194304)\n");
+		printf("aspool mode (uses -blas):\n");
+		printf("  builds BLAS in batches with pooled result memory and one scratch slice per build\n");
+		printf("  -block <bytes>    pool block size (default 16777216)\n");
+		printf("compact mode (uses -grid -long -lati -bins -leaf -rays and the render options):\n");
+		printf("  compacts the Sample02 and Sample03 acceleration structures after the build and\n");
+		printf("  reports allocated memory before and after, checking that traversal is unchanged\n");
+		printf("  BLAS built with full nodes are converted to quantized nodes, the TLAS keeps its format\n");
+		printf("  -compactwide <n>  convert BLAS to 4 or 8 wide nodes instead\n");
+		printf("shadertable mode (uses -frames):\n");
+		printf("  builds a shader table for instances with shared materials and patches animated ones every frame\n");
+		printf("  -instances <n>    instance count (default 100000)\n");
+		printf("  -materials <n>    material count (default 64)\n");
+		printf("progressive mode (uses -samples -light and the render options):\n");
+		printf("  accumulates Sample03 frames while the camera is still and reports the error against\n");
+		printf("  a reference with 4 x samples (default 32), then checks restarts on camera and scene changes\n");
+		printf("scaling mode (uses -repeat and the render options, -threads is the maximum):\n");
+		printf("  renders Sample03 with 1 to n threads for each tile schedule and several tile shapes\n");
+		printf("wavefront mode (uses -repeat -light and the render options):\n");
+		printf("  compares the recursive TraceRay shaders with the wavefront stages and reports time per stage\n");
+		printf("raysort mode (uses -repeat and the render options):\n");
+		printf("  renders Sample03 with the wavefront stages with and without secondary ray sorting for several tile sizes\n");
+		printf("procedural mode (uses -rays -bins -leaf):\n");
+		printf("  builds a bottom-level AS of random capsules, cylinders, cones, tori or rounded boxes for each shape,\n");
+		printf("  checks the analytic intersections against the signed distance and reports throughput\n");
+		printf("triangle mode (uses -rays -long -lati -bins -leaf):\n");
+		printf("  compares the SIMD watertight ray/triangle batch kernel with the scalar fallback and\n");
+		printf("  traces rays at the vertices and edges of a closed sphere mesh from inside to count leaks\n");
+	}
+
+	bool ParseOptions(int argc, char* argv[], Options& opt)
+	{
+		opt.dispatch.width = kWindowWidth;
+		opt.dispatch.height = kWindowHeight;
+		for (int i = 1; i < argc; i++)
+		{
+			auto IsArg = [&](const char* name) { return strcmp(argv[i], name) == 0 && i + 1 < argc; };
+			if (IsArg("-mode")) opt.mode = argv[++i];
+			else if (strcmp(argv[i], "-quantize") == 0) opt.bvh.nodeFormat = kBvhNodeQuantized;
+			else if (strcmp(argv[i], "-wavefront") == 0) opt.wavefront = true;
+			else if (strcmp(argv[i], "-match03") == 0) opt.match03 = true;
+			else if (strcmp(argv[i], "-sort") == 0) opt.dispatch.sortSecondaryRays = true;
+			else if (IsArg("-wide")) opt.bvh.nodeFormat = (atoi(argv[++i]) == 8) ? kBvhNodeWide8 : kBvhNodeWide4;
+			else if (IsArg("-w")) opt.dispatch.width = atoi(argv[++i]);
+			else if (IsArg("-h")) opt.dispatch.height = atoi(argv[++i]);
+			else if (IsArg("-frame")) opt.frame = atoi(argv[++i]);
+			else if (IsArg("-threads")) opt.dispatch.threadCount = atoi(argv[++i]);
+			else if (IsArg("-tile")) opt.dispatch.tileWidth = opt.dispatch.tileHeight = atoi(argv[++i]);
+			else if (IsArg("-tilew")) opt.dispatch.tileWidth = atoi(argv[++i]);
+			else if (IsArg("-tileh")) opt.dispatch.tileHeight = atoi(argv[++i]);
+			else if (IsArg("-schedule"))
+			{
+				const char* name = argv[++i];
+				int schedule = 0;
+				while (schedule < kScheduleCount && strcmp(name, GetTaskScheduleName((TaskSchedule)schedule)) != 0)
+					schedule++;
+				if (schedule == kScheduleCount)
+					return false;
+				opt.dispatch.schedule = (TaskSchedule)schedule;
+			}
+			else if (IsArg("-repeat")) opt.repeat = atoi(argv[++i]);
+			else if (IsArg("-packet")) opt.dispatch.packetSize = atoi(argv[++i]);
+			else if (IsArg("-o")) opt.output = argv[++i];
+			else if (IsArg("-long")) opt.longCount = atoi(argv[++i]);
+			else if (IsArg("-lati")) opt.latiCount = atoi(argv[++i]);
+			else if (IsArg("-bins")) opt.bvh.binCount = atoi(argv[++i]);
+			else if (IsArg("-leaf")) opt.bvh.maxLeafSize = atoi(argv[++i]);
+			else if (IsArg("-rays")) opt.rayCount = atoi(argv[++i]);
+			else if (IsArg("-grid")) opt.gridCount = atoi(argv[++i]);
+			else if (IsArg("-csv")) opt.csv = argv[++i];
+			else if (IsArg("-scene")) opt.sceneFile = argv[++i];
+			else if (IsArg("-cache")) opt.cacheFile = argv[++i];
+			else if (IsArg("-save")) opt.save = argv[++i];
+			else if (IsArg("-frames")) opt.frameCount = atoi(argv[++i]);
+			else if (IsArg("-rebuild")) opt.rebuildRatio = (float)atof(argv[++i]);
+			else if (IsArg("-cpu")) opt.cpuMs = (float)atof(argv[++i]);
+			else if (IsArg("-blas")) opt.blasCount = atoi(argv[++i]);
+			else if (IsArg("-heap")) opt.heapSize = atoi(argv[++i]);
+			else if (IsArg("-maxheap")) opt.maxHeapSize = atoi(argv[++i]);
+			else if (IsArg("-buffers")) opt.bufferCount = atoi(argv[++i]);
+			else if (IsArg("-page")) opt.pageSize = atoi(argv[++i]);
+			else if (IsArg("-block")) opt.blockSize = atoi(argv[++i]);
+			else if (IsArg("-compactwide")) opt.compactFormat = (atoi(argv[++i]) == 8) ? kBvhNodeWide8 : kBvhNodeWide4;
+			else if (IsArg("-instances")) opt.instanceCount = atoi(argv[++i]);
+			else if (IsArg("-materials")) opt.materialCount = atoi(argv[++i]);
+			else if (IsArg("-gpu")) opt.gpuMs = (float)atof(argv[++i]);
+			else if (IsArg("-samples")) opt.sampleCount = atoi(argv[++i]);
+			else if (IsArg("-light")) opt.lightRadius = (float)atof(argv[++i]);
+			else
+			{
+				return false;
+			}
+		}
+		return opt.dispatch.width > 0 && opt.dispatch.height > 0 && opt.repeat > 0 && opt.rayCount > 0 && opt.gridCount > 0 && opt.frameCount > 0
+			&& opt.dispatch.packetSize * opt.dispatch.packetSize <= kMaxPacketRays;
+	}
+
+	// メッシュのBLASを構築し、構築コストと走査コストを出力する
+	bool ReportMeshBvh(const char* name, const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices, const Options& opt)
+	{
+		TriangleGeometryDesc geo;
+		geo.VertexBuffer = vertices.data();
+		geo.VertexStrideInBytes = sizeof(Vertex);
+		geo.VertexCount = (uint32_t)vertices.size();
+		geo.IndexBuffer = indices.data();
+		geo.IndexCount = (uint32_t)indices.size();
+
+		TriangleBlas blas;
+		BvhBuildStats buildStats;
+		if (!blas.Build(geo, opt.bvh, &buildStats))
+		{
+			printf("%s: failed to build BLAS\n", name);
+			return false;
+		}
+
+		// バウンディングスフィアの外側から内側に向けてレイを飛ばす
+		auto bounds = blas.GetBvh().GetBounds();
+		float3 center = bounds.Center();
+		float radius = length(bounds.bmax - bounds.bmin) * 0.5f;
+		Random rnd(1);
+		auto RandomDir = [&]()
+		{
+			float z = rnd.NextFloat(-1.0f, 1.0f);
+			float a = rnd.NextFloat(0.0f, kPI * 2.0f);
+			float r = sqrtf(std::max(0.0f, 1.0f - z * z));
+			return float3(r * cosf(a), r * sinf(a), z);
+		};
+
+		TraversalStats travStats;
+		uint64_t hitCount = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < opt.rayCount; i++)
+		{
+			float3 origin = center + RandomDir() * (radius * 2.0f);
+			float3 target = center + RandomDir() * (radius * 0.5f);
+			RayDesc ray = { origin, 0.0f, normalize(target - origin), 10000.0f };
+			TriangleHit hit;
+			if (blas.Intersect(ray, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, hit, &travStats))
+				hitCount++;
+		}
+		auto end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+
+		printf("%s:\n", name);
+		printf("  triangles      : %u\n", blas.GetPrimitiveCount());
+		printf("  build time     : %.3f ms\n", buildStats.seconds * 1000.0);
+		printf("  SAH cost       : %.3f\n", blas.GetBvh().ComputeSAHCost(opt.bvh));
+		printf("  memory         : %.1f KB\n", blas.GetMemorySize() / 1024.0);
+		printf("  nodes / leaves : %u / %u\n", buildStats.nodeCount, buildStats.leafCount);
+		printf("  max depth      : %u\n", buildStats.maxDepth);
+		printf("  max leaf prims : %u\n", buildStats.maxLeafPrims);
+		printf("  hit rate       : %.3f\n", (double)hitCount / opt.rayCount);
+		printf("  nodes / ray    : %.3f\n", (double)travStats.nodeVisits / opt.rayCount);
+		printf("  tests / ray    : %.3f\n", (double)travStats.primTests / opt.rayCount);
+		printf("  throughput     : %.3f Mrays/s (1 thread)\n", (double)opt.rayCount / seconds * 1e-6);
+		return true;
+	}
+
+	int RunBvhReport(const Options& opt)
+	{
+		printf("bins %u, max leaf size %u\n", opt.bvh.binCount, opt.bvh.maxLeafSize);
+
+		// Sample02 の InitGeometry と同じメッシュ
+		{
+			int vcount, icount;
+			GetBoxVertexAndIndexCount(vcount, icount);
+			std::vector<Vertex> vertices(vcount);
+			std::vector<uint16_t> indices(icount);
+			CreateBoxVertexAndIndex(vertices.data(), indices.data());
+			if (!ReportMeshBvh("box", vertices, indices, opt))
+				return -1;
+		}
+		{
+			int vcount, icount;
+			GetShpereVertexAndIndexCount(opt.longCount, opt.latiCount, vcount, icount);
+			if (vcount > 0x10000)
+			{
+				printf("sphere: %d vertices exceed 16bit index range\n", vcount);
+				return -1;
+			}
+			std::vector<Vertex> vertices(vcount);
+			std::vector<uint16_t> indices(icount);
+			CreateSphereVertexAndIndex(opt.longCount, opt.latiCount, vertices.data(), indices.data());
+
+			char name[64];
+			snprintf(name, sizeof(name), "sphere %dx%d", opt.longCount, opt.latiCount);
+			if (!ReportMeshBvh(name, vertices, indices, opt))
+				return -1;
+		}
+		return 0;
+	}
+
+	// キャッシュのキー
+	// シーンファイルを使う場合はその内容、組み込みのシーンならシーンの設定から求める
+	bool ComputeCacheKey(const Options& opt, uint64_t seed, uint64_t& key)
+	{
+		// リーフのAABB数は判定幅で決まるので、判定幅もキーに含める
+		key = HashValue(seed, HashValue(kAABBBatchSize));
+		if (opt.sceneFile.empty())
+			return true;
+		if (!HashFile(opt.sceneFile.c_str(), key))
+		{
+			printf("failed to open %s\n", opt.sceneFile.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// 経過時間を出力する
+	void PrintSetupTime(std::chrono::steady_clock::time_point start, const char* source)
+	{
+		auto end = std::chrono::steady_clock::now();
+		printf("setup      : %.3f ms (%s)\n", std::chrono::duration<double>(end - start).count() * 1000.0, source);
+	}
+
+	// Sample02 のシーンを構築する
+	// -cache が指定されていれば、キーが一致するキャッシュから復元するか、構築後に保存する
+	bool SetupScene02(const Options& opt, const Scene02Desc& desc, Scene02& scene)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		uint64_t key;
+		if (!ComputeCacheKey(opt, HashValue(desc.topBuild, HashValue(desc.bottomBuild, 2)), key))
+			return false;
+		if (opt.sceneFile.empty())
+			key = HashValue(desc.gridCount, HashValue(desc.latiCount, HashValue(desc.longCount, key)));
+
+		if (!opt.cacheFile.empty() && LoadScene02Cache(opt.cacheFile.c_str(), key, scene))
+		{
+			PrintSetupTime(start, "cache");
+			return true;
+		}
+
+		SceneFile file;
+		if (opt.sceneFile.empty())
+		{
+			if (!MakeScene02File(desc, file))
+			{
+				printf("failed to create the Sample02 scene\n");
+				return false;
+			}
+		}
+		else if (!LoadSceneFile(opt.sceneFile.c_str(), file))
+		{
+			return false;
+		}
+
+		if (!InitScene02(scene, file, desc.bottomBuild, desc.topBuild))
+		{
+			printf("failed to build acceleration structures\n");
+			return false;
+		}
+		PrintSetupTime(start, "build");
+
+		if (!opt.cacheFile.empty() && !SaveScene02Cache(opt.cacheFile.c_str(), key, scene))
+			printf("failed to write %s\n", opt.cacheFile.c_str());
+		return true;
+	}
+
+	// Sample03 のシーンを構築する（-cache の扱いは SetupScene02 と同じ）
+	bool SetupScene03(const Options& opt, Scene03& scene)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		uint64_t key;
+		if (!ComputeCacheKey(opt, HashValue(opt.bvh.nodeFormat, 3), key))
+			return false;
+
+		if (!opt.cacheFile.empty() && LoadScene03Cache(opt.cacheFile.c_str(), key, scene))
+		{
+			PrintSetupTime(start, "cache");
+			return true;
+		}
+
+		SceneFile file;
+		if (opt.sceneFile.empty())
+			MakeScene03File(file);
+		else if (!LoadSceneFile(opt.sceneFile.c_str(), file))
+			return false;
+
+		if (!InitScene03(scene, file, opt.bvh.nodeFormat))
+		{
+			printf("failed to build acceleration structures\n");
+			return false;
+		}
+		PrintSetupTime(start, "build");
+
+		if (!opt.cacheFile.empty() && !SaveScene03Cache(opt.cacheFile.c_str(), key, scene))
+			printf("failed to write %s\n", opt.cacheFile.c_str());
+		return true;
+	}
+
+	// SetupScene03 で構築したシーンを frame のアニメーションの状態にして、そのフレームの定数バッファを作る
+	// baseTransforms は構築したときのインスタンスの変換行列
+	// シーンファイルを使う場合はカメラと球のアニメーションをしない
+	bool SetupFrame03(const Options& opt, Scene03& scene, const std::vector<float3x4>& baseTransforms, int frame, SceneCB& cb)
+	{
+		if (!opt.sceneFile.empty())
+		{
+			cb = MakeSceneFileCB(scene.camera, scene.light, opt.dispatch.width, opt.dispatch.height);
+			return true;
+		}
+
+		std::vector<float3x4> transforms;
+		AnimateScene03(scene, baseTransforms, frame, transforms);
+		if (!UpdateScene03Transforms(scene, transforms, false))
+		{
+			printf("failed to update acceleration structures\n");
+			return false;
+		}
+		cb = MakeScene03CB(frame, opt.dispatch.width, opt.dispatch.height);
+		return true;
+	}
+
+	std::vector<float3x4> GetInstanceTransforms(const Scene03& scene)
+	{
+		std::vector<float3x4> transforms(scene.instanceDescs.size());
+		for (size_t i = 0; i < transforms.size(); i++)
+			transforms[i] = scene.instanceDescs[i].Transform;
+		return transforms;
+	}
+
+	// Sample02 のインスタンスをグリッド状に複製し、ボトムレベルASを共有したまま走査コストを計測する
+	int RunTlasReport(const Options& opt)
+	{
+		Scene02Desc desc;
+		desc.longCount = opt.longCount;
+		desc.latiCount = opt.latiCount;
+		desc.gridCount = opt.gridCount;
+		desc.bottomBuild = opt.bvh;
+		desc.topBuild = opt.bvh;
+
+		Scene02 scene;
+		if (!SetupScene02(opt, desc, scene))
+			return -1;
+
+		// ボトムレベルASを共有しない場合のメモリ量と比較する
+		size_t bottomSize = 0, flattenedSize = 0;
+		uint64_t triangleCount = 0;
+		for (auto&& blas : scene.bottomLevels)
+		{
+			bottomSize += blas.GetMemorySize();
+		}
+		for (auto&& inst : scene.instanceDescs)
+		{
+			auto&& blas = scene.bottomLevels[inst.AccelerationStructure];
+			flattenedSize += blas.GetMemorySize();
+			triangleCount += blas.GetPrimitiveCount();
+		}
+		size_t topSize = scene.topLevel.GetMemorySize();
+
+		// シーンの上方からグリッド内の地面に向けてレイを飛ばす
+		auto bounds = scene.topLevel.GetBvh().GetBounds();
+		Random rnd(1);
+		TraversalStats topStats, bottomStats;
+		uint64_t hitCount = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < opt.rayCount; i++)
+		{
+			float3 origin(rnd.NextFloat(bounds.bmin.x, bounds.bmax.x), bounds.bmax.y + 5.0f, rnd.NextFloat(bounds.bmin.z, bounds.bmax.z));
+			float3 target(rnd.NextFloat(bounds.bmin.x, bounds.bmax.x), bounds.bmin.y, rnd.NextFloat(bounds.bmin.z, bounds.bmax.z));
+			RayDesc ray = { origin, 0.0f, normalize(target - origin), 10000.0f };
+			InstanceHit hit;
+			if (IntersectScene02(scene, ray, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, hit, &topStats, &bottomStats))
+				hitCount++;
+		}
+		auto end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+
+		if (opt.sceneFile.empty())
+			printf("grid %d x %d, bins %u, max leaf size %u\n", opt.gridCount, opt.gridCount, opt.bvh.binCount, opt.bvh.maxLeafSize);
+		else
+			printf("%s, bins %u, max leaf size %u\n", opt.sceneFile.c_str(), opt.bvh.binCount, opt.bvh.maxLeafSize);
+		printf("  instances        : %u\n", scene.topLevel.GetInstanceCount());
+		printf("  triangles        : %llu (instanced)\n", (unsigned long long)triangleCount);
+		printf("  bottom level     : %.1f KB shared, %.1f KB if flattened\n", bottomSize / 1024.0, flattenedSize / 1024.0);
+		printf("  top level        : %.1f KB\n", topSize / 1024.0);
+		if (scene.topLevelStats.nodeCount > 0)
+		{
+			// キャッシュから復元した場合は構築していない
+			printf("  top build time   : %.3f ms\n", scene.topLevelStats.seconds * 1000.0);
+			printf("  top depth        : %u\n", scene.topLevelStats.maxDepth);
+		}
+		printf("  top SAH cost     : %.3f\n", scene.topLevel.GetBvh().ComputeSAHCost(opt.bvh));
+		printf("  hit rate         : %.3f\n", (double)hitCount / opt.rayCount);
+		printf("  top nodes / ray  : %.3f\n", (double)topStats.nodeVisits / opt.rayCount);
+		printf("  instances / ray  : %.3f\n", (double)topStats.primTests / opt.rayCount);
+		printf("  blas nodes / ray : %.3f\n", (double)bottomStats.nodeVisits / opt.rayCount);
+		printf("  tests / ray      : %.3f\n", (double)bottomStats.primTests / opt.rayCount);
+		printf("  throughput       : %.3f Mrays/s (1 thread)\n", (double)opt.rayCount / seconds * 1e-6);
+		return 0;
+	}
+
+	// Sample03 のシーンの内箱の床に、球を gridCount x gridCount 個並べる
+	// 追加した球は file.instances の kScene03GridFirst 番目から
+	static const size_t kScene03GridFirst = 3;
+	static const float kScene03BoxWidth = 6.0f;
+
+	void MakeScene03GridFile(int gridCount, SceneFile& file)
+	{
+		MakeScene03File(file);
+		float cell = kScene03BoxWidth / gridCount;
+		for (int z = 0; z < gridCount; z++)
+		{
+			for (int x = 0; x < gridCount; x++)
+			{
+				float radius = cell * 0.3f;
+				SceneFileInstance inst = file.instances[0];
+				inst.material = (x + z) % 2 == 0 ? inst.material : file.instances[1].material;
+				inst.transform = ToTransform(mul(MatrixScaling(radius, radius, radius), MatrixTranslation((x + 0.5f) * cell - kScene03BoxWidth * 0.5f, radius, (z + 0.5f) * cell - kScene03BoxWidth * 0.5f)));
+				file.instances.push_back(inst);
+			}
+		}
+	}
+
+	// -mode nodes で比較するノード形式
+	const BvhNodeFormat kNodeFormats[] = { kBvhNodeFull, kBvhNodeQuantized, kBvhNodeWide4, kBvhNodeWide8 };
+	const char* const kNodeFormatNames[] = { "full", "quantized", "wide4", "wide8" };
+	static const int kNodeFormatCount = 4;
+
+	struct NodeFormatResult
+	{
+		size_t		memorySize = 0;		// トップレベルとボトムレベルのBVH
+		double		seconds = 0.0;
+		uint64_t	nodeVisits = 0;
+		uint64_t	mismatch = 0;		// 全精度のノードと結果が異なるレイ（ピクセル）の数
+	};
+
+	// 全精度のノードに対する比率を出力する
+	void PrintNodeFormatResults(const char* name, const NodeFormatResult* results, uint64_t rayCount, bool hasNodeVisits)
+	{
+		printf("%s:\n", name);
+		for (int f = 0; f < kNodeFormatCount; f++)
+		{
+			auto&& r = results[f];
+			printf("  %-9s : %8.1f KB (%+6.1f%%), %7.3f Mrays/s (%+6.1f%%)", kNodeFormatNames[f],
+				r.memorySize / 1024.0, 100.0 * ((double)r.memorySize / results[0].memorySize - 1.0),
+				rayCount / r.seconds * 1e-6, 100.0 * (results[0].seconds / r.seconds - 1.0));
+			if (hasNodeVisits)
+				printf(", %6.2f nodes/ray", (double)r.nodeVisits / rayCount);
+			printf(", %llu mismatches\n", (unsigned long long)r.mismatch);
+		}
+	}
+
+	// ノード形式ごとに、ASのメモリ量と走査の速さを比較する
+	// Sample02 のグリッドと、内箱に球を並べた Sample03 で計測する
+	int RunNodeFormatReport(const Options& opt)
+	{
+		printf("grid %d x %d, bins %u, max leaf size %u\n", opt.gridCount, opt.gridCount, opt.bvh.binCount, opt.bvh.maxLeafSize);
+
+		uint64_t totalMismatch = 0;
+		{
+			Scene02Desc desc;
+			desc.longCount = opt.longCount;
+			desc.latiCount = opt.latiCount;
+			desc.gridCount = opt.gridCount;
+			SceneFile file;
+			if (!MakeScene02File(desc, file))
+			{
+				printf("failed to create the Sample02 scene\n");
+				return -1;
+			}
+
+			// -mode tlas と同じく、シーンの上方からグリッド内の地面に向けてレイを飛ばす
+			std::vector<RayDesc> rays(opt.rayCount);
+			std::vector<InstanceHit> hits[kNodeFormatCount];
+			std::vector<bool> isHit[kNodeFormatCount];
+			NodeFormatResult results[kNodeFormatCount];
+			for (int f = 0; f < kNodeFormatCount; f++)
+			{
+				BvhBuildDesc build = opt.bvh;
+				build.nodeFormat = kNodeFormats[f];
+				Scene02 scene;
+				if (!InitScene02(scene, file, build, build))
+				{
+					printf("failed to build acceleration structures\n");
+					return -1;
+				}
+
+				auto&& r = results[f];
+				r.memorySize = scene.topLevel.GetBvh().GetMemorySize();
+				for (auto&& blas : scene.bottomLevels)
+					r.memorySize += blas.GetBvh().GetMemorySize();
+
+				if (f == 0)
+				{
+					auto bounds = scene.topLevel.GetBvh().GetBounds();
+					Random rnd(1);
+					for (auto&& ray : rays)
+					{
+						float3 origin(rnd.NextFloat(bounds.bmin.x, bounds.bmax.x), bounds.bmax.y + 5.0f, rnd.NextFloat(bounds.bmin.z, bounds.bmax.z));
+						float3 target(rnd.NextFloat(bounds.bmin.x, bounds.bmax.x), bounds.bmin.y, rnd.NextFloat(bounds.bmin.z, bounds.bmax.z));
+						ray = { origin, 0.0f, normalize(target - origin), 10000.0f };
+					}
+				}
+
+				// 時間は統計なしで計測し、ノードの訪問数は別に数える
+				hits[f].resize(rays.size());
+				isHit[f].resize(rays.size());
+				for (int i = 0; i < opt.repeat; i++)
+				{
+					auto start = std::chrono::steady_clock::now();
+					for (size_t j = 0; j < rays.size(); j++)
+						isHit[f][j] = IntersectScene02(scene, rays[j], RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, hits[f][j]);
+					auto end = std::chrono::steady_clock::now();
+					double seconds = std::chrono::duration<double>(end - start).count();
+					r.seconds = (i == 0) ? seconds : std::min(r.seconds, seconds);
+				}
+				TraversalStats topStats, bottomStats;
+				for (auto&& ray : rays)
+				{
+					InstanceHit hit;
+					IntersectScene02(scene, ray, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, hit, &topStats, &bottomStats);
+				}
+				r.nodeVisits = topStats.nodeVisits + bottomStats.nodeVisits;
+
+				// どの形式もボックスは元のボックスを含むので、最近接の交差は変わらない
+				for (size_t j = 0; j < rays.size(); j++)
+				{
+					if (isHit[f][j] != isHit[0][j])
+						r.mismatch++;
+					else if (isHit[f][j] && (hits[f][j].instanceIndex != hits[0][j].instanceIndex || hits[f][j].triangle.t != hits[0][j].triangle.t))
+						r.mismatch++;
+				}
+				totalMismatch += r.mismatch;
+			}
+			PrintNodeFormatResults("Sample02", results, rays.size(), true);
+		}
+
+		{
+			SceneFile file;
+			MakeScene03GridFile(opt.gridCount, file);
+
+			Image images[kNodeFormatCount];
+			NodeFormatResult results[kNodeFormatCount];
+			uint64_t rayCount = 0;
+			for (int f = 0; f < kNodeFormatCount; f++)
+			{
+				Scene03 scene;
+				if (!InitScene03(scene, file, kNodeFormats[f]))
+				{
+					printf("failed to build acceleration structures\n");
+					return -1;
+				}
+
+				auto&& r = results[f];
+				r.memorySize = scene.topLevel.GetBvh().GetMemorySize();
+				for (auto&& blas : scene.bottomLevels)
+					r.memorySize += blas.GetBvh().GetMemorySize();
+
+				SceneCB cb = MakeSceneFileCB(scene.camera, scene.light, opt.dispatch.width, opt.dispatch.height);
+				for (int i = 0; i < opt.repeat; i++)
+				{
+					RenderStats stats;
+					DispatchRays03(scene, cb, opt.dispatch, images[f], stats);
+					r.seconds = (i == 0) ? stats.seconds : std::min(r.seconds, stats.seconds);
+					rayCount = stats.rayCount;
+				}
+
+				for (size_t j = 0; j < images[f].pixels.size(); j++)
+				{
+					if (images[f].pixels[j] != images[0].pixels[j])
+						r.mismatch++;
+				}
+				totalMismatch += r.mismatch;
+			}
+
+			char name[64];
+			snprintf(name, sizeof(name), "Sample03 (%u instances)", (uint32_t)file.instances.size());
+			PrintNodeFormatResults(name, results, rayCount, false);
+		}
+		return totalMismatch == 0 ? 0 : -1;
+	}
+
+	// 内箱の球をランダムな速さで動かし、毎フレームのトップレベルASの更新（refit）と構築し直しを比較する
+	// refit したBVHのSAHコストが構築し直したものの rebuildRatio 倍を超えたら、構築し直して以降はそれを refit する
+	int RunRefitReport(const Options& opt)
+	{
+		SceneFile file;
+		MakeScene03GridFile(opt.gridCount, file);
+
+		// 内箱のAABBは壁の外側に大きく伸びていて、ルートの表面積のほとんどを占めてしまう
+		// SAHコストの差が見えなくなるので、内箱はマスクで外して球だけで比べる
+		file.instances[kScene03GridFirst - 1].mask = 0;
+
+		Scene03 scene, rebuilt;
+		if (!InitScene03(scene, file, opt.bvh.nodeFormat) || !InitScene03(rebuilt, file, opt.bvh.nodeFormat))
+		{
+			printf("failed to build acceleration structures\n");
+			return -1;
+		}
+
+		printf("%u instances, rebuild ratio %.2f\n", (uint32_t)file.instances.size(), opt.rebuildRatio);
+		bool canRefit = !scene.topLevel.GetBvh().IsQuantized();
+		if (!canRefit)
+			printf("quantized nodes cannot be refit, every frame is rebuilt\n");
+
+		// 球は床の上を等速で動き、内箱の壁で跳ね返る
+		const float kMaxSpeed = 0.05f;
+		std::vector<float3x4> transforms(scene.instanceDescs.size());
+		std::vector<float2> velocity(transforms.size());
+		Random rnd(1);
+		for (size_t i = 0; i < transforms.size(); i++)
+		{
+			transforms[i] = scene.instanceDescs[i].Transform;
+			if (i >= kScene03GridFirst)
+				velocity[i] = { rnd.NextFloat(-kMaxSpeed, kMaxSpeed), rnd.NextFloat(-kMaxSpeed, kMaxSpeed) };
+		}
+
+		printf("frame,refit ms,rebuild ms,refit SAH,rebuild SAH,ratio,action\n");
+		double refitTotal = 0.0, rebuildTotal = 0.0;
+		int firstRebuild = -1, rebuildCount = 0;
+		for (int frame = 1; frame <= opt.frameCount; frame++)
+		{
+			for (size_t i = kScene03GridFirst; i < transforms.size(); i++)
+			{
+				float radius = transforms[i].m[0][0];
+				float limit = kScene03BoxWidth * 0.5f - radius;
+				for (int axis = 0; axis < 2; axis++)
+				{
+					float& pos = transforms[i].m[axis * 2][3];
+					float& v = (axis == 0) ? velocity[i].x : velocity[i].y;
+					pos += v;
+					if (fabsf(pos) > limit)
+					{
+						pos = (pos > 0.0f) ? limit : -limit;
+						v = -v;
+					}
+				}
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			bool ok = UpdateScene03Transforms(scene, transforms, false);
+			auto mid = std::chrono::steady_clock::now();
+			ok = ok && UpdateScene03Transforms(rebuilt, transforms, true);
+			auto end = std::chrono::steady_clock::now();
+			if (!ok)
+			{
+				printf("failed to update acceleration structures\n");
+				return -1;
+			}
+
+			double refitSeconds = std::chrono::duration<double>(mid - start).count();
+			double rebuildSeconds = std::chrono::duration<double>(end - mid).count();
+			refitTotal += refitSeconds;
+			rebuildTotal += rebuildSeconds;
+
+			float refitCost = scene.topLevel.GetBvh().ComputeSAHCost(opt.bvh);
+			float rebuildCost = rebuilt.topLevel.GetBvh().ComputeSAHCost(opt.bvh);
+			float ratio = refitCost / std::max(rebuildCost, FLT_MIN);
+			const char* action = canRefit ? "refit" : "rebuild";
+			if (canRefit && ratio > opt.rebuildRatio)
+			{
+				// 構築し直したBVHを以降の refit の元にする
+				if (!UpdateScene03Transforms(scene, transforms, true))
+					return -1;
+				action = "rebuild";
+				rebuildCount++;
+				if (firstRebuild < 0)
+					firstRebuild = frame;
+			}
+			printf("%d,%.3f,%.3f,%.3f,%.3f,%.3f,%s\n", frame, refitSeconds * 1000.0, rebuildSeconds * 1000.0, refitCost, rebuildCost, ratio, action);
+		}
+
+		printf("average refit   : %.3f ms\n", refitTotal / opt.frameCount * 1000.0);
+		printf("average rebuild : %.3f ms\n", rebuildTotal / opt.frameCount * 1000.0);
+		if (firstRebuild < 0)
+			printf("no rebuild needed in %d frames\n", opt.frameCount);
+		else
+			printf("first rebuild at frame %d, %d rebuilds in %d frames\n", firstRebuild, rebuildCount, opt.frameCount);
+		return 0;
+	}
+
+	// 指定した時間CPUを回し続ける（sleep では短い時間を正確に待てない）
+	void SpinFor(double seconds)
+	{
+		auto start = std::chrono::steady_clock::now();
+		while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds)
+			;
+	}
+
+	// Sample03 のフレームループを CpuFrameQueue で再現し、同時に処理するフレーム数ごとにフレーム時間を比較する
+	// CPUはスロットのデータを書いてから -cpu の時間だけ記録し、キューは -gpu の時間をかけてスロットのデータを読む
+	// GPUの処理はCPUを使わないので、キューの側は回し続けずにスリープする
+	// キューが読んでいる間にCPUが同じスロットを書き換えたら競合として数える
+	// 毎フレームのアップロードデータは UploadRing から切り出し、キューが読み終わる前に上書きされていないかも調べる
+	int RunFramePacingReport(const Options& opt)
+	{
+		// 1フレームで最大 kMaxSlices x kMaxSliceSize バイト使い、3フレーム分は収まらない大きさにする
+		const uint64_t kRingSize = 16 * 1024;
+		const uint32_t kMaxSlices = 8;
+		const uint32_t kMaxSliceSize = 1024;
+
+		printf("cpu %.2f ms, gpu %.2f ms, %d frames, upload ring %llu bytes\n", opt.cpuMs, opt.gpuMs, opt.frameCount, (unsigned long long)kRingSize);
+		printf("frames in flight,frame ms,cpu wait ms/frame,waits,ring peak bytes,ring waits,races\n");
+
+		uint64_t totalRaces = 0;
+		for (uint32_t slotCount = 1; slotCount <= kMaxFramesInFlight; slotCount++)
+		{
+			std::unique_ptr<std::atomic<int>[]> slotFrames(new std::atomic<int>[slotCount]);
+			for (uint32_t i = 0; i < slotCount; i++)
+				slotFrames[i] = -1;
+			std::atomic<uint64_t> races(0);
+
+			CpuFrameQueue queue;
+			FramePacer pacer;
+			pacer.Init(&queue, slotCount);
+
+			// マップしたままのアップロードバッファの代わり
+			std::vector<uint8_t> ringBuffer(kRingSize);
+			UploadRing ring;
+			ring.Init(kRingSize);
+			Random rnd(1);
+
+			struct Slice
+			{
+				uint64_t	offset;
+				uint32_t	size;
+			};
+
+			auto start = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < opt.frameCount; frame++)
+			{
+				uint32_t slot = (uint32_t)frame % slotCount;
+				pacer.BeginFrame(slot);
+				ring.Retire(queue.GetCompletedValue());
+				slotFrames[slot] = frame;
+
+				// シーン定数（256バイト境界）とインスタンス記述子（16バイト境界）のつもりで切り出して埋める
+				std::vector<Slice> slices(rnd.Next() % kMaxSlices + 1);
+				uint8_t pattern = (uint8_t)(frame * 7 + 1);
+				for (size_t i = 0; i < slices.size(); i++)
+				{
+					slices[i].size = rnd.Next() % kMaxSliceSize + 1;
+					slices[i].offset = ring.Allocate(slices[i].size, (i == 0) ? 256 : 16, queue);
+					if (slices[i].offset == UploadRing::kInvalidOffset)
+					{
+						printf("upload ring overflow\n");
+						return -1;
+					}
+					memset(ringBuffer.data() + slices[i].offset, pattern, slices[i].size);
+				}
+				SpinFor(opt.cpuMs * 1e-3);
+
+				std::atomic<int>* pSlotFrame = &slotFrames[slot];
+				const uint8_t* pRing = ringBuffer.data();
+				queue.Execute([&races, pSlotFrame, frame, slices, pRing, pattern, &opt]()
+				{
+					auto IsValid = [&]()
+					{
+						if (*pSlotFrame != frame)
+							return false;
+						for (auto&& slice : slices)
+						{
+							for (uint32_t i = 0; i < slice.size; i++)
+							{
+								if (pRing[slice.offset + i] != pattern)
+									return false;
+							}
+						}
+						return true;
+					};
+					bool isValid = IsValid();
+					std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(opt.gpuMs));
+					if (!isValid || !IsValid())
+						races++;
+				});
+				ring.EndFrame(pacer.EndFrame());
+			}
+			pacer.WaitIdle();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			auto&& stats = pacer.GetStats();
+			auto&& ringStats = ring.GetStats();
+			printf("%u,%.3f,%.3f,%llu,%llu,%llu,%llu\n", slotCount, seconds / opt.frameCount * 1000.0, stats.waitSeconds / opt.frameCount * 1000.0,
+				(unsigned long long)stats.waitCount, (unsigned long long)ringStats.peakSize, (unsigned long long)ringStats.waitCount, (unsigned long long)races.load());
+			totalRaces += races;
+		}
+		return totalRaces == 0 ? 0 : -1;
+	}
+
+	// Sample03 の CreateFallbackWrappedPointer のように BLAS ごとにディスクリプタを確保しながら、古い BLAS を捨てていく
+	// 確保した範囲にはそれぞれ別の値を書き込み、最後まで読み返せれば範囲が重なっておらず、ヒープを広げても中身が保たれている
+	int RunDescriptorReport(const Options& opt)
+	{
+		const uint32_t kTransientCount = 16;		// スロットごとの一時ディスクリプタ数
+		const uint32_t kTableSize = 4;				// ときどき確保するディスクリプタテーブルの大きさ
+
+		CpuDescriptorHeap heap;
+		heap.Init(opt.heapSize);
+		DescriptorAllocator allocator;
+		if (!allocator.Init(&heap, opt.heapSize, opt.maxHeapSize, kMaxFramesInFlight, kTransientCount))
+		{
+			printf("invalid heap size\n");
+			return -1;
+		}
+
+		struct Allocation
+		{
+			uint32_t	index;
+			uint32_t	count;
+			uint64_t	value;
+		};
+		std::vector<Allocation> live;
+		Random rnd(1);
+		uint64_t nextValue = 1;
+		uint32_t corrupted = 0;
+		int frameCount = std::max(opt.frameCount, 1);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			allocator.BeginFrame((uint32_t)frame % kMaxFramesInFlight);
+
+			// このフレームで読み込む BLAS
+			int blasEnd = (int)((int64_t)opt.blasCount * (frame + 1) / frameCount);
+			int blasBegin = (int)((int64_t)opt.blasCount * frame / frameCount);
+			for (int i = blasBegin; i < blasEnd; i++)
+			{
+				uint32_t count = (rnd.Next() % 8 == 0) ? kTableSize : 1;
+				uint32_t index = allocator.Allocate(count);
+				if (index == DescriptorAllocator::kInvalidIndex)
+				{
+					printf("descriptor heap overflow at %u descriptors\n", allocator.GetCapacity());
+					return -1;
+				}
+				for (uint32_t j = 0; j < count; j++)
+					heap.Write(index + j, nextValue);
+				live.push_back({ index, count, nextValue++ });
+			}
+
+			// 使われなくなった BLAS を4分の1くらい捨てる
+			for (size_t n = live.size() / 4; n > 0 && !live.empty(); n--)
+			{
+				size_t i = rnd.Next() % live.size();
+				allocator.Free(live[i].index, live[i].count);
+				live[i] = live.back();
+				live.pop_back();
+			}
+
+			// このフレームだけで使うディスクリプタ
+			uint32_t transientCount = rnd.Next() % kTransientCount + 1;
+			uint32_t transient = allocator.AllocateTransient(transientCount);
+			if (transient == DescriptorAllocator::kInvalidIndex || transient + transientCount > kMaxFramesInFlight * kTransientCount)
+			{
+				printf("invalid transient range\n");
+				return -1;
+			}
+			for (uint32_t j = 0; j < transientCount; j++)
+				heap.Write(transient + j, nextValue);
+			nextValue++;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (auto&& a : live)
+		{
+			for (uint32_t j = 0; j < a.count; j++)
+			{
+				if (heap.Read(a.index + j) != a.value)
+					corrupted++;
+			}
+		}
+
+		// 最大サイズを超えたら黙って重ねずに失敗を返すか
+		CpuDescriptorHeap smallHeap;
+		smallHeap.Init(16);
+		DescriptorAllocator smallAllocator;
+		smallAllocator.Init(&smallHeap, 16, 64, kMaxFramesInFlight, 4);
+		uint32_t smallCount = 0;
+		while (smallAllocator.Allocate() != DescriptorAllocator::kInvalidIndex)
+			smallCount++;
+		bool overflowDetected = smallAllocator.GetStats().overflowCount == 1 && smallCount == 64 - kMaxFramesInFlight * 4;
+
+		auto&& stats = allocator.GetStats();
+		printf("%d frames, %d BLAS, %.3f ms\n", frameCount, opt.blasCount, seconds * 1000.0);
+		printf("capacity         : %u (initial %d, grew %u times)\n", stats.capacity, opt.heapSize, stats.growCount);
+		printf("persistent       : %u live, %u peak\n", stats.persistentCount, stats.persistentPeak);
+		printf("transient        : %u peak / %u per frame\n", stats.transientPeak, kTransientCount);
+		printf("overflows        : %u\n", stats.overflowCount);
+		printf("corrupted        : %u\n", corrupted);
+		printf("overflow check   : %s\n", overflowDetected ? "ok" : "failed");
+		return (corrupted == 0 && overflowDetected) ? 0 : -1;
+	}
+
+	// シーンの読み込みで作る小さなバッファを UploadArena に詰め、バッファごとにリソースを作る場合と比べる
+	// 各バッファには別の値を書き込み、最後に読み返してアラインメントと重なりを確認する
+	int RunUploadArenaReport(const Options& opt)
+	{
+		const uint64_t kResourceAlignment = 64 * 1024;	// D3D12 のバッファ1つあたりの最小サイズ
+
+		// 種類ごとの要素サイズとアラインメント
+		struct BufferKind
+		{
+			uint32_t	stride;
+			uint32_t	alignment;
+			uint32_t	maxCount;
+		};
+		const BufferKind kKinds[] = {
+			{ 24, 4, 512 },		// 頂点（位置と法線）
+			{ 2, 4, 1536 },		// インデックス
+			{ 24, 8, 16 },		// AABB（D3D12_RAYTRACING_AABB_BYTE_ALIGNMENT）
+			{ 64, 16, 8 },		// インスタンス記述子
+			{ 256, 256, 1 },	// 定数バッファ（D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT）
+			{ 48, 48, 32 },		// StructuredBuffer（FirstElement で指すので要素サイズの倍数に置く）
+		};
+		const int kKindCount = sizeof(kKinds) / sizeof(kKinds[0]);
+
+		CpuUploadPageHeap heap;
+		UploadArena arena;
+		arena.Init(&heap, opt.pageSize);
+
+		struct Buffer
+		{
+			UploadAllocation	alloc;
+			int					kind;
+			uint32_t			value;
+		};
+		std::vector<Buffer> buffers(opt.bufferCount);
+		std::vector<uint8_t> data;
+		Random rnd(1);
+		uint64_t committedBytes = 0;
+		uint32_t misaligned = 0, corrupted = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < opt.bufferCount; i++)
+		{
+			auto&& b = buffers[i];
+			b.kind = (int)(rnd.Next() % kKindCount);
+			b.value = (uint32_t)i;
+			auto&& kind = kKinds[b.kind];
+			uint64_t size = (uint64_t)kind.stride * (rnd.Next() % kind.maxCount + 1);
+			if (!arena.Allocate(size, kind.alignment, b.alloc))
+			{
+				printf("failed to create an upload page\n");
+				return -1;
+			}
+			data.assign((size_t)size, (uint8_t)(b.value * 13 + 1));
+			memcpy(b.alloc.pData, data.data(), data.size());
+			committedBytes += (size + kResourceAlignment - 1) & ~(kResourceAlignment - 1);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (auto&& b : buffers)
+		{
+			// 2のべき乗でないアラインメント（StructuredBuffer）はページ内のオフセットだけが揃う
+			uint32_t alignment = kKinds[b.kind].alignment;
+			if (b.alloc.offset % alignment != 0 || ((alignment & (alignment - 1)) == 0 && b.alloc.address % alignment != 0))
+				misaligned++;
+			auto pData = static_cast<const uint8_t*>(b.alloc.pData);
+			for (uint64_t i = 0; i < b.alloc.size; i++)
+			{
+				if (pData[i] != (uint8_t)(b.value * 13 + 1))
+				{
+					corrupted++;
+					break;
+				}
+			}
+		}
+
+		auto&& stats = arena.GetStats();
+		printf("%d buffers, %.3f ms\n", opt.bufferCount, seconds * 1000.0);
+		printf("data             : %.2f MB\n", stats.allocBytes / (1024.0 * 1024.0));
+		printf("arena            : %u pages, %.2f MB (padding %.2f MB)\n", stats.pageCount, stats.pageBytes / (1024.0 * 1024.0), stats.paddingBytes / (1024.0 * 1024.0));
+		printf("one per buffer   : %d resources, %.2f MB\n", opt.bufferCount, committedBytes / (1024.0 * 1024.0));
+		printf("misaligned       : %u\n", misaligned);
+		printf("corrupted        : %u\n", corrupted);
+		arena.Reset();
+		return (misaligned == 0 && corrupted == 0) ? 0 : -1;
+	}
+
+	// BLAS をまとめて構築するときのメモリを AsMemoryPool から切り出す
+	// 1回の送信で構築する BLAS は間にバリアがないので同時に動くものとし、全部が書き込んでから全部が読み返す
+	// スクラッチをビルドごとに切り出した場合と、Sample02/03 のように1つのスクラッチを共有した場合を比べる
+	int RunAsPoolReport(const Options& opt)
+	{
+		const int kBatchSize = 64;							// 1回の送信で構築する BLAS の数
+		const uint64_t kResourceAlignment = 64 * 1024;		// D3D12 のバッファ1つあたりの最小サイズ
+
+		CpuAsMemoryHeap resultHeap, scratchHeap;
+		AsMemoryPool resultPool, scratchPool;
+		resultPool.Init(&resultHeap, opt.blockSize);
+		scratchPool.Init(&scratchHeap, opt.blockSize);
+
+		struct Build
+		{
+			AsAllocation	result;
+			AsAllocation	scratch;
+			uint8_t			value;
+		};
+		std::vector<AsAllocation> live;
+		Random rnd(1);
+		auto ResourceSize = [&](uint64_t size) { return (size + kResourceAlignment - 1) & ~(kResourceAlignment - 1); };
+		uint64_t committedBytes = 0, committedPeak = 0;		// BLAS とスクラッチを1つずつリソースにした場合
+		uint32_t sliceRaces = 0, sharedRaces = 0, corrupted = 0;
+
+		// バッファを value で埋め、あとで読み返す
+		auto Fill = [](uint8_t* p, uint64_t size, uint8_t value) { memset(p, value, (size_t)size); };
+		auto Check = [](const uint8_t* p, uint64_t size, uint8_t value)
+		{
+			for (uint64_t i = 0; i < size; i++)
+			{
+				if (p[i] != value)
+					return false;
+			}
+			return true;
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		for (int first = 0; first < opt.blasCount; first += kBatchSize)
+		{
+			int count = std::min(kBatchSize, opt.blasCount - first);
+			std::vector<Build> builds(count);
+			uint64_t maxScratch = 0;
+			for (int i = 0; i < count; i++)
+			{
+				auto&& b = builds[i];
+				uint64_t resultSize = 4096 + rnd.Next() % (256 * 1024);
+				uint64_t scratchSize = resultSize / 2 + rnd.Next() % 4096;
+				b.value = (uint8_t)(first + i + 1);
+				if (!resultPool.Allocate(resultSize, b.result) || !scratchPool.Allocate(scratchSize, b.scratch))
+				{
+					printf("failed to create an AS memory block\n");
+					return -1;
+				}
+				maxScratch = std::max(maxScratch, b.scratch.size);
+				committedBytes += ResourceSize(b.result.size);
+			}
+
+			// ビルドごとのスクラッチ
+			for (auto&& b : builds)
+			{
+				Fill(scratchHeap.GetData(b.scratch), b.scratch.size, b.value);
+				Fill(resultHeap.GetData(b.result), b.result.size, b.value);
+			}
+			for (auto&& b : builds)
+			{
+				if (!Check(scratchHeap.GetData(b.scratch), b.scratch.size, b.value))
+					sliceRaces++;
+			}
+
+			// 共有したスクラッチ（ビルドの間にバリアがなければ、同じ範囲を同時に使う）
+			AsAllocation shared;
+			scratchPool.Allocate(maxScratch, shared);
+			for (auto&& b : builds)
+				Fill(scratchHeap.GetData(shared), b.scratch.size, b.value);
+			for (auto&& b : builds)
+			{
+				if (!Check(scratchHeap.GetData(shared), b.scratch.size, b.value))
+					sharedRaces++;
+			}
+			scratchPool.Free(shared);
+			committedPeak = std::max(committedPeak, committedBytes + ResourceSize(maxScratch));
+
+			// 送信したバッチが終わったらスクラッチは返す
+			for (auto&& b : builds)
+			{
+				if (!Check(resultHeap.GetData(b.result), b.result.size, b.value))
+					corrupted++;
+				scratchPool.Free(b.scratch);
+				live.push_back(b.result);
+			}
+
+			// 使われなくなった BLAS を4分の1くらい捨てる
+			for (size_t n = live.size() / 4; n > 0; n--)
+			{
+				size_t i = rnd.Next() % live.size();
+				resultPool.Free(live[i]);
+				committedBytes -= ResourceSize(live[i].size);
+				live[i] = live.back();
+				live.pop_back();
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		auto&& resultStats = resultPool.GetStats();
+		auto&& scratchStats = scratchPool.GetStats();
+		printf("%d BLAS in batches of %d, %.3f ms\n", opt.blasCount, kBatchSize, seconds * 1000.0);
+		printf("result pool      : %u blocks, %.2f MB (peak used %.2f MB, %zu live BLAS)\n", resultStats.blockCount, resultStats.blockBytes / (1024.0 * 1024.0),
+			resultStats.peakBytes / (1024.0 * 1024.0), live.size());
+		printf("scratch pool     : %u blocks, %.2f MB (peak used %.2f MB)\n", scratchStats.blockCount, scratchStats.blockBytes / (1024.0 * 1024.0), scratchStats.peakBytes / (1024.0 * 1024.0));
+		printf("one per resource : %.2f MB peak\n", committedPeak / (1024.0 * 1024.0));
+		printf("scratch races    : %u per-build slices, %u shared scratch\n", sliceRaces, sharedRaces);
+		printf("corrupted        : %u\n", corrupted);
+		resultPool.Reset();
+		scratchPool.Reset();
+		return (sliceRaces == 0 && corrupted == 0) ? 0 : -1;
+	}
+
+	// 構築直後とコンパクション後の確保済みメモリ量を比較し、走査結果が変わらないことを確認する
+	// 構築時のノードは実際の数で確保しているので、減る分はノード形式の変換によるもの
+	int RunCompactReport(const Options& opt)
+	{
+		auto PrintSize = [](const char* name, BvhNodeFormat formatBefore, BvhNodeFormat formatAfter, size_t before, size_t after)
+		{
+			printf("%-16s : %-9s %10.1f KB -> %-9s %10.1f KB (%5.1f%%)\n", name, kNodeFormatNames[formatBefore], before / 1024.0,
+				kNodeFormatNames[formatAfter], after / 1024.0, before ? after * 100.0 / before : 100.0);
+		};
+
+		// Sample02 のグリッド（トライアングルのBLAS）
+		Scene02Desc desc;
+		desc.longCount = opt.longCount;
+		desc.latiCount = opt.latiCount;
+		desc.gridCount = opt.gridCount;
+		desc.bottomBuild = opt.bvh;
+		desc.topBuild = opt.bvh;
+		Scene02 scene02;
+		if (!InitScene02(scene02, desc))
+		{
+			printf("failed to create the Sample02 scene\n");
+			return -1;
+		}
+
+		// シーンの上方からグリッド内の地面に向けてレイを飛ばす
+		auto TraceScene02 = [&](std::vector<InstanceHit>& hits)
+		{
+			auto bounds = scene02.topLevel.GetBvh().GetBounds();
+			Random rnd(1);
+			hits.resize(opt.rayCount);
+			for (int i = 0; i < opt.rayCount; i++)
+			{
+				float3 origin(rnd.NextFloat(bounds.bmin.x, bounds.bmax.x), bounds.bmax.y + 5.0f, rnd.NextFloat(bounds.bmin.z, bounds.bmax.z));
+				float3 target(rnd.NextFloat(bounds.bmin.x, bounds.bmax.x), bounds.bmin.y, rnd.NextFloat(bounds.bmin.z, bounds.bmax.z));
+				RayDesc ray = { origin, 0.0f, normalize(target - origin), 10000.0f };
+				auto&& hit = hits[i];
+				hit = InstanceHit();
+				hit.instanceIndex = ~0u;
+				IntersectScene02(scene02, ray, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, hit);
+			}
+		};
+
+		std::vector<InstanceHit> hitsBefore, hitsAfter;
+		TraceScene02(hitsBefore);
+
+		const char* kScene02Names[] = { "Sample02 box", "Sample02 sphere" };
+		size_t totalBefore = 0, totalAfter = 0;
+		for (size_t i = 0; i < scene02.bottomLevels.size(); i++)
+		{
+			auto&& blas = scene02.bottomLevels[i];
+			auto formatBefore = blas.GetBvh().GetNodeFormat();
+			size_t before = blas.GetAllocatedSize();
+			blas.Compact(opt.compactFormat);
+			size_t after = blas.GetAllocatedSize();
+			PrintSize(i < 2 ? kScene02Names[i] : "Sample02 mesh", formatBefore, blas.GetBvh().GetNodeFormat(), before, after);
+			totalBefore += before;
+			totalAfter += after;
+		}
+		{
+			auto format = scene02.topLevel.GetBvh().GetNodeFormat();
+			size_t before = scene02.topLevel.GetAllocatedSize();
+			scene02.topLevel.Compact();
+			size_t after = scene02.topLevel.GetAllocatedSize();
+			PrintSize("Sample02 TLAS", format, format, before, after);
+			totalBefore += before;
+			totalAfter += after;
+		}
+
+		TraceScene02(hitsAfter);
+		uint32_t mismatches = 0;
+		for (int i = 0; i < opt.rayCount; i++)
+		{
+			auto&& a = hitsBefore[i];
+			auto&& b = hitsAfter[i];
+			if (a.instanceIndex != b.instanceIndex || (a.instanceIndex != ~0u && (a.triangle.t != b.triangle.t || a.triangle.primitiveIndex != b.triangle.primitiveIndex)))
+				mismatches++;
+		}
+
+		// Sample03（プロシージャルのBLAS）は画像で比較する
+		SceneFile file;
+		MakeScene03File(file);
+		Scene03 scene03;
+		if (!InitScene03(scene03, file, opt.bvh.nodeFormat))
+		{
+			printf("failed to create the Sample03 scene\n");
+			return -1;
+		}
+		SceneCB cb = MakeScene03CB(opt.frame, opt.dispatch.width, opt.dispatch.height);
+		Image imageBefore, imageAfter;
+		RenderStats stats;
+		DispatchRays03(scene03, cb, opt.dispatch, imageBefore, stats);
+
+		const char* kScene03Names[] = { "Sample03 inner", "Sample03 prop" };
+		for (int i = 0; i < 2; i++)
+		{
+			auto&& blas = scene03.bottomLevels[i];
+			auto formatBefore = blas.GetBvh().GetNodeFormat();
+			size_t before = blas.GetAllocatedSize();
+			blas.Compact(opt.compactFormat);
+			size_t after = blas.GetAllocatedSize();
+			PrintSize(kScene03Names[i], formatBefore, blas.GetBvh().GetNodeFormat(), before, after);
+			totalBefore += before;
+			totalAfter += after;
+		}
+		{
+			auto format = scene03.topLevel.GetBvh().GetNodeFormat();
+			size_t before = scene03.topLevel.GetAllocatedSize();
+			scene03.topLevel.Compact();
+			size_t after = scene03.topLevel.GetAllocatedSize();
+			PrintSize("Sample03 TLAS", format, format, before, after);
+			totalBefore += before;
+			totalAfter += after;
+		}
+
+		DispatchRays03(scene03, cb, opt.dispatch, imageAfter, stats);
+		uint32_t pixelMismatches = 0;
+		for (size_t i = 0; i < imageBefore.pixels.size(); i++)
+		{
+			if (imageBefore.pixels[i] != imageAfter.pixels[i])
+				pixelMismatches++;
+		}
+
+		printf("%-16s : %20.1f KB -> %20.1f KB (%5.1f%%)\n", "total", totalBefore / 1024.0, totalAfter / 1024.0, totalBefore ? totalAfter * 100.0 / totalBefore : 100.0);
+		printf("Sample02 rays    : %d, %u mismatches\n", opt.rayCount, mismatches);
+		printf("Sample03 pixels  : %zu, %u mismatches\n", imageBefore.pixels.size(), pixelMismatches);
+		return (mismatches == 0 && pixelMismatches == 0) ? 0 : -1;
+	}
+
+	// インスタンスごとにマテリアルのヒットグループを登録したシェーダテーブルを配列の上に作る
+	// 同じマテリアルのインスタンスはレコードを共有し、動くインスタンスは個別のレコードを毎フレーム書き換える
+	int RunShaderTableReport(const Options& opt)
+	{
+		const uint32_t kIdentifierSize = 32;		// D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES
+		const uint32_t kRayTypeCount = 2;			// Sample03 の通常のレイとシャドウレイ
+		const uint32_t kMissCount = 3;
+		const int kAnimatedRatio = 100;				// 100個に1個のインスタンスが動く
+		const uint64_t kBaseAddress = 0x10000;
+
+		struct RayGenArguments
+		{
+			float4		viewport;
+		};
+		struct MaterialArguments
+		{
+			float4		color;
+			uint32_t	textureIndex;
+			uint32_t	instanceIndex;		// 動くインスタンスだけ使う
+		};
+
+		// シェーダ識別子の代わりに番号を書いたもの
+		auto MakeIdentifier = [&](uint32_t id)
+		{
+			std::vector<uint8_t> identifier(kIdentifierSize);
+			for (uint32_t i = 0; i < kIdentifierSize; i++)
+				identifier[i] = (uint8_t)(id * 31 + i);
+			return identifier;
+		};
+		auto rayGenId = MakeIdentifier(0);
+		std::vector<std::vector<uint8_t>> missIds, hitGroupIds;
+		for (uint32_t i = 0; i < kMissCount; i++) missIds.push_back(MakeIdentifier(1 + i));
+		for (uint32_t i = 0; i < kRayTypeCount; i++) hitGroupIds.push_back(MakeIdentifier(1 + kMissCount + i));
+
+		uint32_t materialCount = (uint32_t)std::max(opt.materialCount, 1);
+		std::vector<MaterialArguments> materials(materialCount);
+		Random rnd(1);
+		for (uint32_t i = 0; i < materialCount; i++)
+		{
+			materials[i].color = float4(rnd.NextFloat(), rnd.NextFloat(), rnd.NextFloat(), 1.0f);
+			materials[i].textureIndex = i;
+			materials[i].instanceIndex = 0;
+		}
+
+		struct Instance
+		{
+			uint32_t	material;
+			bool		animated;
+			uint32_t	contribution;		// InstanceContributionToHitGroupIndex
+		};
+		std::vector<Instance> instances(std::max(opt.instanceCount, 1));
+		for (auto&& inst : instances)
+		{
+			inst.material = rnd.Next() % materialCount;
+			inst.animated = (rnd.Next() % kAnimatedRatio) == 0;
+		}
+
+		auto InstanceArguments = [&](uint32_t index, int frame)
+		{
+			auto&& inst = instances[index];
+			MaterialArguments args = materials[inst.material];
+			if (inst.animated)
+			{
+				args.color.w = (float)frame;
+				args.instanceIndex = index;
+			}
+			return args;
+		};
+
+		ShaderTableBuilder builder;
+		auto BuildTable = [&](int frame)
+		{
+			builder.Init(kIdentifierSize);
+			RayGenArguments rayGenArgs = { float4(-1.0f, -1.0f, 1.0f, 1.0f) };
+			builder.Add(kShaderTableRayGen, MakeShaderRecord(rayGenId.data(), rayGenArgs));
+			for (auto&& id : missIds)
+				builder.Add(kShaderTableMiss, MakeShaderRecord(id.data()));
+			for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+			{
+				auto args = InstanceArguments(i, frame);
+				ShaderRecord records[kRayTypeCount];
+				for (uint32_t r = 0; r < kRayTypeCount; r++)
+					records[r] = MakeShaderRecord(hitGroupIds[r].data(), args);
+				instances[i].contribution = instances[i].animated
+					? builder.AddUnique(kShaderTableHitGroup, records, kRayTypeCount)
+					: builder.Add(kShaderTableHitGroup, records, kRayTypeCount);
+			}
+			builder.Build();
+		};
+
+		// レコードが識別子とルート引数の通りに並び、範囲が揃っているか確認する
+		std::vector<uint8_t> buffer;
+		auto Verify = [&](int frame)
+		{
+			uint32_t errors = 0;
+			auto rayGen = builder.GetRecordRange(kShaderTableRayGen, 0, kBaseAddress);
+			auto miss = builder.GetRange(kShaderTableMiss, kBaseAddress);
+			auto hitGroup = builder.GetRange(kShaderTableHitGroup, kBaseAddress);
+			for (auto&& range : { rayGen, miss, hitGroup })
+			{
+				if (range.startAddress % kShaderTableAlignment != 0 || range.strideInBytes % kShaderRecordAlignment != 0)
+					errors++;
+				if (range.startAddress + range.sizeInBytes > kBaseAddress + buffer.size())
+					errors++;
+			}
+			if (miss.sizeInBytes != miss.strideInBytes * kMissCount)
+				errors++;
+
+			auto Record = [&](const ShaderTableRange& range, uint32_t index) { return &buffer[(size_t)(range.startAddress - kBaseAddress + range.strideInBytes * index)]; };
+			for (uint32_t i = 0; i < kMissCount; i++)
+			{
+				if (memcmp(Record(miss, i), missIds[i].data(), kIdentifierSize) != 0)
+					errors++;
+			}
+			for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+			{
+				auto args = InstanceArguments(i, frame);
+				for (uint32_t r = 0; r < kRayTypeCount; r++)
+				{
+					const uint8_t* p = Record(hitGroup, instances[i].contribution + r);
+					if (memcmp(p, hitGroupIds[r].data(), kIdentifierSize) != 0 || memcmp(p + kIdentifierSize, &args, sizeof(args)) != 0)
+						errors++;
+				}
+			}
+			return errors;
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		BuildTable(0);
+		double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		buffer.resize((size_t)builder.GetSize());
+		builder.Write(buffer.data());
+		uint32_t errors = Verify(0);
+
+		auto&& stats = builder.GetStats();
+		uint32_t hitGroupCount = builder.GetRecordCount(kShaderTableHitGroup);
+		uint64_t unsharedSize = (uint64_t)instances.size() * kRayTypeCount * builder.GetStride(kShaderTableHitGroup);
+		printf("%zu instances, %u materials, %u ray types\n", instances.size(), materialCount, kRayTypeCount);
+		printf("stride           : raygen %u, miss %u, hit group %u bytes\n",
+			builder.GetStride(kShaderTableRayGen), builder.GetStride(kShaderTableMiss), builder.GetStride(kShaderTableHitGroup));
+		printf("hit group records: %u (%llu shared), %.1f KB (%.1f KB without sharing)\n", hitGroupCount,
+			(unsigned long long)stats.sharedCount, builder.GetSize() / 1024.0, unsharedSize / 1024.0);
+		printf("build            : %.3f ms\n", buildSeconds * 1000.0);
+
+		// 動くインスタンスのルート引数だけを書き換える場合と、毎フレーム作り直す場合を比べる
+		int frameCount = std::max(opt.frameCount, 1);
+		double patchSeconds = 0.0, rebuildSeconds = 0.0;
+		for (int frame = 1; frame <= frameCount; frame++)
+		{
+			start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+			{
+				if (!instances[i].animated)
+					continue;
+				auto args = InstanceArguments(i, frame);
+				for (uint32_t r = 0; r < kRayTypeCount; r++)
+				{
+					if (!builder.Patch(kShaderTableHitGroup, instances[i].contribution + r, args, buffer.data()))
+						errors++;
+				}
+			}
+			patchSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			errors += Verify(frame);
+		}
+		uint64_t patchCount = builder.GetStats().patchCount;
+		for (int frame = 1; frame <= frameCount; frame++)
+		{
+			start = std::chrono::steady_clock::now();
+			BuildTable(frame);
+			builder.Write(buffer.data());
+			rebuildSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		errors += Verify(frameCount);
+
+		printf("patch            : %.3f ms/frame (%llu records)\n", patchSeconds * 1000.0 / frameCount, (unsigned long long)(patchCount / frameCount));
+		printf("rebuild          : %.3f ms/frame\n", rebuildSeconds * 1000.0 / frameCount);
+		printf("errors           : %u\n", errors);
+		return (errors == 0) ? 0 : -1;
+	}
+
+	// カメラとシーンを止めたまま Sample03 のフレームを累積し、多くのサンプルで作った基準画像との誤差が減っていくことを確かめる
+	// そのあとカメラやシーンを変えたときに累積し直すこと、収束したらレイトレースしないことを確かめる
+	int RunProgressiveReport(const Options& opt)
+	{
+		const uint32_t kReferenceScale = 4;
+		const uint32_t kReferenceSeed = 0x80000000;		// 基準画像は別の乱数系列で作る
+
+		Scene03 scene;
+		if (!SetupScene03(opt, scene))
+			return -1;
+		auto baseTransforms = GetInstanceTransforms(scene);
+
+		SceneCB cb;
+		if (!SetupFrame03(opt, scene, baseTransforms, opt.frame, cb))
+			return -1;
+		cb.lightRadius = opt.lightRadius;
+		const uint32_t cameraSize = offsetof(SceneCB, frameIndex);
+		uint32_t sampleCount = (opt.sampleCount > 0) ? opt.sampleCount : 32;
+
+		// accumulator が止めるまで累積する
+		// perFrame はサンプル数と、そのフレームまでの平均が入った累積バッファを受け取る
+		auto Accumulate = [&](ProgressiveAccumulator& accumulator, uint64_t sceneVersion, uint32_t seed, AccumImage& accum, Image& image,
+			const std::function<void(uint32_t, const AccumImage&, const RenderStats&)>& perFrame)
+		{
+			while (accumulator.BeginFrame(&cb, cameraSize, sceneVersion))
+			{
+				cb.frameIndex = seed + accumulator.GetFrameIndex();
+				cb.sampleCount = accumulator.GetSampleCount();
+				RenderStats stats;
+				DispatchRays03(scene, cb, opt.dispatch, image, stats, &accum);
+				perFrame(cb.sampleCount, accum, stats);
+			}
+		};
+
+		AccumImage reference;
+		Image image;
+		{
+			ProgressiveAccumulator accumulator;
+			accumulator.Init(sampleCount * kReferenceScale);
+			Accumulate(accumulator, 0, kReferenceSeed, reference, image, [](uint32_t, const AccumImage&, const RenderStats&) {});
+		}
+		uint32_t referenceCount = sampleCount * kReferenceScale;
+
+		// 基準画像との平均二乗誤差の平方根（RGBの平均）
+		auto ComputeError = [&](const AccumImage& accum, uint32_t count)
+		{
+			double sum = 0.0;
+			for (uint32_t y = 0; y < accum.height; y++)
+			{
+				for (uint32_t x = 0; x < accum.width; x++)
+				{
+					float4 a = accum.GetAverage(x, y, count);
+					float4 b = reference.GetAverage(x, y, referenceCount);
+					float3 d = a.xyz() - b.xyz();
+					sum += dot(d, d) / 3.0;
+				}
+			}
+			return sqrt(sum / ((double)accum.width * accum.height));
+		};
+
+		// 累積しない場合（画素中心の1サンプルとハードシャドウ）、UNORM の出力を戻して比べる
+		double singleError;
+		{
+			SceneCB single = cb;
+			single.lightRadius = 0.0f;
+			single.sampleCount = 0;
+			AccumImage accum;
+			RenderStats stats;
+			DispatchRays03(scene, single, opt.dispatch, image, stats);
+			accum.Resize(opt.dispatch.width, opt.dispatch.height);
+			for (uint32_t y = 0; y < opt.dispatch.height; y++)
+			{
+				for (uint32_t x = 0; x < opt.dispatch.width; x++)
+				{
+					uint32_t p = image.pixels[(size_t)y * image.width + x];
+					accum.Accumulate(x, y, float4((p & 0xff) / 255.0f, ((p >> 8) & 0xff) / 255.0f, ((p >> 16) & 0xff) / 255.0f, 1.0f), 1);
+				}
+			}
+			singleError = ComputeError(accum, 1);
+		}
+
+		printf("resolution : %u x %u, light radius %.3f rad, reference %u samples\n", opt.dispatch.width, opt.dispatch.height, opt.lightRadius, referenceCount);
+		printf("no accumulation (hard shadow)   : RMSE %.5f\n", singleError);
+
+		uint32_t errors = 0;
+		ProgressiveAccumulator accumulator;
+		accumulator.Init(sampleCount);
+		AccumImage accum;
+		double firstError = 0.0, lastError = 0.0, seconds = 0.0;
+		Accumulate(accumulator, 0, 0, accum, image, [&](uint32_t count, const AccumImage& a, const RenderStats& stats)
+		{
+			seconds += stats.seconds;
+			if ((count & (count - 1)) != 0 && count != sampleCount)
+				return;
+			double error = ComputeError(a, count);
+			if (count == 1)
+				firstError = error;
+			lastError = error;
+			printf("%5u samples                   : RMSE %.5f, %.3f ms/frame\n", count, error, seconds * 1000.0 / count);
+		});
+		if (!accumulator.IsConverged() || accumulator.GetSampleCount() != sampleCount || !(lastError < firstError))
+			errors++;
+
+		// 止まったままなら収束後はレイトレースしない
+		const int kStillFrames = 10;
+		for (int i = 0; i < kStillFrames; i++)
+		{
+			if (accumulator.BeginFrame(&cb, cameraSize, 0))
+				errors++;
+		}
+
+		// カメラが動いたら累積し直す
+		// 累積し直した最初のフレームは、新しい累積バッファに描いたものと同じになる
+		auto CheckRestart = [&](const char* name, uint64_t sceneVersion)
+		{
+			auto restartCount = accumulator.GetStats().restartCount;
+			if (!accumulator.BeginFrame(&cb, cameraSize, sceneVersion) || accumulator.GetSampleCount() != 1
+				|| accumulator.GetStats().restartCount != restartCount + 1)
+			{
+				printf("%s: not restarted\n", name);
+				errors++;
+				return;
+			}
+			cb.frameIndex = accumulator.GetFrameIndex();
+			cb.sampleCount = accumulator.GetSampleCount();
+			RenderStats stats;
+			Image restarted, fresh;
+			AccumImage freshAccum;
+			DispatchRays03(scene, cb, opt.dispatch, restarted, stats, &accum);
+			DispatchRays03(scene, cb, opt.dispatch, fresh, stats, &freshAccum);
+			if (restarted.pixels != fresh.pixels)
+			{
+				printf("%s: accumulation not reset\n", name);
+				errors++;
+			}
+		};
+		SceneCB moved;
+		if (!SetupFrame03(opt, scene, baseTransforms, opt.frame + 1, moved))
+			return -1;
+		moved.lightRadius = cb.lightRadius;
+		cb = moved;
+		CheckRestart("camera", 0);
+
+		// カメラはそのままで球を動かした場合も、シーンのバージョンが変わるので累積し直す
+		CheckRestart("scene", 1);
+
+		auto&& stats = accumulator.GetStats();
+		printf("frames     : %llu (%llu restarts, %llu skipped after convergence)\n",
+			(unsigned long long)stats.frameCount, (unsigned long long)stats.restartCount, (unsigned long long)stats.skipCount);
+		printf("errors     : %u\n", errors);
+		return (errors == 0) ? 0 : -1;
+	}
+
+	// Sample03 をスレッド数とタイルの割り振り方を変えてレンダリングし、スケーリングを比べる
+	// 内箱の反射があるタイルは重いので、連続した帯を配るだけだとスレッドの処理時間が偏る
+	int RunScalingReport(const Options& opt)
+	{
+		Scene03 scene;
+		if (!SetupScene03(opt, scene))
+			return -1;
+		SceneCB cb;
+		if (!SetupFrame03(opt, scene, GetInstanceTransforms(scene), opt.frame, cb))
+			return -1;
+
+		uint32_t maxThreadCount = GetDispatchThreadCount(opt.dispatch);
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t n = 1; n < maxThreadCount; n *= 2)
+			threadCounts.push_back(n);
+		threadCounts.push_back(maxThreadCount);
+
+		struct Result
+		{
+			double			seconds = 0.0;
+			RenderStats		stats;
+		};
+		Image reference;
+		uint32_t mismatchCount = 0;
+		auto Render = [&](const DispatchDesc& desc)
+		{
+			Result r;
+			Image image;
+			for (int i = 0; i < opt.repeat; i++)
+			{
+				RenderStats stats;
+				DispatchRays03(scene, cb, desc, image, stats);
+				if (i == 0 || stats.seconds < r.seconds)
+				{
+					r.seconds = stats.seconds;
+					r.stats = stats;
+				}
+			}
+
+			// 割り振り方によらず同じ画像になる
+			if (reference.pixels.empty())
+				reference = image;
+			else if (image.pixels != reference.pixels)
+				mismatchCount++;
+			return r;
+		};
+
+		// スレッドの処理時間の最大と平均の比（1なら均等）
+		auto Imbalance = [](const ThreadPoolStats& stats)
+		{
+			double maxSeconds = 0.0, sumSeconds = 0.0;
+			for (auto v : stats.threadBusySeconds)
+			{
+				maxSeconds = std::max(maxSeconds, v);
+				sumSeconds += v;
+			}
+			return (sumSeconds > 0.0) ? maxSeconds * stats.threadBusySeconds.size() / sumSeconds : 1.0;
+		};
+
+		printf("resolution : %u x %u, tile %u x %u, %u hardware threads\n", opt.dispatch.width, opt.dispatch.height,
+			opt.dispatch.tileWidth, opt.dispatch.tileHeight, std::max<uint32_t>(std::thread::hardware_concurrency(), 1));
+		printf("schedule threads       time  speedup  efficiency  imbalance  steals (tiles)\n");
+		double baseSeconds = 0.0;
+		for (int schedule = 0; schedule < kScheduleCount; schedule++)
+		{
+			for (auto threadCount : threadCounts)
+			{
+				ThreadPool pool(threadCount);
+				DispatchDesc desc = opt.dispatch;
+				desc.threadCount = threadCount;
+				desc.pThreadPool = &pool;
+				desc.schedule = (TaskSchedule)schedule;
+				auto r = Render(desc);
+				if (baseSeconds == 0.0)
+					baseSeconds = r.seconds;
+
+				double speedup = baseSeconds / r.seconds;
+				printf("%-8s %7u %8.3f ms %7.2fx %10.1f%% %10.2f  %6llu (%llu)\n", GetTaskScheduleName((TaskSchedule)schedule), threadCount,
+					r.seconds * 1000.0, speedup, speedup / threadCount * 100.0, Imbalance(r.stats.tiles),
+					(unsigned long long)r.stats.tiles.stealCount, (unsigned long long)r.stats.tiles.stolenTaskCount);
+			}
+		}
+
+		// タイルの形（小さいほど偏りにくいが、タイルごとのオーバーヘッドとパケットのまとまりが悪くなる）
+		const uint32_t kTileShapes[][2] = { { 8, 8 }, { 16, 16 }, { 32, 32 }, { 64, 64 }, { 64, 4 }, { 4, 64 } };
+		printf("tile shapes with %u threads (%s):\n", maxThreadCount, GetTaskScheduleName(opt.dispatch.schedule));
+		for (auto&& shape : kTileShapes)
+		{
+			DispatchDesc desc = opt.dispatch;
+			desc.tileWidth = shape[0];
+			desc.tileHeight = shape[1];
+			auto r = Render(desc);
+			uint32_t tileCount = 0;
+			for (auto v : r.stats.tiles.threadTaskCounts)
+				tileCount += (uint32_t)v;
+			printf("  %2u x %-2u : %8.3f ms, %5u tiles, imbalance %.2f, %.3f Mrays/s\n", shape[0], shape[1],
+				r.seconds * 1000.0, tileCount, Imbalance(r.stats.tiles), r.stats.MRaysPerSecond());
+		}
+
+		printf("mismatch   : %u\n", mismatchCount);
+		return (mismatchCount == 0) ? 0 : -1;
+	}
+
+	// 再帰的に TraceRay を呼ぶシェーダとウェーブフロント方式で Sample03 をレンダリングし、結果と時間を比べる
+	// 累積する場合のサブピクセル位置とソフトシャドウでも同じになることを確かめる
+	int RunWavefrontReport(const Options& opt)
+	{
+		Scene03 scene;
+		if (!SetupScene03(opt, scene))
+			return -1;
+		SceneCB cb;
+		if (!SetupFrame03(opt, scene, GetInstanceTransforms(scene), opt.frame, cb))
+			return -1;
+
+		DispatchDesc desc = opt.dispatch;
+		desc.packetSize = 0;
+		printf("resolution : %u x %u, tile %u x %u, %u threads\n", desc.width, desc.height, desc.tileWidth, desc.tileHeight, GetDispatchThreadCount(desc));
+
+		uint32_t errors = 0;
+		auto Compare = [&](const char* name, const SceneCB& frameCB)
+		{
+			Image recursiveImage, wavefrontImage;
+			RenderStats recursive, wavefront;
+			WavefrontStats stages;
+			for (int i = 0; i < opt.repeat; i++)
+			{
+				RenderStats stats;
+				DispatchRays03(scene, frameCB, desc, recursiveImage, stats);
+				if (i == 0 || stats.seconds < recursive.seconds)
+					recursive = stats;
+
+				WavefrontStats stageStats;
+				DispatchRaysWavefront03(scene, frameCB, desc, wavefrontImage, stats, nullptr, &stageStats);
+				if (i == 0 || stats.seconds < wavefront.seconds)
+				{
+					wavefront = stats;
+					stages = stageStats;
+				}
+			}
+
+			uint32_t mismatch = 0;
+			for (size_t i = 0; i < recursiveImage.pixels.size(); i++)
+			{
+				if (recursiveImage.pixels[i] != wavefrontImage.pixels[i])
+					mismatch++;
+			}
+			if (mismatch > 0 || recursive.rayCount != wavefront.rayCount)
+				errors++;
+
+			printf("%s:\n", name);
+			printf("  recursive  : %8.3f ms, %.3f Mrays/s (%llu rays)\n", recursive.seconds * 1000.0, recursive.MRaysPerSecond(), (unsigned long long)recursive.rayCount);
+			printf("  wavefront  : %8.3f ms, %.3f Mrays/s (%llu rays), %u mismatches\n", wavefront.seconds * 1000.0, wavefront.MRaysPerSecond(),
+				(unsigned long long)wavefront.rayCount, mismatch);
+			double totalSeconds = 0.0;
+			for (int s = 0; s < kWavefrontStageCount; s++)
+				totalSeconds += stages.seconds[s];
+			for (int s = 0; s < kWavefrontStageCount; s++)
+			{
+				printf("    %-10s : %8.3f ms (%4.1f%%)", GetWavefrontStageName((WavefrontStage)s), stages.seconds[s] * 1000.0,
+					(totalSeconds > 0.0) ? stages.seconds[s] / totalSeconds * 100.0 : 0.0);
+				if (stages.rayCounts[s] > 0)
+					printf(", %9llu rays, %.3f Mrays/s", (unsigned long long)stages.rayCounts[s], stages.rayCounts[s] / stages.seconds[s] * 1e-6);
+				printf("\n");
+			}
+		};
+		Compare("hard shadows", cb);
+
+		SceneCB softCB = cb;
+		softCB.frameIndex = 1;
+		softCB.sampleCount = 1;
+		softCB.lightRadius = opt.lightRadius;
+		Compare("jittered, soft shadows", softCB);
+
+		printf("errors     : %u\n", errors);
+		return (errors == 0) ? 0 : -1;
+	}
+
+	// ウェーブフロント方式で二次レイを並べ替えない場合と並べ替えた場合の速度を比べる
+	// キューはタイルごとなので、タイルが大きいほど並べ替えでまとまるレイが増える
+	int RunRaySortReport(const Options& opt)
+	{
+		Scene03 scene;
+		if (!SetupScene03(opt, scene))
+			return -1;
+		SceneCB cb;
+		if (!SetupFrame03(opt, scene, GetInstanceTransforms(scene), opt.frame, cb))
+			return -1;
+
+		DispatchDesc baseDesc = opt.dispatch;
+		baseDesc.packetSize = 0;
+		printf("resolution : %u x %u, %u threads\n", baseDesc.width, baseDesc.height, GetDispatchThreadCount(baseDesc));
+
+		const uint32_t kTileSizes[] = { 16, 32, 64, 128 };
+		uint32_t errors = 0;
+		printf("%-9s %-8s %10s %14s %14s %10s %12s\n", "tile", "sort", "total ms", "refl Mrays/s", "shadow Mrays/s", "sort ms", "mismatches");
+		for (uint32_t tileSize : kTileSizes)
+		{
+			Image images[2];
+			for (int sort = 0; sort < 2; sort++)
+			{
+				DispatchDesc desc = baseDesc;
+				desc.tileWidth = desc.tileHeight = tileSize;
+				desc.sortSecondaryRays = (sort != 0);
+
+				RenderStats best;
+				WavefrontStats stages;
+				for (int i = 0; i < opt.repeat; i++)
+				{
+					RenderStats stats;
+					WavefrontStats stageStats;
+					DispatchRaysWavefront03(scene, cb, desc, images[sort], stats, nullptr, &stageStats);
+					if (i == 0 || stats.seconds < best.seconds)
+					{
+						best = stats;
+						stages = stageStats;
+					}
+				}
+
+				// 並べ替えてもレイごとの結果は変わらない
+				uint32_t mismatch = 0;
+				if (sort != 0)
+				{
+					for (size_t i = 0; i < images[0].pixels.size(); i++)
+					{
+						if (images[0].pixels[i] != images[1].pixels[i])
+							mismatch++;
+					}
+					if (mismatch > 0)
+						errors++;
+				}
+
+				auto MRays = [&](WavefrontStage stage)
+				{
+					return (stages.seconds[stage] > 0.0) ? stages.rayCounts[stage] / stages.seconds[stage] * 1e-6 : 0.0;
+				};
+				char tileName[32];
+				snprintf(tileName, sizeof(tileName), "%u x %u", tileSize, tileSize);
+				printf("%-9s %-8s %10.3f %14.3f %14.3f %10.3f %12u\n", tileName, sort ? "on" : "off", best.seconds * 1000.0,
+					MRays(kWavefrontReflection), MRays(kWavefrontShadow), stages.seconds[kWavefrontSort] * 1000.0, mismatch);
+			}
+		}
+
+		printf("errors     : %u\n", errors);
+		return (errors == 0) ? 0 : -1;
+	}
+
+	// 解析的なプロシージャルプリミティブを形ごとにランダムに並べてボトムレベルASを作り、交差判定を確かめて速度を測る
+	// 最初の kCheckRayCount 本は、ヒット位置の符号付き距離と法線、AABBに収まっているか、
+	// それより手前でレイがプリミティブの表面を横切っていないか（符号付き距離の符号が変わらないか）を調べる
+	int RunProceduralReport(const Options& opt)
+	{
+		const uint32_t kPrimCount = 512;
+		const float kSceneSize = 10.0f;
+		const int kCheckRayCount = 20000;
+		const int kCheckSteps = 64;
+
+		BvhBuildDesc buildDesc = opt.bvh;
+		buildDesc.nodeFormat = kBvhNodeFull;
+
+		uint32_t errors = 0;
+		printf("%-9s %8s %9s %10s %12s %9s %9s %9s\n", "shape", "prims", "hit rate", "tests/ray", "Mrays/s", "distance", "normal", "crossing");
+		for (uint32_t shape = 0; shape < kProceduralShapeCount; shape++)
+		{
+			Random rnd(shape + 1);
+			auto RandomPoint = [&](float size) { return float3(rnd.NextFloat(-size, size), rnd.NextFloat(-size, size), rnd.NextFloat(-size, size)); };
+			auto RandomDir = [&]()
+			{
+				float z = rnd.NextFloat(-1.0f, 1.0f);
+				float a = rnd.NextFloat(0.0f, kPI * 2.0f);
+				float r = sqrtf(std::max(0.0f, 1.0f - z * z));
+				return float3(r * cosf(a), r * sinf(a), z);
+			};
+
+			std::vector<ProceduralPrimitive> prims(kPrimCount);
+			for (auto&& prim : prims)
+			{
+				float3 center = RandomPoint(kSceneSize);
+				float3 axis = RandomDir() * rnd.NextFloat(0.3f, 1.5f);
+				float radius = rnd.NextFloat(0.1f, 0.6f);
+				switch (shape)
+				{
+				case kProceduralCapsule: prim = MakeProceduralCapsule(center - axis, center + axis, radius); break;
+				case kProceduralCylinder: prim = MakeProceduralCylinder(center - axis, center + axis, radius); break;
+				case kProceduralCone: prim = MakeProceduralCone(center - axis, center + axis, radius, rnd.NextFloat(0.0f, 0.6f)); break;
+				case kProceduralTorus: prim = MakeProceduralTorus(center, axis, radius + 0.4f, radius * 0.5f); break;
+				default: prim = MakeProceduralRoundedBox(center, float3(rnd.NextFloat(0.2f, 1.0f), rnd.NextFloat(0.2f, 1.0f), rnd.NextFloat(0.2f, 1.0f)), radius * 0.5f); break;
+				}
+			}
+
+			std::vector<RaytracingAABB> aabbs(kPrimCount);
+			GetProceduralAABBs(prims.data(), kPrimCount, aabbs.data());
+			ProceduralBlas blas;
+			if (!blas.Build(aabbs.data(), kPrimCount, buildDesc))
+			{
+				printf("failed to build %s\n", GetProceduralShapeName((ProceduralShape)shape));
+				return -1;
+			}
+
+			// 外側から中心に向かうレイと、プリミティブの内側から出ることもあるシーン内のレイを混ぜる
+			std::vector<RayDesc> rays(opt.rayCount);
+			for (int i = 0; i < opt.rayCount; i++)
+			{
+				float3 origin = (i % 4 == 0) ? RandomPoint(kSceneSize) : RandomDir() * (kSceneSize * 3.0f);
+				float3 target = RandomPoint(kSceneSize);
+				RayDesc ray = { origin, 1e-4f, normalize(target - origin), 10000.0f };
+				rays[i] = ray;
+			}
+
+			auto Trace = [&](const RayDesc& ray, uint32_t& primIndex, float& thit, float3& normal, TraversalStats* pStats)
+			{
+				float tmax = ray.TMax;
+				bool isHit = false;
+				blas.Traverse(ray, tmax, [&](uint32_t index, float& tcur)
+				{
+					float t;
+					float3 n;
+					if (!IntersectProceduralPrimitive(prims[index], ray.Origin, ray.Direction, ray.TMin, tcur, t, n))
+						return false;
+					tcur = t;
+					primIndex = index;
+					thit = t;
+					normal = n;
+					isHit = true;
+					return false;
+				}, pStats);
+				return isHit;
+			};
+
+			TraversalStats stats;
+			uint64_t hitCount = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (auto&& ray : rays)
+			{
+				uint32_t primIndex;
+				float thit;
+				float3 normal;
+				if (Trace(ray, primIndex, thit, normal, &stats))
+					hitCount++;
+			}
+			auto end = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(end - start).count();
+
+			uint32_t distanceErrors = 0, normalErrors = 0, crossingErrors = 0;
+			for (int i = 0; i < std::min(opt.rayCount, kCheckRayCount); i++)
+			{
+				auto&& ray = rays[i];
+				uint32_t primIndex = 0;
+				float thit = ray.TMax;
+				float3 normal;
+				bool isHit = Trace(ray, primIndex, thit, normal, nullptr);
+				if (isHit)
+				{
+					auto&& prim = prims[primIndex];
+					float3 p = ray.Origin + ray.Direction * thit;
+					auto&& box = aabbs[primIndex];
+					const float kTolerance = 1e-3f;
+					bool inBox = p.x >= box.MinX - kTolerance && p.y >= box.MinY - kTolerance && p.z >= box.MinZ - kTolerance
+						&& p.x <= box.MaxX + kTolerance && p.y <= box.MaxY + kTolerance && p.z <= box.MaxZ + kTolerance;
+					if (!inBox || fabsf(GetProceduralDistance(prim, p)) > kTolerance)
+						distanceErrors++;
+
+					// 外側に少し離れた位置の距離は増え、内側では減る
+					const float kStep = 1e-3f;
+					if (GetProceduralDistance(prim, p + normal * kStep) <= GetProceduralDistance(prim, p - normal * kStep))
+						normalErrors++;
+				}
+
+				// ヒットより手前で、AABBに当たったプリミティブの表面を横切っていないか
+				float tend = isHit ? thit : kSceneSize * 8.0f;
+				float dummy = tend;
+				blas.Traverse(ray, dummy, [&](uint32_t index, float&)
+				{
+					auto&& prim = prims[index];
+					const float kTolerance = 1e-3f;
+					float prev = GetProceduralDistance(prim, ray.Origin + ray.Direction * ray.TMin);
+					for (int step = 1; step <= kCheckSteps; step++)
+					{
+						float t = ray.TMin + (tend - ray.TMin) * step / kCheckSteps * 0.999f;
+						float d = GetProceduralDistance(prim, ray.Origin + ray.Direction * t);
+						if ((prev > kTolerance && d < -kTolerance) || (prev < -kTolerance && d > kTolerance))
+						{
+							crossingErrors++;
+							return true;
+						}
+						prev = d;
+					}
+					return false;
+				});
+			}
+			if (distanceErrors + normalErrors + crossingErrors > 0)
+				errors++;
+
+			printf("%-9s %8u %9.3f %10.3f %12.3f %9u %9u %9u\n", GetProceduralShapeName((ProceduralShape)shape), kPrimCount,
+				(double)hitCount / opt.rayCount, (double)stats.primTests / opt.rayCount, opt.rayCount / seconds * 1e-6,
+				distanceErrors, normalErrors, crossingErrors);
+		}
+
+		printf("errors     : %u\n", errors);
+		return (errors == 0) ? 0 : -1;
+	}
+
+	// 水密なレイ/トライアングルの一括判定カーネルをスカラー版と比較し、閉じたメッシュの辺や頂点をレイがすり抜けないか確認する
+	int RunTriangleReport(const Options& opt)
+	{
+		// ランダムなトライアングルを並べ、各レイで kTriangleBatchSize 個ずつ判定する
+		const uint32_t kTriangleCount = 1024;
+		Random rnd(1);
+		auto RandomPoint = [&](float size) { return float3(rnd.NextFloat(-size, size), rnd.NextFloat(-size, size), rnd.NextFloat(-size, size)); };
+		TriangleArraySoA tris;
+		tris.Resize(kTriangleCount);
+		for (uint32_t i = 0; i < kTriangleCount; i++)
+		{
+			float3 c = RandomPoint(10.0f);
+			tris.Set(i, c + RandomPoint(2.0f), c + RandomPoint(2.0f), c + RandomPoint(2.0f));
+		}
+
+		// 判定するトライアングルのどれかに向けて飛ばし、カリングの有無も混ぜる
+		const uint32_t kFlags[] = { 0, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, RAY_FLAG_CULL_FRONT_FACING_TRIANGLES };
+		std::vector<RayTrianglePrecomp> rays(opt.rayCount);
+		for (uint32_t i = 0; i < (uint32_t)rays.size(); i++)
+		{
+			float3 v0, v1, v2;
+			tris.Get((i * kTriangleBatchSize + rnd.Next() % kTriangleBatchSize) % kTriangleCount, v0, v1, v2);
+			float3 o = RandomPoint(15.0f);
+			float3 target = (v0 + v1 + v2) * (1.0f / 3.0f) + RandomPoint(1.0f);
+			rays[i] = RayTrianglePrecomp(o, normalize(target - o));
+		}
+
+		auto Measure = [&](decltype(&IntersectTriangleBatch) kernel, uint64_t& hitCount)
+		{
+			hitCount = 0;
+			float t[kTriangleBatchSize], u[kTriangleBatchSize], v[kTriangleBatchSize];
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < (uint32_t)rays.size(); i++)
+			{
+				uint32_t first = (i * kTriangleBatchSize) % kTriangleCount;
+				uint32_t mask = kernel(tris, first, kTriangleBatchSize, rays[i], kFlags[i % 3], 0.0f, 100.0f, t, u, v);
+				for (; mask != 0; mask &= mask - 1)
+					hitCount++;
+			}
+			auto end = std::chrono::steady_clock::now();
+			return std::chrono::duration<double>(end - start).count();
+		};
+
+		// 結果が一致するか確認する
+		uint32_t mismatch = 0;
+		for (uint32_t i = 0; i < (uint32_t)rays.size(); i++)
+		{
+			float t0[kTriangleBatchSize], u0[kTriangleBatchSize], v0[kTriangleBatchSize];
+			float t1[kTriangleBatchSize], u1[kTriangleBatchSize], v1[kTriangleBatchSize];
+			uint32_t first = (i * kTriangleBatchSize) % kTriangleCount;
+			uint32_t m0 = IntersectTriangleBatch(tris, first, kTriangleBatchSize, rays[i], kFlags[i % 3], 0.0f, 100.0f, t0, u0, v0);
+			uint32_t m1 = IntersectTriangleBatchScalar(tris, first, kTriangleBatchSize, rays[i], kFlags[i % 3], 0.0f, 100.0f, t1, u1, v1);
+			bool same = (m0 == m1);
+			for (uint32_t mask = m0 & m1; mask != 0; mask &= mask - 1)
+			{
+				uint32_t k = FirstBitIndex(mask);
+				same = same && t0[k] == t1[k] && u0[k] == u1[k] && v0[k] == v1[k];
+			}
+			if (!same)
+				mismatch++;
+		}
+
+		uint64_t simdHits, scalarHits;
+		double simdSec = Measure(IntersectTriangleBatch, simdHits);
+		double scalarSec = Measure(IntersectTriangleBatchScalar, scalarHits);
+		double triangleTests = (double)rays.size() * kTriangleBatchSize;
+
+		printf("simd width     : %u\n", GetTriangleBatchSimdWidth());
+		printf("triangle tests : %.0f (hit rate %.3f)\n", triangleTests, simdHits / triangleTests);
+		printf("mismatches     : %u\n", mismatch);
+		printf("simd           : %.3f Mtris/s\n", triangleTests / simdSec * 1e-6);
+		printf("scalar         : %.3f Mtris/s\n", triangleTests / scalarSec * 1e-6);
+
+		// 閉じた球のメッシュの内側から頂点と辺の上の点に向けてレイを飛ばし、どのトライアングルにも当たらなかったレイを数える
+		int vcount, icount;
+		GetShpereVertexAndIndexCount(opt.longCount, opt.latiCount, vcount, icount);
+		if (vcount > 0x10000)
+		{
+			printf("sphere: %d vertices exceed 16bit index range\n", vcount);
+			return -1;
+		}
+		std::vector<Vertex> vertices(vcount);
+		std::vector<uint16_t> indices(icount);
+		CreateSphereVertexAndIndex(opt.longCount, opt.latiCount, vertices.data(), indices.data());
+
+		TriangleGeometryDesc geo;
+		geo.VertexBuffer = vertices.data();
+		geo.VertexStrideInBytes = sizeof(Vertex);
+		geo.VertexCount = (uint32_t)vertices.size();
+		geo.IndexBuffer = indices.data();
+		geo.IndexCount = (uint32_t)indices.size();
+		TriangleBlas blas;
+		if (!blas.Build(geo, opt.bvh))
+		{
+			printf("sphere: failed to build BLAS\n");
+			return -1;
+		}
+
+		// 以前の Moller-Trumbore による判定（全トライアングルを調べる）
+		auto IntersectMollerTrumbore = [&](const RayDesc& ray)
+		{
+			for (int i = 0; i < icount; i += 3)
+			{
+				float3 p0 = vertices[indices[i + 0]].pos;
+				float3 e1 = vertices[indices[i + 1]].pos - p0;
+				float3 e2 = vertices[indices[i + 2]].pos - p0;
+				float3 p = cross(ray.Direction, e2);
+				float det = dot(e1, p);
+				if (det == 0.0f)
+					continue;
+				float invDet = 1.0f / det;
+				float3 s = ray.Origin - p0;
+				float u = dot(s, p) * invDet;
+				float3 q = cross(s, e1);
+				float v = dot(ray.Direction, q) * invDet;
+				float t = dot(e2, q) * invDet;
+				if (u >= 0.0f && u <= 1.0f && v >= 0.0f && u + v <= 1.0f && t >= ray.TMin && t < ray.TMax)
+					return true;
+			}
+			return false;
+		};
+
+		uint32_t leakRays = 0, watertightLeaks = 0, mollerTrumboreLeaks = 0, barycentricErrors = 0;
+		auto TraceLeak = [&](const float3& target)
+		{
+			float3 origin = RandomPoint(0.3f);
+			RayDesc ray = { origin, 0.0f, normalize(target - origin), 10.0f };
+			leakRays++;
+
+			TriangleHit hit;
+			if (!blas.Intersect(ray, 0, hit))
+				watertightLeaks++;
+			else
+			{
+				// barycentrics から求めた位置がヒット位置と一致するか（シェーダの補間と同じ重み）
+				const uint16_t* idx = &indices[hit.primitiveIndex * 3];
+				float3 p0 = vertices[idx[0]].pos, p1 = vertices[idx[1]].pos, p2 = vertices[idx[2]].pos;
+				float3 p = p0 + (p1 - p0) * hit.barycentrics.x + (p2 - p0) * hit.barycentrics.y;
+				if (length(p - (ray.Origin + ray.Direction * hit.t)) > 1e-4f)
+					barycentricErrors++;
+			}
+			if (!IntersectMollerTrumbore(ray))
+				mollerTrumboreLeaks++;
+		};
+		for (int i = 0; i < icount; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				float3 a = vertices[indices[i + k]].pos;
+				float3 b = vertices[indices[i + (k + 1) % 3]].pos;
+				TraceLeak(a);
+				TraceLeak((a + b) * 0.5f);
+				TraceLeak(a + (b - a) * rnd.NextFloat(0.0f, 1.0f));
+			}
+		}
+
+		printf("leak test      : sphere %dx%d, %u rays aimed at vertices and edges from inside\n", opt.longCount, opt.latiCount, leakRays);
+		printf("  watertight   : %u leaks, %u barycentric errors\n", watertightLeaks, barycentricErrors);
+		printf("  Moller-Trumbore : %u leaks\n", mollerTrumboreLeaks);
+		return (mismatch == 0 && watertightLeaks == 0 && barycentricErrors == 0) ? 0 : -1;
+	}
+
+	// レイ/AABBの一括判定カーネルをスカラー版と比較する
+	int RunAABBReport(const Options& opt)
+	{
+		// ランダムなAABBを並べ、各レイで kAABBBatchSize 個ずつ判定する
+		const uint32_t kBoxCount = 1024;
+		Random rnd(1);
+		AABBArraySoA boxes;
+		boxes.Resize(kBoxCount);
+		for (uint32_t i = 0; i < kBoxCount; i++)
+		{
+			float3 c(rnd.NextFloat(-10.0f, 10.0f), rnd.NextFloat(-10.0f, 10.0f), rnd.NextFloat(-10.0f, 10.0f));
+			float3 e(rnd.NextFloat(0.1f, 2.0f), rnd.NextFloat(0.1f, 2.0f), rnd.NextFloat(0.1f, 2.0f));
+			boxes.Set(i, c - e, c + e);
+		}
+
+		std::vector<RayBoxPrecomp> rays(opt.rayCount);
+		for (auto&& r : rays)
+		{
+			float3 o(rnd.NextFloat(-15.0f, 15.0f), rnd.NextFloat(-15.0f, 15.0f), rnd.NextFloat(-15.0f, 15.0f));
+			float3 d(rnd.NextFloat(-1.0f, 1.0f), rnd.NextFloat(-1.0f, 1.0f), rnd.NextFloat(-1.0f, 1.0f));
+			// 軸に平行なレイも混ぜる
+			if ((rnd.Next() & 7) == 0) d[rnd.Next() % 3] = 0.0f;
+			r = RayBoxPrecomp(o, normalize(d));
+		}
+
+		auto Measure = [&](decltype(&IntersectAABBBatch) kernel, uint64_t& hitCount)
+		{
+			hitCount = 0;
+			float tEnter[kAABBBatchSize];
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < (uint32_t)rays.size(); i++)
+			{
+				uint32_t first = (i * kAABBBatchSize) % kBoxCount;
+				uint32_t mask = kernel(boxes, first, kAABBBatchSize, rays[i], 0.0f, 100.0f, tEnter);
+				for (; mask != 0; mask &= mask - 1)
+					hitCount++;
+			}
+			auto end = std::chrono::steady_clock::now();
+			return std::chrono::duration<double>(end - start).count();
+		};
+
+		// 結果が一致するか確認する
+		uint32_t mismatch = 0;
+		for (uint32_t i = 0; i < (uint32_t)rays.size(); i++)
+		{
+			float t0[kAABBBatchSize], t1[kAABBBatchSize];
+			uint32_t first = (i * kAABBBatchSize) % kBoxCount;
+			uint32_t m0 = IntersectAABBBatch(boxes, first, kAABBBatchSize, rays[i], 0.0f, 100.0f, t0);
+			uint32_t m1 = IntersectAABBBatchScalar(boxes, first, kAABBBatchSize, rays[i], 0.0f, 100.0f, t1);
+			if (m0 != m1)
+				mismatch++;
+		}
+
+		uint64_t simdHits, scalarHits;
+		double simdSec = Measure(IntersectAABBBatch, simdHits);
+		double scalarSec = Measure(IntersectAABBBatchScalar, scalarHits);
+		double boxTests = (double)rays.size() * kAABBBatchSize;
+
+		printf("simd width : %u\n", GetAABBBatchSimdWidth());
+		printf("box tests  : %.0f\n", boxTests);
+		printf("mismatches : %u\n", mismatch);
+		printf("simd       : %.3f Mboxes/s\n", boxTests / simdSec * 1e-6);
+		printf("scalar     : %.3f Mboxes/s\n", boxTests / scalarSec * 1e-6);
+		return mismatch == 0 ? 0 : -1;
+	}
+
+	// サンプルのシーンごとにレイの種類別のコストを計測する
+	int RunBench(const Options& opt)
+	{
+		BenchDesc desc;
+		desc.width = opt.dispatch.width;
+		desc.height = opt.dispatch.height;
+		desc.frame = opt.frame;
+		desc.rayCount = (uint32_t)opt.rayCount;
+		desc.repeat = (uint32_t)opt.repeat;
+
+		std::vector<BenchResult> results;
+		if (!RunBenchmarks(desc, results))
+		{
+			printf("failed to build acceleration structures\n");
+			return -1;
+		}
+
+		if (opt.csv.empty())
+		{
+			WriteBenchCSV(stdout, results);
+			return 0;
+		}
+
+		FILE* fp = fopen(opt.csv.c_str(), "w");
+		if (!fp)
+		{
+			printf("failed to write %s\n", opt.csv.c_str());
+			return -1;
+		}
+		WriteBenchCSV(fp, results);
+		fclose(fp);
+
+		for (auto&& r : results)
+		{
+			printf("%s %-10s : %8.3f Mrays/s, p99 %8.1f ns\n", r.sample.c_str(), r.rayType.c_str(), r.MRaysPerSecond(), r.latencyNs[2]);
+		}
+		return 0;
+	}
+
+	// シーンファイルを読み込んで内容を出力し、指定があればバイナリ形式で保存する
+	int RunSceneConvert(const Options& opt)
+	{
+		if (opt.sceneFile.empty())
+		{
+			printf("-scene is required\n");
+			return -1;
+		}
+
+		SceneFile file;
+		auto start = std::chrono::steady_clock::now();
+		if (!LoadSceneFile(opt.sceneFile.c_str(), file))
+			return -1;
+		auto end = std::chrono::steady_clock::now();
+
+		size_t triangleCount = 0, aabbCount = 0;
+		for (auto&& mesh : file.meshes)
+			triangleCount += mesh.indices.size() / 3;
+		for (auto&& proc : file.procedurals)
+			aabbCount += proc.aabbs.size();
+
+		printf("materials   : %u\n", (uint32_t)file.materials.size());
+		printf("meshes      : %u (%u triangles)\n", (uint32_t)file.meshes.size(), (uint32_t)triangleCount);
+		printf("procedurals : %u (%u AABBs)\n", (uint32_t)file.procedurals.size(), (uint32_t)aabbCount);
+		printf("instances   : %u\n", (uint32_t)file.instances.size());
+		printf("load time   : %.3f ms\n", std::chrono::duration<double>(end - start).count() * 1000.0);
+
+		if (!opt.save.empty() && !SaveSceneFileBinary(opt.save.c_str(), file))
+			return -1;
+
+		// Sample03 を記述したシーンファイル（scenes/sample03.scene）なら、組み込みのシーンとビット単位で同じ画像になる
+		if (opt.match03)
+		{
+			Options fromFile = opt;
+			fromFile.cacheFile.clear();
+			Options builtIn = fromFile;
+			builtIn.sceneFile.clear();
+
+			Image images[2];
+			const Options* pOptions[] = { &fromFile, &builtIn };
+			for (int i = 0; i < 2; i++)
+			{
+				Scene03 scene;
+				SceneCB cb;
+				RenderStats stats;
+				if (!SetupScene03(*pOptions[i], scene) || !SetupFrame03(*pOptions[i], scene, GetInstanceTransforms(scene), 0, cb))
+					return -1;
+				DispatchRays03(scene, cb, pOptions[i]->dispatch, images[i], stats);
+			}
+
+			uint32_t diffCount = 0;
+			for (size_t i = 0; i < images[0].pixels.size(); i++)
+			{
+				if (images[0].pixels[i] != images[1].pixels[i])
+					diffCount++;
+			}
+			printf("sample03    : %u of %u pixels differ\n", diffCount, (uint32_t)images[0].pixels.size());
+			if (diffCount > 0)
+				return -1;
+		}
+		return 0;
+	}
+
+	int RunRender(const Options& opt)
+	{
+		Scene03 scene;
+		if (!SetupScene03(opt, scene))
+			return -1;
+
+		SceneCB cb;
+		if (!SetupFrame03(opt, scene, GetInstanceTransforms(scene), opt.frame, cb))
+			return -1;
+
+		Image image;
+		RenderStats best;
+		if (opt.sampleCount > 0)
+		{
+			// カメラとシーンを止めたまま -samples フレーム累積する（時間と本数は全フレームの合計）
+			cb.lightRadius = opt.lightRadius;
+			AccumImage accum;
+			ProgressiveAccumulator accumulator;
+			accumulator.Init(opt.sampleCount);
+			while (accumulator.BeginFrame(&cb, offsetof(SceneCB, frameIndex), 0))
+			{
+				cb.frameIndex = accumulator.GetFrameIndex();
+				cb.sampleCount = accumulator.GetSampleCount();
+				RenderStats stats;
+				if (opt.wavefront)
+					DispatchRaysWavefront03(scene, cb, opt.dispatch, image, stats, &accum);
+				else
+					DispatchRays03(scene, cb, opt.dispatch, image, stats, &accum);
+				best.threadRayCounts = stats.threadRayCounts;
+				best.rayCount += stats.rayCount;
+				best.seconds += stats.seconds;
+			}
+			printf("samples    : %u\n", accumulator.GetSampleCount());
+		}
+		else
+		{
+			for (int i = 0; i < opt.repeat; i++)
+			{
+				RenderStats stats;
+				if (opt.wavefront)
+					DispatchRaysWavefront03(scene, cb, opt.dispatch, image, stats);
+				else
+					DispatchRays03(scene, cb, opt.dispatch, image, stats);
+				if (i == 0 || stats.seconds < best.seconds)
+				{
+					best = stats;
+				}
+			}
+		}
+
+		printf("resolution : %u x %u\n", opt.dispatch.width, opt.dispatch.height);
+		printf("threads    : %u\n", (uint32_t)best.threadRayCounts.size());
+		printf("tiles      : %u x %u, %s schedule, %llu steals\n", opt.dispatch.tileWidth, opt.dispatch.tileHeight,
+			GetTaskScheduleName(opt.dispatch.schedule), (unsigned long long)best.tiles.stealCount);
+		if (opt.wavefront)
+			printf("wavefront  : on%s\n", opt.dispatch.sortSecondaryRays ? ", sorted secondary rays" : "");
+		else if (opt.dispatch.packetSize > 0)
+			printf("packet     : %u x %u\n", opt.dispatch.packetSize, opt.dispatch.packetSize);
+		printf("rays       : %llu\n", (unsigned long long)best.rayCount);
+		printf("time       : %.3f ms\n", best.seconds * 1000.0);
+		printf("throughput : %.3f Mrays/s\n", best.MRaysPerSecond());
+
+		if (!WritePPM(opt.output.c_str(), image))
+		{
+			printf("failed to write %s\n", opt.output.c_str());
+			return -1;
+		}
+
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	if (!ParseOptions(argc, argv, opt))
+	{
+		PrintUsage();
+		return -1;
+	}
+
+	// レンダリングのスレッドは全モードで共有し、プロセスの終了前にここで止める
+	ThreadPool threadPool(GetDispatchThreadCount(opt.dispatch));
+	opt.dispatch.pThreadPool = &threadPool;
+
+	if (opt.mode == "render")
+		return RunRender(opt);
+	if (opt.mode == "bvh")
+		return RunBvhReport(opt);
+	if (opt.mode == "tlas")
+		return RunTlasReport(opt);
+	if (opt.mode == "aabb")
+		return RunAABBReport(opt);
+	if (opt.mode == "bench")
+		return RunBench(opt);
+	if (opt.mode == "scene")
+		return RunSceneConvert(opt);
+	if (opt.mode == "nodes")
+		return RunNodeFormatReport(opt);
+	if (opt.mode == "refit")
+		return RunRefitReport(opt);
+	if (opt.mode == "frames")
+		return RunFramePacingReport(opt);
+	if (opt.mode == "descriptors")
+		return RunDescriptorReport(opt);
+	if (opt.mode == "upload")
+		return RunUploadArenaReport(opt);
+	if (opt.mode == "aspool")
+		return RunAsPoolReport(opt);
+	if (opt.mode == "compact")
+		return RunCompactReport(opt);
+	if (opt.mode == "shadertable")
+		return RunShaderTableReport(opt);
+	if (opt.mode == "progressive")
+		return RunProgressiveReport(opt);
+	if (opt.mode == "scaling")
+		return RunScalingReport(opt);
+	if (opt.mode == "wavefront")
+		return RunWavefrontReport(opt);
+	if (opt.mode == "raysort")
+		return RunRaySortReport(opt);
+	if (opt.mode == "procedural")
+		return RunProceduralReport(opt);
+	if (opt.mode == "triangle")
+		return RunTriangleReport(opt);
+
+	PrintUsage();
+	return -1;
+}
+
+//	EOF
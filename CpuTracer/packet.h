@@ -0,0 +1,155 @@
+﻿#pragma once
+
+#include "raytracing.h"
+#include "aabb_simd.h"
+
+// 原点を共有するレイのパケット（プライマリレイ用）
+// ノードの判定は区間演算で行い、パケット内のどのレイも当たらないノードだけを枝刈りする
+
+static const uint32_t kMaxPacketRays = 64;		// 8x8
+
+struct RayPacket
+{
+	float3		origin;
+	float		tmin;
+	uint32_t	rayCount;
+	float3		directions[kMaxPacketRays];
+
+	// Finalize() で求める値
+	float3		invDirections[kMaxPacketRays];
+	float3		invDirMin, invDirMax;		// 軸ごとの逆数の範囲
+	bool		isCoherent;					// 全レイの方向の符号が軸ごとに揃っていて、0の成分もない
+
+	void Finalize()
+	{
+		invDirMin = float3(INFINITY);
+		invDirMax = float3(-INFINITY);
+		int positive[3] = { 0, 0, 0 };
+		int negative[3] = { 0, 0, 0 };
+		for (uint32_t i = 0; i < rayCount; i++)
+		{
+			invDirections[i] = float3(1.0f) / directions[i];
+			invDirMin = min(invDirMin, invDirections[i]);
+			invDirMax = max(invDirMax, invDirections[i]);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (directions[i][axis] > 0.0f) positive[axis]++;
+				else if (directions[i][axis] < 0.0f) negative[axis]++;
+			}
+		}
+
+		isCoherent = true;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (positive[axis] != (int)rayCount && negative[axis] != (int)rayCount)
+				isCoherent = false;
+		}
+	}
+};
+
+// オブジェクト空間のパケットに変換する
+inline void TransformPacket(const float3x4& t, const RayPacket& src, RayPacket& dst)
+{
+	dst.origin = TransformPoint(t, src.origin);
+	dst.tmin = src.tmin;
+	dst.rayCount = src.rayCount;
+	for (uint32_t i = 0; i < src.rayCount; i++)
+	{
+		dst.directions[i] = TransformVector(t, src.directions[i]);
+	}
+	dst.Finalize();
+}
+
+// 区間演算によるパケットとボックスの判定（isCoherent なパケットのみ）
+// false ならパケット内のどのレイも [tmin, tmax] の範囲でボックスに当たらない
+// tEnter にはパケット内のレイの進入距離の下限を返す
+inline bool IntersectPacketBox(const RayPacket& packet, const float3& bmin, const float3& bmax, float tmax, float& tEnter)
+{
+	float enter = packet.tmin, exit = tmax;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lo = packet.invDirMin[axis], hi = packet.invDirMax[axis];
+		bool positive = lo > 0.0f;
+		float dEnter = (positive ? bmin[axis] : bmax[axis]) - packet.origin[axis];
+		float dExit = (positive ? bmax[axis] : bmin[axis]) - packet.origin[axis];
+		enter = std::max(enter, std::min(dEnter * lo, dEnter * hi));
+		exit = std::min(exit, std::max(dExit * lo, dExit * hi));
+	}
+	tEnter = enter;
+	return enter <= exit;
+}
+
+// 原点も方向もばらばらなレイの束（シャドウレイなどの遮蔽判定用）
+// 1つのスタックで走査し、activeMask に残っているレイのどれかが当たるノードだけを辿る
+// 走査を終えたレイのビットを activeMask から外していき、0になったら走査をやめる
+
+static const uint32_t kMaxRayBatch = 16;
+
+struct RayBatch
+{
+	uint32_t		rayCount;
+	uint32_t		activeMask;
+	float3			directions[kMaxRayBatch];
+	RayBoxPrecomp	rays[kMaxRayBatch];			// 原点と方向の逆数
+	float			tmin[kMaxRayBatch];
+	float			tmax[kMaxRayBatch];
+
+	void Init(const RayDesc* src, uint32_t count)
+	{
+		rayCount = count;
+		activeMask = (count < 32) ? (1u << count) - 1 : ~0u;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			directions[i] = src[i].Direction;
+			rays[i] = RayBoxPrecomp(src[i].Origin, src[i].Direction);
+			tmin[i] = src[i].TMin;
+			tmax[i] = src[i].TMax;
+		}
+	}
+
+	float GetMaxTMax() const
+	{
+		float t = -INFINITY;
+		for (uint32_t mask = activeMask; mask != 0; mask &= mask - 1) t = std::max(t, tmax[FirstBitIndex(mask)]);
+		return t;
+	}
+};
+
+// オブジェクト空間のレイの束に変換する（mask のレイだけを変換し、それを activeMask にする）
+inline void TransformBatch(const float3x4& t, const RayBatch& src, uint32_t mask, RayBatch& dst)
+{
+	dst.rayCount = src.rayCount;
+	dst.activeMask = mask;
+	for (; mask != 0; mask &= mask - 1)
+	{
+		uint32_t i = FirstBitIndex(mask);
+		dst.directions[i] = TransformVector(t, src.directions[i]);
+		dst.rays[i] = RayBoxPrecomp(TransformPoint(t, src.rays[i].origin), dst.directions[i]);
+		dst.tmin[i] = src.tmin[i];
+		dst.tmax[i] = src.tmax[i];
+	}
+}
+
+// activeMask のいずれかのレイがボックスに当たるかを調べる
+// 遮蔽判定では辿る順序は結果に影響しないので、最初に当たったレイで打ち切り、その進入距離を tEnter に返す
+inline bool IntersectBatchBox(const RayBatch& batch, const float3& bmin, const float3& bmax, float& tEnter)
+{
+	for (uint32_t mask = batch.activeMask; mask != 0; mask &= mask - 1)
+	{
+		uint32_t i = FirstBitIndex(mask);
+		float3 t0 = (bmin - batch.rays[i].origin) * batch.rays[i].invDir;
+		float3 t1 = (bmax - batch.rays[i].origin) * batch.rays[i].invDir;
+		float3 tNear = min(t0, t1);
+		float3 tFar = max(t0, t1);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, batch.tmin[i]));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, batch.tmax[i]));
+		if (enter <= exit)
+		{
+			tEnter = enter;
+			return true;
+		}
+	}
+	return false;
+}
+
+//	EOF
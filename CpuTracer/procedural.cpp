@@ -0,0 +1,559 @@
+﻿#include "procedural.h"
+
+namespace
+{
+	// 交差判定の途中で見つかった一番近いヒット
+	// 法線は最後に part（どの面か）とヒット位置から求める
+	struct NearestHit
+	{
+		float		tmin;
+		float		t;			// tmax で初期化
+		uint32_t	part = 0;
+		bool		isHit = false;
+
+		void Add(float tc, uint32_t partIndex)
+		{
+			if (tc >= tmin && tc <= t)
+			{
+				t = tc;
+				part = partIndex;
+				isHit = true;
+			}
+		}
+	};
+
+	// 面の境界でどちらの面にも判定されない隙間ができないように、境界を少しだけ広げる
+	static const float kPartEpsilon = 1e-5f;
+
+	float Clamp(float v, float lo, float hi)
+	{
+		return std::min(std::max(v, lo), hi);
+	}
+
+	float3 Clamp(const float3& v, const float3& lo, const float3& hi)
+	{
+		return min(max(v, lo), hi);
+	}
+
+	// 中心からの相対位置 oc の球（dir は単位ベクトル）
+	bool SolveSphere(const float3& oc, const float3& dir, float radius, float& t0, float& t1)
+	{
+		float b = dot(oc, dir);
+		float c = dot(oc, oc) - radius * radius;
+		float h = b * b - c;
+		if (h < 0.0f)
+			return false;
+		h = sqrtf(h);
+		t0 = -b - h;
+		t1 = -b + h;
+		return true;
+	}
+
+	// a*t^2 + 2*b*t + c = 0
+	int SolveQuadratic(float a, float b, float c, float* t)
+	{
+		if (fabsf(a) < 1e-8f)
+		{
+			if (fabsf(b) < 1e-8f)
+				return 0;
+			t[0] = -c / (2.0f * b);
+			return 1;
+		}
+		float h = b * b - a * c;
+		if (h < 0.0f)
+			return 0;
+		h = sqrtf(h);
+		t[0] = (-b - h) / a;
+		t[1] = (-b + h) / a;
+		return 2;
+	}
+
+	// カプセル
+	// part: 0 = 胴体, 1 = p0 側の半球, 2 = p1 側の半球
+	void IntersectCapsule(const ProceduralPrimitive& prim, const float3& ro, const float3& rd, NearestHit& hit)
+	{
+		float r = prim.radius0;
+		float3 ba = prim.p1 - prim.p0;
+		float3 oa = ro - prim.p0;
+		float baba = dot(ba, ba);
+		float bard = dot(ba, rd);
+		float baoa = dot(ba, oa);
+		float eps = kPartEpsilon * baba;
+
+		// 胴体（無限に長い円柱のうち線分の範囲）
+		float t[2];
+		int n = SolveQuadratic(baba - bard * bard, baba * dot(rd, oa) - baoa * bard, baba * dot(oa, oa) - baoa * baoa - r * r * baba, t);
+		for (int i = 0; i < n; i++)
+		{
+			float y = baoa + t[i] * bard;
+			if (y >= -eps && y <= baba + eps)
+				hit.Add(t[i], 0);
+		}
+
+		// 両端の半球（胴体の外側の部分）
+		float t0, t1;
+		if (SolveSphere(oa, rd, r, t0, t1))
+		{
+			if (baoa + t0 * bard <= eps) hit.Add(t0, 1);
+			if (baoa + t1 * bard <= eps) hit.Add(t1, 1);
+		}
+		if (SolveSphere(ro - prim.p1, rd, r, t0, t1))
+		{
+			if (baoa + t0 * bard >= baba - eps) hit.Add(t0, 2);
+			if (baoa + t1 * bard >= baba - eps) hit.Add(t1, 2);
+		}
+	}
+
+	// 円錐台（radiusA == radiusB なら円柱）
+	// part: 0 = 側面, 1 = p0 側の底面, 2 = p1 側の底面
+	void IntersectCappedCone(const float3& pa, const float3& pb, float ra, float rb, const float3& ro, const float3& rd, NearestHit& hit)
+	{
+		float3 ba = pb - pa;
+		float height = length(ba);
+		if (height <= 0.0f)
+			return;
+		float3 u = ba / height;
+		float k = (rb - ra) / height;		// 軸方向に1進んだときの半径の増加
+		float3 oa = ro - pa;
+		float ou = dot(oa, u);
+		float du = dot(rd, u);
+		float eps = kPartEpsilon * height;
+
+		// 側面: 軸からの距離^2 = (ra + k * 軸方向の位置)^2
+		float m = ra + k * ou;
+		float n = k * du;
+		float t[2];
+		int count = SolveQuadratic(1.0f - du * du - n * n, dot(oa, rd) - ou * du - m * n, dot(oa, oa) - ou * ou - m * m, t);
+		for (int i = 0; i < count; i++)
+		{
+			float y = ou + t[i] * du;
+			// 2乗した式は頂点の反対側に映った円錐も含むので、半径が負の解は除く
+			if (y >= -eps && y <= height + eps && m + n * t[i] >= 0.0f)
+				hit.Add(t[i], 0);
+		}
+
+		// 底面
+		if (fabsf(du) > 1e-8f)
+		{
+			float t0 = -ou / du;
+			float3 p0 = oa + rd * t0;
+			if (dot(p0, p0) <= ra * ra * (1.0f + kPartEpsilon))
+				hit.Add(t0, 1);
+
+			float t1 = (height - ou) / du;
+			float3 p1 = oa + rd * t1 - u * height;
+			if (dot(p1, p1) <= rb * rb * (1.0f + kPartEpsilon))
+				hit.Add(t1, 2);
+		}
+	}
+
+	float3 GetCappedConeNormal(const float3& pa, const float3& pb, float ra, float rb, const float3& p, uint32_t part)
+	{
+		float3 ba = pb - pa;
+		float height = length(ba);
+		float3 u = ba / height;
+		if (part == 1)
+			return -u;
+		if (part == 2)
+			return u;
+
+		float3 pa2p = p - pa;
+		float3 q = pa2p - u * dot(pa2p, u);
+		float radial = length(q);
+		float k = (rb - ra) / height;
+		return normalize((radial > 0.0f ? q / radial : float3(0.0f)) - u * k);
+	}
+
+	// 4次方程式 s^4 + a2*s^2 + a1*s + a0 = 0 の [lo, hi] の中で最小の解
+	// 2階微分の解で区切ると1階微分が単調になり、1階微分の解で区切ると元の式が単調になるので、
+	// 単調な区間ごとに符号が変わるかを調べて二分法で解く
+	bool SolveTorusQuartic(float a2, float a1, float a0, float lo, float hi, float& root)
+	{
+		auto F = [&](float s) { return ((s * s + a2) * s + a1) * s + a0; };
+		auto DF = [&](float s) { return (4.0f * s * s + 2.0f * a2) * s + a1; };
+		auto Bisect = [](auto&& f, float x0, float x1)
+		{
+			float f0 = f(x0);
+			for (int i = 0; i < 40; i++)
+			{
+				float xm = 0.5f * (x0 + x1);
+				float fm = f(xm);
+				if ((fm < 0.0f) == (f0 < 0.0f))
+				{
+					x0 = xm;
+					f0 = fm;
+				}
+				else
+				{
+					x1 = xm;
+				}
+			}
+			return 0.5f * (x0 + x1);
+		};
+
+		// 2階微分 12s^2 + 2a2 の解
+		float bounds[6];
+		int boundCount = 0;
+		bounds[boundCount++] = lo;
+		if (a2 < 0.0f)
+		{
+			float s = sqrtf(-a2 / 6.0f);
+			if (-s > lo && -s < hi) bounds[boundCount++] = -s;
+			if (s > lo && s < hi) bounds[boundCount++] = s;
+		}
+		bounds[boundCount++] = hi;
+
+		// 1階微分の解
+		float points[8];
+		int pointCount = 0;
+		points[pointCount++] = lo;
+		for (int i = 0; i + 1 < boundCount; i++)
+		{
+			float d0 = DF(bounds[i]);
+			float d1 = DF(bounds[i + 1]);
+			if ((d0 < 0.0f) != (d1 < 0.0f))
+				points[pointCount++] = Bisect(DF, bounds[i], bounds[i + 1]);
+		}
+		points[pointCount++] = hi;
+
+		for (int i = 0; i + 1 < pointCount; i++)
+		{
+			float f0 = F(points[i]);
+			float f1 = F(points[i + 1]);
+			if (f0 == 0.0f)
+			{
+				root = points[i];
+				return true;
+			}
+			if ((f0 < 0.0f) != (f1 < 0.0f))
+			{
+				root = Bisect(F, points[i], points[i + 1]);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// トーラス
+	void IntersectTorus(const ProceduralPrimitive& prim, const float3& ro, const float3& rd, NearestHit& hit)
+	{
+		float R = prim.radius0;
+		float r = prim.radius1;
+		float3 axis = prim.p1;
+
+		// ro は中心に最も近いレイ上の点（IntersectProceduralPrimitive で移してある）なので o.rd = 0
+		float3 o = ro - prim.p0;
+		float oo = dot(o, o);
+		// 外周をかすめるレイの解が区間の端に来ないように、外接球を少しだけ大きくする
+		float boundRadius = (R + r) * 1.001f;
+		if (oo > boundRadius * boundRadius)
+			return;
+		float half = sqrtf(boundRadius * boundRadius - oo);
+		float lo = std::max(-half, hit.tmin);
+		float hi = std::min(half, hit.t);
+		if (lo > hi)
+			return;
+
+		// (|p|^2 + R^2 - r^2)^2 - 4R^2 (|p|^2 - (p.axis)^2) = 0 を、o.rd = 0 を使って s の式に展開する
+		float oy = dot(o, axis);
+		float dy = dot(rd, axis);
+		float g0 = oo + R * R - r * r;
+		float R4 = 4.0f * R * R;
+		float a2 = 2.0f * g0 - R4 * (1.0f - dy * dy);
+		float a1 = 2.0f * R4 * oy * dy;
+		float a0 = g0 * g0 - R4 * (oo - oy * oy);
+		float s;
+		if (SolveTorusQuartic(a2, a1, a0, lo, hi, s))
+			hit.Add(s, 0);
+	}
+
+	float3 GetTorusNormal(const ProceduralPrimitive& prim, const float3& p)
+	{
+		float R = prim.radius0;
+		float r = prim.radius1;
+		float3 q = p - prim.p0;
+		float qy = dot(q, prim.p1);
+		return normalize(q * (dot(q, q) + R * R - r * r) - (q - prim.p1 * qy) * (2.0f * R * R));
+	}
+
+	// 角を丸めた箱（内側の箱と球のミンコフスキー和）
+	// 面6枚、辺の円柱12本、角の球8個のうち、その部分の領域にある解だけを使う
+	// part: 0-5 = 面（軸 * 2 + 正の側なら1）, 6 以上 = 辺と角（法線はヒット位置から求める）
+	void IntersectRoundedBox(const ProceduralPrimitive& prim, const float3& ro, const float3& rd, NearestHit& hit)
+	{
+		float r = prim.radius0;
+		float3 e = prim.p1 - float3(r);		// 内側の箱の半サイズ
+		float3 o = ro - prim.p0;
+		float eps = kPartEpsilon * (std::max(e.x, std::max(e.y, e.z)) + r);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int j = (axis + 1) % 3;
+			int k = (axis + 2) % 3;
+
+			// 面
+			if (fabsf(rd[axis]) > 1e-8f)
+			{
+				for (int side = 0; side < 2; side++)
+				{
+					float plane = side ? (e[axis] + r) : -(e[axis] + r);
+					float t = (plane - o[axis]) / rd[axis];
+					float pj = o[j] + rd[j] * t;
+					float pk = o[k] + rd[k] * t;
+					if (fabsf(pj) <= e[j] + eps && fabsf(pk) <= e[k] + eps)
+						hit.Add(t, axis * 2 + side);
+				}
+			}
+
+			// axis 方向の辺（j, k の符号で4本）
+			if (r <= 0.0f)
+				continue;
+			float a = rd[j] * rd[j] + rd[k] * rd[k];
+			for (int corner = 0; corner < 4; corner++)
+			{
+				float sj = (corner & 1) ? 1.0f : -1.0f;
+				float sk = (corner & 2) ? 1.0f : -1.0f;
+				float qj = o[j] - sj * e[j];
+				float qk = o[k] - sk * e[k];
+				float t[2];
+				int n = SolveQuadratic(a, qj * rd[j] + qk * rd[k], qj * qj + qk * qk - r * r, t);
+				for (int i = 0; i < n; i++)
+				{
+					float3 p = o + rd * t[i];
+					if (fabsf(p[axis]) <= e[axis] + eps && sj * p[j] >= e[j] - eps && sk * p[k] >= e[k] - eps)
+						hit.Add(t[i], 6);
+				}
+			}
+		}
+
+		// 角
+		if (r <= 0.0f)
+			return;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			float3 s((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+			float t0, t1;
+			if (!SolveSphere(o - s * e, rd, r, t0, t1))
+				continue;
+			for (float t : { t0, t1 })
+			{
+				float3 p = o + rd * t;
+				if (s.x * p.x >= e.x - eps && s.y * p.y >= e.y - eps && s.z * p.z >= e.z - eps)
+					hit.Add(t, 6);
+			}
+		}
+	}
+
+	float3 GetRoundedBoxNormal(const ProceduralPrimitive& prim, const float3& p, uint32_t part)
+	{
+		if (part < 6)
+		{
+			float3 n(0.0f);
+			n[part / 2] = (part & 1) ? 1.0f : -1.0f;
+			return n;
+		}
+		float3 e = prim.p1 - float3(prim.radius0);
+		float3 q = p - prim.p0;
+		return normalize(q - Clamp(q, -e, e));
+	}
+}
+
+const char* GetProceduralShapeName(ProceduralShape shape)
+{
+	static const char* kNames[kProceduralShapeCount] = { "capsule", "cylinder", "cone", "torus", "roundbox" };
+	return (shape < kProceduralShapeCount) ? kNames[shape] : "unknown";
+}
+
+ProceduralPrimitive MakeProceduralCapsule(const float3& a, const float3& b, float radius, uint32_t material)
+{
+	ProceduralPrimitive prim = {};
+	prim.p0 = a;
+	prim.p1 = b;
+	prim.radius0 = radius;
+	prim.shape = kProceduralCapsule;
+	prim.material = material;
+	return prim;
+}
+
+ProceduralPrimitive MakeProceduralCylinder(const float3& a, const float3& b, float radius, uint32_t material)
+{
+	ProceduralPrimitive prim = MakeProceduralCapsule(a, b, radius, material);
+	prim.radius1 = radius;
+	prim.shape = kProceduralCylinder;
+	return prim;
+}
+
+ProceduralPrimitive MakeProceduralCone(const float3& a, const float3& b, float radiusA, float radiusB, uint32_t material)
+{
+	ProceduralPrimitive prim = MakeProceduralCapsule(a, b, radiusA, material);
+	prim.radius1 = radiusB;
+	prim.shape = kProceduralCone;
+	return prim;
+}
+
+ProceduralPrimitive MakeProceduralTorus(const float3& center, const float3& axis, float majorRadius, float minorRadius, uint32_t material)
+{
+	ProceduralPrimitive prim = {};
+	prim.p0 = center;
+	prim.p1 = normalize(axis);
+	prim.radius0 = majorRadius;
+	prim.radius1 = minorRadius;
+	prim.shape = kProceduralTorus;
+	prim.material = material;
+	return prim;
+}
+
+ProceduralPrimitive MakeProceduralRoundedBox(const float3& center, const float3& halfSize, float radius, uint32_t material)
+{
+	ProceduralPrimitive prim = {};
+	prim.p0 = center;
+	prim.p1 = halfSize;
+	prim.radius0 = Clamp(radius, 0.0f, std::min(halfSize.x, std::min(halfSize.y, halfSize.z)));
+	prim.shape = kProceduralRoundedBox;
+	prim.material = material;
+	return prim;
+}
+
+RaytracingAABB GetProceduralAABB(const ProceduralPrimitive& prim)
+{
+	float3 bmin, bmax;
+	switch (prim.shape)
+	{
+	case kProceduralCapsule:
+		bmin = min(prim.p0, prim.p1) - float3(prim.radius0);
+		bmax = max(prim.p0, prim.p1) + float3(prim.radius0);
+		break;
+	case kProceduralCylinder:
+	case kProceduralCone:
+		{
+			// 軸 u に垂直な半径 r の円板は、各軸に r * sqrt(1 - u^2) だけ広がる
+			float3 ba = prim.p1 - prim.p0;
+			float3 u2 = ba * ba / dot(ba, ba);
+			float3 disk(sqrtf(std::max(1.0f - u2.x, 0.0f)), sqrtf(std::max(1.0f - u2.y, 0.0f)), sqrtf(std::max(1.0f - u2.z, 0.0f)));
+			float r1 = (prim.shape == kProceduralCone) ? prim.radius1 : prim.radius0;
+			bmin = min(prim.p0 - disk * prim.radius0, prim.p1 - disk * r1);
+			bmax = max(prim.p0 + disk * prim.radius0, prim.p1 + disk * r1);
+		}
+		break;
+	case kProceduralTorus:
+		{
+			float3 n2 = prim.p1 * prim.p1;
+			float3 extent(sqrtf(std::max(1.0f - n2.x, 0.0f)), sqrtf(std::max(1.0f - n2.y, 0.0f)), sqrtf(std::max(1.0f - n2.z, 0.0f)));
+			extent = extent * prim.radius0 + float3(prim.radius1);
+			bmin = prim.p0 - extent;
+			bmax = prim.p0 + extent;
+		}
+		break;
+	default:
+		bmin = prim.p0 - prim.p1;
+		bmax = prim.p0 + prim.p1;
+		break;
+	}
+
+	RaytracingAABB aabb = { bmin.x, bmin.y, bmin.z, bmax.x, bmax.y, bmax.z };
+	return aabb;
+}
+
+void GetProceduralAABBs(const ProceduralPrimitive* prims, uint32_t count, RaytracingAABB* aabbs)
+{
+	for (uint32_t i = 0; i < count; i++)
+		aabbs[i] = GetProceduralAABB(prims[i]);
+}
+
+bool IntersectProceduralPrimitive(const ProceduralPrimitive& prim, const float3& origin, const float3& direction, float tmin, float tmax, float& thit, float3& normal)
+{
+	// 単位ベクトルのレイで解き、t を元の方向ベクトルの長さに戻す
+	float len = length(direction);
+	if (len <= 0.0f)
+		return false;
+	float3 rd = direction / len;
+
+	// 遠くの原点から2次方程式を解くと桁落ちするので、プリミティブの中心に最も近いレイ上の点を原点にして解く
+	float3 center = (prim.shape <= kProceduralCone) ? (prim.p0 + prim.p1) * 0.5f : prim.p0;
+	float tshift = dot(center - origin, rd);
+	float3 ro = origin + rd * tshift;
+
+	NearestHit hit;
+	hit.tmin = tmin * len - tshift;
+	hit.t = tmax * len - tshift;
+	switch (prim.shape)
+	{
+	case kProceduralCapsule: IntersectCapsule(prim, ro, rd, hit); break;
+	case kProceduralCylinder: IntersectCappedCone(prim.p0, prim.p1, prim.radius0, prim.radius0, ro, rd, hit); break;
+	case kProceduralCone: IntersectCappedCone(prim.p0, prim.p1, prim.radius0, prim.radius1, ro, rd, hit); break;
+	case kProceduralTorus: IntersectTorus(prim, ro, rd, hit); break;
+	case kProceduralRoundedBox: IntersectRoundedBox(prim, ro, rd, hit); break;
+	default: return false;
+	}
+	if (!hit.isHit)
+		return false;
+
+	float3 p = ro + rd * hit.t;
+	switch (prim.shape)
+	{
+	case kProceduralCapsule:
+		{
+			float3 ba = prim.p1 - prim.p0;
+			float h = Clamp(dot(p - prim.p0, ba) / dot(ba, ba), 0.0f, 1.0f);
+			normal = normalize(p - prim.p0 - ba * h);
+		}
+		break;
+	case kProceduralCylinder: normal = GetCappedConeNormal(prim.p0, prim.p1, prim.radius0, prim.radius0, p, hit.part); break;
+	case kProceduralCone: normal = GetCappedConeNormal(prim.p0, prim.p1, prim.radius0, prim.radius1, p, hit.part); break;
+	case kProceduralTorus: normal = GetTorusNormal(prim, p); break;
+	default: normal = GetRoundedBoxNormal(prim, p, hit.part); break;
+	}
+	thit = (hit.t + tshift) / len;
+	return true;
+}
+
+float GetProceduralDistance(const ProceduralPrimitive& prim, const float3& p)
+{
+	switch (prim.shape)
+	{
+	case kProceduralCapsule:
+		{
+			float3 ba = prim.p1 - prim.p0;
+			float3 pa = p - prim.p0;
+			float h = Clamp(dot(pa, ba) / dot(ba, ba), 0.0f, 1.0f);
+			return length(pa - ba * h) - prim.radius0;
+		}
+	case kProceduralCylinder:
+	case kProceduralCone:
+		{
+			// 軸を含む平面で切った断面（台形）までの距離
+			float ra = prim.radius0;
+			float rb = (prim.shape == kProceduralCone) ? prim.radius1 : prim.radius0;
+			float3 ba = prim.p1 - prim.p0;
+			float3 pa = p - prim.p0;
+			float rba = rb - ra;
+			float baba = dot(ba, ba);
+			float paba = dot(pa, ba) / baba;
+			float x = sqrtf(std::max(dot(pa, pa) - paba * paba * baba, 0.0f));
+			float cax = std::max(0.0f, x - ((paba < 0.5f) ? ra : rb));
+			float cay = fabsf(paba - 0.5f) - 0.5f;
+			float f = Clamp((rba * (x - ra) + paba * baba) / (rba * rba + baba), 0.0f, 1.0f);
+			float cbx = x - ra - f * rba;
+			float cby = paba - f;
+			float s = (cbx < 0.0f && cay < 0.0f) ? -1.0f : 1.0f;
+			return s * sqrtf(std::min(cax * cax + cay * cay * baba, cbx * cbx + cby * cby * baba));
+		}
+	case kProceduralTorus:
+		{
+			float3 q = p - prim.p0;
+			float y = dot(q, prim.p1);
+			float x = sqrtf(std::max(dot(q, q) - y * y, 0.0f)) - prim.radius0;
+			return sqrtf(x * x + y * y) - prim.radius1;
+		}
+	default:
+		{
+			float3 e = prim.p1 - float3(prim.radius0);
+			float3 q = abs(p - prim.p0) - e;
+			float outside = length(max(q, float3(0.0f)));
+			float inside = std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+			return outside + inside - prim.radius0;
+		}
+	}
+}
+
+//	EOF
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include "raytracing.h"
+
+// 解析的に交差判定するプロシージャルプリミティブ
+// 細かいトライアングルに分割せずに、プリミティブごとのAABBでボトムレベルASを作り、交差シェーダで判定する
+// Sample03/procedural.hlsli に同じ構造体と交差判定があり、結果が一致するようにしてある
+
+enum ProceduralShape : uint32_t
+{
+	kProceduralCapsule = 0,		// p0-p1 の線分から radius0 以内
+	kProceduralCylinder,		// p0, p1 を底面の中心とする半径 radius0 の円柱
+	kProceduralCone,			// p0 で半径 radius0、p1 で半径 radius1 の円錐台
+	kProceduralTorus,			// 中心 p0、軸 p1（正規化済み）、中心円の半径 radius0、管の半径 radius1
+	kProceduralRoundedBox,		// 中心 p0、半サイズ p1 の軸に沿った箱の角を半径 radius0 で丸めたもの
+
+	kProceduralShapeCount
+};
+
+const char* GetProceduralShapeName(ProceduralShape shape);
+
+// StructuredBuffer の要素（HLSLの ProceduralPrimitive と同じ48バイト）
+// 座標はボトムレベルASのオブジェクト空間
+struct ProceduralPrimitive
+{
+	float3		p0;
+	float		radius0;
+	float3		p1;
+	float		radius1;
+	uint32_t	shape;			// ProceduralShape
+	uint32_t	material;
+	uint32_t	padding[2];
+};
+
+ProceduralPrimitive MakeProceduralCapsule(const float3& a, const float3& b, float radius, uint32_t material = 0);
+ProceduralPrimitive MakeProceduralCylinder(const float3& a, const float3& b, float radius, uint32_t material = 0);
+ProceduralPrimitive MakeProceduralCone(const float3& a, const float3& b, float radiusA, float radiusB, uint32_t material = 0);
+ProceduralPrimitive MakeProceduralTorus(const float3& center, const float3& axis, float majorRadius, float minorRadius, uint32_t material = 0);
+// radius は半サイズの最小値以下に丸める
+ProceduralPrimitive MakeProceduralRoundedBox(const float3& center, const float3& halfSize, float radius, uint32_t material = 0);
+
+// プリミティブを囲むAABB（円柱と円錐台は両端の円板、トーラスは管の円を回した範囲で、余分に大きくしない）
+RaytracingAABB GetProceduralAABB(const ProceduralPrimitive& prim);
+
+// prims[count] のAABBを aabbs[count] に書き出す（ProceduralBlas::Build や D3D12 の AABB バッファに渡す）
+void GetProceduralAABBs(const ProceduralPrimitive* prims, uint32_t count, RaytracingAABB* aabbs);
+
+// オブジェクト空間のレイ（direction は正規化しなくてよい）との交差判定
+// [tmin, tmax] の中で最も近いヒットの thit と外向きの単位法線を返す
+// 原点がプリミティブの内側にあれば裏側（出ていく面）に当たる
+bool IntersectProceduralPrimitive(const ProceduralPrimitive& prim, const float3& origin, const float3& direction, float tmin, float tmax, float& thit, float3& normal);
+
+// 符号付き距離（内側が負、検証用）
+float GetProceduralDistance(const ProceduralPrimitive& prim, const float3& p);
+
+//	EOF
@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+struct ProgressiveStats
+{
+	uint64_t	frameCount = 0;			// BeginFrame を呼んだ回数
+	uint64_t	restartCount = 0;		// カメラかシーンが変わって累積し直した回数
+	uint64_t	skipCount = 0;			// 収束済みでレイトレースしなかったフレーム数
+};
+
+// カメラとシーンが止まっている間だけ、フレームごとのサンプルを累積する
+// カメラ（定数バッファのカメラ部分など）はバイト列で比べるので、D3D12 と CpuTracer のどちらの型でも使える
+// シーンは動かしたときに呼び出し側が増やすバージョン番号で比べる
+class ProgressiveAccumulator
+{
+public:
+	// maxSampleCount に達したら収束したとみなしてレイトレースをやめる（0なら上限なし）
+	void Init(uint32_t maxSampleCount)
+	{
+		maxSampleCount_ = maxSampleCount;
+		camera_.clear();
+		sceneVersion_ = 0;
+		frameIndex_ = 0;
+		sampleCount_ = 0;
+		stats_ = ProgressiveStats();
+	}
+
+	// 次のフレームで累積し直す
+	void Restart()
+	{
+		sampleCount_ = 0;
+	}
+
+	// このフレームのカメラとシーンのバージョンから、累積するサンプル数を決める
+	// 収束済みなら false を返すので、前のフレームの結果をそのまま使う
+	bool BeginFrame(const void* camera, uint32_t cameraSize, uint64_t sceneVersion)
+	{
+		stats_.frameCount++;
+		if (sampleCount_ > 0
+			&& (sceneVersion != sceneVersion_ || cameraSize != camera_.size() || memcmp(camera, camera_.data(), cameraSize) != 0))
+		{
+			sampleCount_ = 0;
+			stats_.restartCount++;
+		}
+		if (sampleCount_ == 0)
+		{
+			auto p = static_cast<const uint8_t*>(camera);
+			camera_.assign(p, p + cameraSize);
+			sceneVersion_ = sceneVersion;
+		}
+
+		if (IsConverged())
+		{
+			stats_.skipCount++;
+			return false;
+		}
+		sampleCount_++;
+		frameIndex_++;
+		return true;
+	}
+	template <typename Camera>
+	bool BeginFrame(const Camera& camera, uint64_t sceneVersion)
+	{
+		return BeginFrame(&camera, (uint32_t)sizeof(Camera), sceneVersion);
+	}
+
+	// シェーダに渡す値（cbScene の frameIndex と sampleCount）
+	// frameIndex は累積し直しても戻さないので、前の累積と同じ乱数の系列にはならない
+	uint32_t GetFrameIndex() const { return frameIndex_; }
+	uint32_t GetSampleCount() const { return sampleCount_; }
+
+	bool IsConverged() const { return maxSampleCount_ > 0 && sampleCount_ >= maxSampleCount_; }
+	const ProgressiveStats& GetStats() const { return stats_; }
+
+private:
+	uint32_t				maxSampleCount_ = 0;
+	std::vector<uint8_t>	camera_;
+	uint64_t				sceneVersion_ = 0;
+	uint32_t				frameIndex_ = 0;
+	uint32_t				sampleCount_ = 0;
+	ProgressiveStats		stats_;
+};	// class ProgressiveAccumulator
+
+//	EOF
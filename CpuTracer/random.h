@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <stdint.h>
+
+// 環境によらず同じ系列を返す乱数（PCG32）
+class Random
+{
+public:
+	explicit Random(uint64_t seed = 0)
+	{
+		state_ = 0;
+		Next();
+		state_ += seed;
+		Next();
+	}
+
+	uint32_t Next()
+	{
+		uint64_t old = state_;
+		state_ = old * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+		uint32_t rot = (uint32_t)(old >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+	}
+
+	// [0, 1)
+	float NextFloat()
+	{
+		return (float)(Next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// [a, b)
+	float NextFloat(float a, float b)
+	{
+		return a + (b - a) * NextFloat();
+	}
+
+private:
+	uint64_t	state_;
+};	// class Random
+
+// 画素ごとの乱数に使うハッシュ（PCG）
+// シェーダでも同じ式で求めるので、状態を持たない
+inline uint32_t HashPcg(uint32_t value)
+{
+	uint32_t state = value * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+// 画素 (x, y) のフレーム frameIndex での乱数のシード
+// salt で同じ画素の中の別の用途（サブピクセル位置、シャドウレイなど）を分ける
+inline uint32_t PixelSeed(uint32_t x, uint32_t y, uint32_t frameIndex, uint32_t salt)
+{
+	return HashPcg(x + HashPcg(y + HashPcg(frameIndex + HashPcg(salt))));
+}
+
+// ハッシュ値を [0, 1) に変換する
+inline float HashToFloat(uint32_t hash)
+{
+	return (float)(hash >> 8) * (1.0f / 16777216.0f);
+}
+
+//	EOF
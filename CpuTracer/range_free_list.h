@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// 連続した範囲の空きを begin の昇順で持ち、先頭から最初に収まる範囲を切り出すフリーリスト
+// 返された範囲は隣の空きとつなげるので、細切れになっても大きな範囲を確保し直せる
+// DescriptorAllocator ではディスクリプタのインデックス、AsMemoryPool ではブロック内のバイト位置に使う
+class RangeFreeList
+{
+public:
+	static const uint64_t kInvalid = ~0ull;
+
+	void Clear()
+	{
+		ranges_.clear();
+	}
+
+	// count 個を切り出して先頭の位置を返し、収まる範囲がなければ kInvalid を返す
+	uint64_t Allocate(uint64_t count)
+	{
+		for (auto it = ranges_.begin(); it != ranges_.end(); ++it)
+		{
+			if (it->count < count)
+				continue;
+
+			uint64_t begin = it->begin;
+			it->begin += count;
+			it->count -= count;
+			if (it->count == 0)
+				ranges_.erase(it);
+			return begin;
+		}
+		return kInvalid;
+	}
+
+	// [begin, begin + count) を空きに戻す
+	void Free(uint64_t begin, uint64_t count)
+	{
+		auto it = std::lower_bound(ranges_.begin(), ranges_.end(), begin,
+			[](const Range& r, uint64_t b) { return r.begin < b; });
+		it = ranges_.insert(it, { begin, count });
+		if (it + 1 != ranges_.end() && it->begin + it->count == (it + 1)->begin)
+		{
+			it->count += (it + 1)->count;
+			ranges_.erase(it + 1);
+		}
+		if (it != ranges_.begin() && (it - 1)->begin + (it - 1)->count == it->begin)
+		{
+			(it - 1)->count += it->count;
+			ranges_.erase(it);
+		}
+	}
+
+	// end で終わる空き範囲の大きさ（末尾に続けて広げるときに使う）
+	uint64_t GetTailCount(uint64_t end) const
+	{
+		if (ranges_.empty() || ranges_.back().begin + ranges_.back().count != end)
+			return 0;
+		return ranges_.back().count;
+	}
+
+private:
+	struct Range
+	{
+		uint64_t	begin;
+		uint64_t	count;
+	};
+
+	std::vector<Range>	ranges_;
+};	// class RangeFreeList
+
+//	EOF
@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include "raytracing.h"
+
+#include <vector>
+
+// ウェーブフロント方式でまとめてトレースするレイのキュー（SoA）
+// 段階ごとに前の段階が書き出したレイを先頭から順に処理するので、1本のレイのために保持する状態は最小限にする
+struct RayQueue
+{
+	std::vector<float>		originX, originY, originZ;
+	std::vector<float>		directionX, directionY, directionZ;
+	std::vector<float>		tmin;
+	std::vector<uint32_t>	pathIndex;		// 結果を書き戻すパス（画素）の番号
+
+	uint32_t GetCount() const { return (uint32_t)pathIndex.size(); }
+
+	void Clear()
+	{
+		originX.clear(); originY.clear(); originZ.clear();
+		directionX.clear(); directionY.clear(); directionZ.clear();
+		tmin.clear();
+		pathIndex.clear();
+	}
+
+	void Reserve(uint32_t count)
+	{
+		originX.reserve(count); originY.reserve(count); originZ.reserve(count);
+		directionX.reserve(count); directionY.reserve(count); directionZ.reserve(count);
+		tmin.reserve(count);
+		pathIndex.reserve(count);
+	}
+
+	// TMax はどのレイも同じ（10000）なので持たない
+	void Push(const float3& origin, float rayTMin, const float3& direction, uint32_t path)
+	{
+		originX.push_back(origin.x); originY.push_back(origin.y); originZ.push_back(origin.z);
+		directionX.push_back(direction.x); directionY.push_back(direction.y); directionZ.push_back(direction.z);
+		tmin.push_back(rayTMin);
+		pathIndex.push_back(path);
+	}
+
+	RayDesc GetRay(uint32_t i, float tmax = 10000.0f) const
+	{
+		RayDesc ray = { float3(originX[i], originY[i], originZ[i]), tmin[i], float3(directionX[i], directionY[i], directionZ[i]), tmax };
+		return ray;
+	}
+};
+
+// RayQueue と同じ並びのヒット情報（SoA）
+struct HitQueue
+{
+	std::vector<uint8_t>	isHit;
+	std::vector<float>		t;
+	std::vector<uint32_t>	instanceIndex;
+	std::vector<uint32_t>	primitiveIndex;
+	std::vector<uint32_t>	hitGroupIndex;
+	std::vector<float>		normalX, normalY, normalZ;
+
+	void Resize(uint32_t count)
+	{
+		isHit.resize(count);
+		t.resize(count);
+		instanceIndex.resize(count);
+		primitiveIndex.resize(count);
+		hitGroupIndex.resize(count);
+		normalX.resize(count); normalY.resize(count); normalZ.resize(count);
+	}
+
+	float3 GetNormal(uint32_t i) const { return float3(normalX[i], normalY[i], normalZ[i]); }
+};
+
+//	EOF
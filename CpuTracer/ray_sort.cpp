@@ -0,0 +1,79 @@
+﻿#include "ray_sort.h"
+
+#include <algorithm>
+
+namespace
+{
+	// 10ビットの値のビットの間に0を2つずつ挟む
+	uint32_t SpreadBits3(uint32_t v)
+	{
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	uint32_t Quantize(float v, float vmin, float invExtent)
+	{
+		const float kMax = (float)((1u << kRaySortMortonBits) - 1);
+		float q = (v - vmin) * invExtent * kMax;
+		return (uint32_t)std::min(std::max(q, 0.0f), kMax);
+	}
+
+	// 並べ替えた順に SoA の配列を並べ直す
+	template <typename T>
+	void Gather(std::vector<T>& values, const std::vector<uint64_t>& keys, std::vector<T>& temp)
+	{
+		temp.resize(values.size());
+		for (size_t i = 0; i < keys.size(); i++)
+			temp[i] = values[(uint32_t)keys[i]];
+		values.swap(temp);
+	}
+}
+
+uint32_t ComputeRaySortKey(const float3& origin, const float3& direction, const float3& boundsMin, const float3& invExtent)
+{
+	uint32_t morton = SpreadBits3(Quantize(origin.x, boundsMin.x, invExtent.x))
+		| (SpreadBits3(Quantize(origin.y, boundsMin.y, invExtent.y)) << 1)
+		| (SpreadBits3(Quantize(origin.z, boundsMin.z, invExtent.z)) << 2);
+	return (GetDirectionOctant(direction) << (kRaySortMortonBits * 3)) | morton;
+}
+
+void SortRayQueue(RayQueue& queue, RaySortScratch& scratch)
+{
+	uint32_t count = queue.GetCount();
+	if (count < 2)
+		return;
+
+	float3 bmin(queue.originX[0], queue.originY[0], queue.originZ[0]);
+	float3 bmax = bmin;
+	for (uint32_t i = 1; i < count; i++)
+	{
+		bmin = float3(std::min(bmin.x, queue.originX[i]), std::min(bmin.y, queue.originY[i]), std::min(bmin.z, queue.originZ[i]));
+		bmax = float3(std::max(bmax.x, queue.originX[i]), std::max(bmax.y, queue.originY[i]), std::max(bmax.z, queue.originZ[i]));
+	}
+	auto InvExtent = [](float e) { return (e > 0.0f) ? 1.0f / e : 0.0f; };
+	float3 invExtent(InvExtent(bmax.x - bmin.x), InvExtent(bmax.y - bmin.y), InvExtent(bmax.z - bmin.z));
+
+	// 同じキーのレイは元の順（画素の順）のまま
+	scratch.keys.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float3 origin(queue.originX[i], queue.originY[i], queue.originZ[i]);
+		float3 direction(queue.directionX[i], queue.directionY[i], queue.directionZ[i]);
+		scratch.keys[i] = ((uint64_t)ComputeRaySortKey(origin, direction, bmin, invExtent) << 32) | i;
+	}
+	std::sort(scratch.keys.begin(), scratch.keys.end());
+
+	Gather(queue.originX, scratch.keys, scratch.floats);
+	Gather(queue.originY, scratch.keys, scratch.floats);
+	Gather(queue.originZ, scratch.keys, scratch.floats);
+	Gather(queue.directionX, scratch.keys, scratch.floats);
+	Gather(queue.directionY, scratch.keys, scratch.floats);
+	Gather(queue.directionZ, scratch.keys, scratch.floats);
+	Gather(queue.tmin, scratch.keys, scratch.floats);
+	Gather(queue.pathIndex, scratch.keys, scratch.uints);
+}
+
+//	EOF
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include "ray_queue.h"
+
+#include <vector>
+
+// 二次レイ（反射レイ、シャドウレイ）を似たレイが続くように並べ替える
+// 方向の符号（8分円）を上位に、起点のモートンコードを下位にしたキーで並べるので、
+// 同じ方向に飛ぶ近くのレイが同じBVHのノードを続けて走査する
+
+// 起点を bounds 内で各軸 kRaySortMortonBits ビットに量子化する
+static const uint32_t kRaySortMortonBits = 9;
+
+// 方向 direction の符号から 0-7 の番号を求める
+inline uint32_t GetDirectionOctant(const float3& direction)
+{
+	return (direction.x < 0.0f ? 1u : 0u) | (direction.y < 0.0f ? 2u : 0u) | (direction.z < 0.0f ? 4u : 0u);
+}
+
+// 並べ替えのキー（上位3ビットが8分円、下位27ビットが起点のモートンコード）
+// boundsMin と invExtent はキュー全体の起点を囲むボックスの最小点と、大きさの逆数
+uint32_t ComputeRaySortKey(const float3& origin, const float3& direction, const float3& boundsMin, const float3& invExtent);
+
+// 並べ替えに使う作業領域（スレッドごとに使い回す）
+struct RaySortScratch
+{
+	std::vector<uint64_t>	keys;		// キー << 32 | 元の位置
+	std::vector<float>		floats;
+	std::vector<uint32_t>	uints;
+};
+
+// queue のレイをキーの順に並べ替える
+// pathIndex も一緒に並べ替えるので、トレースした結果はそのままパスに書き戻せる
+void SortRayQueue(RayQueue& queue, RaySortScratch& scratch);
+
+//	EOF
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include "rt_math.h"
+
+// DXRのAPI/HLSL組み込み型をCPU側で再現したもの
+
+// RAY_FLAG（HLSLと同じ値）
+enum RayFlag : uint32_t
+{
+	RAY_FLAG_NONE								= 0x00,
+	RAY_FLAG_FORCE_OPAQUE						= 0x01,
+	RAY_FLAG_FORCE_NON_OPAQUE					= 0x02,
+	RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH	= 0x04,
+	RAY_FLAG_SKIP_CLOSEST_HIT_SHADER			= 0x08,
+	RAY_FLAG_CULL_BACK_FACING_TRIANGLES			= 0x10,
+	RAY_FLAG_CULL_FRONT_FACING_TRIANGLES		= 0x20,
+	RAY_FLAG_CULL_OPAQUE						= 0x40,
+	RAY_FLAG_CULL_NON_OPAQUE					= 0x80,
+};
+
+struct RayDesc
+{
+	float3	Origin;
+	float	TMin;
+	float3	Direction;
+	float	TMax;
+};
+
+// D3D12_RAYTRACING_AABB
+struct RaytracingAABB
+{
+	float	MinX, MinY, MinZ;
+	float	MaxX, MaxY, MaxZ;
+};
+
+// D3D12_RAYTRACING_INSTANCE_FLAGS
+enum RaytracingInstanceFlag : uint32_t
+{
+	RAYTRACING_INSTANCE_FLAG_NONE								= 0x0,
+	RAYTRACING_INSTANCE_FLAG_TRIANGLE_CULL_DISABLE				= 0x1,
+	RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE	= 0x2,
+	RAYTRACING_INSTANCE_FLAG_FORCE_OPAQUE						= 0x4,
+	RAYTRACING_INSTANCE_FLAG_FORCE_NON_OPAQUE					= 0x8,
+};
+
+// D3D12_RAYTRACING_INSTANCE_DESC
+// AccelerationStructure はGPUアドレスの代わりにボトムレベルASのインデックスを持つ
+struct RaytracingInstanceDesc
+{
+	float3x4	Transform;
+	uint32_t	InstanceID : 24;
+	uint32_t	InstanceMask : 8;
+	uint32_t	InstanceContributionToHitGroupIndex : 24;
+	uint32_t	Flags : 8;
+	uint64_t	AccelerationStructure;
+};
+
+// インスタンスフラグをトライアングルのカリング用のレイフラグに反映する
+inline uint32_t ApplyInstanceFlags(uint32_t rayFlags, uint32_t instanceFlags)
+{
+	const uint32_t kCullMask = RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_CULL_FRONT_FACING_TRIANGLES;
+	if (instanceFlags & RAYTRACING_INSTANCE_FLAG_TRIANGLE_CULL_DISABLE)
+	{
+		return rayFlags & ~kCullMask;
+	}
+	if (instanceFlags & RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE)
+	{
+		// 表裏が反転するのでカリング対象も入れ替える
+		// CULL_BACK(0x10) と CULL_FRONT(0x20) は隣り合うビットなので入れ替えはシフトで済む
+		uint32_t swapped = ((rayFlags & RAY_FLAG_CULL_BACK_FACING_TRIANGLES) << 1) | ((rayFlags & RAY_FLAG_CULL_FRONT_FACING_TRIANGLES) >> 1);
+		return (rayFlags & ~kCullMask) | swapped;
+	}
+	return rayFlags;
+}
+
+// シェーダから参照できるレイのシステム値
+struct RaySystemValues
+{
+	float3		worldRayOrigin;
+	float3		worldRayDirection;
+	float		rayTMin;
+	float		rayTCurrent;
+	uint32_t	rayFlags;
+	uint32_t	instanceIndex;
+	uint32_t	instanceID;
+	uint32_t	primitiveIndex;
+};
+
+//	EOF
@@ -0,0 +1,50 @@
+﻿#include "renderer.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+uint32_t GetDispatchThreadCount(const DispatchDesc& desc)
+{
+	if (desc.pThreadPool)
+	{
+		return desc.pThreadPool->GetThreadCount();
+	}
+	if (desc.threadCount > 0)
+	{
+		return desc.threadCount;
+	}
+	return std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void DispatchTiles(const DispatchDesc& desc, const std::function<void(const Tile&, uint32_t)>& func, ThreadPoolStats* pStats)
+{
+	uint32_t tileW = std::max<uint32_t>(desc.tileWidth, 1);
+	uint32_t tileH = std::max<uint32_t>(desc.tileHeight, 1);
+	uint32_t tileCountX = (desc.width + tileW - 1) / tileW;
+	uint32_t tileCountY = (desc.height + tileH - 1) / tileH;
+	uint32_t tileCount = tileCountX * tileCountY;
+
+	// スレッドプールが渡されていなければ、この呼び出しの間だけ作る
+	std::unique_ptr<ThreadPool> localPool;
+	ThreadPool* pPool = desc.pThreadPool;
+	if (!pPool)
+	{
+		localPool.reset(new ThreadPool(GetDispatchThreadCount(desc)));
+		pPool = localPool.get();
+	}
+
+	// タイルは行優先に並べるので、スレッドごとに配られるのは画面の横長の帯になる
+	// 反射の多い帯のように重いタイルが偏っても、空いたスレッドが残りを盗んで処理する
+	pPool->Run(tileCount, [&](uint32_t index, uint32_t threadIndex)
+	{
+		Tile tile;
+		tile.x0 = (index % tileCountX) * tileW;
+		tile.y0 = (index / tileCountX) * tileH;
+		tile.x1 = std::min(tile.x0 + tileW, desc.width);
+		tile.y1 = std::min(tile.y0 + tileH, desc.height);
+		func(tile, threadIndex);
+	}, desc.schedule, pStats);
+}
+
+//	EOF
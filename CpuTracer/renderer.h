@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include "thread_pool.h"
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// DispatchRays をタイル単位に分割してCPUの全コアで処理する
+
+struct DispatchDesc
+{
+	uint32_t	width = 0;
+	uint32_t	height = 0;
+	uint32_t	tileWidth = 16;
+	uint32_t	tileHeight = 16;
+	uint32_t	threadCount = 0;		// 0ならハードウェアスレッド数（pThreadPool を使う場合は無視する）
+	ThreadPool*	pThreadPool = nullptr;	// 呼び出し元が持つ常駐のスレッドプール（nullなら呼び出しごとに threadCount のスレッドを作る）
+	uint32_t	packetSize = 0;			// プライマリレイを packetSize x packetSize のパケットで処理する（0なら無効）
+	TaskSchedule	schedule = kScheduleWorkStealing;	// タイルの割り振り方
+	bool		sortSecondaryRays = false;	// ウェーブフロントで反射レイとシャドウレイを方向と起点で並べ替えてからトレースする
+};
+
+struct Tile
+{
+	uint32_t	x0, y0;
+	uint32_t	x1, y1;		// 終端（含まない）
+};
+
+struct RenderStats
+{
+	std::vector<uint64_t>	threadRayCounts;
+	uint64_t				rayCount = 0;
+	double					seconds = 0.0;
+	ThreadPoolStats			tiles;			// スレッドごとのタイル数と処理時間
+
+	double MRaysPerSecond() const
+	{
+		return (seconds > 0.0) ? (double)rayCount / seconds * 1e-6 : 0.0;
+	}
+};
+
+// pThreadPool があればそのスレッド数
+uint32_t GetDispatchThreadCount(const DispatchDesc& desc);
+
+// 全タイルを処理し終えるまで戻らない
+// func はタイルと処理スレッド番号を受け取る
+// 同じ pThreadPool を使う呼び出しは、同時に1つのスレッドからだけにすること
+void DispatchTiles(const DispatchDesc& desc, const std::function<void(const Tile&, uint32_t)>& func, ThreadPoolStats* pStats = nullptr);
+
+//	EOF
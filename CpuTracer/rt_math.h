@@ -0,0 +1,293 @@
+﻿#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+
+// HLSLと同じ名前で扱えるようにした最低限のベクトル・行列
+// 行列はDirectXMathと同じ行優先・行ベクトル形式（シェーダは-Zprでコンパイルされている）
+
+static const float kPI = 3.141592654f;
+
+struct float2
+{
+	float x, y;
+};
+
+struct float3
+{
+	float x, y, z;
+
+	float3()
+	{}
+	float3(float _x, float _y, float _z)
+		: x(_x), y(_y), z(_z)
+	{}
+	explicit float3(float v)
+		: x(v), y(v), z(v)
+	{}
+
+	float& operator[](int i) { return (&x)[i]; }
+	float operator[](int i) const { return (&x)[i]; }
+};
+
+struct float4
+{
+	float x, y, z, w;
+
+	float4()
+	{}
+	float4(float _x, float _y, float _z, float _w)
+		: x(_x), y(_y), z(_z), w(_w)
+	{}
+	float4(const float3& v, float _w)
+		: x(v.x), y(v.y), z(v.z), w(_w)
+	{}
+
+	float3 xyz() const { return float3(x, y, z); }
+	float& operator[](int i) { return (&x)[i]; }
+	float operator[](int i) const { return (&x)[i]; }
+};
+
+// 4x4行列
+struct float4x4
+{
+	float m[4][4];
+};
+
+// D3D12_RAYTRACING_INSTANCE_DESC::Transform と同じ3x4行列
+// 列ベクトル形式で、m[i][3] が平行移動成分
+struct float3x4
+{
+	float m[3][4];
+};
+
+inline float3 operator+(const float3& a, const float3& b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline float3 operator-(const float3& a, const float3& b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline float3 operator*(const float3& a, const float3& b) { return float3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline float3 operator/(const float3& a, const float3& b) { return float3(a.x / b.x, a.y / b.y, a.z / b.z); }
+inline float3 operator*(const float3& a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+inline float3 operator*(float s, const float3& a) { return float3(a.x * s, a.y * s, a.z * s); }
+inline float3 operator/(const float3& a, float s) { return float3(a.x / s, a.y / s, a.z / s); }
+inline float3 operator-(const float3& a) { return float3(-a.x, -a.y, -a.z); }
+inline float3& operator+=(float3& a, const float3& b) { a.x += b.x; a.y += b.y; a.z += b.z; return a; }
+inline float3& operator*=(float3& a, float s) { a.x *= s; a.y *= s; a.z *= s; return a; }
+
+inline float4 operator+(const float4& a, const float4& b) { return float4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+inline float4 operator*(const float4& a, float s) { return float4(a.x * s, a.y * s, a.z * s, a.w * s); }
+
+inline float saturate(float v) { return std::min(std::max(v, 0.0f), 1.0f); }
+inline float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float3 cross(const float3& a, const float3& b)
+{
+	return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float length(const float3& v) { return sqrtf(dot(v, v)); }
+inline float3 normalize(const float3& v) { return v / length(v); }
+inline float3 abs(const float3& v) { return float3(fabsf(v.x), fabsf(v.y), fabsf(v.z)); }
+inline float3 min(const float3& a, const float3& b) { return float3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+inline float3 max(const float3& a, const float3& b) { return float3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+
+inline float ConvertToRadians(float degree) { return degree * (kPI / 180.0f); }
+
+// 行ベクトル * 行列
+inline float4 mul(const float4& v, const float4x4& m)
+{
+	float4 ret;
+	for (int i = 0; i < 4; i++)
+	{
+		ret[i] = v.x * m.m[0][i] + v.y * m.m[1][i] + v.z * m.m[2][i] + v.w * m.m[3][i];
+	}
+	return ret;
+}
+
+inline float4x4 mul(const float4x4& a, const float4x4& b)
+{
+	float4x4 ret;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			ret.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		}
+	}
+	return ret;
+}
+
+inline float4x4 MatrixIdentity()
+{
+	float4x4 ret = {};
+	ret.m[0][0] = ret.m[1][1] = ret.m[2][2] = ret.m[3][3] = 1.0f;
+	return ret;
+}
+
+inline float4x4 MatrixScaling(float x, float y, float z)
+{
+	float4x4 ret = MatrixIdentity();
+	ret.m[0][0] = x; ret.m[1][1] = y; ret.m[2][2] = z;
+	return ret;
+}
+
+inline float4x4 MatrixTranslation(float x, float y, float z)
+{
+	float4x4 ret = MatrixIdentity();
+	ret.m[3][0] = x; ret.m[3][1] = y; ret.m[3][2] = z;
+	return ret;
+}
+
+inline float4x4 MatrixRotationX(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	float4x4 ret = MatrixIdentity();
+	ret.m[1][1] = c; ret.m[1][2] = s;
+	ret.m[2][1] = -s; ret.m[2][2] = c;
+	return ret;
+}
+
+inline float4x4 MatrixRotationY(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	float4x4 ret = MatrixIdentity();
+	ret.m[0][0] = c; ret.m[0][2] = -s;
+	ret.m[2][0] = s; ret.m[2][2] = c;
+	return ret;
+}
+
+inline float4x4 MatrixRotationZ(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	float4x4 ret = MatrixIdentity();
+	ret.m[0][0] = c; ret.m[0][1] = s;
+	ret.m[1][0] = -s; ret.m[1][1] = c;
+	return ret;
+}
+
+inline float4x4 MatrixTranspose(const float4x4& m)
+{
+	float4x4 ret;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			ret.m[i][j] = m.m[j][i];
+	return ret;
+}
+
+// XMMatrixLookAtLH 相当
+inline float4x4 MatrixLookAtLH(const float3& eye, const float3& at, const float3& up)
+{
+	float3 z = normalize(at - eye);
+	float3 x = normalize(cross(up, z));
+	float3 y = cross(z, x);
+
+	float4x4 ret = {};
+	ret.m[0][0] = x.x; ret.m[0][1] = y.x; ret.m[0][2] = z.x;
+	ret.m[1][0] = x.y; ret.m[1][1] = y.y; ret.m[1][2] = z.y;
+	ret.m[2][0] = x.z; ret.m[2][1] = y.z; ret.m[2][2] = z.z;
+	ret.m[3][0] = -dot(x, eye); ret.m[3][1] = -dot(y, eye); ret.m[3][2] = -dot(z, eye);
+	ret.m[3][3] = 1.0f;
+	return ret;
+}
+
+// XMMatrixPerspectiveFovLH 相当
+inline float4x4 MatrixPerspectiveFovLH(float fovY, float aspect, float nearZ, float farZ)
+{
+	float h = 1.0f / tanf(fovY * 0.5f);
+	float w = h / aspect;
+	float range = farZ / (farZ - nearZ);
+
+	float4x4 ret = {};
+	ret.m[0][0] = w;
+	ret.m[1][1] = h;
+	ret.m[2][2] = range;
+	ret.m[2][3] = 1.0f;
+	ret.m[3][2] = -range * nearZ;
+	return ret;
+}
+
+// 余因子展開による逆行列
+inline float4x4 MatrixInverse(const float4x4& mat)
+{
+	const float* m = &mat.m[0][0];
+	float inv[16];
+
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	float invDet = (det != 0.0f) ? 1.0f / det : 0.0f;
+
+	float4x4 ret;
+	for (int i = 0; i < 16; i++)
+	{
+		(&ret.m[0][0])[i] = inv[i] * invDet;
+	}
+	return ret;
+}
+
+// Sample03 の ToTransform ラムダと同じ変換（4x4行ベクトル行列 -> 3x4列ベクトル行列）
+inline float3x4 ToTransform(const float4x4& mtx)
+{
+	float3x4 ret;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			ret.m[i][j] = mtx.m[j][i];
+		}
+	}
+	return ret;
+}
+
+inline float3x4 Transform3x4Identity()
+{
+	float3x4 ret = {};
+	ret.m[0][0] = ret.m[1][1] = ret.m[2][2] = 1.0f;
+	return ret;
+}
+
+// ToTransform の逆変換（3x4列ベクトル行列 -> 4x4行ベクトル行列）
+inline float4x4 ToMatrix(const float3x4& t)
+{
+	float4x4 m = MatrixIdentity();
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 4; j++)
+			m.m[j][i] = t.m[i][j];
+	return m;
+}
+
+// 3x4行列の逆行列（アフィン変換前提）
+inline float3x4 Transform3x4Inverse(const float3x4& t)
+{
+	return ToTransform(MatrixInverse(ToMatrix(t)));
+}
+
+inline float3 TransformPoint(const float3x4& t, const float3& p)
+{
+	return float3(
+		t.m[0][0] * p.x + t.m[0][1] * p.y + t.m[0][2] * p.z + t.m[0][3],
+		t.m[1][0] * p.x + t.m[1][1] * p.y + t.m[1][2] * p.z + t.m[1][3],
+		t.m[2][0] * p.x + t.m[2][1] * p.y + t.m[2][2] * p.z + t.m[2][3]);
+}
+
+inline float3 TransformVector(const float3x4& t, const float3& v)
+{
+	return float3(
+		t.m[0][0] * v.x + t.m[0][1] * v.y + t.m[0][2] * v.z,
+		t.m[1][0] * v.x + t.m[1][1] * v.y + t.m[1][2] * v.z,
+		t.m[2][0] * v.x + t.m[2][1] * v.y + t.m[2][2] * v.z);
+}
+
+//	EOF
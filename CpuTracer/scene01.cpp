@@ -0,0 +1,79 @@
+﻿#include "scene01.h"
+
+bool InitScene01(Scene01& scene)
+{
+	const float size = 0.7f;
+	const float depth = 1.0f;
+	const float3 kVertices[4] = {
+		float3( size, -size, depth),
+		float3(-size, -size, depth),
+		float3( size,  size, depth),
+		float3(-size,  size, depth),
+	};
+	const uint16_t kIndices[6] =
+	{
+		0, 1, 2,
+		1, 3, 2,
+	};
+	for (int i = 0; i < 4; i++) scene.vertices[i] = kVertices[i];
+	for (int i = 0; i < 6; i++) scene.indices[i] = kIndices[i];
+
+	TriangleGeometryDesc geo;
+	geo.VertexBuffer = scene.vertices;
+	geo.VertexStrideInBytes = sizeof(float3);
+	geo.VertexCount = 4;
+	geo.IndexBuffer = scene.indices;
+	geo.IndexCount = 6;
+	if (!scene.bottomLevel.Build(geo, BvhBuildDesc()))
+		return false;
+
+	// トランスフォーム行列は単位行列
+	RaytracingInstanceDesc desc{};
+	desc.Transform = Transform3x4Identity();
+	desc.InstanceMask = 1;
+	desc.AccelerationStructure = 0;
+	scene.instanceDescs.assign(1, desc);
+
+	scene.viewport = { -1.0f, -1.0f, 1.0f, 1.0f };
+	scene.stencil = { -0.9f, -0.9f, 0.9f, 0.9f };
+
+	BoundingBox bottomBounds = scene.bottomLevel.GetBvh().GetBounds();
+	return scene.topLevel.Build(scene.instanceDescs.data(), 1, &bottomBounds, 1, BvhBuildDesc());
+}
+
+bool MakeScene01Ray(const Scene01& scene, float u, float v, RayDesc& ray)
+{
+	// 正射影としてレイを飛ばす
+	auto&& vp = scene.viewport;
+	float3 origin(vp.left + (vp.right - vp.left) * u, vp.top + (vp.bottom - vp.top) * v, 0.0f);
+
+	auto&& st = scene.stencil;
+	if (origin.x < st.left || origin.x > st.right || origin.y < st.top || origin.y > st.bottom)
+		return false;
+
+	ray.Origin = origin;
+	ray.TMin = 0.0f;
+	ray.Direction = float3(0.0f, 0.0f, 1.0f);
+	ray.TMax = 10000.0f;
+	return true;
+}
+
+bool IntersectScene01(const Scene01& scene, const RayDesc& ray, uint32_t rayFlags, TriangleHit& hit, TraversalStats* pTopStats, TraversalStats* pBottomStats)
+{
+	bool isHit = false;
+	float tmax = ray.TMax;
+	scene.topLevel.Traverse(ray, ~0u, tmax, [&](uint32_t instanceIndex, const RayDesc& objRay, float& tcur)
+	{
+		auto&& inst = scene.topLevel.GetInstanceDesc(instanceIndex);
+		if (!scene.bottomLevel.Intersect(objRay, ApplyInstanceFlags(rayFlags, inst.Flags), hit, pBottomStats))
+			return false;
+
+		tcur = hit.t;
+		isHit = true;
+		return (rayFlags & RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH) != 0;
+	}, pTopStats);
+
+	return isHit;
+}
+
+//	EOF
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include "blas.h"
+#include "tlas.h"
+
+// Sample01 のシーン（正射影のレイで見る四角形ポリゴン1枚）
+
+struct Viewport
+{
+	float	left;
+	float	top;
+	float	right;
+	float	bottom;
+};
+
+struct Scene01
+{
+	float3								vertices[4];
+	uint16_t							indices[6];
+	TriangleBlas						bottomLevel;
+
+	std::vector<RaytracingInstanceDesc>	instanceDescs;
+	TopLevelAS							topLevel;
+
+	// RayGenCB
+	Viewport							viewport;
+	Viewport							stencil;
+};
+
+// Sample01 の InitGeometry と InitAccelerationStructure 相当
+bool InitScene01(Scene01& scene);
+
+// RayGenerator と同じく (u, v) = DispatchRaysIndex() / DispatchRaysDimensions() からレイを生成する
+// ステンシル領域外でレイを飛ばさない場合は false を返す
+bool MakeScene01Ray(const Scene01& scene, float u, float v, RayDesc& ray);
+
+bool IntersectScene01(const Scene01& scene, const RayDesc& ray, uint32_t rayFlags, TriangleHit& hit, TraversalStats* pTopStats = nullptr, TraversalStats* pBottomStats = nullptr);
+
+//	EOF
@@ -0,0 +1,248 @@
+﻿#include "scene02.h"
+
+#include <stdio.h>
+
+bool MakeScene02File(const Scene02Desc& desc, SceneFile& file)
+{
+	if (desc.gridCount <= 0)
+		return false;
+
+	file = SceneFile();
+	file.camera.position = float3(0.0f, 5.0f, -5.0f);
+	file.light.direction = float3(1.0f, -1.0f, -1.0f);
+
+	// マテリアル（rootArguments の matColor）
+	file.materials = {
+		{ "red", float4(1.0f, 0.0f, 0.0f, 1.0f) },
+		{ "yellow", float4(1.0f, 1.0f, 0.0f, 1.0f) },
+		{ "green", float4(0.0f, 1.0f, 0.0f, 1.0f) },
+	};
+
+	// メッシュ
+	file.meshes.resize(2);
+	{
+		auto&& mesh = file.meshes[kScene02BoxBottomAS];
+		int vcount, icount;
+		GetBoxVertexAndIndexCount(vcount, icount);
+		mesh.name = "box";
+		mesh.vertices.resize(vcount);
+		mesh.indices.resize(icount);
+		CreateBoxVertexAndIndex(mesh.vertices.data(), mesh.indices.data());
+	}
+	{
+		auto&& mesh = file.meshes[kScene02SphereBottomAS];
+		int vcount, icount;
+		GetShpereVertexAndIndexCount(desc.longCount, desc.latiCount, vcount, icount);
+		if (vcount > 0x10000)
+		{
+			// インデックスは16bit
+			return false;
+		}
+		mesh.name = "sphere";
+		mesh.vertices.resize(vcount);
+		mesh.indices.resize(icount);
+		CreateSphereVertexAndIndex(desc.longCount, desc.latiCount, mesh.vertices.data(), mesh.indices.data());
+	}
+
+	// インスタンス
+	// Sample02 と同じ3インスタンスを、間隔を空けてXZ平面上のグリッドに並べる
+	const float kGridSpacing = 8.0f;
+	float4x4 mtxLocal[3];
+	mtxLocal[0] = MatrixTranslation(-1.5f, 0.0f, 0.0f);
+	mtxLocal[1] = mul(MatrixRotationY(ConvertToRadians(45.0f)), MatrixTranslation(1.5f, 0.0f, 0.0f));
+	mtxLocal[2] = MatrixTranslation(0.0f, 0.0f, 2.5f);
+	const uint32_t kMesh[3] = { kScene02BoxBottomAS, kScene02BoxBottomAS, kScene02SphereBottomAS };
+
+	file.instances.reserve(desc.gridCount * desc.gridCount * 3);
+	float offset = (float)(desc.gridCount - 1) * kGridSpacing * 0.5f;
+	for (int z = 0; z < desc.gridCount; z++)
+	{
+		for (int x = 0; x < desc.gridCount; x++)
+		{
+			auto mtxCell = MatrixTranslation((float)x * kGridSpacing - offset, 0.0f, (float)z * kGridSpacing - offset);
+			for (int i = 0; i < 3; i++)
+			{
+				SceneFileInstance inst = {};
+				inst.geometryType = kSceneGeometryMesh;
+				inst.geometryIndex = kMesh[i];
+				inst.material = i;
+				inst.instanceID = z * desc.gridCount + x;
+				inst.mask = 1;
+				inst.contribution = i;
+				inst.transform = ToTransform(mul(mtxLocal[i], mtxCell));
+				file.instances.push_back(inst);
+			}
+		}
+	}
+	return true;
+}
+
+bool InitScene02(Scene02& scene, const Scene02Desc& desc)
+{
+	SceneFile file;
+	if (!MakeScene02File(desc, file))
+		return false;
+	return InitScene02(scene, file, desc.bottomBuild, desc.topBuild);
+}
+
+bool InitScene02(Scene02& scene, const SceneFile& file, const BvhBuildDesc& bottomBuild, const BvhBuildDesc& topBuild)
+{
+	// ボトムレベルAS
+	const size_t meshCount = file.meshes.size();
+	scene.meshVertices.resize(meshCount);
+	scene.meshIndices.resize(meshCount);
+	scene.bottomLevels.resize(meshCount);
+	std::vector<BoundingBox> bottomBounds(meshCount);
+	for (size_t i = 0; i < meshCount; i++)
+	{
+		scene.meshVertices[i] = file.meshes[i].vertices;
+		scene.meshIndices[i] = file.meshes[i].indices;
+
+		TriangleGeometryDesc geo;
+		geo.VertexBuffer = scene.meshVertices[i].data();
+		geo.VertexStrideInBytes = sizeof(Vertex);
+		geo.VertexCount = (uint32_t)scene.meshVertices[i].size();
+		geo.IndexBuffer = scene.meshIndices[i].data();
+		geo.IndexCount = (uint32_t)scene.meshIndices[i].size();
+		if (!scene.bottomLevels[i].Build(geo, bottomBuild))
+			return false;
+		bottomBounds[i] = scene.bottomLevels[i].GetBvh().GetBounds();
+	}
+
+	scene.camera = file.camera;
+	scene.light = file.light;
+
+	// インスタンス
+	scene.instanceDescs.resize(file.instances.size());
+	scene.instanceColors.resize(file.instances.size());
+	for (size_t i = 0; i < file.instances.size(); i++)
+	{
+		auto&& src = file.instances[i];
+		if (src.geometryType != kSceneGeometryMesh)
+		{
+			printf("Sample02 scene has no hit group for procedural geometry\n");
+			return false;
+		}
+
+		RaytracingInstanceDesc inst{};
+		inst.Transform = src.transform;
+		inst.InstanceID = src.instanceID;
+		inst.InstanceMask = src.mask;
+		inst.InstanceContributionToHitGroupIndex = src.contribution;
+		inst.AccelerationStructure = src.geometryIndex;
+		scene.instanceDescs[i] = inst;
+		scene.instanceColors[i] = file.materials[src.material].color;
+	}
+
+	return scene.topLevel.Build(scene.instanceDescs.data(), (uint32_t)scene.instanceDescs.size(), bottomBounds.data(), (uint32_t)meshCount, topBuild, &scene.topLevelStats);
+}
+
+bool SaveScene02Cache(const char* filename, uint64_t key, const Scene02& scene)
+{
+	AccelCacheWriter writer(key);
+	writer.WriteValue(scene.camera);
+	writer.WriteValue(scene.light);
+
+	// 法線の補間に使うので、メッシュの頂点とインデックスも保存する
+	writer.WriteValue((uint32_t)scene.bottomLevels.size());
+	for (size_t i = 0; i < scene.bottomLevels.size(); i++)
+	{
+		writer.WriteArray(scene.meshVertices[i]);
+		writer.WriteArray(scene.meshIndices[i]);
+		scene.bottomLevels[i].Save(writer);
+	}
+
+	writer.WriteArray(scene.instanceDescs);
+	writer.WriteArray(scene.instanceColors);
+	scene.topLevel.Save(writer);
+	return writer.Save(filename);
+}
+
+bool LoadScene02Cache(const char* filename, uint64_t key, Scene02& scene)
+{
+	AccelCacheReader reader;
+	if (!reader.Open(filename, key))
+		return false;
+
+	uint32_t meshCount;
+	if (!reader.ReadValue(scene.camera) || !reader.ReadValue(scene.light) || !reader.ReadValue(meshCount))
+		return false;
+
+	scene.meshVertices.resize(meshCount);
+	scene.meshIndices.resize(meshCount);
+	scene.bottomLevels.resize(meshCount);
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		if (!reader.ReadArray(scene.meshVertices[i]) || !reader.ReadArray(scene.meshIndices[i]) || !scene.bottomLevels[i].Load(reader))
+			return false;
+		if (scene.bottomLevels[i].GetPrimitiveCount() * 3 != scene.meshIndices[i].size())
+			return false;
+	}
+
+	if (!reader.ReadArray(scene.instanceDescs) || !reader.ReadArray(scene.instanceColors) || !scene.topLevel.Load(reader, meshCount))
+		return false;
+	scene.topLevelStats = BvhBuildStats();
+	return reader.IsEnd()
+		&& scene.instanceColors.size() == scene.instanceDescs.size()
+		&& scene.topLevel.GetInstanceCount() == scene.instanceDescs.size();
+}
+
+SceneCB MakeScene02CB(int frame, int width, int height)
+{
+	// Render では毎フレーム sYAngle が1度ずつ増える
+	float yAngle = (float)frame;
+
+	float4 camPos = { 0.0f, 5.0f, -5.0f, 1.0f };
+	float3 tgtPos = { 0.0f, 0.0f, 0.0f };
+	float3 upVec = { 0.0f, 1.0f, 0.0f };
+	camPos = mul(camPos, MatrixRotationY(ConvertToRadians(yAngle)));
+	auto mtxWorldToView = MatrixLookAtLH(camPos.xyz(), tgtPos, upVec);
+	auto mtxViewToClip = MatrixPerspectiveFovLH(ConvertToRadians(60.0f), (float)width / (float)height, 0.01f, 100.0f);
+	auto mtxWorldToClip = mul(mtxWorldToView, mtxViewToClip);
+
+	SceneCB cb;
+	cb.mtxProjToWorld = MatrixInverse(mtxWorldToClip);
+	cb.camPos = camPos;
+	cb.lightDir = float4(normalize(float3(1.0f, -1.0f, -1.0f)), 0.0f);
+	cb.lightColor = float4(1.0f, 1.0f, 1.0f, 1.0f);
+	return cb;
+}
+
+bool IntersectScene02(const Scene02& scene, const RayDesc& ray, uint32_t rayFlags, uint32_t instanceInclusionMask, InstanceHit& hit, TraversalStats* pTopStats, TraversalStats* pBottomStats)
+{
+	bool isHit = false;
+	float tmax = ray.TMax;
+	scene.topLevel.Traverse(ray, instanceInclusionMask, tmax, [&](uint32_t instanceIndex, const RayDesc& objRay, float& tcur)
+	{
+		auto&& inst = scene.topLevel.GetInstanceDesc(instanceIndex);
+		TriangleHit triHit;
+		if (!scene.bottomLevels[inst.AccelerationStructure].Intersect(objRay, ApplyInstanceFlags(rayFlags, inst.Flags), triHit, pBottomStats))
+			return false;
+
+		tcur = triHit.t;
+		hit.triangle = triHit;
+		hit.instanceIndex = instanceIndex;
+		isHit = true;
+		return (rayFlags & RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH) != 0;
+	}, pTopStats);
+
+	return isHit;
+}
+
+float3 GetScene02Normal(const Scene02& scene, const InstanceHit& hit)
+{
+	auto&& inst = scene.topLevel.GetInstanceDesc(hit.instanceIndex);
+	auto&& vertices = scene.meshVertices[inst.AccelerationStructure];
+	auto&& indices = scene.meshIndices[inst.AccelerationStructure];
+	const uint16_t* idx = indices.data() + hit.triangle.primitiveIndex * 3;
+
+	float3 n0 = vertices[idx[0]].normal;
+	float3 n1 = vertices[idx[1]].normal;
+	float3 n2 = vertices[idx[2]].normal;
+	float3 normal = n0 + hit.triangle.barycentrics.x * (n1 - n0) + hit.triangle.barycentrics.y * (n2 - n0);
+
+	// インスタンスは回転と平行移動だけなので、法線もそのまま変換できる
+	return normalize(TransformVector(inst.Transform, normalize(normal)));
+}
+
+//	EOF
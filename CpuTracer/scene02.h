@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include "blas.h"
+#include "tlas.h"
+#include "shapes.h"
+#include "scene_cb.h"
+#include "scene_file.h"
+
+#include <vector>
+
+// Sample02 のシーン（箱メッシュを共有するインスタンス2つ + 球メッシュのインスタンス1つ）
+
+// MakeScene02File が作るメッシュの番号
+static const int kScene02BoxBottomAS = 0;
+static const int kScene02SphereBottomAS = 1;
+
+struct Scene02
+{
+	// ボトムレベル（トライアングルジオメトリ）
+	std::vector<std::vector<Vertex>>	meshVertices;
+	std::vector<std::vector<uint16_t>>	meshIndices;
+	std::vector<TriangleBlas>			bottomLevels;
+
+	// トップレベルのインスタンス
+	std::vector<RaytracingInstanceDesc>	instanceDescs;
+	std::vector<float4>					instanceColors;		// マテリアルの色（Sample02 の matColor）
+	TopLevelAS							topLevel;
+
+	BvhBuildStats						topLevelStats;
+
+	// シーンファイルのカメラとライト
+	SceneFileCamera						camera;
+	SceneFileLight						light;
+};
+
+struct Scene02Desc
+{
+	int				longCount = 16;		// Sample02 の kLongCount
+	int				latiCount = 16;		// Sample02 の kLatiCount
+	int				gridCount = 1;		// Sample02 のインスタンス3つを gridCount x gridCount 個並べる
+	BvhBuildDesc	bottomBuild;
+	BvhBuildDesc	topBuild;
+};
+
+// トップレベルASの交差結果
+struct InstanceHit
+{
+	TriangleHit		triangle;
+	uint32_t		instanceIndex;
+};
+
+// Sample02 の InitGeometry と InitAccelerationStructure のシーン（mtxT[3], rootArguments の色）
+bool MakeScene02File(const Scene02Desc& desc, SceneFile& file);
+
+// Sample02 の InitGeometry 相当
+bool InitScene02(Scene02& scene, const Scene02Desc& desc);
+
+// シーンファイルのメッシュとインスタンスから構築する（プロシージャルジオメトリは使えない）
+bool InitScene02(Scene02& scene, const SceneFile& file, const BvhBuildDesc& bottomBuild, const BvhBuildDesc& topBuild);
+
+// 構築済みのシーンをキャッシュファイルに保存する
+// key には元のシーンと構築パラメータのハッシュを渡し、読み込み時に一致しなければ失敗する
+bool SaveScene02Cache(const char* filename, uint64_t key, const Scene02& scene);
+
+// キャッシュファイルから復元する（パースもAS構築もしない）
+bool LoadScene02Cache(const char* filename, uint64_t key, Scene02& scene);
+
+// Sample02 の Render で frame 回目に設定されるシーン定数
+SceneCB MakeScene02CB(int frame, int width, int height);
+
+// シーン全体に対する最近接交差判定
+// pTopStats はトップレベル、pBottomStats はボトムレベルの走査統計
+bool IntersectScene02(const Scene02& scene, const RayDesc& ray, uint32_t rayFlags, uint32_t instanceInclusionMask, InstanceHit& hit, TraversalStats* pTopStats = nullptr, TraversalStats* pBottomStats = nullptr);
+
+// ヒット位置のワールド空間の法線（ClosestHitProcessor と同じく頂点法線を補間する）
+float3 GetScene02Normal(const Scene02& scene, const InstanceHit& hit);
+
+//	EOF
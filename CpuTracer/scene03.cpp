@@ -0,0 +1,290 @@
+﻿#include "scene03.h"
+
+#include <stdio.h>
+
+namespace
+{
+	RaytracingAABB MakeAABB(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+	{
+		RaytracingAABB ret = { minX, minY, minZ, maxX, maxY, maxZ };
+		return ret;
+	}
+
+	SceneFileInstance MakeInstance(uint32_t procedural, uint32_t material, const float4x4& mtxLocalToWorld)
+	{
+		SceneFileInstance ret = {};
+		ret.geometryType = kSceneGeometryProcedural;
+		ret.geometryIndex = procedural;
+		ret.material = material;
+		ret.mask = 1;
+		ret.transform = ToTransform(mtxLocalToWorld);
+		return ret;
+	}
+
+	SceneFileInstance MakeSphereInstance(uint32_t procedural, uint32_t material, const float3& center, float radius)
+	{
+		return MakeInstance(procedural, material, mul(MatrixScaling(radius, radius, radius), MatrixTranslation(center.x, center.y, center.z)));
+	}
+}
+
+void MakeScene03File(SceneFile& file)
+{
+	file = SceneFile();
+
+	// frame 0 のカメラ
+	file.camera.position = float3(0.0f, 2.5f, -5.0f);
+	file.camera.target = float3(0.0f, 2.5f, 0.0f);
+	file.light.direction = float3(1.0f, -1.0f, 1.0f);
+
+	enum { kWhite, kRed, kGreen, kYellow, kCyan };
+	file.materials = {
+		{ "white", float4(0.8f, 0.8f, 0.8f, 1.0f) },
+		{ "red", float4(0.8f, 0.0f, 0.0f, 1.0f) },
+		{ "green", float4(0.0f, 0.8f, 0.0f, 1.0f) },
+		{ "yellow", float4(1.0f, 1.0f, 0.0f, 1.0f) },
+		{ "cyan", float4(0.0f, 1.0f, 1.0f, 1.0f) },
+	};
+
+	// 内箱のAABB
+	file.procedurals.resize(2);
+	{
+		const float kInnerBoxHeight = 5.0f;
+		const float kInnerBoxWidth = 6.0f;
+		const float hw = kInnerBoxWidth * 0.5f;
+
+		auto&& box = file.procedurals[0];
+		box.name = "innerBox";
+		box.type = kSceneProceduralBoxes;
+		box.aabbs.push_back(MakeAABB(-hw, -100.0f, -hw, hw, 0.0f, hw));										// -Y
+		box.aabbs.push_back(MakeAABB(-hw, kInnerBoxHeight, -hw, hw, kInnerBoxHeight + 100.0f, hw));			// +Y
+		box.aabbs.push_back(MakeAABB(-hw - 100.0f, 0.0f, -hw, -hw, kInnerBoxHeight, hw));					// -X
+		box.aabbs.push_back(MakeAABB(hw, 0.0f, -hw, hw + 100.0f, kInnerBoxHeight, hw));						// +X
+		box.aabbs.push_back(MakeAABB(-hw, 0.0f, hw, hw, kInnerBoxHeight, hw + 100.0f));						// +Z
+		box.aabbMaterials = { kWhite, kWhite, kRed, kGreen, kWhite };
+	}
+
+	// 球用のAABB
+	{
+		auto&& sphere = file.procedurals[1];
+		sphere.name = "sphere";
+		sphere.type = kSceneProceduralSphere;
+		sphere.aabbs.push_back(MakeAABB(-1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f));
+	}
+
+	// インスタンス
+	file.instances.push_back(MakeSphereInstance(1, kYellow, float3(1.5f, 1.0f, 0.0f), 1.0f));
+	file.instances.push_back(MakeSphereInstance(1, kCyan, float3(-1.5f, 1.0f, 0.0f), 1.0f));
+	file.instances.push_back(MakeInstance(0, kWhite, MatrixIdentity()));
+}
+
+bool InitScene03(Scene03& scene)
+{
+	SceneFile file;
+	MakeScene03File(file);
+	return InitScene03(scene, file);
+}
+
+bool InitScene03(Scene03& scene, const SceneFile& file, BvhNodeFormat nodeFormat)
+{
+	// 球はすべて単位AABBのボトムレベルASを共有する
+	// 内箱はプリミティブ番号で InnerBoxAABBs を参照するので、1つだけ置ける
+	int innerBox = -1;
+	for (size_t i = 0; i < file.procedurals.size(); i++)
+	{
+		if (file.procedurals[i].type != kSceneProceduralBoxes)
+			continue;
+		if (innerBox >= 0)
+		{
+			printf("Sample03 scene supports only one procedural boxes geometry\n");
+			return false;
+		}
+		innerBox = (int)i;
+	}
+
+	scene.bottomAABBs[kScene03PropBottomAS].assign(1, MakeAABB(-1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f));
+	scene.bottomAABBs[kScene03InnerBoxBottomAS].clear();
+	scene.innerBoxAABBs.clear();
+	if (innerBox >= 0)
+	{
+		auto&& box = file.procedurals[innerBox];
+		scene.bottomAABBs[kScene03InnerBoxBottomAS] = box.aabbs;
+		scene.innerBoxAABBs.resize(box.aabbs.size());
+		for (size_t i = 0; i < box.aabbs.size(); i++)
+		{
+			auto&& aabb = box.aabbs[i];
+			scene.innerBoxAABBs[i].aabbMin = float3(aabb.MinX, aabb.MinY, aabb.MinZ);
+			scene.innerBoxAABBs[i].aabbMax = float3(aabb.MaxX, aabb.MaxY, aabb.MaxZ);
+			scene.innerBoxAABBs[i].color = file.materials[box.aabbMaterials[i]].color;
+		}
+	}
+
+	scene.camera = file.camera;
+	scene.light = file.light;
+
+	// インスタンス
+	// Instances バッファはインスタンス番号で参照するので、内箱のインスタンスの分も並べておく
+	scene.instances.resize(file.instances.size());
+	scene.instanceDescs.resize(file.instances.size());
+	for (size_t i = 0; i < file.instances.size(); i++)
+	{
+		auto&& src = file.instances[i];
+		if (src.geometryType != kSceneGeometryProcedural)
+		{
+			printf("Sample03 scene has no hit group for triangle meshes\n");
+			return false;
+		}
+		bool isBox = file.procedurals[src.geometryIndex].type == kSceneProceduralBoxes;
+
+		auto&& inst = scene.instances[i];
+		inst.mtxLocalToWorld = ToMatrix(src.transform);
+		inst.mtxWorldToLocal = MatrixInverse(inst.mtxLocalToWorld);
+		inst.color = file.materials[src.material].color;
+
+		RaytracingInstanceDesc desc{};
+		desc.Transform = src.transform;
+		desc.InstanceID = src.instanceID;
+		desc.InstanceContributionToHitGroupIndex = isBox ? kInnerBoxHitGroup : kSphereHitGroup;
+		desc.InstanceMask = src.mask;
+		desc.AccelerationStructure = isBox ? kScene03InnerBoxBottomAS : kScene03PropBottomAS;
+		scene.instanceDescs[i] = desc;
+	}
+
+	// ASを構築する
+	// リーフのAABBはまとめて判定できるので、ボトムレベルのリーフは判定幅まで詰め込む
+	BvhBuildDesc bottomDesc;
+	bottomDesc.maxLeafSize = kAABBBatchSize;
+	bottomDesc.nodeFormat = nodeFormat;
+	BoundingBox bottomBounds[2];
+	for (int i = 0; i < 2; i++)
+	{
+		auto&& aabbs = scene.bottomAABBs[i];
+		if (aabbs.empty())
+			continue;
+		if (!scene.bottomLevels[i].Build(aabbs.data(), (uint32_t)aabbs.size(), bottomDesc))
+			return false;
+		bottomBounds[i] = scene.bottomLevels[i].GetBvh().GetBounds();
+	}
+
+	scene.topBuild = BvhBuildDesc();
+	scene.topBuild.nodeFormat = nodeFormat;
+	return scene.topLevel.Build(scene.instanceDescs.data(), (uint32_t)scene.instanceDescs.size(), bottomBounds, 2, scene.topBuild);
+}
+
+bool SaveScene03Cache(const char* filename, uint64_t key, const Scene03& scene)
+{
+	AccelCacheWriter writer(key);
+	writer.WriteValue(scene.camera);
+	writer.WriteValue(scene.light);
+
+	// AABBがないボトムレベルASは構築していないので保存しない
+	for (int i = 0; i < 2; i++)
+	{
+		writer.WriteArray(scene.bottomAABBs[i]);
+		if (!scene.bottomAABBs[i].empty())
+			scene.bottomLevels[i].Save(writer);
+	}
+
+	writer.WriteArray(scene.instanceDescs);
+	scene.topLevel.Save(writer);
+	writer.WriteArray(scene.instances);
+	writer.WriteArray(scene.innerBoxAABBs);
+	return writer.Save(filename);
+}
+
+bool LoadScene03Cache(const char* filename, uint64_t key, Scene03& scene)
+{
+	AccelCacheReader reader;
+	if (!reader.Open(filename, key))
+		return false;
+	if (!reader.ReadValue(scene.camera) || !reader.ReadValue(scene.light))
+		return false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!reader.ReadArray(scene.bottomAABBs[i]))
+			return false;
+		if (!scene.bottomAABBs[i].empty() && !scene.bottomLevels[i].Load(reader))
+			return false;
+	}
+
+	// シェーダは primitiveIndex と instanceIndex でバッファを参照するので、数が合っているか確認する
+	if (!reader.ReadArray(scene.instanceDescs) || !scene.topLevel.Load(reader, 2)
+		|| !reader.ReadArray(scene.instances) || !reader.ReadArray(scene.innerBoxAABBs))
+		return false;
+	scene.topBuild = BvhBuildDesc();
+	scene.topBuild.nodeFormat = scene.topLevel.GetBvh().GetNodeFormat();
+	return reader.IsEnd()
+		&& scene.instances.size() == scene.instanceDescs.size()
+		&& scene.topLevel.GetInstanceCount() == scene.instanceDescs.size()
+		&& scene.innerBoxAABBs.size() == scene.bottomAABBs[kScene03InnerBoxBottomAS].size();
+}
+
+bool UpdateScene03Transforms(Scene03& scene, const std::vector<float3x4>& transforms, bool rebuild)
+{
+	if (transforms.size() != scene.instanceDescs.size())
+		return false;
+
+	for (size_t i = 0; i < transforms.size(); i++)
+	{
+		auto&& inst = scene.instances[i];
+		scene.instanceDescs[i].Transform = transforms[i];
+		inst.mtxLocalToWorld = ToMatrix(transforms[i]);
+		inst.mtxWorldToLocal = MatrixInverse(inst.mtxLocalToWorld);
+	}
+
+	BoundingBox bottomBounds[2];
+	for (int i = 0; i < 2; i++)
+	{
+		if (!scene.bottomAABBs[i].empty())
+			bottomBounds[i] = scene.bottomLevels[i].GetBvh().GetBounds();
+	}
+
+	auto&& descs = scene.instanceDescs;
+	if (!rebuild && scene.topLevel.Update(descs.data(), (uint32_t)descs.size(), bottomBounds, 2))
+		return true;
+	return scene.topLevel.Build(descs.data(), (uint32_t)descs.size(), bottomBounds, 2, scene.topBuild);
+}
+
+void AnimateScene03(const Scene03& scene, const std::vector<float3x4>& baseTransforms, int frame, std::vector<float3x4>& transforms)
+{
+	// 球ごとに速さを変えて上下に弾ませる（frame 0 では元の位置）
+	const float kBounceSpeed[2] = { 2.0f, 3.0f };
+	const float kBounceHeight = 1.5f;
+
+	transforms = baseTransforms;
+	uint32_t sphereIndex = 0;
+	for (size_t i = 0; i < transforms.size(); i++)
+	{
+		if (scene.instanceDescs[i].AccelerationStructure != kScene03PropBottomAS)
+			continue;
+		float angle = ConvertToRadians(kBounceSpeed[sphereIndex++ % 2] * (float)frame);
+		transforms[i].m[1][3] += fabsf(sinf(angle)) * kBounceHeight;
+	}
+}
+
+SceneCB MakeScene03CB(int frame, int width, int height)
+{
+	// LetsRaytracing では毎フレーム sYAngle が1度ずつ増える
+	float yAngle = (float)frame;
+
+	float4 camPos = { 0.0f, 2.5f, -5.0f, 1.0f };
+	auto mtxYRot = MatrixRotationY(sinf(ConvertToRadians(yAngle)) * kPI * 0.1f);
+	camPos = mul(camPos, mtxYRot);
+
+	// 行列はシーンファイルのカメラと同じ関数で作り、scenes/sample03.scene と同じ結果になるようにする
+	// （定数のまま計算すると tanf などがコンパイル時に畳み込まれて、実行時の計算と値がずれることがある）
+	SceneFileCamera camera;
+	camera.position = camPos.xyz();
+	camera.target = float3(0.0f, 2.5f, 0.0f);
+	camera.up = float3(0.0f, 1.0f, 0.0f);
+	camera.fovY = 60.0f;
+	camera.nearZ = 0.01f;
+	camera.farZ = 100.0f;
+
+	SceneFileLight light;
+	light.direction = float3(1.0f, -1.0f, 1.0f);
+	light.color = float3(1.0f, 1.0f, 1.0f);
+	return MakeSceneFileCB(camera, light, width, height);
+}
+
+//	EOF
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "blas.h"
+#include "tlas.h"
+#include "scene_cb.h"
+#include "scene_file.h"
+
+#include <vector>
+
+// Sample03 のシーン（球インスタンス2つ + 内箱AABB5つ）
+
+struct AABBInfo
+{
+	float3		aabbMin, aabbMax;
+	float4		color;
+};
+
+struct PrimitiveInstance
+{
+	float4x4	mtxLocalToWorld;
+	float4x4	mtxWorldToLocal;
+	float4		color;
+};
+
+struct Scene03
+{
+	// ボトムレベル（プロシージャルAABBジオメトリ）
+	// [0] = 内箱, [1] = 球用の単位AABB
+	std::vector<RaytracingAABB>			bottomAABBs[2];
+	ProceduralBlas						bottomLevels[2];
+
+	// トップレベルのインスタンス
+	std::vector<RaytracingInstanceDesc>	instanceDescs;
+	TopLevelAS							topLevel;
+	BvhBuildDesc						topBuild;		// 更新できない場合に構築し直すためのパラメータ
+
+	// シェーダから参照するバッファ
+	std::vector<PrimitiveInstance>		instances;		// Instances
+	std::vector<AABBInfo>				innerBoxAABBs;	// InnerBoxAABBs
+
+	// シーンファイルのカメラとライト
+	SceneFileCamera						camera;
+	SceneFileLight						light;
+};
+
+static const int kScene03InnerBoxBottomAS = 0;
+static const int kScene03PropBottomAS = 1;
+
+// シェーダテーブルのヒットグループ番号
+static const uint32_t kSphereHitGroup = 0;
+static const uint32_t kSphereShadowHitGroup = 1;
+static const uint32_t kInnerBoxHitGroup = 2;
+static const uint32_t kInnerBoxShadowHitGroup = 3;
+
+// Sample03 の InitAABBs と InitAccelerationStructure のシーン（spheres[], aabbs[]）
+void MakeScene03File(SceneFile& file);
+
+// Sample03 の InitAABBs と InitAccelerationStructure 相当
+bool InitScene03(Scene03& scene);
+
+// シーンファイルから構築する
+// 球は procedural sphere、内箱は procedural boxes（1つまで）で記述し、メッシュは使えない
+// nodeFormat はボトムレベルとトップレベルのBVHのノード形式
+bool InitScene03(Scene03& scene, const SceneFile& file, BvhNodeFormat nodeFormat = kBvhNodeFull);
+
+// 構築済みのシーンをキャッシュファイルに保存する
+// key には元のシーンと構築パラメータのハッシュを渡し、読み込み時に一致しなければ失敗する
+bool SaveScene03Cache(const char* filename, uint64_t key, const Scene03& scene);
+
+// キャッシュファイルから復元する（パースもAS構築もしない）
+bool LoadScene03Cache(const char* filename, uint64_t key, Scene03& scene);
+
+// インスタンスの変換行列を transforms に差し替えてトップレベルASを更新する
+// rebuild が false ならBVHの構造はそのままでボックスだけを更新し、更新できないBVHなら構築し直す
+bool UpdateScene03Transforms(Scene03& scene, const std::vector<float3x4>& transforms, bool rebuild);
+
+// Sample03 の UpdateTopLevelAS で frame 回目に動かした球の変換行列を求める（内箱はそのまま）
+// baseTransforms は frame 0 の変換行列
+void AnimateScene03(const Scene03& scene, const std::vector<float3x4>& baseTransforms, int frame, std::vector<float3x4>& transforms);
+
+// Sample03 の LetsRaytracing で frame 回目に設定されるシーン定数
+SceneCB MakeScene03CB(int frame, int width, int height);
+
+//	EOF
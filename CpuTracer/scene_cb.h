@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include "raytracing.h"
+#include "random.h"
+
+// Sample02, Sample03 共通のシーン定数バッファ（cbScene）
+
+struct SceneCB
+{
+	float4x4	mtxProjToWorld;
+	float4		camPos;
+	float4		lightDir;
+	float4		lightColor;
+
+	// プログレッシブレンダリング（すべて0なら画素中心の1サンプルとハードシャドウ）
+	uint32_t	frameIndex = 0;			// 乱数の系列
+	uint32_t	sampleCount = 0;		// このフレームを含めて累積したサンプル数（0なら累積しない）
+	float		lightRadius = 0.0f;		// 平行光源の見かけの半径（ラジアン）、0ならハードシャドウ
+	float		padding = 0.0f;
+};
+
+// 累積する場合はピクセル内の位置をフレームごとにずらす
+inline float2 GetPixelJitter(const SceneCB& cb, uint32_t x, uint32_t y)
+{
+	if (cb.sampleCount == 0)
+		return { 0.5f, 0.5f };
+	return { HashToFloat(PixelSeed(x, y, cb.frameIndex, 0)), HashToFloat(PixelSeed(x, y, cb.frameIndex, 1)) };
+}
+
+// RayGenerator と同じ方法で、スクリーン上の (px, py) を通るカメラからのレイを生成する
+// px, py はピクセル単位の座標（ピクセル中心なら +0.5）
+inline RayDesc MakeCameraRay(const SceneCB& cb, float px, float py, uint32_t width, uint32_t height)
+{
+	// スクリーン座標をクリップ空間座標に変換
+	float clipX = px / (float)width * 2.0f - 1.0f;
+	float clipY = py / (float)height * -2.0f + 1.0f;
+
+	// クリップ空間座標をワールド空間座標に変換
+	float4 worldPos = mul(float4(clipX, clipY, 0, 1), cb.mtxProjToWorld);
+
+	// ワールド空間座標とカメラ位置からレイを生成
+	float3 origin = cb.camPos.xyz();
+	float3 direction = normalize(worldPos.xyz() / worldPos.w - origin);
+
+	RayDesc ray = { origin, 0.0f, direction, 10000.0f };
+	return ray;
+}
+
+//	EOF
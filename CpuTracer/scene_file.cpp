@@ -0,0 +1,684 @@
+﻿#include "scene_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace
+{
+	static const char kBinaryMagic[4] = { 'S', 'C', 'N', 'B' };
+	static const uint32_t kMaxNameLength = 256;
+
+	static_assert(sizeof(SceneFileInstance) == 72, "SceneFileInstance is stored as is in binary files");
+	static_assert(sizeof(Vertex) == 24, "Vertex is stored as is in binary files");
+
+	bool ReadWholeFile(const char* filename, std::vector<char>& data)
+	{
+		FILE* fp = fopen(filename, "rb");
+		if (!fp)
+		{
+			printf("failed to open %s\n", filename);
+			return false;
+		}
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		data.resize(size > 0 ? (size_t)size + 1 : 1);
+		bool ok = size >= 0 && fread(data.data(), 1, (size_t)size, fp) == (size_t)size;
+		fclose(fp);
+		if (!ok)
+		{
+			printf("failed to read %s\n", filename);
+			return false;
+		}
+		data[data.size() - 1] = '\0';
+		return true;
+	}
+
+	// テキスト形式の1行分のトークン
+	class TextLine
+	{
+	public:
+		TextLine(const char* filename)
+			: filename_(filename)
+		{}
+
+		// line を空白で分割する（line は書き換える）
+		void Set(char* line, int lineNumber)
+		{
+			lineNumber_ = lineNumber;
+			tokens_.clear();
+			pos_ = 0;
+
+			char* comment = strchr(line, '#');
+			if (comment) *comment = '\0';
+			for (char* p = line; *p; )
+			{
+				while (*p == ' ' || *p == '\t' || *p == '\r') *p++ = '\0';
+				if (!*p) break;
+				tokens_.push_back(p);
+				while (*p && *p != ' ' && *p != '\t' && *p != '\r') p++;
+			}
+		}
+
+		bool IsEmpty() const { return tokens_.empty(); }
+		bool IsEnd() const { return pos_ >= tokens_.size(); }
+
+		bool Error(const char* message) const
+		{
+			printf("%s(%d): %s\n", filename_, lineNumber_, message);
+			return false;
+		}
+
+		bool Word(const char*& value)
+		{
+			if (IsEnd())
+				return Error("missing argument");
+			value = tokens_[pos_++];
+			return true;
+		}
+
+		bool Float(float& value)
+		{
+			const char* word;
+			if (!Word(word))
+				return false;
+			char* end;
+			value = strtof(word, &end);
+			if (*end != '\0')
+				return Error("invalid number");
+			return true;
+		}
+
+		bool Float3(float3& value)
+		{
+			return Float(value.x) && Float(value.y) && Float(value.z);
+		}
+
+		bool Uint(uint32_t& value)
+		{
+			const char* word;
+			if (!Word(word))
+				return false;
+			char* end;
+			unsigned long v = strtoul(word, &end, 0);
+			if (*end != '\0' || word[0] == '-')
+				return Error("invalid integer");
+			value = (uint32_t)v;
+			return true;
+		}
+
+		// 余分な引数がないことを確認する
+		bool Finish() const
+		{
+			return IsEnd() ? true : Error("too many arguments");
+		}
+
+	private:
+		const char*			filename_;
+		int					lineNumber_ = 0;
+		std::vector<char*>	tokens_;
+		size_t				pos_ = 0;
+	};	// class TextLine
+
+	struct GeometryRef
+	{
+		SceneFileGeometryType	type;
+		uint32_t				index;
+	};
+
+	// バイナリ形式の読み書き
+	class BinaryWriter
+	{
+	public:
+		explicit BinaryWriter(FILE* fp)
+			: fp_(fp)
+		{}
+
+		void Write(const void* data, size_t size)
+		{
+			if (ok_ && size > 0)
+				ok_ = fwrite(data, 1, size, fp_) == size;
+		}
+		void WriteUint(uint32_t value)
+		{
+			Write(&value, sizeof(value));
+		}
+		void WriteString(const std::string& value)
+		{
+			WriteUint((uint32_t)value.size());
+			Write(value.data(), value.size());
+		}
+		template <typename T>
+		void WriteArray(const std::vector<T>& values)
+		{
+			WriteUint((uint32_t)values.size());
+			Write(values.data(), values.size() * sizeof(T));
+		}
+
+		bool IsOk() const { return ok_; }
+
+	private:
+		FILE*	fp_;
+		bool	ok_ = true;
+	};	// class BinaryWriter
+
+	class BinaryReader
+	{
+	public:
+		BinaryReader(const std::vector<char>& data)
+			: data_(data)
+		{}
+
+		bool Read(void* dst, size_t size)
+		{
+			if (!ok_ || size > data_.size() - pos_)
+			{
+				ok_ = false;
+				return false;
+			}
+			memcpy(dst, data_.data() + pos_, size);
+			pos_ += size;
+			return true;
+		}
+		bool ReadUint(uint32_t& value)
+		{
+			return Read(&value, sizeof(value));
+		}
+		bool ReadString(std::string& value)
+		{
+			uint32_t length;
+			if (!ReadUint(length) || length > kMaxNameLength)
+				return ok_ = false;
+			value.resize(length);
+			return Read(&value[0], length);
+		}
+		template <typename T>
+		bool ReadArray(std::vector<T>& values)
+		{
+			uint32_t count;
+			if (!ReadUint(count) || (size_t)count * sizeof(T) > data_.size() - pos_)
+				return ok_ = false;
+			values.resize(count);
+			return Read(values.data(), (size_t)count * sizeof(T));
+		}
+
+	private:
+		const std::vector<char>&	data_;
+		size_t						pos_ = 0;
+		bool						ok_ = true;
+	};	// class BinaryReader
+}
+
+bool LoadSceneFile(const char* filename, SceneFile& scene)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (!fp)
+	{
+		printf("failed to open %s\n", filename);
+		return false;
+	}
+	char magic[4] = {};
+	size_t readSize = fread(magic, 1, sizeof(magic), fp);
+	fclose(fp);
+
+	if (readSize == 0)
+	{
+		printf("%s is empty\n", filename);
+		return false;
+	}
+	if (readSize == sizeof(magic) && memcmp(magic, kBinaryMagic, sizeof(magic)) == 0)
+		return LoadSceneFileBinary(filename, scene);
+	return LoadSceneFileText(filename, scene);
+}
+
+bool LoadSceneFileText(const char* filename, SceneFile& scene)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(filename, data))
+		return false;
+
+	scene = SceneFile();
+	std::unordered_map<std::string, uint32_t> materialMap;
+	std::unordered_map<std::string, GeometryRef> geometryMap;
+
+	auto AddGeometry = [&](TextLine& line, const char* name, SceneFileGeometryType type, uint32_t index)
+	{
+		if (!geometryMap.insert(std::make_pair(std::string(name), GeometryRef{ type, index })).second)
+			return line.Error("duplicate geometry name");
+		return true;
+	};
+	auto FindMaterial = [&](TextLine& line, uint32_t& index)
+	{
+		const char* name;
+		if (!line.Word(name))
+			return false;
+		auto it = materialMap.find(name);
+		if (it == materialMap.end())
+			return line.Error("unknown material");
+		index = it->second;
+		return true;
+	};
+
+	// mesh, procedural boxes の end までの間
+	SceneFileMesh* pMesh = nullptr;
+	SceneFileProcedural* pBoxes = nullptr;
+
+	TextLine line(filename);
+	int lineNumber = 0;
+	for (char* p = data.data(); *p; )
+	{
+		char* next = strchr(p, '\n');
+		if (next) *next++ = '\0';
+		else next = p + strlen(p);
+
+		line.Set(p, ++lineNumber);
+		p = next;
+		if (line.IsEmpty())
+			continue;
+
+		const char* cmd = "";
+		line.Word(cmd);
+
+		if (pMesh)
+		{
+			if (strcmp(cmd, "v") == 0)
+			{
+				Vertex v;
+				if (!line.Float3(v.pos) || !line.Float3(v.normal))
+					return false;
+				pMesh->vertices.push_back(v);
+			}
+			else if (strcmp(cmd, "f") == 0)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					uint32_t index;
+					if (!line.Uint(index))
+						return false;
+					if (index > 0xffff)
+						return line.Error("index exceeds 16bit range");
+					pMesh->indices.push_back((uint16_t)index);
+				}
+			}
+			else if (strcmp(cmd, "end") == 0)
+			{
+				pMesh = nullptr;
+			}
+			else
+			{
+				return line.Error("expected v, f or end");
+			}
+		}
+		else if (pBoxes)
+		{
+			if (strcmp(cmd, "aabb") == 0)
+			{
+				float3 bmin, bmax;
+				uint32_t material;
+				if (!line.Float3(bmin) || !line.Float3(bmax) || !FindMaterial(line, material))
+					return false;
+				RaytracingAABB aabb = { bmin.x, bmin.y, bmin.z, bmax.x, bmax.y, bmax.z };
+				pBoxes->aabbs.push_back(aabb);
+				pBoxes->aabbMaterials.push_back(material);
+			}
+			else if (strcmp(cmd, "end") == 0)
+			{
+				pBoxes = nullptr;
+			}
+			else
+			{
+				return line.Error("expected aabb or end");
+			}
+		}
+		else if (strcmp(cmd, "camera") == 0)
+		{
+			auto&& cam = scene.camera;
+			if (!line.Float3(cam.position) || !line.Float3(cam.target) || !line.Float3(cam.up)
+				|| !line.Float(cam.fovY) || !line.Float(cam.nearZ) || !line.Float(cam.farZ))
+				return false;
+		}
+		else if (strcmp(cmd, "light") == 0)
+		{
+			if (!line.Float3(scene.light.direction) || !line.Float3(scene.light.color))
+				return false;
+		}
+		else if (strcmp(cmd, "material") == 0)
+		{
+			SceneFileMaterial mat;
+			const char* name;
+			if (!line.Word(name) || !line.Float(mat.color.x) || !line.Float(mat.color.y) || !line.Float(mat.color.z) || !line.Float(mat.color.w))
+				return false;
+			mat.name = name;
+			if (!materialMap.insert(std::make_pair(mat.name, (uint32_t)scene.materials.size())).second)
+				return line.Error("duplicate material name");
+			scene.materials.push_back(mat);
+		}
+		else if (strcmp(cmd, "mesh") == 0)
+		{
+			const char* name;
+			if (!line.Word(name) || !AddGeometry(line, name, kSceneGeometryMesh, (uint32_t)scene.meshes.size()))
+				return false;
+			scene.meshes.push_back(SceneFileMesh());
+			auto&& mesh = scene.meshes.back();
+			mesh.name = name;
+
+			const char* shape = nullptr;
+			if (line.IsEnd())
+			{
+				pMesh = &mesh;
+			}
+			else if (line.Word(shape) && strcmp(shape, "box") == 0)
+			{
+				int vcount, icount;
+				GetBoxVertexAndIndexCount(vcount, icount);
+				mesh.vertices.resize(vcount);
+				mesh.indices.resize(icount);
+				CreateBoxVertexAndIndex(mesh.vertices.data(), mesh.indices.data());
+			}
+			else if (shape && strcmp(shape, "sphere") == 0)
+			{
+				uint32_t longCount, latiCount;
+				if (!line.Uint(longCount) || !line.Uint(latiCount))
+					return false;
+				if (longCount < 4 || latiCount < 2)
+					return line.Error("sphere needs at least 4 x 2 divisions");
+				// int に変換して頂点数を求める前に、16bitインデックスに収まるか確かめる
+				if (longCount > 0x10000 || latiCount > 0x10000 || (uint64_t)longCount * (latiCount - 1) + 2 > 0x10000)
+					return line.Error("sphere vertices exceed 16bit index range");
+				int vcount, icount;
+				GetShpereVertexAndIndexCount((int)longCount, (int)latiCount, vcount, icount);
+				mesh.vertices.resize(vcount);
+				mesh.indices.resize(icount);
+				CreateSphereVertexAndIndex((int)longCount, (int)latiCount, mesh.vertices.data(), mesh.indices.data());
+			}
+			else
+			{
+				return line.Error("unknown mesh shape");
+			}
+		}
+		else if (strcmp(cmd, "procedural") == 0)
+		{
+			const char* name;
+			const char* type;
+			if (!line.Word(name) || !line.Word(type) || !AddGeometry(line, name, kSceneGeometryProcedural, (uint32_t)scene.procedurals.size()))
+				return false;
+			scene.procedurals.push_back(SceneFileProcedural());
+			auto&& proc = scene.procedurals.back();
+			proc.name = name;
+			if (strcmp(type, "sphere") == 0)
+			{
+				RaytracingAABB aabb = { -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+				proc.type = kSceneProceduralSphere;
+				proc.aabbs.push_back(aabb);
+			}
+			else if (strcmp(type, "boxes") == 0)
+			{
+				proc.type = kSceneProceduralBoxes;
+				pBoxes = &proc;
+			}
+			else
+			{
+				return line.Error("unknown procedural type");
+			}
+		}
+		else if (strcmp(cmd, "instance") == 0)
+		{
+			const char* name;
+			if (!line.Word(name))
+				return false;
+			auto it = geometryMap.find(name);
+			if (it == geometryMap.end())
+				return line.Error("unknown geometry");
+
+			SceneFileInstance inst = {};
+			inst.geometryType = it->second.type;
+			inst.geometryIndex = it->second.index;
+			inst.mask = 1;
+			if (!FindMaterial(line, inst.material))
+				return false;
+
+			float4x4 mtx = MatrixIdentity();
+			while (!line.IsEnd())
+			{
+				const char* key = "";
+				line.Word(key);
+				if (strcmp(key, "contribution") == 0)
+				{
+					if (!line.Uint(inst.contribution))
+						return false;
+				}
+				else if (strcmp(key, "mask") == 0)
+				{
+					if (!line.Uint(inst.mask))
+						return false;
+				}
+				else if (strcmp(key, "id") == 0)
+				{
+					if (!line.Uint(inst.instanceID))
+						return false;
+				}
+				else if (strcmp(key, "scale") == 0)
+				{
+					float3 s;
+					if (!line.Float3(s))
+						return false;
+					mtx = mul(mtx, MatrixScaling(s.x, s.y, s.z));
+				}
+				else if (strcmp(key, "rotate") == 0)
+				{
+					const char* axis;
+					float angle;
+					if (!line.Word(axis) || !line.Float(angle))
+						return false;
+					float rad = ConvertToRadians(angle);
+					if (strcmp(axis, "x") == 0) mtx = mul(mtx, MatrixRotationX(rad));
+					else if (strcmp(axis, "y") == 0) mtx = mul(mtx, MatrixRotationY(rad));
+					else if (strcmp(axis, "z") == 0) mtx = mul(mtx, MatrixRotationZ(rad));
+					else return line.Error("rotation axis must be x, y or z");
+				}
+				else if (strcmp(key, "translate") == 0)
+				{
+					float3 t;
+					if (!line.Float3(t))
+						return false;
+					mtx = mul(mtx, MatrixTranslation(t.x, t.y, t.z));
+				}
+				else
+				{
+					return line.Error("unknown instance parameter");
+				}
+			}
+			inst.transform = ToTransform(mtx);
+			scene.instances.push_back(inst);
+		}
+		else
+		{
+			return line.Error("unknown command");
+		}
+
+		if (!line.Finish())
+			return false;
+	}
+
+	if (pMesh || pBoxes)
+	{
+		printf("%s: missing end\n", filename);
+		return false;
+	}
+
+	return ValidateSceneFile(scene);
+}
+
+bool LoadSceneFileBinary(const char* filename, SceneFile& scene)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(filename, data))
+		return false;
+
+	scene = SceneFile();
+	BinaryReader reader(data);
+	char magic[4];
+	uint32_t version;
+	if (!reader.Read(magic, sizeof(magic)) || memcmp(magic, kBinaryMagic, sizeof(magic)) != 0
+		|| !reader.ReadUint(version) || version != kSceneFileVersion)
+	{
+		printf("%s: unsupported scene file\n", filename);
+		return false;
+	}
+
+	bool ok = reader.Read(&scene.camera, sizeof(scene.camera))
+		&& reader.Read(&scene.light, sizeof(scene.light));
+
+	uint32_t count = 0;
+	ok = ok && reader.ReadUint(count);
+	for (uint32_t i = 0; ok && i < count; i++)
+	{
+		SceneFileMaterial mat;
+		ok = reader.ReadString(mat.name) && reader.Read(&mat.color, sizeof(mat.color));
+		scene.materials.push_back(mat);
+	}
+
+	ok = ok && reader.ReadUint(count);
+	for (uint32_t i = 0; ok && i < count; i++)
+	{
+		scene.meshes.push_back(SceneFileMesh());
+		auto&& mesh = scene.meshes.back();
+		ok = reader.ReadString(mesh.name) && reader.ReadArray(mesh.vertices) && reader.ReadArray(mesh.indices);
+	}
+
+	ok = ok && reader.ReadUint(count);
+	for (uint32_t i = 0; ok && i < count; i++)
+	{
+		scene.procedurals.push_back(SceneFileProcedural());
+		auto&& proc = scene.procedurals.back();
+		uint32_t type = 0;
+		ok = reader.ReadString(proc.name) && reader.ReadUint(type) && reader.ReadArray(proc.aabbs) && reader.ReadArray(proc.aabbMaterials);
+		proc.type = (SceneFileProceduralType)type;
+	}
+
+	ok = ok && reader.ReadArray(scene.instances);
+	if (!ok)
+	{
+		printf("%s: unexpected end of file\n", filename);
+		return false;
+	}
+
+	return ValidateSceneFile(scene);
+}
+
+bool SaveSceneFileBinary(const char* filename, const SceneFile& scene)
+{
+	FILE* fp = fopen(filename, "wb");
+	if (!fp)
+	{
+		printf("failed to open %s\n", filename);
+		return false;
+	}
+
+	BinaryWriter writer(fp);
+	writer.Write(kBinaryMagic, sizeof(kBinaryMagic));
+	writer.WriteUint(kSceneFileVersion);
+	writer.Write(&scene.camera, sizeof(scene.camera));
+	writer.Write(&scene.light, sizeof(scene.light));
+
+	writer.WriteUint((uint32_t)scene.materials.size());
+	for (auto&& mat : scene.materials)
+	{
+		writer.WriteString(mat.name);
+		writer.Write(&mat.color, sizeof(mat.color));
+	}
+
+	writer.WriteUint((uint32_t)scene.meshes.size());
+	for (auto&& mesh : scene.meshes)
+	{
+		writer.WriteString(mesh.name);
+		writer.WriteArray(mesh.vertices);
+		writer.WriteArray(mesh.indices);
+	}
+
+	writer.WriteUint((uint32_t)scene.procedurals.size());
+	for (auto&& proc : scene.procedurals)
+	{
+		writer.WriteString(proc.name);
+		writer.WriteUint(proc.type);
+		writer.WriteArray(proc.aabbs);
+		writer.WriteArray(proc.aabbMaterials);
+	}
+
+	writer.WriteArray(scene.instances);
+
+	bool ok = writer.IsOk();
+	if (fclose(fp) != 0) ok = false;
+	if (!ok)
+		printf("failed to write %s\n", filename);
+	return ok;
+}
+
+bool ValidateSceneFile(const SceneFile& scene)
+{
+	const uint32_t materialCount = (uint32_t)scene.materials.size();
+	for (auto&& mesh : scene.meshes)
+	{
+		if (mesh.vertices.size() > 0x10000 || mesh.indices.empty() || mesh.indices.size() % 3 != 0)
+		{
+			printf("mesh %s: invalid vertex or index count\n", mesh.name.c_str());
+			return false;
+		}
+		for (auto index : mesh.indices)
+		{
+			if (index >= mesh.vertices.size())
+			{
+				printf("mesh %s: index out of range\n", mesh.name.c_str());
+				return false;
+			}
+		}
+	}
+	for (auto&& proc : scene.procedurals)
+	{
+		bool isValidType = proc.type == kSceneProceduralSphere || proc.type == kSceneProceduralBoxes;
+		bool hasMaterials = proc.type != kSceneProceduralBoxes || proc.aabbMaterials.size() == proc.aabbs.size();
+		if (!isValidType || proc.aabbs.empty() || !hasMaterials)
+		{
+			printf("procedural %s: invalid geometry\n", proc.name.c_str());
+			return false;
+		}
+		for (auto material : proc.aabbMaterials)
+		{
+			if (material >= materialCount)
+			{
+				printf("procedural %s: material out of range\n", proc.name.c_str());
+				return false;
+			}
+		}
+	}
+	for (size_t i = 0; i < scene.instances.size(); i++)
+	{
+		auto&& inst = scene.instances[i];
+		size_t geometryCount = (inst.geometryType == kSceneGeometryMesh) ? scene.meshes.size()
+			: (inst.geometryType == kSceneGeometryProcedural) ? scene.procedurals.size() : 0;
+		if (inst.geometryIndex >= geometryCount || inst.material >= materialCount)
+		{
+			printf("instance %u: geometry or material out of range\n", (uint32_t)i);
+			return false;
+		}
+	}
+	return true;
+}
+
+SceneCB MakeSceneFileCB(const SceneFileCamera& cam, const SceneFileLight& light, int width, int height)
+{
+	auto mtxWorldToView = MatrixLookAtLH(cam.position, cam.target, cam.up);
+	auto mtxViewToClip = MatrixPerspectiveFovLH(ConvertToRadians(cam.fovY), (float)width / (float)height, cam.nearZ, cam.farZ);
+	auto mtxWorldToClip = mul(mtxWorldToView, mtxViewToClip);
+
+	SceneCB cb;
+	cb.mtxProjToWorld = MatrixInverse(mtxWorldToClip);
+	cb.camPos = float4(cam.position, 1.0f);
+	cb.lightDir = float4(normalize(light.direction), 0.0f);
+	cb.lightColor = float4(light.color, 1.0f);
+	return cb;
+}
+
+//	EOF
@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include "raytracing.h"
+#include "shapes.h"
+#include "scene_cb.h"
+
+#include <string>
+#include <vector>
+
+// シーン記述ファイル
+// テキスト形式とバイナリ形式があり、LoadSceneFile は先頭のマジックで判別する
+//
+// テキスト形式（1行1命令、# 以降はコメント、角度は度）
+//   camera <pos x y z> <target x y z> <up x y z> <fovY> <near> <far>
+//   light <dir x y z> <color r g b>
+//   material <name> <r g b a>
+//   mesh <name> box
+//   mesh <name> sphere <long> <lati>
+//   mesh <name>                        ... end まで v, f 行で頂点とインデックスを並べる
+//     v <pos x y z> <normal x y z>
+//     f <i0 i1 i2>
+//   end
+//   procedural <name> sphere           ... 単位球（AABB は [-1, 1]）
+//   procedural <name> boxes            ... end まで aabb 行で箱を並べる
+//     aabb <min x y z> <max x y z> <material>
+//   end
+//   instance <geometry> <material> [contribution <n>] [mask <n>] [id <n>]
+//            [scale <x y z>] [rotate <x|y|z> <angle>] [translate <x y z>]
+//
+// instance の変換は書いた順に右から掛ける（mtxT = scale * rotate * translate の順なら書いた通り）
+
+static const uint32_t kSceneFileVersion = 1;
+
+struct SceneFileCamera
+{
+	float3		position = float3(0.0f, 0.0f, -5.0f);
+	float3		target = float3(0.0f, 0.0f, 0.0f);
+	float3		up = float3(0.0f, 1.0f, 0.0f);
+	float		fovY = 60.0f;			// 度
+	float		nearZ = 0.01f;
+	float		farZ = 100.0f;
+};
+
+struct SceneFileLight
+{
+	float3		direction = float3(1.0f, -1.0f, 1.0f);		// 光の進む向き（cbScene の lightDir）
+	float3		color = float3(1.0f, 1.0f, 1.0f);
+};
+
+struct SceneFileMaterial
+{
+	std::string	name;
+	float4		color;
+};
+
+// トライアングルジオメトリ（box, sphere も読み込み時に頂点とインデックスに展開する）
+struct SceneFileMesh
+{
+	std::string				name;
+	std::vector<Vertex>		vertices;
+	std::vector<uint16_t>	indices;
+};
+
+// プロシージャルジオメトリの種類（使用する交差シェーダ）
+enum SceneFileProceduralType : uint32_t
+{
+	kSceneProceduralSphere = 0,
+	kSceneProceduralBoxes = 1,
+};
+
+struct SceneFileProcedural
+{
+	std::string					name;
+	SceneFileProceduralType		type = kSceneProceduralSphere;
+	std::vector<RaytracingAABB>	aabbs;
+	std::vector<uint32_t>		aabbMaterials;		// boxes のみ
+};
+
+enum SceneFileGeometryType : uint32_t
+{
+	kSceneGeometryMesh = 0,
+	kSceneGeometryProcedural = 1,
+};
+
+// バイナリ形式ではこの構造体の配列をそのまま読み書きする
+struct SceneFileInstance
+{
+	SceneFileGeometryType	geometryType;
+	uint32_t				geometryIndex;		// meshes または procedurals のインデックス
+	uint32_t				material;
+	uint32_t				instanceID;
+	uint32_t				mask;
+	uint32_t				contribution;		// InstanceContributionToHitGroupIndex
+	float3x4				transform;
+};
+
+struct SceneFile
+{
+	SceneFileCamera						camera;
+	SceneFileLight						light;
+	std::vector<SceneFileMaterial>		materials;
+	std::vector<SceneFileMesh>			meshes;
+	std::vector<SceneFileProcedural>	procedurals;
+	std::vector<SceneFileInstance>		instances;
+};
+
+// 失敗時はエラー内容を出力して false を返す
+bool LoadSceneFile(const char* filename, SceneFile& scene);
+bool LoadSceneFileText(const char* filename, SceneFile& scene);
+bool LoadSceneFileBinary(const char* filename, SceneFile& scene);
+
+// バイナリ形式で保存する（リトルエンディアン）
+bool SaveSceneFileBinary(const char* filename, const SceneFile& scene);
+
+// 参照先のインデックスが範囲内か確認する
+bool ValidateSceneFile(const SceneFile& scene);
+
+// camera と light からシーン定数を作る
+SceneCB MakeSceneFileCB(const SceneFileCamera& camera, const SceneFileLight& light, int width, int height);
+
+//	EOF
@@ -0,0 +1,670 @@
+﻿#include "shader03.h"
+
+#include <chrono>
+
+namespace
+{
+	static const uint32_t kHitGroupCount = 4;
+	static const uint32_t kMissCount = 3;
+
+	bool SolveQuadraticEqn(float a, float b, float c, float& x0, float& x1)
+	{
+		float discr = b * b - 4 * a * c;
+		if (discr < 0) return false;
+		else if (discr == 0) x0 = x1 = -0.5f * b / a;
+		else {
+			float q = (b > 0) ?
+				-0.5f * (b + sqrtf(discr)) :
+				-0.5f * (b - sqrtf(discr));
+			x0 = q / a;
+			x1 = c / q;
+		}
+		if (x0 > x1)
+		{
+			std::swap(x0, x1);
+		}
+
+		return true;
+	}
+
+	float3 CalculateNormalForARaySphereHit(const float3& s_center, const float3& ray_origin, const float3& ray_dir, float thit)
+	{
+		float3 hitPosition = ray_origin + thit * ray_dir;
+		return normalize(hitPosition - s_center);
+	}
+
+	bool SolveRaySphereIntersectionEquation(const float3& s_center, float s_radius, const float3& ray_origin, const float3& ray_dir, float& tmin, float& tmax)
+	{
+		float3 L = ray_origin - s_center;
+		float a = dot(ray_dir, ray_dir);
+		float b = 2 * dot(ray_dir, L);
+		float c = dot(L, L) - s_radius * s_radius;
+		return SolveQuadraticEqn(a, b, c, tmin, tmax);
+	}
+
+	bool IntersectToSphere(const RaySystemValues& sv, const float3& s_center, float s_radius, const float3& ray_origin, const float3& ray_dir, float& t, float3& normal)
+	{
+		float t0, t1;
+		if (!SolveRaySphereIntersectionEquation(s_center, s_radius, ray_origin, ray_dir, t0, t1))
+			return false;
+
+		if ((sv.rayTMin < t0 && t0 < sv.rayTCurrent))
+			t = t0;
+		else if ((sv.rayTMin < t1 && t1 < sv.rayTCurrent))
+			t = t1;
+		else
+			return false;
+		normal = CalculateNormalForARaySphereHit(s_center, ray_origin, ray_dir, t);
+		return true;
+	}
+
+	bool IntersectToAABBDetail(const RaySystemValues& sv, const float3 aabb[2], const float3& ray_origin, const float3& ray_dir, float& tmin, float& tmax)
+	{
+		// 除算は逆数の計算1回だけにする
+		float3 tmin3, tmax3;
+		float3 invDir = float3(1.0f) / ray_dir;
+		int sign3[3] = { ray_dir.x > 0, ray_dir.y > 0, ray_dir.z > 0 };
+		tmin3.x = (aabb[1 - sign3[0]].x - ray_origin.x) * invDir.x;
+		tmax3.x = (aabb[sign3[0]].x - ray_origin.x) * invDir.x;
+
+		tmin3.y = (aabb[1 - sign3[1]].y - ray_origin.y) * invDir.y;
+		tmax3.y = (aabb[sign3[1]].y - ray_origin.y) * invDir.y;
+
+		tmin3.z = (aabb[1 - sign3[2]].z - ray_origin.z) * invDir.z;
+		tmax3.z = (aabb[sign3[2]].z - ray_origin.z) * invDir.z;
+
+		tmin = std::max(std::max(tmin3.x, tmin3.y), tmin3.z);
+		tmax = std::min(std::min(tmax3.x, tmax3.y), tmax3.z);
+
+		return tmax > tmin && tmax >= sv.rayTMin && tmin <= sv.rayTCurrent;
+	}
+
+	bool IntersectToAABB(const RaySystemValues& sv, const float3& aabbMin, const float3& aabbMax, const float3& ray_origin, const float3& ray_dir, float& t, float3& normal)
+	{
+		float tmin, tmax;
+		float3 aabb[2] = { aabbMin, aabbMax };
+		if (IntersectToAABBDetail(sv, aabb, ray_origin, ray_dir, tmin, tmax))
+		{
+			t = tmin >= sv.rayTMin ? tmin : tmax;
+
+			// Set a normal to the normal of a face the hit point lays on.
+			float3 hitPosition = ray_origin + t * ray_dir;
+			float3 distanceToBounds[2] = {
+				abs(aabb[0] - hitPosition),
+				abs(aabb[1] - hitPosition)
+			};
+			const float eps = 0.0001f;
+			if (distanceToBounds[0].x < eps) normal = float3(-1, 0, 0);
+			else if (distanceToBounds[0].y < eps) normal = float3(0, -1, 0);
+			else if (distanceToBounds[0].z < eps) normal = float3(0, 0, -1);
+			else if (distanceToBounds[1].x < eps) normal = float3(1, 0, 0);
+			else if (distanceToBounds[1].y < eps) normal = float3(0, 1, 0);
+			else if (distanceToBounds[1].z < eps) normal = float3(0, 0, 1);
+
+			return true;
+		}
+		return false;
+	}
+
+	// [shader("intersection")]
+	bool IntersectionSphereProcessor(TraceContext03& ctx, const RaySystemValues& sv, float& thit, MyAttribute& attr)
+	{
+		auto&& instance = ctx.scene->instances[sv.instanceIndex];
+		float3 ray_origin = sv.worldRayOrigin + sv.worldRayDirection * sv.rayTMin;
+		float3 ray_dir = sv.worldRayDirection;
+
+		float3 center = float3(instance.mtxLocalToWorld.m[3][0], instance.mtxLocalToWorld.m[3][1], instance.mtxLocalToWorld.m[3][2]);
+		float radius = instance.mtxLocalToWorld.m[0][0];
+		return IntersectToSphere(sv, center, radius, ray_origin, ray_dir, thit, attr.normal);
+	}
+
+	// [shader("intersection")]
+	bool IntersectionInnerBoxProcessor(TraceContext03& ctx, const RaySystemValues& sv, float& thit, MyAttribute& attr)
+	{
+		auto&& aabb = ctx.scene->innerBoxAABBs[sv.primitiveIndex];
+		float3 ray_origin = sv.worldRayOrigin + sv.worldRayDirection * sv.rayTMin;
+		float3 ray_dir = sv.worldRayDirection;
+
+		return IntersectToAABB(sv, aabb.aabbMin, aabb.aabbMax, ray_origin, ray_dir, thit, attr.normal);
+	}
+
+	// シャドウチェック
+	float TraceShadow(TraceContext03& ctx, const RaySystemValues& sv, const float3& lightDir)
+	{
+		float3 origin = sv.worldRayOrigin + sv.worldRayDirection * sv.rayTCurrent;
+		RayDesc ray = { origin, 1e-4f, lightDir, 10000.0f };
+		return Occluded03(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, 1, 1, ray) ? 0.0f : 1.0f;
+	}
+
+	// [shader("closesthit")]
+	void ClosestHitSphereProcessor(TraceContext03& ctx, const RaySystemValues& sv, HitData& payload, const MyAttribute& attr)
+	{
+		auto&& instance = ctx.scene->instances[sv.instanceIndex];
+		auto&& cb = *ctx.cb;
+
+		float3 lightDir = normalize(-cb.lightDir.xyz());
+
+		float shadow = TraceShadow(ctx, sv, GetShadowRayDir03(cb, ctx.pixelX, ctx.pixelY, sv.instanceIndex, sv.primitiveIndex));
+
+		// 平行光源のライティング計算
+		float NoL = saturate(dot(attr.normal, lightDir));
+		float3 finalColor = instance.color.xyz() * cb.lightColor.xyz() * (NoL * shadow + 0.2f);
+
+		payload.color = float4(finalColor, 1);
+	}
+
+	// [shader("closesthit")]
+	void ClosestHitInnerBoxProcessor(TraceContext03& ctx, const RaySystemValues& sv, HitData& payload, const MyAttribute& attr)
+	{
+		auto&& aabb = ctx.scene->innerBoxAABBs[sv.primitiveIndex];
+		auto&& cb = *ctx.cb;
+
+		float3 lightDir = normalize(-cb.lightDir.xyz());
+
+		float shadow = TraceShadow(ctx, sv, GetShadowRayDir03(cb, ctx.pixelX, ctx.pixelY, sv.instanceIndex, sv.primitiveIndex));
+
+		// 平行光源のライティング計算
+		float NoL = saturate(dot(attr.normal, lightDir));
+		float3 finalColor = aabb.color.xyz() * cb.lightColor.xyz() * (NoL * shadow + 0.2f);
+
+		// 反射
+		if (payload.color.w > 0)
+		{
+			float3 origin = sv.worldRayOrigin + sv.worldRayDirection * sv.rayTCurrent;
+			float3 reflection = dot(attr.normal, -sv.worldRayDirection) * 2.0f * attr.normal + sv.worldRayDirection;
+			RayDesc ray = { origin, 1e-5f, reflection, 10000.0f };
+			HitData refl_payload = { float4(0, 0, 0, 0) };
+			TraceRay03(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, 0, 1, 2, ray, refl_payload);
+
+			NoL = saturate(dot(attr.normal, reflection));
+			finalColor += aabb.color.xyz() * refl_payload.color.xyz() * NoL;
+		}
+
+		payload.color = float4(finalColor, 1);
+	}
+
+	// [shader("closesthit")]
+	void ClosestHitShadowProcessor(TraceContext03&, const RaySystemValues&, HitData& payload, const MyAttribute&)
+	{
+		payload.color = float4(0, 0, 0, 1);
+	}
+
+	// [shader("miss")]
+	void MissProcessor(HitData& payload)
+	{
+		payload.color = float4(0, 0, 1, 1);
+	}
+
+	// [shader("miss")]
+	void MissShadowProcessor(HitData& payload)
+	{
+		payload.color = float4(1, 1, 1, 1);
+	}
+
+	// [shader("miss")]
+	void MissReflectionProcessor(HitData& payload)
+	{
+		payload.color = float4(0, 0, 0, 1);
+	}
+
+	// ヒットグループとミスシェーダのテーブル
+	// 並びは Sample03 の InitShaderTable と同じ
+	struct HitGroup03
+	{
+		bool (*intersection)(TraceContext03&, const RaySystemValues&, float&, MyAttribute&);
+		void (*closestHit)(TraceContext03&, const RaySystemValues&, HitData&, const MyAttribute&);
+	};
+	static const HitGroup03 kHitGroups[kHitGroupCount] = {
+		{ IntersectionSphereProcessor, ClosestHitSphereProcessor },			// SphereHitGroup
+		{ IntersectionSphereProcessor, ClosestHitShadowProcessor },			// SphereShadowHitGroup
+		{ IntersectionInnerBoxProcessor, ClosestHitInnerBoxProcessor },		// InnerBoxHitGroup
+		{ IntersectionInnerBoxProcessor, ClosestHitShadowProcessor },		// InnerBoxShadowHitGroup
+	};
+	static void (* const kMissShaders[kMissCount])(HitData&) = {
+		MissProcessor,
+		MissShadowProcessor,
+		MissReflectionProcessor,
+	};
+
+	// 1本のレイの探索状態
+	// パケットでは配列で確保するので、初期化は Init() で必要な部分だけ行う
+	struct RayQuery03
+	{
+		RaySystemValues	sv;
+
+		// 確定したヒット情報（isHit が true の場合のみ有効）
+		bool			isHit;
+		RaySystemValues	committed;
+		MyAttribute		committedAttr;
+		uint32_t		committedHitGroup;
+
+		void Init(const RayDesc& ray, uint32_t rayFlags)
+		{
+			sv.worldRayOrigin = ray.Origin;
+			sv.worldRayDirection = ray.Direction;
+			sv.rayTMin = ray.TMin;
+			sv.rayTCurrent = ray.TMax;
+			sv.rayFlags = rayFlags;
+			sv.instanceIndex = 0;
+			sv.instanceID = 0;
+			sv.primitiveIndex = 0;
+			isHit = false;
+		}
+	};
+
+	// 交差シェーダを呼び出し、ReportHit されたヒットが範囲内なら確定する
+	// 呼び出し前に sv.instanceIndex, sv.instanceID, sv.rayTCurrent を設定しておくこと
+	bool InvokeIntersection(TraceContext03& ctx, RayQuery03& query, uint32_t hitGroupIndex, uint32_t primitiveIndex)
+	{
+		auto&& sv = query.sv;
+		sv.primitiveIndex = primitiveIndex;
+
+		float thit;
+		MyAttribute attr;
+		if (!kHitGroups[hitGroupIndex].intersection(ctx, sv, thit, attr))
+			return false;
+
+		// ReportHit: 範囲外のヒットは破棄される
+		if (thit < sv.rayTMin || thit > sv.rayTCurrent)
+			return false;
+
+		sv.rayTCurrent = thit;
+		query.committed = sv;
+		query.committedAttr = attr;
+		query.committedHitGroup = hitGroupIndex;
+		query.isHit = true;
+		return true;
+	}
+
+	// 探索結果に応じてクローゼストヒットシェーダかミスシェーダを呼び出す
+	void FinishQuery(TraceContext03& ctx, const RayQuery03& query, uint32_t missShaderIndex, HitData& payload)
+	{
+		if (query.isHit)
+		{
+			if (!(query.sv.rayFlags & RAY_FLAG_SKIP_CLOSEST_HIT_SHADER))
+			{
+				kHitGroups[query.committedHitGroup].closestHit(ctx, query.committed, payload, query.committedAttr);
+			}
+		}
+		else
+		{
+			kMissShaders[missShaderIndex](payload);
+		}
+	}
+
+	// アクセラレーション構造を走査して最近接（または最初の）ヒットを探す
+	void SearchRay(
+		TraceContext03& ctx,
+		RayQuery03& query,
+		uint32_t instanceInclusionMask,
+		uint32_t rayContributionToHitGroupIndex,
+		uint32_t multiplierForGeometryContributionToHitGroupIndex,
+		const RayDesc& ray)
+	{
+		auto&& scene = *ctx.scene;
+		uint32_t rayFlags = query.sv.rayFlags;
+
+		// ジオメトリは1つのボトムレベルASに1つだけなので GeometryIndex は常に0
+		const uint32_t geometryIndex = 0;
+
+		float tmax = ray.TMax;
+		scene.topLevel.Traverse(ray, instanceInclusionMask, tmax, [&](uint32_t instanceIndex, const RayDesc& objRay, float& tcur)
+		{
+			auto&& desc = scene.topLevel.GetInstanceDesc(instanceIndex);
+			uint32_t hitGroupIndex = desc.InstanceContributionToHitGroupIndex + rayContributionToHitGroupIndex + multiplierForGeometryContributionToHitGroupIndex * geometryIndex;
+
+			query.sv.instanceIndex = instanceIndex;
+			query.sv.instanceID = desc.InstanceID;
+
+			bool endSearch = false;
+			scene.bottomLevels[desc.AccelerationStructure].Traverse(objRay, tcur, [&](uint32_t primitiveIndex, float& tprim)
+			{
+				query.sv.rayTCurrent = tprim;
+				if (!InvokeIntersection(ctx, query, hitGroupIndex, primitiveIndex))
+					return false;
+
+				tprim = query.sv.rayTCurrent;
+				endSearch = (rayFlags & RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH) != 0;
+				return endSearch;
+			}, ctx.pBottomStats);
+			return endSearch;
+		}, ctx.pTopStats);
+	}
+
+	// 交差シェーダを呼び出し、範囲内のヒットを報告したかを返す（ヒットは確定しない）
+	// 呼び出し前に sv.instanceIndex, sv.instanceID を設定しておくこと
+	bool ReportsHit(TraceContext03& ctx, RaySystemValues& sv, uint32_t hitGroupIndex, uint32_t primitiveIndex)
+	{
+		sv.primitiveIndex = primitiveIndex;
+
+		float thit;
+		MyAttribute attr;
+		if (!kHitGroups[hitGroupIndex].intersection(ctx, sv, thit, attr))
+			return false;
+		return thit >= sv.rayTMin && thit <= sv.rayTCurrent;
+	}
+
+	// 最初のヒットが見つかった時点で走査をやめる
+	// 交差シェーダはワールド空間のレイを使うので、sv の tCurrent は ray.TMax のまま変えない
+	bool SearchOcclusion(
+		TraceContext03& ctx,
+		RaySystemValues& sv,
+		uint32_t instanceInclusionMask,
+		uint32_t rayContributionToHitGroupIndex,
+		uint32_t multiplierForGeometryContributionToHitGroupIndex,
+		const RayDesc& ray)
+	{
+		auto&& scene = *ctx.scene;
+		const uint32_t geometryIndex = 0;
+
+		bool isOccluded = false;
+		float tmax = ray.TMax;
+		scene.topLevel.Traverse(ray, instanceInclusionMask, tmax, [&](uint32_t instanceIndex, const RayDesc& objRay, float& tcur)
+		{
+			auto&& desc = scene.topLevel.GetInstanceDesc(instanceIndex);
+			uint32_t hitGroupIndex = desc.InstanceContributionToHitGroupIndex + rayContributionToHitGroupIndex + multiplierForGeometryContributionToHitGroupIndex * geometryIndex;
+
+			sv.instanceIndex = instanceIndex;
+			sv.instanceID = desc.InstanceID;
+			scene.bottomLevels[desc.AccelerationStructure].Traverse(objRay, tcur, [&](uint32_t primitiveIndex, float&)
+			{
+				if (!ReportsHit(ctx, sv, hitGroupIndex, primitiveIndex))
+					return false;
+
+				isOccluded = true;
+				return true;
+			}, ctx.pBottomStats);
+			return isOccluded;
+		}, ctx.pTopStats);
+		return isOccluded;
+	}
+
+	void InitOcclusionRay(RaySystemValues& sv, const RayDesc& ray, uint32_t rayFlags)
+	{
+		sv.worldRayOrigin = ray.Origin;
+		sv.worldRayDirection = ray.Direction;
+		sv.rayTMin = ray.TMin;
+		sv.rayTCurrent = ray.TMax;
+		sv.rayFlags = rayFlags | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER;
+		sv.instanceIndex = 0;
+		sv.instanceID = 0;
+		sv.primitiveIndex = 0;
+	}
+}
+
+RayDesc MakePrimaryRay03(const SceneCB& cb, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	// ピクセル中心を通るレイ（累積する場合はフレームごとにピクセル内でずらす）
+	float2 jitter = GetPixelJitter(cb, x, y);
+	return MakeCameraRay(cb, (float)x + jitter.x, (float)y + jitter.y, width, height);
+}
+
+float3 GetShadowRayDir03(const SceneCB& cb, uint32_t pixelX, uint32_t pixelY, uint32_t instanceIndex, uint32_t primitiveIndex)
+{
+	float3 lightDir = normalize(-cb.lightDir.xyz());
+	if (cb.sampleCount == 0 || cb.lightRadius <= 0.0f)
+		return lightDir;
+
+	// 累積する場合は、光源の見かけの大きさの中でシャドウレイの方向をずらしてソフトシャドウにする
+	// 乱数は画素とフレーム、ヒットしたプリミティブで決める
+	uint32_t seed = PixelSeed(pixelX, pixelY, cb.frameIndex, 2 + (instanceIndex << 16) + primitiveIndex);
+	float r = tanf(cb.lightRadius) * sqrtf(HashToFloat(seed));
+	float phi = HashToFloat(HashPcg(seed)) * kPI * 2.0f;
+
+	float3 up = (fabsf(lightDir.y) < 0.999f) ? float3(0, 1, 0) : float3(1, 0, 0);
+	float3 t = normalize(cross(up, lightDir));
+	float3 b = cross(lightDir, t);
+	return normalize(lightDir + (t * cosf(phi) + b * sinf(phi)) * r);
+}
+
+void TraceRay03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	uint32_t missShaderIndex,
+	const RayDesc& ray,
+	HitData& payload)
+{
+	ctx.rayCount++;
+
+	RayQuery03 query;
+	query.Init(ray, rayFlags);
+	SearchRay(ctx, query, instanceInclusionMask, rayContributionToHitGroupIndex, multiplierForGeometryContributionToHitGroupIndex, ray);
+	FinishQuery(ctx, query, missShaderIndex, payload);
+}
+
+bool TraceRayQuery03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	const RayDesc& ray,
+	HitInfo03& hit)
+{
+	ctx.rayCount++;
+
+	RayQuery03 query;
+	query.Init(ray, rayFlags);
+	SearchRay(ctx, query, instanceInclusionMask, rayContributionToHitGroupIndex, multiplierForGeometryContributionToHitGroupIndex, ray);
+	if (!query.isHit)
+		return false;
+
+	hit.t = query.committed.rayTCurrent;
+	hit.instanceIndex = query.committed.instanceIndex;
+	hit.primitiveIndex = query.committed.primitiveIndex;
+	hit.hitGroupIndex = query.committedHitGroup;
+	hit.normal = query.committedAttr.normal;
+	return true;
+}
+
+bool Occluded03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	const RayDesc& ray)
+{
+	ctx.rayCount++;
+
+	RaySystemValues sv;
+	InitOcclusionRay(sv, ray, rayFlags);
+	return SearchOcclusion(ctx, sv, instanceInclusionMask, rayContributionToHitGroupIndex, multiplierForGeometryContributionToHitGroupIndex, ray);
+}
+
+uint32_t OccludedBatch03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	const RayDesc* rays,
+	uint32_t count)
+{
+	auto&& scene = *ctx.scene;
+	count = std::min(count, kMaxOcclusionBatch);
+	ctx.rayCount += count;
+	const uint32_t geometryIndex = 0;
+
+	RaySystemValues sv[kMaxOcclusionBatch];
+	for (uint32_t i = 0; i < count; i++)
+		InitOcclusionRay(sv[i], rays[i], rayFlags);
+
+	// 遮られたレイは束から外れるので、走査を終えても残っているレイが遮られなかったもの
+	RayBatch batch;
+	batch.Init(rays, count);
+	uint32_t allMask = batch.activeMask;
+	scene.topLevel.TraverseBatch(batch, instanceInclusionMask, [&](uint32_t instanceIndex, RayBatch& objBatch)
+	{
+		auto&& desc = scene.topLevel.GetInstanceDesc(instanceIndex);
+		uint32_t hitGroupIndex = desc.InstanceContributionToHitGroupIndex + rayContributionToHitGroupIndex + multiplierForGeometryContributionToHitGroupIndex * geometryIndex;
+		for (uint32_t mask = objBatch.activeMask; mask != 0; mask &= mask - 1)
+		{
+			uint32_t r = FirstBitIndex(mask);
+			sv[r].instanceIndex = instanceIndex;
+			sv[r].instanceID = desc.InstanceID;
+		}
+
+		// 交差シェーダはワールド空間のレイを使う
+		scene.bottomLevels[desc.AccelerationStructure].TraverseBatch(objBatch, [&](uint32_t r, uint32_t primitiveIndex)
+		{
+			return ReportsHit(ctx, sv[r], hitGroupIndex, primitiveIndex);
+		}, ctx.pBottomStats);
+	}, ctx.pTopStats);
+	return allMask & ~batch.activeMask;
+}
+
+float4 RayGenerator03(TraceContext03& ctx, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	ctx.pixelX = x;
+	ctx.pixelY = y;
+	RayDesc ray = MakePrimaryRay03(*ctx.cb, x, y, width, height);
+	HitData payload = { float4(0, 0, 0, 1) };
+	TraceRay03(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, 0, 1, 0, ray, payload);
+
+	return payload.color;
+}
+
+void RayGeneratorPacket03(TraceContext03& ctx, const Tile& block, uint32_t width, uint32_t height, float4* colors)
+{
+	auto&& scene = *ctx.scene;
+	const uint32_t rayFlags = RAY_FLAG_CULL_BACK_FACING_TRIANGLES;
+	const uint32_t missShaderIndex = 0;
+
+	// ブロック内のプライマリレイはすべてカメラ位置を原点とする
+	RayPacket packet;
+	RayQuery03 queries[kMaxPacketRays];
+	float rayTMax[kMaxPacketRays];
+	packet.rayCount = 0;
+	for (uint32_t y = block.y0; y < block.y1; y++)
+	{
+		for (uint32_t x = block.x0; x < block.x1; x++)
+		{
+			RayDesc ray = MakePrimaryRay03(*ctx.cb, x, y, width, height);
+			packet.origin = ray.Origin;
+			packet.tmin = ray.TMin;
+			packet.directions[packet.rayCount] = ray.Direction;
+			rayTMax[packet.rayCount] = ray.TMax;
+			queries[packet.rayCount].Init(ray, rayFlags);
+			packet.rayCount++;
+		}
+	}
+	packet.Finalize();
+
+	// 方向の符号が揃っていないパケットは枝刈りできないのでレイ1本ずつ処理する
+	if (!packet.isCoherent)
+	{
+		uint32_t i = 0;
+		for (uint32_t y = block.y0; y < block.y1; y++)
+		{
+			for (uint32_t x = block.x0; x < block.x1; x++)
+			{
+				colors[i++] = RayGenerator03(ctx, x, y, width, height);
+			}
+		}
+		return;
+	}
+
+	ctx.rayCount += packet.rayCount;
+	scene.topLevel.TraversePacket(packet, ~0u, rayTMax, [&](uint32_t instanceIndex, const RayPacket& objPacket)
+	{
+		auto&& desc = scene.topLevel.GetInstanceDesc(instanceIndex);
+		uint32_t hitGroupIndex = desc.InstanceContributionToHitGroupIndex;
+		for (uint32_t r = 0; r < packet.rayCount; r++)
+		{
+			queries[r].sv.instanceIndex = instanceIndex;
+			queries[r].sv.instanceID = desc.InstanceID;
+		}
+
+		scene.bottomLevels[desc.AccelerationStructure].TraversePacket(objPacket, rayTMax, [&](uint32_t r, uint32_t primitiveIndex)
+		{
+			queries[r].sv.rayTCurrent = rayTMax[r];
+			if (InvokeIntersection(ctx, queries[r], hitGroupIndex, primitiveIndex))
+				rayTMax[r] = queries[r].sv.rayTCurrent;
+		});
+	});
+
+	uint32_t blockWidth = block.x1 - block.x0;
+	for (uint32_t r = 0; r < packet.rayCount; r++)
+	{
+		ctx.pixelX = block.x0 + r % blockWidth;
+		ctx.pixelY = block.y0 + r / blockWidth;
+		HitData payload = { float4(0, 0, 0, 1) };
+		FinishQuery(ctx, queries[r], missShaderIndex, payload);
+		colors[r] = payload.color;
+	}
+}
+
+void DispatchRays03(const Scene03& scene, const SceneCB& cb, const DispatchDesc& desc, Image& image, RenderStats& stats, AccumImage* pAccum)
+{
+	image.Resize(desc.width, desc.height);
+
+	// 累積する場合は RayGenerator と同じく、合計を累積バッファに書いて平均を出力する
+	bool accumulate = (cb.sampleCount > 0 && pAccum != nullptr);
+	if (accumulate && (pAccum->width != desc.width || pAccum->height != desc.height))
+		pAccum->Resize(desc.width, desc.height);
+	auto Store = [&](uint32_t x, uint32_t y, const float4& color)
+	{
+		image.Store(x, y, accumulate ? pAccum->Accumulate(x, y, color, cb.sampleCount) : color);
+	};
+
+	uint32_t threadCount = GetDispatchThreadCount(desc);
+	std::vector<TraceContext03> contexts(threadCount);
+	for (auto&& ctx : contexts)
+	{
+		ctx.scene = &scene;
+		ctx.cb = &cb;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	DispatchTiles(desc, [&](const Tile& tile, uint32_t threadIndex)
+	{
+		auto&& ctx = contexts[threadIndex];
+		if (desc.packetSize > 0)
+		{
+			// タイルをさらにパケット単位のブロックに分けて処理する
+			float4 colors[kMaxPacketRays];
+			for (uint32_t by = tile.y0; by < tile.y1; by += desc.packetSize)
+			{
+				for (uint32_t bx = tile.x0; bx < tile.x1; bx += desc.packetSize)
+				{
+					Tile block = { bx, by, std::min(bx + desc.packetSize, tile.x1), std::min(by + desc.packetSize, tile.y1) };
+					RayGeneratorPacket03(ctx, block, desc.width, desc.height, colors);
+
+					uint32_t i = 0;
+					for (uint32_t y = block.y0; y < block.y1; y++)
+					{
+						for (uint32_t x = block.x0; x < block.x1; x++)
+						{
+							Store(x, y, colors[i++]);
+						}
+					}
+				}
+			}
+			return;
+		}
+
+		for (uint32_t y = tile.y0; y < tile.y1; y++)
+		{
+			for (uint32_t x = tile.x0; x < tile.x1; x++)
+			{
+				Store(x, y, RayGenerator03(ctx, x, y, desc.width, desc.height));
+			}
+		}
+	}, &stats.tiles);
+	auto end = std::chrono::steady_clock::now();
+
+	stats.seconds = std::chrono::duration<double>(end - start).count();
+	stats.threadRayCounts.resize(threadCount);
+	stats.rayCount = 0;
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		stats.threadRayCounts[i] = contexts[i].rayCount;
+		stats.rayCount += contexts[i].rayCount;
+	}
+}
+
+//	EOF
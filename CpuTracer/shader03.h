@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include "scene03.h"
+#include "image.h"
+#include "renderer.h"
+
+// Sample03/test.r.hlsl のCPU移植
+
+struct HitData
+{
+	float4		color;
+};
+
+struct MyAttribute
+{
+	float3		normal;
+};
+
+// 1スレッド分のレイトレース状態
+struct TraceContext03
+{
+	const Scene03*	scene = nullptr;
+	const SceneCB*	cb = nullptr;
+	uint64_t		rayCount = 0;
+	uint32_t		pixelX = 0;			// DispatchRaysIndex
+	uint32_t		pixelY = 0;
+
+	// 設定されていれば走査統計を集計する
+	TraversalStats*	pTopStats = nullptr;
+	TraversalStats*	pBottomStats = nullptr;
+};
+
+// TraceRayQuery03 の結果
+struct HitInfo03
+{
+	float		t;
+	uint32_t	instanceIndex;
+	uint32_t	primitiveIndex;
+	uint32_t	hitGroupIndex;
+	float3		normal;			// 交差シェーダが返した法線
+};
+
+// RayGenerator のプライマリレイ（累積する場合はピクセル内でずらす）
+RayDesc MakePrimaryRay03(const SceneCB& cb, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+// クローゼストヒットシェーダがシャドウレイを飛ばす方向
+// 画素 (pixelX, pixelY) のレイがインスタンス instanceIndex のプリミティブ primitiveIndex にヒットした場合
+float3 GetShadowRayDir03(const SceneCB& cb, uint32_t pixelX, uint32_t pixelY, uint32_t instanceIndex, uint32_t primitiveIndex);
+
+// HLSLの TraceRay() 相当
+void TraceRay03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	uint32_t missShaderIndex,
+	const RayDesc& ray,
+	HitData& payload);
+
+// TraceRay03 と同じ探索を行い、クローゼストヒット/ミスシェーダを呼ばずにヒット情報を返す
+bool TraceRayQuery03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	const RayDesc& ray,
+	HitInfo03& hit);
+
+// シャドウレイ用の遮蔽判定（occluded(ray) -> bool）
+// RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER で TraceRay するのと同じで、
+// 交差シェーダが範囲内のヒットを最初に報告した時点で走査をやめ、ペイロードもクローゼストヒットシェーダも使わない
+bool Occluded03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	const RayDesc& ray);
+
+// OccludedBatch03 で一度に判定できるレイの数
+static const uint32_t kMaxOcclusionBatch = kMaxRayBatch;
+
+// rays[count]（4、8、16本など kMaxOcclusionBatch 本以下）をまとめて判定し、遮られたレイのビットを返す
+// 全レイで1つのスタックを使ってASを走査し、遮られたレイを外しながら、すべて遮られた時点で走査をやめる
+// 近い画素のシャドウレイを並べて渡すと、ノードの読み込みと判定を共有できる
+uint32_t OccludedBatch03(
+	TraceContext03& ctx,
+	uint32_t rayFlags,
+	uint32_t instanceInclusionMask,
+	uint32_t rayContributionToHitGroupIndex,
+	uint32_t multiplierForGeometryContributionToHitGroupIndex,
+	const RayDesc* rays,
+	uint32_t count);
+
+// RayGenerator シェーダ
+float4 RayGenerator03(TraceContext03& ctx, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+// RayGenerator シェーダを block 内の画素についてまとめて実行する（パケットトレース）
+// block は kMaxPacketRays 画素以下で、colors には行優先で結果を格納する
+void RayGeneratorPacket03(TraceContext03& ctx, const Tile& block, uint32_t width, uint32_t height, float4* colors);
+
+// DispatchRays 相当
+// desc.width x desc.height のレイを生成して image に書き込む
+// cb.sampleCount が1以上なら pAccum に累積し、image にはそれまでのサンプルの平均を書き込む
+void DispatchRays03(const Scene03& scene, const SceneCB& cb, const DispatchDesc& desc, Image& image, RenderStats& stats, AccumImage* pAccum = nullptr);
+
+//	EOF
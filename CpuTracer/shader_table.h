@@ -0,0 +1,291 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// D3D12 の値と同じ
+static const uint32_t kShaderRecordAlignment = 32;		// D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT
+static const uint32_t kShaderTableAlignment = 64;		// D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT
+
+// シェーダテーブルの区分
+// 1つのバッファにこの順で並べ、それぞれ DispatchRays に渡す範囲になる
+enum ShaderTableSection
+{
+	kShaderTableRayGen = 0,
+	kShaderTableMiss,
+	kShaderTableHitGroup,
+
+	kShaderTableSectionCount
+};
+
+// シェーダレコード（シェーダ識別子 + ローカルルート引数）
+// ポインタの先は Add から戻るまで有効であればよい
+struct ShaderRecord
+{
+	const void*	identifier = nullptr;
+	const void*	rootArguments = nullptr;
+	uint32_t	rootArgumentSize = 0;
+};
+
+inline ShaderRecord MakeShaderRecord(const void* identifier)
+{
+	ShaderRecord record;
+	record.identifier = identifier;
+	return record;
+}
+
+template <typename RootArguments>
+ShaderRecord MakeShaderRecord(const void* identifier, const RootArguments& rootArguments)
+{
+	ShaderRecord record;
+	record.identifier = identifier;
+	record.rootArguments = &rootArguments;
+	record.rootArgumentSize = (uint32_t)sizeof(RootArguments);
+	return record;
+}
+
+// DispatchRays に渡す範囲（D3D12_GPU_VIRTUAL_ADDRESS_RANGE_AND_STRIDE と同じ）
+struct ShaderTableRange
+{
+	uint64_t	startAddress = 0;
+	uint64_t	sizeInBytes = 0;
+	uint64_t	strideInBytes = 0;
+};
+
+struct ShaderTableStats
+{
+	uint64_t	addCount = 0;			// Add で渡されたレコード数
+	uint64_t	sharedCount = 0;		// 追加済みのレコードを共有して追加しなかった数
+	uint64_t	patchCount = 0;
+};
+
+// シェーダテーブルを組み立てる
+// レコードの長さ（識別子 + ルート引数）から区分ごとにストライドを決め、識別子の取得元やバッファに依存しないので配列でも確認できる
+// 同じ内容のレコードの並びは共有し、構築後はルート引数だけを書き換えられる
+class ShaderTableBuilder
+{
+public:
+	static const uint32_t kInvalidIndex = 0xffffffff;
+
+	// identifierSize はシェーダ識別子のサイズ（GetShaderIdentifierSize）
+	void Init(uint32_t identifierSize)
+	{
+		identifierSize_ = identifierSize;
+		for (auto&& v : sections_) v = Section();
+		data_.clear();
+		stats_ = ShaderTableStats();
+	}
+
+	// records[count] を区分の連続したレコードとして追加し、先頭のレコード番号を返す
+	// 同じ内容の並びが追加済みならその番号を返すので、ヒットグループならレイの種類ごとのレコードをまとめて渡し、
+	// 戻り値をインスタンスの InstanceContributionToHitGroupIndex に使う
+	uint32_t Add(ShaderTableSection section, const ShaderRecord* records, uint32_t count)
+	{
+		return AddRecords(section, records, count, true);
+	}
+	uint32_t Add(ShaderTableSection section, const ShaderRecord& record)
+	{
+		return Add(section, &record, 1);
+	}
+
+	// 共有せずに追加する（あとで Patch で個別に書き換えるレコード用）
+	uint32_t AddUnique(ShaderTableSection section, const ShaderRecord* records, uint32_t count)
+	{
+		return AddRecords(section, records, count, false);
+	}
+	uint32_t AddUnique(ShaderTableSection section, const ShaderRecord& record)
+	{
+		return AddUnique(section, &record, 1);
+	}
+
+	// 区分ごとのストライドと位置を決めて、テーブル全体の内容を作る
+	// レコードを追加したら、GetSize や Write、Patch の前に呼ぶ
+	void Build()
+	{
+		uint64_t offset = 0;
+		for (auto&& section : sections_)
+		{
+			section.offset = offset;
+			section.stride = AlignUp(identifierSize_ + section.maxArgumentSize, kShaderRecordAlignment);
+			offset = AlignUp(offset + (uint64_t)section.stride * section.GetCount(), kShaderTableAlignment);
+		}
+
+		data_.assign((size_t)offset, 0);
+		for (auto&& section : sections_)
+		{
+			for (uint32_t i = 0; i < section.GetCount(); i++)
+			{
+				uint32_t size = section.starts[i + 1] - section.starts[i];
+				memcpy(&data_[(size_t)(section.offset + (uint64_t)section.stride * i)], &section.bytes[section.starts[i]], size);
+			}
+		}
+	}
+
+	uint64_t GetSize() const { return data_.size(); }
+	const uint8_t* GetData() const { return data_.data(); }
+
+	// 作った内容を pDst（GetSize() バイト、アップロードバッファをマップした先など）に書き込む
+	void Write(void* pDst) const
+	{
+		memcpy(pDst, data_.data(), data_.size());
+	}
+
+	// テーブルを置いたGPUアドレス baseAddress（kShaderTableAlignment 境界）での区分の範囲
+	ShaderTableRange GetRange(ShaderTableSection section, uint64_t baseAddress) const
+	{
+		auto&& s = sections_[section];
+		ShaderTableRange range;
+		range.startAddress = baseAddress + s.offset;
+		range.sizeInBytes = (uint64_t)s.stride * s.GetCount();
+		range.strideInBytes = s.stride;
+		return range;
+	}
+
+	// レコード1つの範囲（RayGenerationShaderRecord 用）
+	ShaderTableRange GetRecordRange(ShaderTableSection section, uint32_t index, uint64_t baseAddress) const
+	{
+		ShaderTableRange range;
+		range.startAddress = baseAddress + GetRecordOffset(section, index);
+		range.sizeInBytes = sections_[section].stride;
+		range.strideInBytes = sections_[section].stride;
+		return range;
+	}
+
+	// Build 後に、レコード index のルート引数の offset バイト目から size バイトを書き換える（構築し直さない）
+	// pDst に Write した先を渡せば、そこも同じ位置を書き換える
+	// 共有されたレコードなら、それを使うすべてのインスタンスに反映される
+	bool Patch(ShaderTableSection section, uint32_t index, const void* data, uint32_t size, uint32_t offset = 0, void* pDst = nullptr)
+	{
+		auto&& s = sections_[section];
+		if (index >= s.GetCount() || data_.empty())
+			return false;
+		uint32_t argumentSize = s.starts[index + 1] - s.starts[index] - identifierSize_;
+		if (offset + size > argumentSize)
+			return false;
+
+		uint32_t recordOffset = identifierSize_ + offset;
+		memcpy(&s.bytes[s.starts[index] + recordOffset], data, size);
+		uint64_t dst = GetRecordOffset(section, index) + recordOffset;
+		memcpy(&data_[(size_t)dst], data, size);
+		if (pDst != nullptr)
+			memcpy(static_cast<uint8_t*>(pDst) + dst, data, size);
+		stats_.patchCount++;
+		return true;
+	}
+	template <typename RootArguments>
+	bool Patch(ShaderTableSection section, uint32_t index, const RootArguments& rootArguments, void* pDst = nullptr)
+	{
+		return Patch(section, index, &rootArguments, (uint32_t)sizeof(RootArguments), 0, pDst);
+	}
+
+	uint32_t GetRecordCount(ShaderTableSection section) const { return sections_[section].GetCount(); }
+	uint32_t GetStride(ShaderTableSection section) const { return sections_[section].stride; }
+	uint64_t GetRecordOffset(ShaderTableSection section, uint32_t index) const
+	{
+		return sections_[section].offset + (uint64_t)sections_[section].stride * index;
+	}
+	const ShaderTableStats& GetStats() const { return stats_; }
+
+private:
+	struct Section
+	{
+		std::vector<uint8_t>	bytes;				// 識別子 + ルート引数をレコードの順に詰めたもの
+		std::vector<uint32_t>	starts = { 0 };		// レコード i は bytes の [starts[i], starts[i + 1])
+		uint32_t				maxArgumentSize = 0;
+		std::unordered_multimap<uint64_t, uint32_t>	groups;		// 共有できる並びの内容のハッシュと先頭のレコード番号
+
+		uint64_t				offset = 0;
+		uint32_t				stride = 0;
+
+		uint32_t GetCount() const { return (uint32_t)starts.size() - 1; }
+	};
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// FNV-1a
+	static uint64_t Hash(const void* data, size_t size, uint64_t hash)
+	{
+		auto p = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ p[i]) * 0x100000001b3ull;
+		return hash;
+	}
+
+	bool IsSame(const Section& section, uint32_t first, const ShaderRecord* records, uint32_t count) const
+	{
+		if (first + count > section.GetCount())
+			return false;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto&& r = records[i];
+			const uint8_t* p = &section.bytes[section.starts[first + i]];
+			if (section.starts[first + i + 1] - section.starts[first + i] != identifierSize_ + r.rootArgumentSize)
+				return false;
+			if (memcmp(p, r.identifier, identifierSize_) != 0)
+				return false;
+			if (r.rootArgumentSize > 0 && memcmp(p + identifierSize_, r.rootArguments, r.rootArgumentSize) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	uint32_t AddRecords(ShaderTableSection section, const ShaderRecord* records, uint32_t count, bool share)
+	{
+		auto&& s = sections_[section];
+		stats_.addCount += count;
+
+		uint64_t hash = 0;
+		if (share)
+		{
+			hash = Hash(&count, sizeof(count), 0xcbf29ce484222325ull);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				hash = Hash(records[i].identifier, identifierSize_, hash);
+				hash = Hash(&records[i].rootArgumentSize, sizeof(uint32_t), hash);
+				hash = Hash(records[i].rootArguments, records[i].rootArgumentSize, hash);
+			}
+
+			// ハッシュの衝突や Patch での書き換えがあるので、内容も比べる
+			auto range = s.groups.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (IsSame(s, it->second, records, count))
+				{
+					stats_.sharedCount += count;
+					return it->second;
+				}
+			}
+		}
+
+		uint32_t first = s.GetCount();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto&& r = records[i];
+			auto p = static_cast<const uint8_t*>(r.identifier);
+			s.bytes.insert(s.bytes.end(), p, p + identifierSize_);
+			if (r.rootArgumentSize > 0)
+			{
+				p = static_cast<const uint8_t*>(r.rootArguments);
+				s.bytes.insert(s.bytes.end(), p, p + r.rootArgumentSize);
+			}
+			s.starts.push_back((uint32_t)s.bytes.size());
+			s.maxArgumentSize = std::max(s.maxArgumentSize, r.rootArgumentSize);
+		}
+		if (share)
+			s.groups.emplace(hash, first);
+		return first;
+	}
+
+	uint32_t				identifierSize_ = 32;
+	Section					sections_[kShaderTableSectionCount];
+	std::vector<uint8_t>	data_;
+	ShaderTableStats		stats_;
+};	// class ShaderTableBuilder
+
+//	EOF
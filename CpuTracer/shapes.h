@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include "rt_math.h"
+
+// Sample02/shapes.h のCPU版（頂点レイアウトは同じ）
+
+struct Vertex
+{
+	float3	pos;
+	float3	normal;
+};
+
+// Box
+void GetBoxVertexAndIndexCount(int& vcount, int& icount);
+void CreateBoxVertexAndIndex(Vertex* pVertex, unsigned short* pIndex);
+
+// Sphere
+void GetShpereVertexAndIndexCount(int longCount, int latiCount, int& vcount, int& icount);
+void CreateSphereVertexAndIndex(int longCount, int latiCount, Vertex* pVertex, unsigned short* pIndex);
+
+//	EOF
@@ -0,0 +1,199 @@
+﻿#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+const char* GetTaskScheduleName(TaskSchedule schedule)
+{
+	static const char* kNames[kScheduleCount] = { "steal", "shared", "static" };
+	return (schedule < kScheduleCount) ? kNames[schedule] : "unknown";
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+	: nextTask_(0), remainingCount_(0)
+{
+	threadCount = std::max<uint32_t>(threadCount, 1);
+	for (uint32_t i = 0; i < threadCount; i++)
+		queues_.emplace_back(new TaskQueue());
+
+	threads_.reserve(threadCount - 1);
+	for (uint32_t i = 1; i < threadCount; i++)
+		threads_.emplace_back([this, i]() { WorkerMain(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		isQuit_ = true;
+	}
+	startCV_.notify_all();
+	for (auto&& t : threads_) t.join();
+}
+
+void ThreadPool::Run(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& func, TaskSchedule schedule, ThreadPoolStats* pStats)
+{
+	uint32_t threadCount = GetThreadCount();
+	stats_ = ThreadPoolStats();
+	stats_.threadTaskCounts.assign(threadCount, 0);
+	stats_.threadBusySeconds.assign(threadCount, 0.0);
+
+	if (taskCount > 0)
+	{
+		pFunc_ = &func;
+		schedule_ = schedule;
+		taskCount_ = taskCount;
+		nextTask_ = 0;
+		remainingCount_ = taskCount;
+
+		// 連続した範囲をスレッドごとのキューに配る
+		if (schedule != kScheduleShared)
+		{
+			for (uint32_t i = 0; i < threadCount; i++)
+			{
+				auto&& queue = *queues_[i];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.tasks.clear();
+				for (uint32_t task = (uint32_t)((uint64_t)taskCount * i / threadCount); task < (uint32_t)((uint64_t)taskCount * (i + 1) / threadCount); task++)
+					queue.tasks.push_back(task);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			activeCount_ = threadCount - 1;
+			generation_++;
+		}
+		startCV_.notify_all();
+
+		Work(0);
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		doneCV_.wait(lock, [&]() { return activeCount_ == 0; });
+		pFunc_ = nullptr;
+	}
+
+	if (pStats != nullptr)
+		*pStats = stats_;
+}
+
+void ThreadPool::WorkerMain(uint32_t threadIndex)
+{
+	uint64_t generation = 0;
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		startCV_.wait(lock, [&]() { return isQuit_ || generation_ != generation; });
+		if (isQuit_)
+			break;
+		generation = generation_;
+
+		lock.unlock();
+		Work(threadIndex);
+		lock.lock();
+
+		if (--activeCount_ == 0)
+			doneCV_.notify_one();
+	}
+}
+
+void ThreadPool::Work(uint32_t threadIndex)
+{
+	auto&& func = *pFunc_;
+	uint64_t taskCount = 0, stealCount = 0, stolenTaskCount = 0;
+	double busySeconds = 0.0;
+	auto Execute = [&](uint32_t task)
+	{
+		auto start = std::chrono::steady_clock::now();
+		func(task, threadIndex);
+		busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		taskCount++;
+	};
+
+	if (schedule_ == kScheduleShared)
+	{
+		while (true)
+		{
+			uint32_t task = nextTask_.fetch_add(1);
+			if (task >= taskCount_)
+				break;
+			Execute(task);
+		}
+	}
+	else
+	{
+		while (true)
+		{
+			uint32_t task;
+			if (PopTask(threadIndex, task))
+			{
+				remainingCount_--;
+				Execute(task);
+				continue;
+			}
+			if (schedule_ == kScheduleStatic)
+				break;
+
+			uint32_t stolen = StealTasks(threadIndex, task);
+			if (stolen > 0)
+			{
+				stealCount++;
+				stolenTaskCount += stolen;
+				remainingCount_--;
+				Execute(task);
+				continue;
+			}
+
+			// 盗んだスレッドが自分のキューに移している途中のタスクがあれば、見えるようになるまで待つ
+			if (remainingCount_ == 0)
+				break;
+			std::this_thread::yield();
+		}
+	}
+
+	stats_.threadTaskCounts[threadIndex] = taskCount;
+	stats_.threadBusySeconds[threadIndex] = busySeconds;
+	std::lock_guard<std::mutex> lock(mutex_);
+	stats_.stealCount += stealCount;
+	stats_.stolenTaskCount += stolenTaskCount;
+}
+
+bool ThreadPool::PopTask(uint32_t threadIndex, uint32_t& task)
+{
+	auto&& queue = *queues_[threadIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+		return false;
+	task = queue.tasks.front();
+	queue.tasks.pop_front();
+	return true;
+}
+
+uint32_t ThreadPool::StealTasks(uint32_t threadIndex, uint32_t& task)
+{
+	// 隣のスレッドから順に、タスクの残っているキューの後ろ半分を盗む
+	// 1つはすぐに実行し、残りは自分のキューに入れて前から処理する
+	uint32_t threadCount = GetThreadCount();
+	std::vector<uint32_t> stolen;
+	for (uint32_t i = 1; i < threadCount && stolen.empty(); i++)
+	{
+		auto&& victim = *queues_[(threadIndex + i) % threadCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		size_t count = (victim.tasks.size() + 1) / 2;
+		stolen.assign(victim.tasks.end() - count, victim.tasks.end());
+		victim.tasks.erase(victim.tasks.end() - count, victim.tasks.end());
+	}
+	if (stolen.empty())
+		return 0;
+
+	task = stolen.front();
+	if (stolen.size() > 1)
+	{
+		auto&& queue = *queues_[threadIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.insert(queue.tasks.end(), stolen.begin() + 1, stolen.end());
+	}
+	return (uint32_t)stolen.size();
+}
+
+//	EOF
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// タスクをスレッドに割り振る方法
+enum TaskSchedule
+{
+	kScheduleWorkStealing = 0,		// スレッドごとのキューに連続した範囲を配り、空いたら他のキューの後ろ半分を盗む
+	kScheduleShared,				// 1つのカウンタから空いたスレッドが順に取る
+	kScheduleStatic,				// 連続した範囲を配るだけで盗まない（比較用）
+
+	kScheduleCount
+};
+
+const char* GetTaskScheduleName(TaskSchedule schedule);
+
+struct ThreadPoolStats
+{
+	std::vector<uint64_t>	threadTaskCounts;		// スレッドごとに実行したタスク数
+	std::vector<double>		threadBusySeconds;		// スレッドごとにタスクを実行していた時間
+	uint64_t				stealCount = 0;			// 他のスレッドのキューから盗んだ回数
+	uint64_t				stolenTaskCount = 0;	// 盗んだタスク数
+};
+
+// 常駐するワーカースレッドでタスクを並列に処理する
+// Run ごとにスレッドを作らないので、フレームごとに呼んでも生成のコストがかからない
+class ThreadPool
+{
+public:
+	// threadCount は呼び出し元のスレッドを含む数
+	explicit ThreadPool(uint32_t threadCount);
+	~ThreadPool();
+
+	uint32_t GetThreadCount() const { return (uint32_t)queues_.size(); }
+
+	// taskCount 個のタスクを処理し終えるまで戻らない（呼び出し元のスレッドはスレッド0として働く）
+	// func はタスク番号と処理スレッド番号を受け取る
+	// 同時に呼べるのは1つのスレッドからだけ
+	void Run(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& func, TaskSchedule schedule = kScheduleWorkStealing, ThreadPoolStats* pStats = nullptr);
+
+private:
+	// スレッドごとのタスクキュー
+	// 持ち主は前から取り、盗むスレッドは後ろから取るので、持ち主は連続したタスクを順に処理できる
+	struct TaskQueue
+	{
+		std::mutex				mutex;
+		std::deque<uint32_t>	tasks;
+	};
+
+	void WorkerMain(uint32_t threadIndex);
+	void Work(uint32_t threadIndex);
+	bool PopTask(uint32_t threadIndex, uint32_t& task);
+	uint32_t StealTasks(uint32_t threadIndex, uint32_t& task);
+
+	std::vector<std::unique_ptr<TaskQueue>>	queues_;
+	std::vector<std::thread>				threads_;
+
+	std::mutex					mutex_;
+	std::condition_variable		startCV_;
+	std::condition_variable		doneCV_;
+	uint64_t					generation_ = 0;		// Run ごとに増える
+	uint32_t					activeCount_ = 0;		// 処理中のワーカースレッド数
+	bool						isQuit_ = false;
+
+	// Run の間だけ有効
+	const std::function<void(uint32_t, uint32_t)>*	pFunc_ = nullptr;
+	TaskSchedule				schedule_ = kScheduleWorkStealing;
+	uint32_t					taskCount_ = 0;
+	std::atomic<uint32_t>		nextTask_;				// kScheduleShared で次に取るタスク
+	std::atomic<uint32_t>		remainingCount_;		// まだ取られていないタスク数
+	ThreadPoolStats				stats_;
+};	// class ThreadPool
+
+//	EOF
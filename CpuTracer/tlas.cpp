@@ -0,0 +1,115 @@
+﻿#include "tlas.h"
+
+namespace
+{
+	// オブジェクト空間のバウンディングボックスの8頂点を変換してワールド空間のバウンディングボックスを求める
+	BoundingBox TransformBounds(const float3x4& t, const BoundingBox& b)
+	{
+		BoundingBox ret;
+		if (!b.IsValid())
+			return ret;
+
+		for (int i = 0; i < 8; i++)
+		{
+			float3 p((i & 1) ? b.bmax.x : b.bmin.x, (i & 2) ? b.bmax.y : b.bmin.y, (i & 4) ? b.bmax.z : b.bmin.z);
+			ret.Grow(TransformPoint(t, p));
+		}
+		return ret;
+	}
+}
+
+bool TopLevelAS::Build(const RaytracingInstanceDesc* instanceDescs, uint32_t instanceCount, const BoundingBox* blasBounds, uint32_t blasCount, const BvhBuildDesc& desc, BvhBuildStats* pStats)
+{
+	std::vector<BoundingBox> bounds;
+	if (!SetInstances(instanceDescs, instanceCount, blasBounds, blasCount, bounds))
+	{
+		instanceDescs_.clear();
+		worldToObject_.clear();
+		instanceBounds_.Resize(0);
+		return false;
+	}
+
+	if (!bvh_.Build(bounds.data(), instanceCount, desc, pStats))
+		return false;
+
+	SetInstanceBounds(bounds);
+	return true;
+}
+
+bool TopLevelAS::Update(const RaytracingInstanceDesc* instanceDescs, uint32_t instanceCount, const BoundingBox* blasBounds, uint32_t blasCount)
+{
+	// 更新できない場合は元のインスタンスのまま残す
+	if (instanceCount != instanceDescs_.size() || bvh_.IsQuantized())
+		return false;
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		if (instanceDescs[i].AccelerationStructure >= blasCount)
+			return false;
+	}
+
+	std::vector<BoundingBox> bounds;
+	SetInstances(instanceDescs, instanceCount, blasBounds, blasCount, bounds);
+	if (!bvh_.Refit(bounds.data(), instanceCount))
+		return false;
+
+	SetInstanceBounds(bounds);
+	return true;
+}
+
+bool TopLevelAS::SetInstances(const RaytracingInstanceDesc* instanceDescs, uint32_t instanceCount, const BoundingBox* blasBounds, uint32_t blasCount, std::vector<BoundingBox>& bounds)
+{
+	instanceDescs_.assign(instanceDescs, instanceDescs + instanceCount);
+	worldToObject_.resize(instanceCount);
+
+	bounds.assign(instanceCount, BoundingBox());
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		auto&& inst = instanceDescs_[i];
+		if (inst.AccelerationStructure >= blasCount)
+			return false;
+
+		worldToObject_[i] = Transform3x4Inverse(inst.Transform);
+
+		// InstanceMask が0のインスタンスはどのレイにも当たらないので空のボックスにしておく
+		if (inst.InstanceMask != 0)
+			bounds[i] = TransformBounds(inst.Transform, blasBounds[inst.AccelerationStructure]);
+	}
+	return true;
+}
+
+void TopLevelAS::SetInstanceBounds(const std::vector<BoundingBox>& bounds)
+{
+	auto&& primIndices = bvh_.GetPrimIndices();
+	instanceBounds_.Resize((uint32_t)bounds.size());
+	for (uint32_t i = 0; i < (uint32_t)bounds.size(); i++)
+	{
+		auto&& b = bounds[primIndices[i]];
+		instanceBounds_.Set(i, b.bmin, b.bmax);
+	}
+}
+
+void TopLevelAS::Save(AccelCacheWriter& writer) const
+{
+	bvh_.Save(writer);
+	writer.WriteArray(instanceDescs_);
+	writer.WriteArray(worldToObject_);
+	instanceBounds_.Save(writer);
+}
+
+bool TopLevelAS::Load(AccelCacheReader& reader, uint32_t blasCount)
+{
+	if (!bvh_.Load(reader) || !reader.ReadArray(instanceDescs_) || !reader.ReadArray(worldToObject_) || !instanceBounds_.Load(reader))
+		return false;
+
+	const size_t instanceCount = instanceDescs_.size();
+	if (bvh_.GetPrimIndices().size() != instanceCount || worldToObject_.size() != instanceCount || instanceBounds_.GetCount() != instanceCount)
+		return false;
+	for (auto&& inst : instanceDescs_)
+	{
+		if (inst.AccelerationStructure >= blasCount)
+			return false;
+	}
+	return true;
+}
+
+//	EOF
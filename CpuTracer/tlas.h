@@ -0,0 +1,185 @@
+﻿#pragma once
+
+#include "raytracing.h"
+#include "bvh.h"
+#include "aabb_simd.h"
+#include "packet.h"
+
+// トップレベルAS
+// インスタンスのワールド空間バウンディングボックスでBVHを構築する
+// ボトムレベルASはインデックスで参照するだけなので、同じジオメトリを複数のインスタンスで共有できる
+class TopLevelAS
+{
+public:
+	// blasBounds[desc.AccelerationStructure] が参照先ボトムレベルASのオブジェクト空間バウンディングボックス
+	bool Build(const RaytracingInstanceDesc* instanceDescs, uint32_t instanceCount, const BoundingBox* blasBounds, uint32_t blasCount, const BvhBuildDesc& desc, BvhBuildStats* pStats = nullptr);
+
+	// インスタンスの変換行列などを差し替え、BVHは構築し直さずにボックスだけを更新する（DXRの PERFORM_UPDATE 相当）
+	// instanceCount は構築時と同じであること。量子化ノードのBVHは更新できないので失敗し、その場合は Build し直す
+	bool Update(const RaytracingInstanceDesc* instanceDescs, uint32_t instanceCount, const BoundingBox* blasBounds, uint32_t blasCount);
+
+	// InstanceInclusionMask に一致するインスタンスについて func(instanceIndex, objectRay, tmax) を呼び出す
+	// objectRay はオブジェクト空間のレイで、方向ベクトルは正規化しないのでtの値はワールド空間と共通
+	// func は交差があれば tmax を更新し、探索を打ち切る場合は true を返す
+	template <typename Func>
+	void Traverse(const RayDesc& ray, uint32_t instanceInclusionMask, float& tmax, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		RayBoxPrecomp precomp(ray.Origin, ray.Direction);
+		auto&& primIndices = bvh_.GetPrimIndices();
+		bvh_.TraverseLeaves(ray.Origin, ray.Direction, ray.TMin, tmax, [&](uint32_t first, uint32_t count, float& tcur)
+		{
+			// リーフ内のインスタンスのバウンディングボックスでまとめて判定し、当たったものだけレイを変換する
+			for (uint32_t base = 0; base < count; base += kAABBBatchSize)
+			{
+				uint32_t n = std::min(count - base, kAABBBatchSize);
+				float tEnter[kAABBBatchSize];
+				uint32_t mask = IntersectAABBBatch(instanceBounds_, first + base, n, precomp, ray.TMin, tcur, tEnter);
+				if (pStats) pStats->primTests += n;
+				for (; mask != 0; mask &= mask - 1)
+				{
+					uint32_t index = primIndices[first + base + FirstBitIndex(mask)];
+					if ((instanceDescs_[index].InstanceMask & instanceInclusionMask) == 0)
+						continue;
+
+					auto&& worldToObject = worldToObject_[index];
+					RayDesc objRay = { TransformPoint(worldToObject, ray.Origin), ray.TMin, TransformVector(worldToObject, ray.Direction), tcur };
+					if (func(index, objRay, tcur))
+						return true;
+				}
+			}
+			return false;
+		}, pStats);
+	}
+
+	// パケット版
+	// パケットのいずれかのレイが当たる可能性のあるインスタンスについて func(instanceIndex, objectPacket) を呼び出す
+	// rayTMax はレイごとの tmax で、func の中で更新される
+	// packet は isCoherent であること（そうでなければレイ1本ずつ Traverse する）
+	template <typename Func>
+	void TraversePacket(const RayPacket& packet, uint32_t instanceInclusionMask, const float* rayTMax, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		auto PacketTMax = [&]()
+		{
+			float t = packet.tmin;
+			for (uint32_t r = 0; r < packet.rayCount; r++) t = std::max(t, rayTMax[r]);
+			return t;
+		};
+
+		RayPacket objPacket;
+		auto&& primIndices = bvh_.GetPrimIndices();
+		float packetTMax = PacketTMax();
+		bvh_.TraverseLeavesWith([&](const BvhNode& node, float tcur, float& tEnter)
+		{
+			return IntersectPacketBox(packet, node.bmin, node.bmax, tcur, tEnter);
+		}, packetTMax, [&](uint32_t first, uint32_t count, float& tcur)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (pStats) pStats->primTests++;
+				uint32_t index = primIndices[first + i];
+				if ((instanceDescs_[index].InstanceMask & instanceInclusionMask) == 0)
+					continue;
+
+				float3 bmin, bmax;
+				float tEnter;
+				instanceBounds_.Get(first + i, bmin, bmax);
+				if (!IntersectPacketBox(packet, bmin, bmax, tcur, tEnter))
+					continue;
+
+				TransformPacket(worldToObject_[index], packet, objPacket);
+				func(index, objPacket);
+				tcur = PacketTMax();
+			}
+			return false;
+		}, pStats);
+	}
+
+	// レイの束版（遮蔽判定用）
+	// batch.activeMask のレイのいずれかが当たる可能性のあるインスタンスについて func(instanceIndex, objectBatch) を呼び出す
+	// objectBatch の activeMask はインスタンスのボックスに当たったレイで、func は走査を終えたレイのビットをそこから外す
+	// 外されたビットは batch.activeMask からも外し、すべてのレイが終わったら走査をやめる
+	template <typename Func>
+	void TraverseBatch(RayBatch& batch, uint32_t instanceInclusionMask, Func&& func, TraversalStats* pStats = nullptr) const
+	{
+		RayBatch objBatch;
+		auto&& primIndices = bvh_.GetPrimIndices();
+		float batchTMax = batch.GetMaxTMax();
+		bvh_.TraverseLeavesWith([&](const BvhNode& node, float, float& tEnter)
+		{
+			return IntersectBatchBox(batch, node.bmin, node.bmax, tEnter);
+		}, batchTMax, [&](uint32_t first, uint32_t count, float&)
+		{
+			// リーフ内のインスタンスのバウンディングボックスはレイごとにまとめて判定し、インスタンスごとのレイのマスクにする
+			for (uint32_t base = 0; base < count; base += kAABBBatchSize)
+			{
+				uint32_t n = std::min(count - base, kAABBBatchSize);
+				uint32_t instanceRays[kAABBBatchSize] = {};
+				for (uint32_t mask = batch.activeMask; mask != 0; mask &= mask - 1)
+				{
+					uint32_t r = FirstBitIndex(mask);
+					float tEnter[kAABBBatchSize];
+					uint32_t hitMask = IntersectAABBBatch(instanceBounds_, first + base, n, batch.rays[r], batch.tmin[r], batch.tmax[r], tEnter);
+					if (pStats) pStats->primTests += n;
+					for (; hitMask != 0; hitMask &= hitMask - 1)
+						instanceRays[FirstBitIndex(hitMask)] |= 1u << r;
+				}
+
+				for (uint32_t i = 0; i < n; i++)
+				{
+					uint32_t index = primIndices[first + base + i];
+					uint32_t rays = instanceRays[i] & batch.activeMask;
+					if (rays == 0 || (instanceDescs_[index].InstanceMask & instanceInclusionMask) == 0)
+						continue;
+
+					TransformBatch(worldToObject_[index], batch, rays, objBatch);
+					func(index, objBatch);
+					batch.activeMask &= ~(rays & ~objBatch.activeMask);
+					if (batch.activeMask == 0)
+						return true;
+				}
+			}
+			return false;
+		}, pStats);
+	}
+
+	uint32_t GetInstanceCount() const { return (uint32_t)instanceDescs_.size(); }
+	const RaytracingInstanceDesc& GetInstanceDesc(uint32_t index) const { return instanceDescs_[index]; }
+	const float3x4& GetObjectToWorld(uint32_t index) const { return instanceDescs_[index].Transform; }
+	const float3x4& GetWorldToObject(uint32_t index) const { return worldToObject_[index]; }
+	const Bvh& GetBvh() const { return bvh_; }
+	size_t GetMemorySize() const
+	{
+		return bvh_.GetMemorySize() + instanceBounds_.GetMemorySize() + instanceDescs_.size() * (sizeof(RaytracingInstanceDesc) + sizeof(float3x4));
+	}
+	size_t GetAllocatedSize() const
+	{
+		return bvh_.GetAllocatedSize() + instanceBounds_.GetAllocatedSize()
+			+ instanceDescs_.capacity() * sizeof(RaytracingInstanceDesc) + worldToObject_.capacity() * sizeof(float3x4);
+	}
+
+	// 構築後に余分に確保した分を解放する
+	// Update で Refit するのでノードの形式は変えない
+	void Compact()
+	{
+		bvh_.Compact(bvh_.GetNodeFormat());
+		instanceBounds_.ShrinkToFit();
+		instanceDescs_.shrink_to_fit();
+		worldToObject_.shrink_to_fit();
+	}
+
+	// キャッシュへの保存と復元
+	// 復元時は参照先のボトムレベルASの数 blasCount で AccelerationStructure を確認する
+	void Save(AccelCacheWriter& writer) const;
+	bool Load(AccelCacheReader& reader, uint32_t blasCount);
+
+private:
+	bool SetInstances(const RaytracingInstanceDesc* instanceDescs, uint32_t instanceCount, const BoundingBox* blasBounds, uint32_t blasCount, std::vector<BoundingBox>& bounds);
+	void SetInstanceBounds(const std::vector<BoundingBox>& bounds);
+
+	Bvh									bvh_;
+	std::vector<RaytracingInstanceDesc>	instanceDescs_;
+	std::vector<float3x4>				worldToObject_;
+	AABBArraySoA						instanceBounds_;	// BVHのプリミティブ配列順に並べたワールド空間のバウンディングボックス
+};	// class TopLevelAS
+
+//	EOF
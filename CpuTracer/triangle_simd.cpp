@@ -0,0 +1,298 @@
+﻿#include "triangle_simd.h"
+#include "aabb_simd.h"
+
+#if defined(__AVX2__)
+#define TRIANGLE_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRIANGLE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+RayTrianglePrecomp::RayTrianglePrecomp(const float3& o, const float3& dir)
+	: origin(o)
+{
+	float3 a = abs(dir);
+	kz = (a.x > a.y) ? ((a.x > a.z) ? 0 : 2) : ((a.y > a.z) ? 1 : 2);
+	kx = (kz + 1) % 3;
+	ky = (kx + 1) % 3;
+	// 巻き方向が変わらないように、-z 向きなら x と y を入れ替える
+	if (dir[kz] < 0.0f)
+		std::swap(kx, ky);
+
+	sx = dir[kx] / dir[kz];
+	sy = dir[ky] / dir[kz];
+	sz = 1.0f / dir[kz];
+}
+
+void TriangleArraySoA::Resize(uint32_t count)
+{
+	count_ = count;
+	for (auto&& d : data_)
+		d.assign(count + kTriangleBatchSize, NAN);
+}
+
+void TriangleArraySoA::Set(uint32_t index, const float3& v0, const float3& v1, const float3& v2)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		data_[i][index] = v0[i];
+		data_[3 + i][index] = v1[i];
+		data_[6 + i][index] = v2[i];
+	}
+}
+
+void TriangleArraySoA::Get(uint32_t index, float3& v0, float3& v1, float3& v2) const
+{
+	for (int i = 0; i < 3; i++)
+	{
+		v0[i] = data_[i][index];
+		v1[i] = data_[3 + i][index];
+		v2[i] = data_[6 + i][index];
+	}
+}
+
+void TriangleArraySoA::Save(AccelCacheWriter& writer) const
+{
+	writer.WriteValue(count_);
+	for (auto&& d : data_)
+		writer.WriteArray(d);
+}
+
+bool TriangleArraySoA::Load(AccelCacheReader& reader)
+{
+	count_ = 0;
+	uint32_t count;
+	if (!reader.ReadValue(count))
+		return false;
+	for (auto&& d : data_)
+	{
+		if (!reader.ReadArray(d) || d.size() != (size_t)count + kTriangleBatchSize)
+			return false;
+	}
+	count_ = count;
+	return true;
+}
+
+namespace
+{
+	// 剪断した座標系での頂点（レイの原点が原点、方向が +z）
+	struct ShearedVertex
+	{
+		float	x, y, z;
+	};
+
+	ShearedVertex Shear(const RayTrianglePrecomp& ray, const float* px, const float* py, const float* pz)
+	{
+		float ax = *px - ray.origin[ray.kx];
+		float ay = *py - ray.origin[ray.ky];
+		float az = *pz - ray.origin[ray.kz];
+		ShearedVertex v = { ax - ray.sx * az, ay - ray.sy * az, ray.sz * az };
+		return v;
+	}
+
+	// 1つのトライアングルの判定（SIMD版で辺の関数が0になったレーンもこれで判定し直す）
+	bool IntersectTriangle(const TriangleArraySoA& tris, uint32_t index, const RayTrianglePrecomp& ray, uint32_t rayFlags,
+		float tmin, float tmax, float& t, float& u, float& v)
+	{
+		ShearedVertex a = Shear(ray, tris.GetComponent(0, ray.kx) + index, tris.GetComponent(0, ray.ky) + index, tris.GetComponent(0, ray.kz) + index);
+		ShearedVertex b = Shear(ray, tris.GetComponent(1, ray.kx) + index, tris.GetComponent(1, ray.ky) + index, tris.GetComponent(1, ray.kz) + index);
+		ShearedVertex c = Shear(ray, tris.GetComponent(2, ray.kx) + index, tris.GetComponent(2, ray.ky) + index, tris.GetComponent(2, ray.kz) + index);
+
+		// 辺の関数（符号がすべて同じなら内側）
+		float e0 = c.x * b.y - c.y * b.x;
+		float e1 = a.x * c.y - a.y * c.x;
+		float e2 = b.x * a.y - b.y * a.x;
+
+		// 辺の上では float の誤差で符号が決まらないので、double で計算し直す
+		if (e0 == 0.0f || e1 == 0.0f || e2 == 0.0f)
+		{
+			e0 = (float)((double)c.x * (double)b.y - (double)c.y * (double)b.x);
+			e1 = (float)((double)a.x * (double)c.y - (double)a.y * (double)c.x);
+			e2 = (float)((double)b.x * (double)a.y - (double)b.y * (double)a.x);
+		}
+		if ((e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) && (e0 > 0.0f || e1 > 0.0f || e2 > 0.0f))
+			return false;
+
+		// 時計回りに見える面（表面）なら det > 0（Moller-Trumbore の det と同じ符号）
+		float det = e0 + e1 + e2;
+		if (det == 0.0f || det != det)
+			return false;
+		if ((rayFlags & RAY_FLAG_CULL_BACK_FACING_TRIANGLES) && det < 0.0f)
+			return false;
+		if ((rayFlags & RAY_FLAG_CULL_FRONT_FACING_TRIANGLES) && det > 0.0f)
+			return false;
+
+		float tc = (e0 * a.z + e1 * b.z + e2 * c.z) / det;
+		if (!(tc >= tmin && tc < tmax))
+			return false;
+
+		t = tc;
+		u = e1 / det;
+		v = e2 / det;
+		return true;
+	}
+}
+
+uint32_t IntersectTriangleBatchScalar(const TriangleArraySoA& tris, uint32_t first, uint32_t count, const RayTrianglePrecomp& ray, uint32_t rayFlags,
+	float tmin, float tmax, float* t, float* u, float* v)
+{
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (IntersectTriangle(tris, first + i, ray, rayFlags, tmin, tmax, t[i], u[i], v[i]))
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+#if defined(TRIANGLE_SIMD_AVX2)
+
+uint32_t IntersectTriangleBatch(const TriangleArraySoA& tris, uint32_t first, uint32_t count, const RayTrianglePrecomp& ray, uint32_t rayFlags,
+	float tmin, float tmax, float* t, float* u, float* v)
+{
+	const __m256 kZero = _mm256_setzero_ps();
+	__m256 ox = _mm256_set1_ps(ray.origin[ray.kx]);
+	__m256 oy = _mm256_set1_ps(ray.origin[ray.ky]);
+	__m256 oz = _mm256_set1_ps(ray.origin[ray.kz]);
+	__m256 sx = _mm256_set1_ps(ray.sx);
+	__m256 sy = _mm256_set1_ps(ray.sy);
+	__m256 sz = _mm256_set1_ps(ray.sz);
+
+	__m256 px[3], py[3], pz[3];
+	for (int k = 0; k < 3; k++)
+	{
+		__m256 az = _mm256_sub_ps(_mm256_loadu_ps(tris.GetComponent(k, ray.kz) + first), oz);
+		px[k] = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(tris.GetComponent(k, ray.kx) + first), ox), _mm256_mul_ps(sx, az));
+		py[k] = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(tris.GetComponent(k, ray.ky) + first), oy), _mm256_mul_ps(sy, az));
+		pz[k] = _mm256_mul_ps(sz, az);
+	}
+
+	__m256 e0 = _mm256_sub_ps(_mm256_mul_ps(px[2], py[1]), _mm256_mul_ps(py[2], px[1]));
+	__m256 e1 = _mm256_sub_ps(_mm256_mul_ps(px[0], py[2]), _mm256_mul_ps(py[0], px[2]));
+	__m256 e2 = _mm256_sub_ps(_mm256_mul_ps(px[1], py[0]), _mm256_mul_ps(py[1], px[0]));
+
+	__m256 anyNeg = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(e0, kZero, _CMP_LT_OQ), _mm256_cmp_ps(e1, kZero, _CMP_LT_OQ)), _mm256_cmp_ps(e2, kZero, _CMP_LT_OQ));
+	__m256 anyPos = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(e0, kZero, _CMP_GT_OQ), _mm256_cmp_ps(e1, kZero, _CMP_GT_OQ)), _mm256_cmp_ps(e2, kZero, _CMP_GT_OQ));
+	__m256 anyZero = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(e0, kZero, _CMP_EQ_OQ), _mm256_cmp_ps(e1, kZero, _CMP_EQ_OQ)), _mm256_cmp_ps(e2, kZero, _CMP_EQ_OQ));
+
+	__m256 det = _mm256_add_ps(_mm256_add_ps(e0, e1), e2);
+	__m256 valid = _mm256_andnot_ps(_mm256_and_ps(anyNeg, anyPos), _mm256_cmp_ps(det, kZero, _CMP_NEQ_OQ));
+	if (rayFlags & RAY_FLAG_CULL_BACK_FACING_TRIANGLES)
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(det, kZero, _CMP_GT_OQ));
+	if (rayFlags & RAY_FLAG_CULL_FRONT_FACING_TRIANGLES)
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(det, kZero, _CMP_LT_OQ));
+
+	__m256 tc = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e0, pz[0]), _mm256_mul_ps(e1, pz[1])), _mm256_mul_ps(e2, pz[2])), det);
+	valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(tc, _mm256_set1_ps(tmin), _CMP_GE_OQ), _mm256_cmp_ps(tc, _mm256_set1_ps(tmax), _CMP_LT_OQ)));
+	_mm256_storeu_ps(t, tc);
+	_mm256_storeu_ps(u, _mm256_div_ps(e1, det));
+	_mm256_storeu_ps(v, _mm256_div_ps(e2, det));
+
+	uint32_t laneMask = (count >= 8) ? 0xffu : ((1u << count) - 1);
+	uint32_t mask = (uint32_t)_mm256_movemask_ps(valid) & laneMask;
+
+	// 辺の関数が0になったレーンはスカラー版で判定し直す
+	for (uint32_t retry = (uint32_t)_mm256_movemask_ps(anyZero) & laneMask; retry != 0; retry &= retry - 1)
+	{
+		uint32_t i = FirstBitIndex(retry);
+		mask &= ~(1u << i);
+		if (IntersectTriangle(tris, first + i, ray, rayFlags, tmin, tmax, t[i], u[i], v[i]))
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+uint32_t GetTriangleBatchSimdWidth()
+{
+	return 8;
+}
+
+#elif defined(TRIANGLE_SIMD_SSE2)
+
+uint32_t IntersectTriangleBatch(const TriangleArraySoA& tris, uint32_t first, uint32_t count, const RayTrianglePrecomp& ray, uint32_t rayFlags,
+	float tmin, float tmax, float* t, float* u, float* v)
+{
+	const __m128 kZero = _mm_setzero_ps();
+	__m128 ox = _mm_set1_ps(ray.origin[ray.kx]);
+	__m128 oy = _mm_set1_ps(ray.origin[ray.ky]);
+	__m128 oz = _mm_set1_ps(ray.origin[ray.kz]);
+	__m128 sx = _mm_set1_ps(ray.sx);
+	__m128 sy = _mm_set1_ps(ray.sy);
+	__m128 sz = _mm_set1_ps(ray.sz);
+	__m128 vtmin = _mm_set1_ps(tmin);
+	__m128 vtmax = _mm_set1_ps(tmax);
+
+	// 4個ずつ2回に分けて処理する
+	uint32_t mask = 0, zeroMask = 0;
+	for (uint32_t base = 0; base < count; base += 4)
+	{
+		__m128 px[3], py[3], pz[3];
+		for (int k = 0; k < 3; k++)
+		{
+			__m128 az = _mm_sub_ps(_mm_loadu_ps(tris.GetComponent(k, ray.kz) + first + base), oz);
+			px[k] = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.GetComponent(k, ray.kx) + first + base), ox), _mm_mul_ps(sx, az));
+			py[k] = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.GetComponent(k, ray.ky) + first + base), oy), _mm_mul_ps(sy, az));
+			pz[k] = _mm_mul_ps(sz, az);
+		}
+
+		__m128 e0 = _mm_sub_ps(_mm_mul_ps(px[2], py[1]), _mm_mul_ps(py[2], px[1]));
+		__m128 e1 = _mm_sub_ps(_mm_mul_ps(px[0], py[2]), _mm_mul_ps(py[0], px[2]));
+		__m128 e2 = _mm_sub_ps(_mm_mul_ps(px[1], py[0]), _mm_mul_ps(py[1], px[0]));
+
+		__m128 anyNeg = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(e0, kZero), _mm_cmplt_ps(e1, kZero)), _mm_cmplt_ps(e2, kZero));
+		__m128 anyPos = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(e0, kZero), _mm_cmpgt_ps(e1, kZero)), _mm_cmpgt_ps(e2, kZero));
+		__m128 anyZero = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(e0, kZero), _mm_cmpeq_ps(e1, kZero)), _mm_cmpeq_ps(e2, kZero));
+
+		__m128 det = _mm_add_ps(_mm_add_ps(e0, e1), e2);
+		__m128 valid = _mm_andnot_ps(_mm_and_ps(anyNeg, anyPos), _mm_cmpneq_ps(det, kZero));
+		if (rayFlags & RAY_FLAG_CULL_BACK_FACING_TRIANGLES)
+			valid = _mm_and_ps(valid, _mm_cmpgt_ps(det, kZero));
+		if (rayFlags & RAY_FLAG_CULL_FRONT_FACING_TRIANGLES)
+			valid = _mm_and_ps(valid, _mm_cmplt_ps(det, kZero));
+
+		__m128 tc = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e0, pz[0]), _mm_mul_ps(e1, pz[1])), _mm_mul_ps(e2, pz[2])), det);
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(tc, vtmin), _mm_cmplt_ps(tc, vtmax)));
+		_mm_storeu_ps(t + base, tc);
+		_mm_storeu_ps(u + base, _mm_div_ps(e1, det));
+		_mm_storeu_ps(v + base, _mm_div_ps(e2, det));
+
+		mask |= (uint32_t)_mm_movemask_ps(valid) << base;
+		zeroMask |= (uint32_t)_mm_movemask_ps(anyZero) << base;
+	}
+
+	uint32_t laneMask = (count >= 32) ? ~0u : ((1u << count) - 1);
+	mask &= laneMask;
+
+	// 辺の関数が0になったレーンはスカラー版で判定し直す
+	for (uint32_t retry = zeroMask & laneMask; retry != 0; retry &= retry - 1)
+	{
+		uint32_t i = FirstBitIndex(retry);
+		mask &= ~(1u << i);
+		if (IntersectTriangle(tris, first + i, ray, rayFlags, tmin, tmax, t[i], u[i], v[i]))
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+uint32_t GetTriangleBatchSimdWidth()
+{
+	return 4;
+}
+
+#else
+
+uint32_t IntersectTriangleBatch(const TriangleArraySoA& tris, uint32_t first, uint32_t count, const RayTrianglePrecomp& ray, uint32_t rayFlags,
+	float tmin, float tmax, float* t, float* u, float* v)
+{
+	return IntersectTriangleBatchScalar(tris, first, count, ray, rayFlags, tmin, tmax, t, u, v);
+}
+
+uint32_t GetTriangleBatchSimdWidth()
+{
+	return 1;
+}
+
+#endif
+
+//	EOF
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include "raytracing.h"
+#include "as_cache.h"
+
+#include <vector>
+
+// 1本のレイと複数のトライアングルを一括で判定するカーネル
+// 水密な判定（Woop, Benthin, Wald 2013）で、隣り合うトライアングルの共有する辺や頂点をレイがすり抜けない
+// AVX2が有効なら8個、SSE2なら4個ずつまとめて処理し、どちらも使えなければスカラーで処理する
+// barycentrics は BuiltInTriangleIntersectionAttributes と同じく頂点1と頂点2の重みで、
+// シェーダの n0 + b.x * (n1 - n0) + b.y * (n2 - n0) でそのまま補間できる
+
+static const uint32_t kTriangleBatchSize = 8;
+
+// レイごとに1回だけ計算しておく値
+// 方向の成分が最大の軸を kz とし、レイの方向が +z になるように剪断した座標系で判定する
+struct RayTrianglePrecomp
+{
+	float3	origin;
+	int		kx, ky, kz;
+	float	sx, sy, sz;
+
+	RayTrianglePrecomp()
+	{}
+	RayTrianglePrecomp(const float3& o, const float3& dir);
+};
+
+// SoA配置のトライアングル列（頂点0, 1, 2 の位置）
+// 末尾を kTriangleBatchSize 個分の NaN のトライアングルで埋めておくので、どの位置からでも8個まとめて読み込める
+class TriangleArraySoA
+{
+public:
+	void Resize(uint32_t count);
+	void Set(uint32_t index, const float3& v0, const float3& v1, const float3& v2);
+	void Get(uint32_t index, float3& v0, float3& v1, float3& v2) const;
+
+	uint32_t GetCount() const { return count_; }
+	size_t GetMemorySize() const { return data_[0].size() * sizeof(float) * 9; }
+	size_t GetAllocatedSize() const { return data_[0].capacity() * sizeof(float) * 9; }
+	void ShrinkToFit() { for (auto&& d : data_) d.shrink_to_fit(); }
+
+	// 頂点 vertex の軸 axis の成分
+	const float* GetComponent(int vertex, int axis) const { return data_[vertex * 3 + axis].data(); }
+
+	// キャッシュへの保存と復元
+	void Save(AccelCacheWriter& writer) const;
+	bool Load(AccelCacheReader& reader);
+
+private:
+	std::vector<float>	data_[9];
+	uint32_t			count_ = 0;
+};	// class TriangleArraySoA
+
+// tris の first から count 個（kTriangleBatchSize 以下）のトライアングルとレイの交差判定を行う
+// tmin <= t < tmax で当たったトライアングルのビットが立ったマスクを返し、t と barycentrics（u = 頂点1, v = 頂点2 の重み）を格納する
+// rayFlags の RAY_FLAG_CULL_BACK_FACING_TRIANGLES, RAY_FLAG_CULL_FRONT_FACING_TRIANGLES に対応する（時計回りに見える面が表面）
+uint32_t IntersectTriangleBatch(const TriangleArraySoA& tris, uint32_t first, uint32_t count, const RayTrianglePrecomp& ray, uint32_t rayFlags,
+	float tmin, float tmax, float* t, float* u, float* v);
+
+// スカラー版（SIMDが使えない環境での実装と検証用）
+uint32_t IntersectTriangleBatchScalar(const TriangleArraySoA& tris, uint32_t first, uint32_t count, const RayTrianglePrecomp& ray, uint32_t rayFlags,
+	float tmin, float tmax, float* t, float* u, float* v);
+
+// 実際に使われるSIMD幅
+uint32_t GetTriangleBatchSimdWidth();
+
+//	EOF
@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// アップロードページを作る側の抽象
+// D3D12 ではアップロードヒープのバッファ、CpuTracer では配列（CpuUploadPageHeap）で実装する
+class UploadPageHeap
+{
+public:
+	virtual ~UploadPageHeap() {}
+
+	// size バイトのページを作り、マップしたCPUアドレスとGPUアドレスを返す
+	// GPUアドレスは UploadArena で使う最大のアラインメントに揃っていること（D3D12 のバッファは64KB境界）
+	virtual bool CreatePage(uint64_t size, void** ppData, uint64_t* pAddress) = 0;
+
+	// CreatePage で作ったページをすべて破棄する
+	virtual void DestroyPages() = 0;
+};	// class UploadPageHeap
+
+// UploadArena から確保した領域
+// page と offset はページのバッファとその中の位置（ビューを作るときに使う）
+struct UploadAllocation
+{
+	uint32_t	page = 0;
+	uint64_t	offset = 0;
+	uint64_t	size = 0;
+	void*		pData = nullptr;
+	uint64_t	address = 0;
+};
+
+struct UploadArenaStats
+{
+	uint32_t	pageCount = 0;
+	uint64_t	pageBytes = 0;			// 作ったページの合計サイズ
+	uint64_t	allocCount = 0;
+	uint64_t	allocBytes = 0;
+	uint64_t	paddingBytes = 0;		// アラインメントで空けた分
+};
+
+// 小さなバッファを大きなアップロードページの中に詰めて置いていく線形アロケータ
+// 頂点バッファやAABB、インスタンス、StructuredBuffer のように作ったら書き換えないデータ用で、個別には解放せず Reset でまとめて捨てる
+// 今のページに収まらなければ新しいページを作り、ページより大きなものはそれ専用のページにする
+class UploadArena
+{
+public:
+	void Init(UploadPageHeap* pHeap, uint64_t pageSize)
+	{
+		pHeap_ = pHeap;
+		pageSize_ = pageSize;
+		pages_.clear();
+		stats_ = UploadArenaStats();
+	}
+
+	// size バイトを、ページ先頭からのオフセットが alignment の倍数になる位置に確保する
+	// alignment が2のべき乗ならGPUアドレスも揃い、StructuredBuffer の要素サイズを渡せば FirstElement で指せる位置になる
+	bool Allocate(uint64_t size, uint64_t alignment, UploadAllocation& alloc)
+	{
+		if (!pages_.empty())
+		{
+			auto&& page = pages_.back();
+			uint64_t offset = (page.used + alignment - 1) / alignment * alignment;
+			if (offset + size <= page.size)
+			{
+				stats_.paddingBytes += offset - page.used;
+				page.used = offset + size;
+				SetAllocation((uint32_t)pages_.size() - 1, offset, size, alloc);
+				return true;
+			}
+		}
+
+		// 今のページの残りは捨てる
+		Page page;
+		page.size = std::max(size, pageSize_);
+		page.used = size;
+		if (!pHeap_->CreatePage(page.size, &page.pData, &page.address))
+			return false;
+		pages_.push_back(page);
+		stats_.pageCount++;
+		stats_.pageBytes += page.size;
+		SetAllocation((uint32_t)pages_.size() - 1, 0, size, alloc);
+		return true;
+	}
+
+	// Allocate して pData をコピーする
+	bool Upload(const void* pData, uint64_t size, uint64_t alignment, UploadAllocation& alloc)
+	{
+		if (!Allocate(size, alignment, alloc))
+			return false;
+		memcpy(alloc.pData, pData, (size_t)size);
+		return true;
+	}
+
+	// すべての領域とページを捨てる
+	// GPUがもう参照していないことを呼び出し側で確認しておく
+	void Reset()
+	{
+		if (pHeap_ != nullptr)
+			pHeap_->DestroyPages();
+		pages_.clear();
+		stats_ = UploadArenaStats();
+	}
+
+	const UploadArenaStats& GetStats() const { return stats_; }
+
+private:
+	struct Page
+	{
+		uint64_t	size = 0;
+		uint64_t	used = 0;
+		void*		pData = nullptr;
+		uint64_t	address = 0;
+	};
+
+	void SetAllocation(uint32_t pageIndex, uint64_t offset, uint64_t size, UploadAllocation& alloc)
+	{
+		auto&& page = pages_[pageIndex];
+		alloc.page = pageIndex;
+		alloc.offset = offset;
+		alloc.size = size;
+		alloc.pData = static_cast<uint8_t*>(page.pData) + offset;
+		alloc.address = page.address + offset;
+		stats_.allocCount++;
+		stats_.allocBytes += size;
+	}
+
+	UploadPageHeap*			pHeap_ = nullptr;
+	uint64_t				pageSize_ = 0;
+	std::vector<Page>		pages_;
+	UploadArenaStats		stats_;
+};	// class UploadArena
+
+//	EOF
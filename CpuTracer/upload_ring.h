@@ -0,0 +1,110 @@
+﻿#pragma once
+
+#include "frame_pacer.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+
+// フレームごとにアップロードするデータを、1つの大きなバッファからリング状に切り出すアロケータ
+// バッファは起動時に一度だけマップしたままにしておき、ここではオフセットだけを管理する
+// 切り出した領域は EndFrame で渡したフェンス値に紐づき、キューがそのフェンス値まで進んだら Retire で再利用される
+struct UploadRingStats
+{
+	uint64_t	allocCount = 0;
+	uint64_t	allocBytes = 0;
+	uint64_t	peakSize = 0;			// 使用中の最大サイズ（アラインメントと末尾で捨てた分を含む）
+	uint64_t	waitCount = 0;			// 空きがなくてキューを待った回数
+};
+
+class UploadRing
+{
+public:
+	static const uint64_t kInvalidOffset = ~0ull;
+
+	// capacity はバッファのサイズで、使うアラインメントの倍数にしておく
+	void Init(uint64_t capacity)
+	{
+		capacity_ = capacity;
+		head_ = tail_ = 0;
+		frames_.clear();
+		stats_ = UploadRingStats();
+	}
+
+	// size バイトを alignment（2のべき乗）に揃えて切り出し、バッファ先頭からのオフセットを返す
+	// 末尾に収まらなければ先頭に戻り、空きがなければ kInvalidOffset を返す
+	uint64_t Allocate(uint64_t size, uint64_t alignment)
+	{
+		if (size > capacity_)
+			return kInvalidOffset;
+
+		uint64_t offset = head_ % capacity_;
+		uint64_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+		uint64_t start = head_ + (aligned - offset);
+		if (aligned + size > capacity_)
+		{
+			// 末尾の残りは捨てて先頭から切り出す
+			start = head_ + (capacity_ - offset);
+			aligned = 0;
+		}
+		if (start + size - tail_ > capacity_)
+			return kInvalidOffset;
+
+		head_ = start + size;
+		stats_.allocCount++;
+		stats_.allocBytes += size;
+		stats_.peakSize = std::max(stats_.peakSize, head_ - tail_);
+		return aligned;
+	}
+
+	// Allocate と同じだが、空きがなければ古いフレームの完了をキューで待って解放してから切り出す
+	// 処理中のフレームがなくなっても空きがなければ（今のフレームだけで溢れたら）kInvalidOffset を返す
+	uint64_t Allocate(uint64_t size, uint64_t alignment, FrameQueue& queue)
+	{
+		uint64_t offset = Allocate(size, alignment);
+		while (offset == kInvalidOffset && !frames_.empty())
+		{
+			queue.Wait(frames_.front().fenceValue);
+			stats_.waitCount++;
+			Retire(queue.GetCompletedValue());
+			offset = Allocate(size, alignment);
+		}
+		return offset;
+	}
+
+	// ここまでに切り出した領域は、キューのフェンスが fenceValue になるまで使われる
+	void EndFrame(uint64_t fenceValue)
+	{
+		frames_.push_back({ fenceValue, head_ });
+	}
+
+	// フェンスが completedValue まで進んだフレームの領域を再利用できるようにする
+	void Retire(uint64_t completedValue)
+	{
+		while (!frames_.empty() && frames_.front().fenceValue <= completedValue)
+		{
+			tail_ = frames_.front().head;
+			frames_.pop_front();
+		}
+	}
+
+	uint64_t GetCapacity() const { return capacity_; }
+	uint64_t GetUsedSize() const { return head_ - tail_; }
+	const UploadRingStats& GetStats() const { return stats_; }
+
+private:
+	struct Frame
+	{
+		uint64_t	fenceValue;
+		uint64_t	head;			// このフレームの終わりの位置
+	};
+
+	// head_ と tail_ は先頭に戻らずに増え続ける位置で、バッファ内のオフセットは capacity_ の剰余
+	uint64_t			capacity_ = 0;
+	uint64_t			head_ = 0;
+	uint64_t			tail_ = 0;
+	std::deque<Frame>	frames_;
+	UploadRingStats		stats_;
+};	// class UploadRing
+
+//	EOF
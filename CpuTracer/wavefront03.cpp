@@ -0,0 +1,263 @@
+﻿#include "wavefront03.h"
+
+#include <chrono>
+
+namespace
+{
+	// ヒットしたものの種類
+	enum SurfaceKind : uint8_t
+	{
+		kSurfaceMiss = 0,
+		kSurfaceSphere,
+		kSurfaceInnerBox,
+	};
+
+	// パスの1つの交点のシェーディングに必要な値（ClosestHit*Processor のローカル変数）
+	// シャドウの結果と反射の結果が揃ったら Resolve で合成する
+	struct PathVertex
+	{
+		SurfaceKind	kind;
+		float3		color;			// instance.color または aabb.color
+		float		NoL;
+		float		shadow;
+		float		reflectionNoL;	// 反射レイを飛ばした場合のみ
+	};
+
+	// 1スレッド分のキューとパスの状態
+	struct WavefrontWorkspace
+	{
+		RayQueue					primaryRays;
+		RayQueue					reflectionRays;
+		RayQueue					shadowRays;
+		HitQueue					hits;
+		RaySortScratch				sortScratch;
+		std::vector<PathVertex>		vertices[2];		// [0] プライマリレイの交点, [1] 反射レイの交点
+		std::vector<uint32_t>		pixelX, pixelY;
+		WavefrontStats				stats;
+	};
+
+	// シャドウレイはパスの番号の最上位ビットで反射レイの交点のものか区別する
+	static const uint32_t kShadowDepthBit = 0x80000000;
+
+	// キューのレイをすべてトレースし、同じ並びでヒット情報を返す
+	void TraceQueue(TraceContext03& ctx, uint32_t rayFlags, uint32_t rayContributionToHitGroupIndex, const RayQueue& rays, HitQueue& hits)
+	{
+		uint32_t count = rays.GetCount();
+		hits.Resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			HitInfo03 hit;
+			bool isHit = TraceRayQuery03(ctx, rayFlags, ~0u, rayContributionToHitGroupIndex, 1, rays.GetRay(i), hit);
+			hits.isHit[i] = isHit ? 1 : 0;
+			if (!isHit)
+				continue;
+			hits.t[i] = hit.t;
+			hits.instanceIndex[i] = hit.instanceIndex;
+			hits.primitiveIndex[i] = hit.primitiveIndex;
+			hits.hitGroupIndex[i] = hit.hitGroupIndex;
+			hits.normalX[i] = hit.normal.x;
+			hits.normalY[i] = hit.normal.y;
+			hits.normalZ[i] = hit.normal.z;
+		}
+	}
+
+	// ClosestHitSphereProcessor と ClosestHitInnerBoxProcessor の、TraceRay より前の部分
+	// シャドウレイと（プライマリレイの交点なら）反射レイをキューに書き出す
+	void ShadeHits(const Scene03& scene, const SceneCB& cb, WavefrontWorkspace& ws, const RayQueue& rays, uint32_t depth)
+	{
+		auto&& hits = ws.hits;
+		float3 lightDir = normalize(-cb.lightDir.xyz());
+		for (uint32_t i = 0; i < rays.GetCount(); i++)
+		{
+			uint32_t path = rays.pathIndex[i];
+			auto&& v = ws.vertices[depth][path];
+			if (!hits.isHit[i])
+			{
+				v.kind = kSurfaceMiss;
+				continue;
+			}
+
+			uint32_t hitGroup = hits.hitGroupIndex[i];
+			v.kind = (hitGroup == kSphereHitGroup) ? kSurfaceSphere : kSurfaceInnerBox;
+			v.color = (v.kind == kSurfaceSphere) ? scene.instances[hits.instanceIndex[i]].color.xyz() : scene.innerBoxAABBs[hits.primitiveIndex[i]].color.xyz();
+
+			float3 normal = hits.GetNormal(i);
+			float3 direction(rays.directionX[i], rays.directionY[i], rays.directionZ[i]);
+			float3 origin = float3(rays.originX[i], rays.originY[i], rays.originZ[i]) + direction * hits.t[i];
+			float3 shadowDir = GetShadowRayDir03(cb, ws.pixelX[path], ws.pixelY[path], hits.instanceIndex[i], hits.primitiveIndex[i]);
+			ws.shadowRays.Push(origin, 1e-4f, shadowDir, path | (depth > 0 ? kShadowDepthBit : 0));
+			v.NoL = saturate(dot(normal, lightDir));
+
+			// 反射するのは内箱のプライマリレイの交点だけ（反射レイの payload.color.w は0）
+			if (v.kind == kSurfaceInnerBox && depth == 0)
+			{
+				float3 reflection = dot(normal, -direction) * 2.0f * normal + direction;
+				ws.reflectionRays.Push(origin, 1e-5f, reflection, path);
+				v.reflectionNoL = saturate(dot(normal, reflection));
+			}
+		}
+	}
+
+	// クローゼストヒットシェーダの finalColor を同じ式で求める
+	float3 ResolveVertex(const SceneCB& cb, const PathVertex& v)
+	{
+		return v.color * cb.lightColor.xyz() * (v.NoL * v.shadow + 0.2f);
+	}
+}
+
+const char* GetWavefrontStageName(WavefrontStage stage)
+{
+	static const char* kNames[kWavefrontStageCount] = { "primary", "shade", "sort", "reflection", "shadow", "resolve" };
+	return (stage < kWavefrontStageCount) ? kNames[stage] : "unknown";
+}
+
+void DispatchRaysWavefront03(const Scene03& scene, const SceneCB& cb, const DispatchDesc& desc, Image& image, RenderStats& stats,
+	AccumImage* pAccum, WavefrontStats* pWavefrontStats)
+{
+	image.Resize(desc.width, desc.height);
+
+	bool accumulate = (cb.sampleCount > 0 && pAccum != nullptr);
+	if (accumulate && (pAccum->width != desc.width || pAccum->height != desc.height))
+		pAccum->Resize(desc.width, desc.height);
+
+	uint32_t threadCount = GetDispatchThreadCount(desc);
+	std::vector<TraceContext03> contexts(threadCount);
+	std::vector<WavefrontWorkspace> workspaces(threadCount);
+	uint32_t tilePixelCount = std::max<uint32_t>(desc.tileWidth, 1) * std::max<uint32_t>(desc.tileHeight, 1);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		contexts[i].scene = &scene;
+		contexts[i].cb = &cb;
+
+		auto&& ws = workspaces[i];
+		ws.primaryRays.Reserve(tilePixelCount);
+		ws.reflectionRays.Reserve(tilePixelCount);
+		ws.shadowRays.Reserve(tilePixelCount * 2);
+		for (auto&& v : ws.vertices) v.resize(tilePixelCount);
+		ws.pixelX.resize(tilePixelCount);
+		ws.pixelY.resize(tilePixelCount);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	DispatchTiles(desc, [&](const Tile& tile, uint32_t threadIndex)
+	{
+		auto&& ctx = contexts[threadIndex];
+		auto&& ws = workspaces[threadIndex];
+		auto stageStart = std::chrono::steady_clock::now();
+		auto EndStage = [&](WavefrontStage stage, uint64_t rayCount)
+		{
+			auto now = std::chrono::steady_clock::now();
+			ws.stats.seconds[stage] += std::chrono::duration<double>(now - stageStart).count();
+			ws.stats.rayCounts[stage] += rayCount;
+			stageStart = now;
+		};
+
+		// プライマリレイを生成してトレースする
+		ws.primaryRays.Clear();
+		ws.reflectionRays.Clear();
+		ws.shadowRays.Clear();
+		for (uint32_t y = tile.y0; y < tile.y1; y++)
+		{
+			for (uint32_t x = tile.x0; x < tile.x1; x++)
+			{
+				uint32_t path = ws.primaryRays.GetCount();
+				RayDesc ray = MakePrimaryRay03(cb, x, y, desc.width, desc.height);
+				ws.primaryRays.Push(ray.Origin, ray.TMin, ray.Direction, path);
+				ws.pixelX[path] = x;
+				ws.pixelY[path] = y;
+			}
+		}
+		TraceQueue(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, 0, ws.primaryRays, ws.hits);
+		EndStage(kWavefrontPrimary, ws.primaryRays.GetCount());
+
+		ShadeHits(scene, cb, ws, ws.primaryRays, 0);
+		EndStage(kWavefrontShade, 0);
+
+		// 反射レイの交点もシャドウレイを書き出すので、シャドウレイより先にトレースする
+		// 反射レイは壁ごとに向きが大きく違うので、並べ替えて同じ向きの近いレイを続けてトレースする
+		if (desc.sortSecondaryRays)
+		{
+			SortRayQueue(ws.reflectionRays, ws.sortScratch);
+			EndStage(kWavefrontSort, ws.reflectionRays.GetCount());
+		}
+		TraceQueue(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, 0, ws.reflectionRays, ws.hits);
+		EndStage(kWavefrontReflection, ws.reflectionRays.GetCount());
+		ShadeHits(scene, cb, ws, ws.reflectionRays, 1);
+		EndStage(kWavefrontShade, 0);
+
+		// シャドウレイは遮られたかどうかだけを使う（ClosestHitShadowProcessor は0、MissShadowProcessor は1）
+		if (desc.sortSecondaryRays)
+		{
+			SortRayQueue(ws.shadowRays, ws.sortScratch);
+			EndStage(kWavefrontSort, ws.shadowRays.GetCount());
+		}
+		// ヒット情報は要らないので、遮蔽判定で kMaxOcclusionBatch 本ずつ調べる
+		for (uint32_t first = 0; first < ws.shadowRays.GetCount(); first += kMaxOcclusionBatch)
+		{
+			uint32_t count = std::min(ws.shadowRays.GetCount() - first, kMaxOcclusionBatch);
+			RayDesc rays[kMaxOcclusionBatch];
+			for (uint32_t i = 0; i < count; i++)
+				rays[i] = ws.shadowRays.GetRay(first + i);
+			uint32_t occludedMask = OccludedBatch03(ctx, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0u, 1, 1, rays, count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t path = ws.shadowRays.pathIndex[first + i];
+				ws.vertices[(path & kShadowDepthBit) ? 1 : 0][path & ~kShadowDepthBit].shadow = (occludedMask & (1u << i)) ? 0.0f : 1.0f;
+			}
+		}
+		EndStage(kWavefrontShadow, ws.shadowRays.GetCount());
+
+		// 反射レイの結果を、それを飛ばしたプライマリレイの交点に合成する
+		uint32_t path = 0;
+		for (uint32_t y = tile.y0; y < tile.y1; y++)
+		{
+			for (uint32_t x = tile.x0; x < tile.x1; x++, path++)
+			{
+				auto&& v = ws.vertices[0][path];
+				float4 color;
+				if (v.kind == kSurfaceMiss)
+				{
+					color = float4(0, 0, 1, 1);		// MissProcessor
+				}
+				else
+				{
+					float3 finalColor = ResolveVertex(cb, v);
+					if (v.kind == kSurfaceInnerBox)
+					{
+						auto&& r = ws.vertices[1][path];
+						float3 reflColor = (r.kind == kSurfaceMiss) ? float3(0.0f) : ResolveVertex(cb, r);		// MissReflectionProcessor は黒
+						finalColor += v.color * reflColor * v.reflectionNoL;
+					}
+					color = float4(finalColor, 1);
+				}
+				image.Store(x, y, accumulate ? pAccum->Accumulate(x, y, color, cb.sampleCount) : color);
+			}
+		}
+		EndStage(kWavefrontResolve, 0);
+	}, &stats.tiles);
+	auto end = std::chrono::steady_clock::now();
+
+	stats.seconds = std::chrono::duration<double>(end - start).count();
+	stats.threadRayCounts.resize(threadCount);
+	stats.rayCount = 0;
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		stats.threadRayCounts[i] = contexts[i].rayCount;
+		stats.rayCount += contexts[i].rayCount;
+	}
+
+	if (pWavefrontStats != nullptr)
+	{
+		*pWavefrontStats = WavefrontStats();
+		for (auto&& ws : workspaces)
+		{
+			for (int s = 0; s < kWavefrontStageCount; s++)
+			{
+				pWavefrontStats->rayCounts[s] += ws.stats.rayCounts[s];
+				pWavefrontStats->seconds[s] += ws.stats.seconds[s];
+			}
+		}
+	}
+}
+
+//	EOF
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include "shader03.h"
+#include "ray_queue.h"
+#include "ray_sort.h"
+
+// Sample03 をウェーブフロント方式でレンダリングする
+// クローゼストヒットシェーダの中で TraceRay を再帰的に呼ぶ代わりに、段階（プライマリ、シェーディング、反射、シャドウ）ごとに
+// 次の段階のレイをレイの種類ごとのキューに書き出し、次の段階でまとめてトレースする
+// 結果は DispatchRays03 と同じになる
+
+enum WavefrontStage
+{
+	kWavefrontPrimary = 0,		// プライマリレイの生成とトレース
+	kWavefrontShade,			// ヒットしたレイのシェーディングと、シャドウレイ・反射レイの書き出し
+	kWavefrontSort,				// 反射レイとシャドウレイの並べ替え（DispatchDesc::sortSecondaryRays）
+	kWavefrontReflection,		// 反射レイのトレース
+	kWavefrontShadow,			// シャドウレイのトレース
+	kWavefrontResolve,			// パスごとの結果を合成して書き込む
+
+	kWavefrontStageCount
+};
+
+const char* GetWavefrontStageName(WavefrontStage stage);
+
+struct WavefrontStats
+{
+	uint64_t	rayCounts[kWavefrontStageCount] = {};
+	double		seconds[kWavefrontStageCount] = {};		// 全スレッドの合計
+};
+
+// DispatchRays03 と同じ引数で、タイルごとにウェーブフロントで処理する
+// キューはタイルの画素数分だけ確保し、スレッドごとに使い回す
+void DispatchRaysWavefront03(const Scene03& scene, const SceneCB& cb, const DispatchDesc& desc, Image& image, RenderStats& stats,
+	AccumImage* pAccum = nullptr, WavefrontStats* pWavefrontStats = nullptr);
+
+//	EOF
@@ -0,0 +1,441 @@
+// ͓IɌ肷vV[Wv~eBu
+// CpuTracer/procedural.h, procedural.cpp Ɠ\̂ƔŁACPUłƌʂv
+// AABB  CPU  GetProceduralAABBs ōă{gxASɓn
+//
+// VF[_̎g
+//   StructuredBuffer<ProceduralPrimitive> Primitives : register(tN);
+//
+//   float thit;
+//   float3 normal;
+//   if (IntersectProceduralPrimitive(Primitives[PrimitiveIndex()], ObjectRayOrigin(), ObjectRayDirection(), RayTMin(), RayTCurrent(), thit, normal))
+//   {
+//       MyAttribute attr;
+//       attr.normal = normalize(mul(normal, (float3x3)WorldToObject3x4()));
+//       ReportHit(thit, 0, attr);
+//   }
+
+#ifndef PROCEDURAL_HLSLI
+#define PROCEDURAL_HLSLI
+
+static const uint kProceduralCapsule = 0;		// p0-p1 ̐ radius0 ȓ
+static const uint kProceduralCylinder = 1;		// p0, p1 ʂ̒SƂ锼a radius0 ̉~
+static const uint kProceduralCone = 2;			// p0 Ŕa radius0Ap1 Ŕa radius1 ̉~
+static const uint kProceduralTorus = 3;			// S p0A p1iKς݁jAS~̔a radius0Aǂ̔a radius1
+static const uint kProceduralRoundedBox = 4;	// S p0ATCY p1 ̎ɉ̊p𔼌a radius0 Ŋۂ߂
+
+// CPUł ProceduralPrimitive Ɠ48oCg
+struct ProceduralPrimitive
+{
+	float3		p0;
+	float		radius0;
+	float3		p1;
+	float		radius1;
+	uint		shape;
+	uint		material;
+	uint2		padding;
+};
+
+// ʂ̋Ełǂ̖ʂɂ肳ȂԂłȂ悤ɁAEL
+static const float kPartEpsilon = 1e-5;
+
+// ̓rŌԋ߂qbg
+struct NearestHit
+{
+	float		tmin;
+	float		t;
+	uint		part;
+	bool		isHit;
+};
+
+void AddHit(inout NearestHit hit, float tc, uint part)
+{
+	if (tc >= hit.tmin && tc <= hit.t)
+	{
+		hit.t = tc;
+		hit.part = part;
+		hit.isHit = true;
+	}
+}
+
+// S̑Έʒu oc ̋idir ͒PʃxNgj
+bool SolveSphere(float3 oc, float3 dir, float radius, out float t0, out float t1)
+{
+	float b = dot(oc, dir);
+	float c = dot(oc, oc) - radius * radius;
+	float h = b * b - c;
+	t0 = t1 = 0;
+	if (h < 0.0)
+		return false;
+	h = sqrt(h);
+	t0 = -b - h;
+	t1 = -b + h;
+	return true;
+}
+
+// a*t^2 + 2*b*t + c = 0
+int SolveQuadratic(float a, float b, float c, out float2 t)
+{
+	t = float2(0, 0);
+	if (abs(a) < 1e-8)
+	{
+		if (abs(b) < 1e-8)
+			return 0;
+		t.x = -c / (2.0 * b);
+		return 1;
+	}
+	float h = b * b - a * c;
+	if (h < 0.0)
+		return 0;
+	h = sqrt(h);
+	t = float2((-b - h) / a, (-b + h) / a);
+	return 2;
+}
+
+// JvZ
+// part: 0 = , 1 = p0 ̔, 2 = p1 ̔
+void IntersectCapsule(ProceduralPrimitive prim, float3 ro, float3 rd, inout NearestHit hit)
+{
+	float r = prim.radius0;
+	float3 ba = prim.p1 - prim.p0;
+	float3 oa = ro - prim.p0;
+	float baba = dot(ba, ba);
+	float bard = dot(ba, rd);
+	float baoa = dot(ba, oa);
+	float eps = kPartEpsilon * baba;
+
+	float2 t;
+	int n = SolveQuadratic(baba - bard * bard, baba * dot(rd, oa) - baoa * bard, baba * dot(oa, oa) - baoa * baoa - r * r * baba, t);
+	for (int i = 0; i < n; i++)
+	{
+		float y = baoa + t[i] * bard;
+		if (y >= -eps && y <= baba + eps)
+			AddHit(hit, t[i], 0);
+	}
+
+	float t0, t1;
+	if (SolveSphere(oa, rd, r, t0, t1))
+	{
+		if (baoa + t0 * bard <= eps) AddHit(hit, t0, 1);
+		if (baoa + t1 * bard <= eps) AddHit(hit, t1, 1);
+	}
+	if (SolveSphere(ro - prim.p1, rd, r, t0, t1))
+	{
+		if (baoa + t0 * bard >= baba - eps) AddHit(hit, t0, 2);
+		if (baoa + t1 * bard >= baba - eps) AddHit(hit, t1, 2);
+	}
+}
+
+// ~ira == rb Ȃ~j
+// part: 0 = , 1 = p0 ̒, 2 = p1 ̒
+void IntersectCappedCone(float3 pa, float3 pb, float ra, float rb, float3 ro, float3 rd, inout NearestHit hit)
+{
+	float3 ba = pb - pa;
+	float height = length(ba);
+	if (height <= 0.0)
+		return;
+	float3 u = ba / height;
+	float k = (rb - ra) / height;
+	float3 oa = ro - pa;
+	float ou = dot(oa, u);
+	float du = dot(rd, u);
+	float eps = kPartEpsilon * height;
+
+	// : ̋^2 = (ra + k * ̈ʒu)^2
+	float m = ra + k * ou;
+	float n = k * du;
+	float2 t;
+	int count = SolveQuadratic(1.0 - du * du - n * n, dot(oa, rd) - ou * du - m * n, dot(oa, oa) - ou * ou - m * m, t);
+	for (int i = 0; i < count; i++)
+	{
+		float y = ou + t[i] * du;
+		if (y >= -eps && y <= height + eps && m + n * t[i] >= 0.0)
+			AddHit(hit, t[i], 0);
+	}
+
+	if (abs(du) > 1e-8)
+	{
+		float t0 = -ou / du;
+		float3 p0 = oa + rd * t0;
+		if (dot(p0, p0) <= ra * ra * (1.0 + kPartEpsilon))
+			AddHit(hit, t0, 1);
+
+		float t1 = (height - ou) / du;
+		float3 p1 = oa + rd * t1 - u * height;
+		if (dot(p1, p1) <= rb * rb * (1.0 + kPartEpsilon))
+			AddHit(hit, t1, 2);
+	}
+}
+
+float3 GetCappedConeNormal(float3 pa, float3 pb, float ra, float rb, float3 p, uint part)
+{
+	float3 ba = pb - pa;
+	float height = length(ba);
+	float3 u = ba / height;
+	if (part == 1)
+		return -u;
+	if (part == 2)
+		return u;
+
+	float3 pa2p = p - pa;
+	float3 q = pa2p - u * dot(pa2p, u);
+	float radial = length(q);
+	float k = (rb - ra) / height;
+	return normalize((radial > 0.0 ? q / radial : float3(0, 0, 0)) - u * k);
+}
+
+// s^4 + a2*s^2 + a1*s + a0 ƁA̔
+float TorusQuartic(float4 c, float s)
+{
+	return ((s * s + c.x) * s + c.y) * s + c.z;
+}
+float TorusQuarticDerivative(float4 c, float s)
+{
+	return (4.0 * s * s + 2.0 * c.x) * s + c.y;
+}
+
+//  [x0, x1] ŕς鎮̉񕪖@ŋ߂iderivative Ȃ̕j
+float BisectTorusQuartic(float4 c, float x0, float x1, bool derivative)
+{
+	float f0 = derivative ? TorusQuarticDerivative(c, x0) : TorusQuartic(c, x0);
+	for (int i = 0; i < 40; i++)
+	{
+		float xm = 0.5 * (x0 + x1);
+		float fm = derivative ? TorusQuarticDerivative(c, xm) : TorusQuartic(c, xm);
+		if ((fm < 0.0) == (f0 < 0.0))
+		{
+			x0 = xm;
+			f0 = fm;
+		}
+		else
+		{
+			x1 = xm;
+		}
+	}
+	return 0.5 * (x0 + x1);
+}
+
+// 4 s^4 + a2*s^2 + a1*s + a0 = 0  [lo, hi] ̒ōŏ̉
+// 2K̉ŋ؂1KPɂȂA1K̉ŋ؂ƌ̎PɂȂ̂ŁA
+// PȋԂƂɕς邩𒲂ׂē񕪖@ŉ
+bool SolveTorusQuartic(float a2, float a1, float a0, float lo, float hi, out float root)
+{
+	float4 c = float4(a2, a1, a0, 0);
+	root = 0;
+
+	float bounds[4];
+	int boundCount = 0;
+	bounds[boundCount++] = lo;
+	if (a2 < 0.0)
+	{
+		float s = sqrt(-a2 / 6.0);
+		if (-s > lo && -s < hi) bounds[boundCount++] = -s;
+		if (s > lo && s < hi) bounds[boundCount++] = s;
+	}
+	bounds[boundCount++] = hi;
+
+	float points[5];
+	int pointCount = 0;
+	points[pointCount++] = lo;
+	for (int i = 0; i + 1 < boundCount; i++)
+	{
+		float d0 = TorusQuarticDerivative(c, bounds[i]);
+		float d1 = TorusQuarticDerivative(c, bounds[i + 1]);
+		if ((d0 < 0.0) != (d1 < 0.0))
+			points[pointCount++] = BisectTorusQuartic(c, bounds[i], bounds[i + 1], true);
+	}
+	points[pointCount++] = hi;
+
+	for (int j = 0; j + 1 < pointCount; j++)
+	{
+		float f0 = TorusQuartic(c, points[j]);
+		float f1 = TorusQuartic(c, points[j + 1]);
+		if (f0 == 0.0)
+		{
+			root = points[j];
+			return true;
+		}
+		if ((f0 < 0.0) != (f1 < 0.0))
+		{
+			root = BisectTorusQuartic(c, points[j], points[j + 1], false);
+			return true;
+		}
+	}
+	return false;
+}
+
+// g[X
+// ro ͒Sɍł߂C̓_iIntersectProceduralPrimitive ňڂĂjȂ̂ o.rd = 0
+void IntersectTorus(ProceduralPrimitive prim, float3 ro, float3 rd, inout NearestHit hit)
+{
+	float R = prim.radius0;
+	float r = prim.radius1;
+	float3 axis = prim.p1;
+
+	float3 o = ro - prim.p0;
+	float oo = dot(o, o);
+	// O߂郌C̉Ԃ̒[ɗȂ悤ɁAOڋ傫
+	float boundRadius = (R + r) * 1.001;
+	if (oo > boundRadius * boundRadius)
+		return;
+	float halfLength = sqrt(boundRadius * boundRadius - oo);
+	float lo = max(-halfLength, hit.tmin);
+	float hi = min(halfLength, hit.t);
+	if (lo > hi)
+		return;
+
+	// (|p|^2 + R^2 - r^2)^2 - 4R^2 (|p|^2 - (p.axis)^2) = 0 Ao.rd = 0 g s ̎ɓWJ
+	float oy = dot(o, axis);
+	float dy = dot(rd, axis);
+	float g0 = oo + R * R - r * r;
+	float R4 = 4.0 * R * R;
+	float a2 = 2.0 * g0 - R4 * (1.0 - dy * dy);
+	float a1 = 2.0 * R4 * oy * dy;
+	float a0 = g0 * g0 - R4 * (oo - oy * oy);
+	float s;
+	if (SolveTorusQuartic(a2, a1, a0, lo, hi, s))
+		AddHit(hit, s, 0);
+}
+
+float3 GetTorusNormal(ProceduralPrimitive prim, float3 p)
+{
+	float R = prim.radius0;
+	float r = prim.radius1;
+	float3 q = p - prim.p0;
+	float qy = dot(q, prim.p1);
+	return normalize(q * (dot(q, q) + R * R - r * r) - (q - prim.p1 * qy) * (2.0 * R * R));
+}
+
+// pۂ߂i̔Ƌ̃~RtXL[aj
+// 6Aӂ̉~12{Ap̋8̂Ä̗̕ɂg
+// part: 0-5 = ʁi * 2 + ̑Ȃ1j, 6 = ӂƊpi@̓qbgʒu狁߂j
+void IntersectRoundedBox(ProceduralPrimitive prim, float3 ro, float3 rd, inout NearestHit hit)
+{
+	float r = prim.radius0;
+	float3 e = prim.p1 - r;
+	float3 o = ro - prim.p0;
+	float eps = kPartEpsilon * (max(e.x, max(e.y, e.z)) + r);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int j = (axis + 1) % 3;
+		int k = (axis + 2) % 3;
+
+		if (abs(rd[axis]) > 1e-8)
+		{
+			for (int side = 0; side < 2; side++)
+			{
+				float plane = side ? (e[axis] + r) : -(e[axis] + r);
+				float t = (plane - o[axis]) / rd[axis];
+				float pj = o[j] + rd[j] * t;
+				float pk = o[k] + rd[k] * t;
+				if (abs(pj) <= e[j] + eps && abs(pk) <= e[k] + eps)
+					AddHit(hit, t, axis * 2 + side);
+			}
+		}
+
+		if (r <= 0.0)
+			continue;
+		float a = rd[j] * rd[j] + rd[k] * rd[k];
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float sj = (corner & 1) ? 1.0 : -1.0;
+			float sk = (corner & 2) ? 1.0 : -1.0;
+			float qj = o[j] - sj * e[j];
+			float qk = o[k] - sk * e[k];
+			float2 t;
+			int n = SolveQuadratic(a, qj * rd[j] + qk * rd[k], qj * qj + qk * qk - r * r, t);
+			for (int i = 0; i < n; i++)
+			{
+				float3 p = o + rd * t[i];
+				if (abs(p[axis]) <= e[axis] + eps && sj * p[j] >= e[j] - eps && sk * p[k] >= e[k] - eps)
+					AddHit(hit, t[i], 6);
+			}
+		}
+	}
+
+	if (r <= 0.0)
+		return;
+	for (int c = 0; c < 8; c++)
+	{
+		float3 s = float3((c & 1) ? 1.0 : -1.0, (c & 2) ? 1.0 : -1.0, (c & 4) ? 1.0 : -1.0);
+		float t0, t1;
+		if (!SolveSphere(o - s * e, rd, r, t0, t1))
+			continue;
+		float3 p0 = o + rd * t0;
+		if (all(s * p0 >= e - eps))
+			AddHit(hit, t0, 6);
+		float3 p1 = o + rd * t1;
+		if (all(s * p1 >= e - eps))
+			AddHit(hit, t1, 6);
+	}
+}
+
+float3 GetRoundedBoxNormal(ProceduralPrimitive prim, float3 p, uint part)
+{
+	if (part < 6)
+	{
+		float3 n = float3(0, 0, 0);
+		n[part / 2] = (part & 1) ? 1.0 : -1.0;
+		return n;
+	}
+	float3 e = prim.p1 - prim.radius0;
+	float3 q = p - prim.p0;
+	return normalize(q - clamp(q, -e, e));
+}
+
+// IuWFNgԂ̃Cidirection ͐KȂĂ悢jƂ̌
+// [tmin, tmax] ̒ōł߂qbg thit ƊO̒Pʖ@Ԃ
+bool IntersectProceduralPrimitive(ProceduralPrimitive prim, float3 origin, float3 direction, float tmin, float tmax, out float thit, out float3 normal)
+{
+	thit = 0;
+	normal = float3(0, 0, 0);
+
+	float len = length(direction);
+	if (len <= 0.0)
+		return false;
+	float3 rd = direction / len;
+
+	// ̌_2ƌ̂ŁAv~eBu̒Sɍł߂C̓__ɂĉ
+	float3 center = (prim.shape <= kProceduralCone) ? (prim.p0 + prim.p1) * 0.5 : prim.p0;
+	float tshift = dot(center - origin, rd);
+	float3 ro = origin + rd * tshift;
+
+	NearestHit hit;
+	hit.tmin = tmin * len - tshift;
+	hit.t = tmax * len - tshift;
+	hit.part = 0;
+	hit.isHit = false;
+	switch (prim.shape)
+	{
+	case kProceduralCapsule: IntersectCapsule(prim, ro, rd, hit); break;
+	case kProceduralCylinder: IntersectCappedCone(prim.p0, prim.p1, prim.radius0, prim.radius0, ro, rd, hit); break;
+	case kProceduralCone: IntersectCappedCone(prim.p0, prim.p1, prim.radius0, prim.radius1, ro, rd, hit); break;
+	case kProceduralTorus: IntersectTorus(prim, ro, rd, hit); break;
+	case kProceduralRoundedBox: IntersectRoundedBox(prim, ro, rd, hit); break;
+	default: return false;
+	}
+	if (!hit.isHit)
+		return false;
+
+	float3 p = ro + rd * hit.t;
+	switch (prim.shape)
+	{
+	case kProceduralCapsule:
+		{
+			float3 ba = prim.p1 - prim.p0;
+			float h = saturate(dot(p - prim.p0, ba) / dot(ba, ba));
+			normal = normalize(p - prim.p0 - ba * h);
+		}
+		break;
+	case kProceduralCylinder: normal = GetCappedConeNormal(prim.p0, prim.p1, prim.radius0, prim.radius0, p, hit.part); break;
+	case kProceduralCone: normal = GetCappedConeNormal(prim.p0, prim.p1, prim.radius0, prim.radius1, p, hit.part); break;
+	case kProceduralTorus: normal = GetTorusNormal(prim, p); break;
+	default: normal = GetRoundedBoxNormal(prim, p, hit.part); break;
+	}
+	thit = (hit.t + tshift) / len;
+	return true;
+}
+
+#endif // PROCEDURAL_HLSLI
+
+// EOF
@@ -4,6 +4,12 @@ struct SceneCB
 	float4		camPos;
 	float4		lightDir;
 	float4		lightColor;
+
+	// vObVu_Oiׂ0ȂfS1Tvƃn[hVhEj
+	uint		frameIndex;			// ̌n
+	uint		sampleCount;		// ̃t[܂߂ėݐςTvi0ȂݐςȂj
+	float		lightRadius;		// š̔aiWAjA0Ȃn[hVhE
+	float		padding;
 };
 
 struct MyAttribute
@@ -33,15 +39,58 @@ RaytracingAccelerationStructure		Scene			: register(t0, space0);
 StructuredBuffer<Instance>			Instances		: register(t1, space0);
 StructuredBuffer<AABB>				InnerBoxAABBs	: register(t2, space0);
 RWTexture2D<float4>					RenderTarget	: register(u0);
+RWTexture2D<float4>					AccumBuffer		: register(u1);		// Tv̍v
 ConstantBuffer<SceneCB>				cbScene			: register(b0);
 
+static const float PI = 3.141592654;
+
+// fƂ̗ɎgnbViPCGACpuTracer  HashPcg Ɠj
+uint HashPcg(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+// salt œf̒̕ʂ̗priTusNZʒuAVhECȂǁj𕪂
+uint PixelSeed(uint2 index, uint salt)
+{
+	return HashPcg(index.x + HashPcg(index.y + HashPcg(cbScene.frameIndex + HashPcg(salt))));
+}
+
+// [0, 1)
+float HashToFloat(uint hash)
+{
+	return (float)(hash >> 8) * (1.0 / 16777216.0);
+}
+
+// ݐςꍇ́Ǎ̑傫̒ŃVhEC̕炵ă\tgVhEɂ
+// ͉fƃt[Aqbgv~eBuŌ߂
+float3 SampleLightDir(float3 lightDir)
+{
+	if (cbScene.sampleCount == 0 || cbScene.lightRadius <= 0.0)
+		return lightDir;
+
+	uint seed = PixelSeed(DispatchRaysIndex().xy, 2 + (InstanceIndex() << 16) + PrimitiveIndex());
+	float r = tan(cbScene.lightRadius) * sqrt(HashToFloat(seed));
+	float phi = HashToFloat(HashPcg(seed)) * PI * 2.0;
+
+	float3 up = (abs(lightDir.y) < 0.999) ? float3(0, 1, 0) : float3(1, 0, 0);
+	float3 t = normalize(cross(up, lightDir));
+	float3 b = cross(lightDir, t);
+	return normalize(lightDir + (t * cos(phi) + b * sin(phi)) * r);
+}
 
 [shader("raygeneration")]
 void RayGenerator()
 {
 	// sNZSWNbvԍWɕϊ
-	uint2 index = DispatchRaysIndex();
-	float2 xy = (float2)index + 0.5;
+	// ݐςꍇ̓t[ƂɃsNZł炷
+	uint2 index = DispatchRaysIndex().xy;
+	float2 jitter = 0.5;
+	if (cbScene.sampleCount > 0)
+		jitter = float2(HashToFloat(PixelSeed(index, 0)), HashToFloat(PixelSeed(index, 1)));
+	float2 xy = (float2)index + jitter;
 	float2 clipSpacePos = xy / DispatchRaysDimensions() * float2(2, -2) + float2(-1, 1);
 
 	// NbvԍW[hԍWɕϊ
@@ -57,8 +106,20 @@ void RayGenerator()
 	HitData payload = { float4(0, 0, 0, 1) };
 	TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 1, 0, ray, payload);
 
+	// ݐςꍇ͍vݐσobt@ɏāA܂ł̃Tv̕ςo͂
+	// sampleCount 1ȂÕt[܂ł̍v͎̂Ă
+	float4 color = payload.color;
+	if (cbScene.sampleCount > 0)
+	{
+		float4 sum = color;
+		if (cbScene.sampleCount > 1)
+			sum += AccumBuffer[index];
+		AccumBuffer[index] = sum;
+		color = sum * (1.0 / (float)cbScene.sampleCount);
+	}
+
 	// Write the raytraced color to the output texture.
-	RenderTarget[index] = payload.color;
+	RenderTarget[index] = color;
 }
 
 bool SolveQuadraticEqn(float a, float b, float c, out float x0, out float x1)
@@ -116,19 +177,21 @@ bool IntersectToSphere(float3 s_center, float s_radius, float3 ray_origin, float
 
 bool IntersectToAABBDetail(float3 aabb[2], float3 ray_origin, float3 ray_dir, out float tmin, out float tmax)
 {
+	// Z͋ťvZ1񂾂ɂ
 	float3 tmin3, tmax3;
+	float3 invDir = 1.0 / ray_dir;
 	int3 sign3 = ray_dir > 0;
-	tmin3.x = (aabb[1 - sign3.x].x - ray_origin.x) / ray_dir.x;
-	tmax3.x = (aabb[sign3.x].x - ray_origin.x) / ray_dir.x;
+	tmin3.x = (aabb[1 - sign3.x].x - ray_origin.x) * invDir.x;
+	tmax3.x = (aabb[sign3.x].x - ray_origin.x) * invDir.x;
 
-	tmin3.y = (aabb[1 - sign3.y].y - ray_origin.y) / ray_dir.y;
-	tmax3.y = (aabb[sign3.y].y - ray_origin.y) / ray_dir.y;
+	tmin3.y = (aabb[1 - sign3.y].y - ray_origin.y) * invDir.y;
+	tmax3.y = (aabb[sign3.y].y - ray_origin.y) * invDir.y;
 
-	tmin3.z = (aabb[1 - sign3.z].z - ray_origin.z) / ray_dir.z;
-	tmax3.z = (aabb[sign3.z].z - ray_origin.z) / ray_dir.z;
+	tmin3.z = (aabb[1 - sign3.z].z - ray_origin.z) * invDir.z;
+	tmax3.z = (aabb[sign3.z].z - ray_origin.z) * invDir.z;
 
 	tmin = max(max(tmin3.x, tmin3.y), tmin3.z);
-	tmax = min(min(tmax3.x, tmax3.z), tmax3.z);
+	tmax = min(min(tmax3.x, tmax3.y), tmax3.z);
 
 	return tmax > tmin && tmax >= RayTMin() && tmin <= RayTCurrent();
 }
@@ -211,9 +274,10 @@ void ClosestHitSphereProcessor(inout HitData payload : SV_RayPayload, in MyAttri
 	float shadow = 1.0;
 	{
 		float3 origin = WorldRayOrigin() + WorldRayDirection() * RayTCurrent();
-		RayDesc ray = { origin, 1e-4, lightDir, 10000.0f };
+		RayDesc ray = { origin, 1e-4, SampleLightDir(lightDir), 10000.0f };
+		// qbg0̂܂܁iN[[XgqbgVF[_͌Ă΂ȂjA~XȂ MissShadowProcessor 1
 		HitData shadow_payload = { float4(0, 0, 0, 0) };
-		TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH, ~0, 1, 1, 1, ray, shadow_payload);
+		TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER, ~0, 1, 1, 1, ray, shadow_payload);
 		shadow = shadow_payload.color.x;
 	}
 
@@ -250,9 +314,10 @@ void ClosestHitInnerBoxProcessor(inout HitData payload : SV_RayPayload, in MyAtt
 	float shadow = 1.0;
 	{
 		float3 origin = WorldRayOrigin() + WorldRayDirection() * RayTCurrent();
-		RayDesc ray = { origin, 1e-4, lightDir, 10000.0f };
+		RayDesc ray = { origin, 1e-4, SampleLightDir(lightDir), 10000.0f };
+		// qbg0̂܂܁iN[[XgqbgVF[_͌Ă΂ȂjA~XȂ MissShadowProcessor 1
 		HitData shadow_payload = { float4(0, 0, 0, 0) };
-		TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH, ~0, 1, 1, 1, ray, shadow_payload);
+		TraceRay(Scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES | RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER, ~0, 1, 1, 1, ray, shadow_payload);
 		shadow = shadow_payload.color.x;
 	}
 